@@ -0,0 +1,55 @@
+# - Find lz4
+# Find the native LZ4 includes and library
+#
+#  LZ4_INCLUDE_DIRS - where to find lz4frame.h, etc.
+#  LZ4_LIBRARIES    - List of libraries when using lz4.
+#  LZ4_VERSION      - Version of lz4 as given in lz4.h
+#  LZ4_FOUND        - True if lz4 found in the requested version.
+
+
+IF (LZ4_INCLUDE_DIRS)
+  # Already in cache, be silent
+  SET(LZ4_FIND_QUIETLY TRUE)
+ENDIF (LZ4_INCLUDE_DIRS)
+
+FIND_PATH(LZ4_INCLUDE_DIR lz4frame.h)
+
+SET(LZ4_NAMES lz4)
+FIND_LIBRARY(LZ4_LIBRARY NAMES ${LZ4_NAMES} )
+
+SET(LZ4_VERSION)
+SET(LZ4_VERSION_OK FALSE)
+IF(LZ4_INCLUDE_DIR AND EXISTS "${LZ4_INCLUDE_DIR}/lz4.h")
+  FILE(STRINGS "${LZ4_INCLUDE_DIR}/lz4.h" _LZ4_VERSION_LINES
+       REGEX "#define LZ4_VERSION_(MAJOR|MINOR|RELEASE) +[0-9]+")
+  STRING(REGEX REPLACE ".*LZ4_VERSION_MAJOR +([0-9]+).*" "\\1"
+         _LZ4_VERSION_MAJOR "${_LZ4_VERSION_LINES}")
+  STRING(REGEX REPLACE ".*LZ4_VERSION_MINOR +([0-9]+).*" "\\1"
+         _LZ4_VERSION_MINOR "${_LZ4_VERSION_LINES}")
+  STRING(REGEX REPLACE ".*LZ4_VERSION_RELEASE +([0-9]+).*" "\\1"
+         _LZ4_VERSION_RELEASE "${_LZ4_VERSION_LINES}")
+  SET(LZ4_VERSION
+      "${_LZ4_VERSION_MAJOR}.${_LZ4_VERSION_MINOR}.${_LZ4_VERSION_RELEASE}")
+  SET(LZ4_VERSION_OK TRUE)
+  IF(LZ4_FIND_VERSION AND LZ4_VERSION VERSION_LESS LZ4_FIND_VERSION)
+    MESSAGE(STATUS "lz4 ${LZ4_VERSION} found in ${LZ4_INCLUDE_DIR}, "
+                   "at least ${LZ4_FIND_VERSION} required")
+    SET(LZ4_VERSION_OK FALSE)
+  ENDIF(LZ4_FIND_VERSION AND LZ4_VERSION VERSION_LESS LZ4_FIND_VERSION)
+ENDIF(LZ4_INCLUDE_DIR AND EXISTS "${LZ4_INCLUDE_DIR}/lz4.h")
+
+# handle the QUIETLY and REQUIRED arguments and set LZ4_FOUND to TRUE if
+# all listed variables are TRUE
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(LZ4 DEFAULT_MSG LZ4_LIBRARY LZ4_INCLUDE_DIR
+                                  LZ4_VERSION_OK)
+
+IF(LZ4_FOUND)
+  SET( LZ4_LIBRARIES ${LZ4_LIBRARY} )
+  SET( LZ4_INCLUDE_DIRS ${LZ4_INCLUDE_DIR} )
+ELSE(LZ4_FOUND)
+  SET( LZ4_LIBRARIES )
+  SET( LZ4_INCLUDE_DIRS )
+ENDIF(LZ4_FOUND)
+
+MARK_AS_ADVANCED( LZ4_LIBRARIES LZ4_INCLUDE_DIRS )
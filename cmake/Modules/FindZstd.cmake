@@ -0,0 +1,55 @@
+# - Find zstd
+# Find the native ZSTD includes and library
+#
+#  ZSTD_INCLUDE_DIRS - where to find zstd.h, etc.
+#  ZSTD_LIBRARIES    - List of libraries when using zstd.
+#  ZSTD_VERSION      - Version of zstd as given in zstd.h
+#  ZSTD_FOUND        - True if zstd found in the requested version.
+
+
+IF (ZSTD_INCLUDE_DIRS)
+  # Already in cache, be silent
+  SET(ZSTD_FIND_QUIETLY TRUE)
+ENDIF (ZSTD_INCLUDE_DIRS)
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h)
+
+SET(ZSTD_NAMES zstd)
+FIND_LIBRARY(ZSTD_LIBRARY NAMES ${ZSTD_NAMES} )
+
+SET(ZSTD_VERSION)
+SET(ZSTD_VERSION_OK FALSE)
+IF(ZSTD_INCLUDE_DIR AND EXISTS "${ZSTD_INCLUDE_DIR}/zstd.h")
+  FILE(STRINGS "${ZSTD_INCLUDE_DIR}/zstd.h" _ZSTD_VERSION_LINES
+       REGEX "#define ZSTD_VERSION_(MAJOR|MINOR|RELEASE) +[0-9]+")
+  STRING(REGEX REPLACE ".*ZSTD_VERSION_MAJOR +([0-9]+).*" "\\1"
+         _ZSTD_VERSION_MAJOR "${_ZSTD_VERSION_LINES}")
+  STRING(REGEX REPLACE ".*ZSTD_VERSION_MINOR +([0-9]+).*" "\\1"
+         _ZSTD_VERSION_MINOR "${_ZSTD_VERSION_LINES}")
+  STRING(REGEX REPLACE ".*ZSTD_VERSION_RELEASE +([0-9]+).*" "\\1"
+         _ZSTD_VERSION_RELEASE "${_ZSTD_VERSION_LINES}")
+  SET(ZSTD_VERSION
+      "${_ZSTD_VERSION_MAJOR}.${_ZSTD_VERSION_MINOR}.${_ZSTD_VERSION_RELEASE}")
+  SET(ZSTD_VERSION_OK TRUE)
+  IF(Zstd_FIND_VERSION AND ZSTD_VERSION VERSION_LESS Zstd_FIND_VERSION)
+    MESSAGE(STATUS "zstd ${ZSTD_VERSION} found in ${ZSTD_INCLUDE_DIR}, "
+                   "at least ${Zstd_FIND_VERSION} required")
+    SET(ZSTD_VERSION_OK FALSE)
+  ENDIF(Zstd_FIND_VERSION AND ZSTD_VERSION VERSION_LESS Zstd_FIND_VERSION)
+ENDIF(ZSTD_INCLUDE_DIR AND EXISTS "${ZSTD_INCLUDE_DIR}/zstd.h")
+
+# handle the QUIETLY and REQUIRED arguments and set ZSTD_FOUND to TRUE if
+# all listed variables are TRUE
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(ZSTD DEFAULT_MSG ZSTD_LIBRARY ZSTD_INCLUDE_DIR
+                                  ZSTD_VERSION_OK)
+
+IF(ZSTD_FOUND)
+  SET( ZSTD_LIBRARIES ${ZSTD_LIBRARY} )
+  SET( ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR} )
+ELSE(ZSTD_FOUND)
+  SET( ZSTD_LIBRARIES )
+  SET( ZSTD_INCLUDE_DIRS )
+ENDIF(ZSTD_FOUND)
+
+MARK_AS_ADVANCED( ZSTD_LIBRARIES ZSTD_INCLUDE_DIRS )
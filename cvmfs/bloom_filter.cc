@@ -0,0 +1,270 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "bloom_filter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "logging.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+const double BloomFilter::kDefaultFalsePositiveRate = 0.01;
+
+
+BloomFilter::Layer::Layer(
+  const uint64_t capacity,
+  const double false_positive_rate)
+  : capacity(capacity)
+  , count(0)
+{
+  assert(capacity > 0);
+  assert((false_positive_rate > 0.0) && (false_positive_rate < 1.0));
+  const double ln2 = log(2.0);
+  const double m =
+    -static_cast<double>(capacity) * log(false_positive_rate) / (ln2 * ln2);
+  num_bits = ((static_cast<uint64_t>(ceil(m)) + 63) / 64) * 64;
+  const double k = ceil(m / static_cast<double>(capacity) * ln2);
+  num_hashes = std::max(1, std::min(16, static_cast<int>(k)));
+  bits.resize(num_bits / 64, 0);
+}
+
+
+BloomFilter::Layer::Layer(const LayerHeader &header)
+  : capacity(header.capacity)
+  , num_bits(header.num_bits)
+  , num_hashes(header.num_hashes)
+  , count(header.count)
+  , bits(header.num_bits / 64, 0)
+{ }
+
+
+void BloomFilter::Layer::Set(const uint64_t h1, const uint64_t h2) {
+  for (unsigned i = 0; i < num_hashes; ++i) {
+    const uint64_t bit = (h1 + i * h2) % num_bits;
+    bits[bit / 64] |= (uint64_t(1) << (bit % 64));
+  }
+}
+
+
+bool BloomFilter::Layer::Test(const uint64_t h1, const uint64_t h2) const {
+  for (unsigned i = 0; i < num_hashes; ++i) {
+    const uint64_t bit = (h1 + i * h2) % num_bits;
+    if ((bits[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+BloomFilter::BloomFilter(
+  const uint64_t capacity,
+  const double false_positive_rate)
+  : false_positive_rate_(false_positive_rate)
+  , count_(0)
+{
+  layers_.push_back(new Layer(capacity, false_positive_rate));
+}
+
+
+BloomFilter::BloomFilter(const FileHeader &header)
+  : false_positive_rate_(header.false_positive_rate)
+  , count_(0)
+{ }
+
+
+BloomFilter::~BloomFilter() {
+  for (unsigned i = 0; i < layers_.size(); ++i)
+    delete layers_[i];
+}
+
+
+BloomFilter *BloomFilter::Load(const string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  FileHeader header;
+  ssize_t nbytes = SafeRead(fd, &header, sizeof(header));
+  if ((nbytes != static_cast<ssize_t>(sizeof(header))) ||
+      (header.magic != kMagic) || (header.version != kVersion) ||
+      (header.num_layers == 0) || (header.num_layers > kMaxLayers) ||
+      !(header.false_positive_rate > 0.0) ||
+      !(header.false_positive_rate < 1.0))
+  {
+    LogCvmfs(kLogCvmfs, kLogDebug, "invalid Bloom filter header in %s",
+             path.c_str());
+    close(fd);
+    return NULL;
+  }
+
+  BloomFilter *result = new BloomFilter(header);
+  for (unsigned i = 0; i < header.num_layers; ++i) {
+    LayerHeader layer_header;
+    nbytes = SafeRead(fd, &layer_header, sizeof(layer_header));
+    if ((nbytes != static_cast<ssize_t>(sizeof(layer_header))) ||
+        (layer_header.num_hashes == 0) || (layer_header.capacity == 0) ||
+        (layer_header.num_bits == 0) || (layer_header.num_bits % 64 != 0))
+    {
+      LogCvmfs(kLogCvmfs, kLogDebug, "invalid Bloom filter layer in %s",
+               path.c_str());
+      close(fd);
+      delete result;
+      return NULL;
+    }
+
+    Layer *layer = new Layer(layer_header);
+    result->layers_.push_back(layer);
+    result->count_ += layer->count;
+    const size_t size = layer->bits.size() * sizeof(uint64_t);
+    nbytes = SafeRead(fd, &layer->bits[0], size);
+    if (nbytes != static_cast<ssize_t>(size)) {
+      LogCvmfs(kLogCvmfs, kLogDebug, "truncated Bloom filter in %s",
+               path.c_str());
+      close(fd);
+      delete result;
+      return NULL;
+    }
+  }
+  close(fd);
+  return result;
+}
+
+
+bool BloomFilter::Save(const string &path) const {
+  const string tmp_path = path + ".tmp";
+  const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to create %s (errno: %d)",
+             tmp_path.c_str(), errno);
+    return false;
+  }
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.num_layers = layers_.size();
+  header.false_positive_rate = false_positive_rate_;
+  bool retval = SafeWrite(fd, &header, sizeof(header));
+  for (unsigned i = 0; retval && (i < layers_.size()); ++i) {
+    const Layer *layer = layers_[i];
+    LayerHeader layer_header;
+    memset(&layer_header, 0, sizeof(layer_header));
+    layer_header.num_hashes = layer->num_hashes;
+    layer_header.num_bits = layer->num_bits;
+    layer_header.capacity = layer->capacity;
+    layer_header.count = layer->count;
+    retval = SafeWrite(fd, &layer_header, sizeof(layer_header)) &&
+             SafeWrite(fd, &layer->bits[0],
+                       layer->bits.size() * sizeof(uint64_t));
+  }
+  retval = (close(fd) == 0) && retval;
+  if (retval)
+    retval = (rename(tmp_path.c_str(), path.c_str()) == 0);
+  if (!retval) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to write Bloom filter to %s "
+             "(errno: %d)", path.c_str(), errno);
+    unlink(tmp_path.c_str());
+  }
+  return retval;
+}
+
+
+/**
+ * The digest is uniformly distributed, so its first 16 bytes serve as the two
+ * base hashes.  The second one is odd, which keeps the probe sequence from
+ * collapsing onto a single bit.
+ */
+void BloomFilter::GetBaseHashes(
+  const shash::Any &hash,
+  uint64_t *h1,
+  uint64_t *h2) const
+{
+  assert(hash.GetDigestSize() >= 2 * sizeof(uint64_t));
+  memcpy(h1, hash.digest, sizeof(uint64_t));
+  memcpy(h2, hash.digest + sizeof(uint64_t), sizeof(uint64_t));
+  *h1 ^= static_cast<uint64_t>(hash.suffix) * 0x9E3779B97F4A7C15LLU;
+  *h2 |= 1;
+}
+
+
+/**
+ * The new layer has twice the capacity and half the false positive rate of the
+ * previous one, so that the false positive rates of all the layers add up to
+ * less than twice the rate of the first one.
+ */
+void BloomFilter::AddLayer() {
+  const Layer *last = layers_.back();
+  const double false_positive_rate =
+    false_positive_rate_ / static_cast<double>(uint64_t(1) << layers_.size());
+  layers_.push_back(new Layer(2 * last->capacity, false_positive_rate));
+  LogCvmfs(kLogCvmfs, kLogDebug, "Bloom filter with %" PRIu64 " entries grows "
+           "to %u layers", count_, num_layers());
+}
+
+
+void BloomFilter::Add(const shash::Any &hash) {
+  uint64_t h1, h2;
+  GetBaseHashes(hash, &h1, &h2);
+  for (unsigned i = 0; i < layers_.size(); ++i) {
+    if (layers_[i]->Test(h1, h2))
+      return;
+  }
+
+  if (layers_.back()->count >= layers_.back()->capacity)
+    AddLayer();
+  layers_.back()->Set(h1, h2);
+  layers_.back()->count++;
+  ++count_;
+}
+
+
+bool BloomFilter::Contains(const shash::Any &hash) const {
+  uint64_t h1, h2;
+  GetBaseHashes(hash, &h1, &h2);
+  for (unsigned i = 0; i < layers_.size(); ++i) {
+    if (layers_[i]->Test(h1, h2))
+      return true;
+  }
+  return false;
+}
+
+
+void BloomFilter::Clear() {
+  for (unsigned i = 1; i < layers_.size(); ++i)
+    delete layers_[i];
+  layers_.resize(1);
+  std::fill(layers_[0]->bits.begin(), layers_[0]->bits.end(), 0);
+  layers_[0]->count = 0;
+  count_ = 0;
+}
+
+
+uint64_t BloomFilter::capacity() const {
+  uint64_t result = 0;
+  for (unsigned i = 0; i < layers_.size(); ++i)
+    result += layers_[i]->capacity;
+  return result;
+}
+
+
+uint64_t BloomFilter::num_bits() const {
+  uint64_t result = 0;
+  for (unsigned i = 0; i < layers_.size(); ++i)
+    result += layers_[i]->num_bits;
+  return result;
+}
@@ -0,0 +1,123 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_BLOOM_FILTER_H_
+#define CVMFS_BLOOM_FILTER_H_
+
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include "hash.h"
+
+/**
+ * A Bloom filter over content hashes.  Contains() never reports false for a
+ * hash that was added but can report true for a hash that was never added.
+ * The probability of such a false positive is given on construction together
+ * with the expected number of entries.
+ *
+ * Once the number of entries reaches the capacity, the filter grows by another
+ * layer with twice the capacity and half the false positive rate of the
+ * previous one.  Lookups check all the layers, so that the overall false
+ * positive rate stays below twice the given one however many entries are
+ * added.  Adding a hash that the filter already contains has no effect, so
+ * that count() approximates the number of distinct entries.
+ *
+ * The bit positions are derived from the digest itself by double hashing, so
+ * the filter only works on keys that are cryptographic hashes.  The hash
+ * suffix is part of the key, i.e. "<hash>" and "<hash>C" are different keys.
+ *
+ * The filter can be stored in and loaded from a file.  It is not thread-safe.
+ */
+class BloomFilter {
+ public:
+  static const uint64_t kDefaultCapacity = 8 * 1024 * 1024;
+  static const double   kDefaultFalsePositiveRate;
+
+  explicit BloomFilter(const uint64_t capacity = kDefaultCapacity,
+                       const double false_positive_rate =
+                         kDefaultFalsePositiveRate);
+  ~BloomFilter();
+
+  /**
+   * Returns NULL if the file does not exist or is not a valid filter.
+   */
+  static BloomFilter *Load(const std::string &path);
+  /**
+   * Writes the filter to a temporary file next to path and renames it.
+   */
+  bool Save(const std::string &path) const;
+
+  void Add(const shash::Any &hash);
+  bool Contains(const shash::Any &hash) const;
+  /**
+   * Removes all entries and the layers added by growing the filter.
+   */
+  void Clear();
+
+  /**
+   * Number of entries before the filter grows by another layer.
+   */
+  uint64_t capacity() const;
+  uint64_t num_bits() const;
+  /**
+   * Number of hash functions of the first layer.
+   */
+  unsigned num_hashes() const { return layers_[0]->num_hashes; }
+  unsigned num_layers() const { return layers_.size(); }
+  /**
+   * Number of distinct entries, up to false positives during Add().
+   */
+  uint64_t count() const { return count_; }
+
+ private:
+  static const uint32_t kMagic = 0x46424643;  // "CFBF"
+  static const uint32_t kVersion = 2;
+  /**
+   * Limits the size of a corrupted or hostile file
+   */
+  static const uint32_t kMaxLayers = 48;
+
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_layers;
+    uint32_t reserved;
+    double   false_positive_rate;
+  };
+
+  struct LayerHeader {
+    uint32_t num_hashes;
+    uint32_t reserved;
+    uint64_t num_bits;
+    uint64_t capacity;
+    uint64_t count;
+  };
+
+  struct Layer {
+    Layer(const uint64_t capacity, const double false_positive_rate);
+    explicit Layer(const LayerHeader &header);
+    void Set(const uint64_t h1, const uint64_t h2);
+    bool Test(const uint64_t h1, const uint64_t h2) const;
+
+    uint64_t capacity;
+    uint64_t num_bits;
+    unsigned num_hashes;
+    uint64_t count;
+    std::vector<uint64_t> bits;
+  };
+
+  BloomFilter(const BloomFilter &other);
+  BloomFilter &operator=(const BloomFilter &other);
+  explicit BloomFilter(const FileHeader &header);
+  void GetBaseHashes(const shash::Any &hash, uint64_t *h1, uint64_t *h2) const;
+  void AddLayer();
+
+  double false_positive_rate_;
+  uint64_t count_;
+  std::vector<Layer *> layers_;
+};
+
+#endif  // CVMFS_BLOOM_FILTER_H_
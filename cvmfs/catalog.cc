@@ -2,14 +2,18 @@
  * This file is part of the CernVM File System.
  */
 
+#define __STDC_FORMAT_MACROS
+
 #include "catalog.h"
 
 #include <alloca.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include <algorithm>
 #include <cassert>
 
+#include "bloom_filter.h"
 #include "catalog_mgr.h"
 #include "logging.h"
 #include "platform.h"
@@ -21,6 +25,7 @@ using namespace std;  // NOLINT
 namespace catalog {
 
 const shash::Md5 Catalog::kMd5PathEmpty("", 0);
+const double Catalog::kPathFilterFalsePositiveRate = 0.01;
 
 
 /**
@@ -70,6 +75,9 @@ Catalog::Catalog(const PathString &mountpoint,
   database_ = NULL;
   uid_map_ = NULL;
   gid_map_ = NULL;
+  path_filter_statistics_ = NULL;
+  path_filter_ = NULL;
+  path_filter_building_ = false;
   sql_listing_ = NULL;
   sql_lookup_md5path_ = NULL;
   sql_lookup_nested_ = NULL;
@@ -85,6 +93,11 @@ Catalog::~Catalog() {
   pthread_mutex_destroy(lock_);
   free(lock_);
   FinalizePreparedStatements();
+  if (path_filter_ != NULL) {
+    perf::Xadd(path_filter_statistics_->sz_path_filters,
+               -static_cast<int64_t>(path_filter_->num_bits() / 8));
+    delete path_filter_;
+  }
   delete database_;
 }
 
@@ -136,7 +149,7 @@ bool Catalog::ReadCatalogCounters() {
   assert(database_ != NULL);
   bool statistics_loaded;
   if (database().schema_version() <
-      CatalogDatabase::kLatestSupportedSchema - CatalogDatabase::kSchemaEpsilon)
+      CatalogDatabase::kLatestSchema - CatalogDatabase::kSchemaEpsilon)
   {
     statistics_loaded =
       counters_.ReadFromDatabase(database(), LegacyMode::kLegacy);
@@ -289,6 +302,14 @@ bool Catalog::LookupEntry(const shash::Md5 &md5path, const bool expand_symlink,
   assert(IsInitialized());
 
   pthread_mutex_lock(lock_);
+  if ((path_filter_ != NULL) &&
+      !path_filter_->Contains(shash::Any(shash::kMd5, md5path.digest)))
+  {
+    pthread_mutex_unlock(lock_);
+    perf::Inc(path_filter_statistics_->n_path_filter_negative);
+    return false;
+  }
+
   sql_lookup_md5path_->BindPathHash(md5path);
   bool found = sql_lookup_md5path_->FetchRow();
   if (found && (dirent != NULL)) {
@@ -296,12 +317,76 @@ bool Catalog::LookupEntry(const shash::Md5 &md5path, const bool expand_symlink,
     FixTransitionPoint(md5path, dirent);
   }
   sql_lookup_md5path_->Reset();
+
+  bool build_path_filter = false;
+  if (!found && (path_filter_statistics_ != NULL)) {
+    if (path_filter_ != NULL) {
+      perf::Inc(path_filter_statistics_->n_path_filter_false_positive);
+    } else if (!path_filter_building_) {
+      path_filter_building_ = true;
+      build_path_filter = true;
+    }
+  }
   pthread_mutex_unlock(lock_);
 
+  if (build_path_filter)
+    BuildPathFilter();
   return found;
 }
 
 
+/**
+ * Adds the path hashes of all entries to a new path filter.  Catalogs that
+ * only see lookups of existing paths never build the filter.  The catalog
+ * table is read in batches of row ids through the catalog's own database
+ * connection.  The lock is only held per batch, so that concurrent lookups in
+ * this catalog are served in between.  On failure, the path filter is disabled
+ * for this catalog.
+ */
+void Catalog::BuildPathFilter() const {
+  BloomFilter *filter = new BloomFilter(std::max(max_row_id_, uint64_t(1)),
+                                        kPathFilterFalsePositiveRate);
+  SqlAllPathHashes *sql_all_paths = NULL;
+  bool retval = true;
+  for (uint64_t first = 0; retval && (first <= max_row_id_);
+       first += kPathFilterBatchSize)
+  {
+    MutexLockGuard guard(lock_);
+    if (sql_all_paths == NULL)
+      sql_all_paths = new SqlAllPathHashes(database());
+    retval = sql_all_paths->BindRowIdRange(first,
+                                           first + kPathFilterBatchSize - 1);
+    while (retval && sql_all_paths->FetchRow()) {
+      filter->Add(
+        shash::Any(shash::kMd5, sql_all_paths->GetPathHash().digest));
+    }
+    retval = retval && (sql_all_paths->GetLastError() == SQLITE_DONE);
+    if (!retval) {
+      LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogWarn,
+               "failed to build path filter for catalog %s (%s)",
+               mountpoint_.c_str(), sql_all_paths->GetLastErrorMsg().c_str());
+    }
+    sql_all_paths->Reset();
+  }
+
+  MutexLockGuard guard(lock_);
+  delete sql_all_paths;
+  path_filter_building_ = false;
+  if (!retval) {
+    delete filter;
+    path_filter_statistics_ = NULL;
+    return;
+  }
+  LogCvmfs(kLogCatalog, kLogDebug,
+           "built path filter for catalog %s with %" PRIu64 " entries "
+           "(%" PRIu64 " bytes)",
+           mountpoint_.c_str(), filter->count(), filter->num_bits() / 8);
+  perf::Xadd(path_filter_statistics_->sz_path_filters,
+             static_cast<int64_t>(filter->num_bits() / 8));
+  path_filter_ = filter;
+}
+
+
 /**
  * Performs a lookup on this Catalog for a given MD5 path hash.
  * @param md5path the MD5 hash of the searched path
@@ -717,6 +802,18 @@ void Catalog::SetOwnerMaps(const OwnerMap *uid_map, const OwnerMap *gid_map) {
 }
 
 
+/**
+ * Writable catalogs change under the filter and therefore never use it.
+ */
+void Catalog::EnablePathFilter(const Statistics *statistics) {
+  assert(statistics != NULL);
+  if (IsWritable())
+    return;
+  MutexLockGuard guard(lock_);
+  path_filter_statistics_ = statistics;
+}
+
+
 /**
  * Add a Catalog as child to this Catalog.
  * @param child the Catalog to define as child
@@ -24,6 +24,8 @@
 #include "uid_map.h"
 #include "xattr.h"
 
+class BloomFilter;
+
 namespace swissknife {
 class CommandMigrate;
 }
@@ -36,6 +38,7 @@ class AbstractCatalogManager;
 class Catalog;
 
 class Counters;
+struct Statistics;
 
 typedef std::vector<Catalog *> CatalogList;
 typedef IntegerMap<uint64_t> OwnerMap;  // used to map uid/gid
@@ -210,6 +213,7 @@ class Catalog : SingleCopy {
                           const uint64_t hardlink_group) const;
 
   void SetOwnerMaps(const OwnerMap *uid_map, const OwnerMap *gid_map);
+  void EnablePathFilter(const Statistics *statistics);
   uint64_t MapUid(const uint64_t uid) const {
     if (uid_map_) { return uid_map_->Map(uid); }
     return uid;
@@ -254,6 +258,11 @@ class Catalog : SingleCopy {
    * repository, which is the child transition point of a bind mountpoint.
    */
   static const shash::Md5 kMd5PathEmpty;
+  static const double kPathFilterFalsePositiveRate;
+  /**
+   * Number of rows read per lock acquisition while building the path filter
+   */
+  static const uint64_t kPathFilterBatchSize = 4096;
 
   enum VomsAuthzStatus {
     kVomsUnknown,  // Not yet looked up
@@ -280,6 +289,7 @@ class Catalog : SingleCopy {
                           StatEntryList *listing) const;
   bool LookupEntry(const shash::Md5 &md5path, const bool expand_symlink,
                    DirectoryEntry *dirent) const;
+  void BuildPathFilter() const;
 
   CatalogDatabase *database_;
 
@@ -317,6 +327,15 @@ class Catalog : SingleCopy {
   // Point to the maps in the catalog manager
   const OwnerMap *uid_map_;
   const OwnerMap *gid_map_;
+  /**
+   * Bloom filter over the path hashes of all entries, so that most lookups of
+   * non-existing paths are answered without a database query.  It is built on
+   * the first negative lookup if enabled by EnablePathFilter().  Counts to the
+   * statistics of the catalog manager.
+   */
+  mutable const Statistics *path_filter_statistics_;
+  mutable BloomFilter *path_filter_;
+  mutable bool path_filter_building_;
 
   SqlListing                  *sql_listing_;
   SqlLookupPathHash           *sql_lookup_md5path_;
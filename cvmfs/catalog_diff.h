@@ -0,0 +1,115 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_CATALOG_DIFF_H_
+#define CVMFS_CATALOG_DIFF_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "compression.h"
+#include "directory_entry.h"
+#include "hash.h"
+#include "object_fetcher.h"
+#include "shortstring.h"
+
+namespace swissknife {
+
+/**
+ * Compares two revisions of a repository's catalog tree and reports the
+ * directory entries that were added, removed, or modified in between.
+ *
+ * Nested catalogs that have the same hash in both revisions are identical and
+ * skipped without being fetched.  For all other directories that exist in
+ * both revisions, the listings are sorted by name and merge-joined.  Subtrees
+ * that exist only in one of the revisions are reported entry by entry.  The
+ * comparison follows the directory tree, so the nested catalog structure may
+ * differ between the two revisions.
+ *
+ * Users derive from CatalogDiff<> and implement the Report*() callbacks.  The
+ * paths handed to the callbacks are only valid during the call.
+ *
+ * @param ObjectFetcherT  strategy to fetch catalogs, see CatalogTraversal<>
+ */
+template <class ObjectFetcherT>
+class CatalogDiff {
+ public:
+  typedef typename ObjectFetcherT::CatalogTN CatalogTN;
+  typedef std::pair<shash::Any, zlib::Algorithms> Object;
+  typedef std::vector<Object> ObjectList;
+
+  explicit CatalogDiff(ObjectFetcherT *object_fetcher)
+    : object_fetcher_(object_fetcher) { }
+  virtual ~CatalogDiff() { }
+
+  /**
+   * Compares the catalog trees starting at the given root catalogs.  Returns
+   * false if a catalog cannot be loaded.
+   */
+  bool Run(const shash::Any &old_root_hash, const shash::Any &new_root_hash);
+
+  /**
+   * Lists the objects (files, chunks, micro catalogs) that are referenced by
+   * new_catalog but not by old_catalog.  Both object lists are sorted and
+   * merge-joined.  If the old catalog is already replicated, these are the
+   * objects that remain to be replicated for the new catalog.
+   */
+  static bool ListNewObjects(CatalogTN *old_catalog,
+                             CatalogTN *new_catalog,
+                             ObjectList *new_objects);
+
+ protected:
+  virtual void ReportAddition(const PathString &path,
+                              const catalog::DirectoryEntry &entry) = 0;
+  virtual void ReportRemoval(const PathString &path,
+                             const catalog::DirectoryEntry &entry) = 0;
+  virtual void ReportModification(const PathString &path,
+                                  const catalog::DirectoryEntry &old_entry,
+                                  const catalog::DirectoryEntry &new_entry) = 0;
+
+ private:
+  enum Side {
+    kOld,
+    kNew
+  };
+
+  CatalogTN *FetchCatalog(const shash::Any &catalog_hash,
+                          const PathString &mountpoint);
+  CatalogTN *EnterDirectory(CatalogTN *catalog,
+                            const PathString &path,
+                            const catalog::DirectoryEntry &entry);
+  bool DiffDirectory(CatalogTN *old_catalog,
+                     CatalogTN *new_catalog,
+                     const PathString &path);
+  bool DiffSubdirectory(CatalogTN *old_catalog,
+                        const catalog::DirectoryEntry &old_entry,
+                        CatalogTN *new_catalog,
+                        const catalog::DirectoryEntry &new_entry,
+                        const PathString &path);
+  bool ReportTree(const Side side,
+                  CatalogTN *catalog,
+                  const PathString &path,
+                  const catalog::DirectoryEntry &entry);
+  void ListDirectory(CatalogTN *catalog,
+                     const PathString &path,
+                     catalog::DirectoryEntryList *listing);
+
+  static bool NameLess(const catalog::DirectoryEntry &a,
+                       const catalog::DirectoryEntry &b);
+  static bool ObjectLess(const Object &a, const Object &b);
+  static bool IsModified(const catalog::DirectoryEntry &old_entry,
+                         const catalog::DirectoryEntry &new_entry);
+  static shash::Any FindNested(const CatalogTN *catalog,
+                               const PathString &mountpoint);
+  static bool ListObjects(CatalogTN *catalog, ObjectList *objects);
+
+  ObjectFetcherT *object_fetcher_;
+};
+
+}  // namespace swissknife
+
+#include "catalog_diff_impl.h"
+
+#endif  // CVMFS_CATALOG_DIFF_H_
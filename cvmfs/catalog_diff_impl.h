@@ -0,0 +1,338 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_CATALOG_DIFF_IMPL_H_
+#define CVMFS_CATALOG_DIFF_IMPL_H_
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "logging.h"
+
+namespace swissknife {
+
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::Run(
+  const shash::Any &old_root_hash,
+  const shash::Any &new_root_hash)
+{
+  if (old_root_hash == new_root_hash)
+    return true;
+
+  const PathString root_path("");
+  CatalogTN *old_root = FetchCatalog(old_root_hash, root_path);
+  if (old_root == NULL)
+    return false;
+  CatalogTN *new_root = FetchCatalog(new_root_hash, root_path);
+  if (new_root == NULL) {
+    delete old_root;
+    return false;
+  }
+
+  const bool retval = DiffDirectory(old_root, new_root, root_path);
+  delete old_root;
+  delete new_root;
+  return retval;
+}
+
+
+template <class ObjectFetcherT>
+typename CatalogDiff<ObjectFetcherT>::CatalogTN *
+CatalogDiff<ObjectFetcherT>::FetchCatalog(
+  const shash::Any &catalog_hash,
+  const PathString &mountpoint)
+{
+  CatalogTN *catalog = NULL;
+  const typename ObjectFetcherT::Failures retval =
+    object_fetcher_->FetchCatalog(catalog_hash,
+                                  mountpoint.ToString(),
+                                  &catalog,
+                                  !mountpoint.IsEmpty());
+  if (retval != ObjectFetcherT::kFailOk) {
+    LogCvmfs(kLogCatalog, kLogStderr, "failed to load catalog %s (%d - %s)",
+             catalog_hash.ToStringWithSuffix().c_str(),
+             retval, Code2Ascii(retval));
+    return NULL;
+  }
+  return catalog;
+}
+
+
+/**
+ * Returns the catalog that contains the listing of the given directory.  That
+ * is a newly fetched nested catalog if the directory is a mountpoint, which
+ * the caller has to delete.
+ */
+template <class ObjectFetcherT>
+typename CatalogDiff<ObjectFetcherT>::CatalogTN *
+CatalogDiff<ObjectFetcherT>::EnterDirectory(
+  CatalogTN *catalog,
+  const PathString &path,
+  const catalog::DirectoryEntry &entry)
+{
+  if (!entry.IsNestedCatalogMountpoint())
+    return catalog;
+
+  const shash::Any nested_hash = FindNested(catalog, path);
+  if (nested_hash.IsNull()) {
+    LogCvmfs(kLogCatalog, kLogStderr, "nested catalog at %s not registered",
+             path.c_str());
+    return NULL;
+  }
+  return FetchCatalog(nested_hash, path);
+}
+
+
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::DiffDirectory(
+  CatalogTN *old_catalog,
+  CatalogTN *new_catalog,
+  const PathString &path)
+{
+  catalog::DirectoryEntryList old_listing;
+  catalog::DirectoryEntryList new_listing;
+  ListDirectory(old_catalog, path, &old_listing);
+  ListDirectory(new_catalog, path, &new_listing);
+
+  unsigned i = 0;
+  unsigned j = 0;
+  while ((i < old_listing.size()) || (j < new_listing.size())) {
+    const bool take_old = (j == new_listing.size()) ||
+      ((i < old_listing.size()) && NameLess(old_listing[i], new_listing[j]));
+    const bool take_new = !take_old && ((i == old_listing.size()) ||
+      NameLess(new_listing[j], old_listing[i]));
+    const catalog::DirectoryEntry &entry =
+      take_new ? new_listing[j] : old_listing[i];
+
+    PathString entry_path(path);
+    entry_path.Append("/", 1);
+    entry_path.Append(entry.name().GetChars(), entry.name().GetLength());
+
+    bool retval = true;
+    if (take_old) {
+      retval = ReportTree(kOld, old_catalog, entry_path, old_listing[i++]);
+    } else if (take_new) {
+      retval = ReportTree(kNew, new_catalog, entry_path, new_listing[j++]);
+    } else {
+      const catalog::DirectoryEntry &old_entry = old_listing[i++];
+      const catalog::DirectoryEntry &new_entry = new_listing[j++];
+      if (old_entry.IsDirectory() != new_entry.IsDirectory()) {
+        retval = ReportTree(kOld, old_catalog, entry_path, old_entry) &&
+                 ReportTree(kNew, new_catalog, entry_path, new_entry);
+      } else {
+        if (IsModified(old_entry, new_entry))
+          ReportModification(entry_path, old_entry, new_entry);
+        if (old_entry.IsDirectory()) {
+          retval = DiffSubdirectory(old_catalog, old_entry,
+                                    new_catalog, new_entry, entry_path);
+        }
+      }
+    }
+    if (!retval)
+      return false;
+  }
+  return true;
+}
+
+
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::DiffSubdirectory(
+  CatalogTN *old_catalog,
+  const catalog::DirectoryEntry &old_entry,
+  CatalogTN *new_catalog,
+  const catalog::DirectoryEntry &new_entry,
+  const PathString &path)
+{
+  // Identical nested catalogs imply identical subtrees
+  if (old_entry.IsNestedCatalogMountpoint() &&
+      new_entry.IsNestedCatalogMountpoint())
+  {
+    const shash::Any old_nested = FindNested(old_catalog, path);
+    const shash::Any new_nested = FindNested(new_catalog, path);
+    if (!old_nested.IsNull() && (old_nested == new_nested))
+      return true;
+  }
+
+  CatalogTN *old_subtree = EnterDirectory(old_catalog, path, old_entry);
+  if (old_subtree == NULL)
+    return false;
+  CatalogTN *new_subtree = EnterDirectory(new_catalog, path, new_entry);
+  if (new_subtree == NULL) {
+    if (old_subtree != old_catalog)
+      delete old_subtree;
+    return false;
+  }
+
+  const bool retval = DiffDirectory(old_subtree, new_subtree, path);
+  if (old_subtree != old_catalog)
+    delete old_subtree;
+  if (new_subtree != new_catalog)
+    delete new_subtree;
+  return retval;
+}
+
+
+/**
+ * Reports an entry and, for directories, everything below it as added or as
+ * removed.
+ */
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::ReportTree(
+  const Side side,
+  CatalogTN *catalog,
+  const PathString &path,
+  const catalog::DirectoryEntry &entry)
+{
+  if (side == kOld)
+    ReportRemoval(path, entry);
+  else
+    ReportAddition(path, entry);
+  if (!entry.IsDirectory())
+    return true;
+
+  CatalogTN *subtree = EnterDirectory(catalog, path, entry);
+  if (subtree == NULL)
+    return false;
+  catalog::DirectoryEntryList listing;
+  ListDirectory(subtree, path, &listing);
+
+  bool retval = true;
+  for (unsigned i = 0; (i < listing.size()) && retval; ++i) {
+    PathString entry_path(path);
+    entry_path.Append("/", 1);
+    entry_path.Append(listing[i].name().GetChars(),
+                      listing[i].name().GetLength());
+    retval = ReportTree(side, subtree, entry_path, listing[i]);
+  }
+
+  if (subtree != catalog)
+    delete subtree;
+  return retval;
+}
+
+
+/**
+ * An empty directory and a failed lookup look the same for some catalog
+ * implementations, so the return value of the listing is not meaningful.
+ */
+template <class ObjectFetcherT>
+void CatalogDiff<ObjectFetcherT>::ListDirectory(
+  CatalogTN *catalog,
+  const PathString &path,
+  catalog::DirectoryEntryList *listing)
+{
+  catalog->ListingPath(path, listing);
+  std::sort(listing->begin(), listing->end(), NameLess);
+}
+
+
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::NameLess(
+  const catalog::DirectoryEntry &a,
+  const catalog::DirectoryEntry &b)
+{
+  return a.name() < b.name();
+}
+
+
+/**
+ * Differences that stem from the catalog layout or, for directories, from
+ * changes of their contents are not reported.
+ */
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::IsModified(
+  const catalog::DirectoryEntry &old_entry,
+  const catalog::DirectoryEntry &new_entry)
+{
+  typedef catalog::DirectoryEntryBase::Difference Difference;
+  catalog::DirectoryEntryBase::Differences ignore =
+    Difference::kNestedCatalogTransitionFlags | Difference::kHardlinkGroup;
+  if (old_entry.IsDirectory()) {
+    ignore |= Difference::kLinkcount | Difference::kSize | Difference::kMtime |
+              Difference::kChecksum;
+  }
+  if ((old_entry.CompareTo(new_entry) & ~ignore) != 0)
+    return true;
+  return (old_entry.uid() != new_entry.uid()) ||
+         (old_entry.gid() != new_entry.gid());
+}
+
+
+template <class ObjectFetcherT>
+shash::Any CatalogDiff<ObjectFetcherT>::FindNested(
+  const CatalogTN *catalog,
+  const PathString &mountpoint)
+{
+  typedef typename CatalogTN::NestedCatalogList NestedCatalogList;
+  const NestedCatalogList nested_catalogs = catalog->ListOwnNestedCatalogs();
+  for (typename NestedCatalogList::const_iterator i = nested_catalogs.begin(),
+       iEnd = nested_catalogs.end(); i != iEnd; ++i)
+  {
+    if (i->mountpoint == mountpoint)
+      return i->hash;
+  }
+  return shash::Any();
+}
+
+
+/**
+ * The hash comparison operators ignore the suffix but objects with different
+ * suffixes are stored under different names.
+ */
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::ObjectLess(
+  const Object &a,
+  const Object &b)
+{
+  if (a.first != b.first)
+    return a.first < b.first;
+  return a.first.suffix < b.first.suffix;
+}
+
+
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::ListObjects(
+  CatalogTN *catalog,
+  ObjectList *objects)
+{
+  if (!catalog->AllChunksBegin())
+    return false;
+  Object object;
+  while (catalog->AllChunksNext(&object.first, &object.second))
+    objects->push_back(object);
+  catalog->AllChunksEnd();
+  std::sort(objects->begin(), objects->end(), ObjectLess);
+  return true;
+}
+
+
+template <class ObjectFetcherT>
+bool CatalogDiff<ObjectFetcherT>::ListNewObjects(
+  CatalogTN *old_catalog,
+  CatalogTN *new_catalog,
+  ObjectList *new_objects)
+{
+  ObjectList old_list;
+  ObjectList new_list;
+  if (!ListObjects(old_catalog, &old_list) ||
+      !ListObjects(new_catalog, &new_list))
+  {
+    return false;
+  }
+
+  unsigned i = 0;
+  for (unsigned j = 0; j < new_list.size(); ++j) {
+    while ((i < old_list.size()) && ObjectLess(old_list[i], new_list[j]))
+      ++i;
+    if ((i < old_list.size()) && !ObjectLess(new_list[j], old_list[i]))
+      continue;
+    new_objects->push_back(new_list[j]);
+  }
+  return true;
+}
+
+}  // namespace swissknife
+
+#endif  // CVMFS_CATALOG_DIFF_IMPL_H_
@@ -68,6 +68,9 @@ struct Statistics {
   perf::Counter *n_lookup_inode;
   perf::Counter *n_lookup_path;
   perf::Counter *n_lookup_path_negative;
+  perf::Counter *n_path_filter_negative;
+  perf::Counter *n_path_filter_false_positive;
+  perf::Counter *sz_path_filters;
   perf::Counter *n_lookup_xattrs;
   perf::Counter *n_listing;
   perf::Counter *n_nested_listing;
@@ -80,6 +83,14 @@ struct Statistics {
     n_lookup_path_negative = statistics->Register(
         "catalog_mgr.n_lookup_path_negative",
         "Number of negative path lookups");
+    n_path_filter_negative = statistics->Register(
+        "catalog_mgr.n_path_filter_negative",
+        "Number of catalog lookups answered by the path filters");
+    n_path_filter_false_positive = statistics->Register(
+        "catalog_mgr.n_path_filter_false_positive",
+        "Number of catalog lookups missed despite passing the path filters");
+    sz_path_filters = statistics->Register("catalog_mgr.sz_path_filters",
+        "Overall size of the path filters in bytes");
     n_lookup_xattrs = statistics->Register("catalog_mgr.n_lookup_xattrs",
         "Number of xattrs lookups");
     n_listing = statistics->Register("catalog_mgr.n_listing",
@@ -172,6 +183,11 @@ class AbstractCatalogManager : public SingleCopy {
                       const shash::Algorithms interpret_hashes_as,
                       FileChunkList *chunks);
   void SetOwnerMaps(const OwnerMap &uid_map, const OwnerMap &gid_map);
+  /**
+   * Path filters are enabled by default.  Applies to catalogs attached
+   * afterwards.
+   */
+  void SetPathFilter(const bool enable) { enable_path_filter_ = enable; }
 
   Statistics statistics() const { return statistics_; }
   uint64_t inode_gauge() {
@@ -296,6 +312,7 @@ class AbstractCatalogManager : public SingleCopy {
   pthread_key_t pkey_sqlitemem_;
   OwnerMap uid_map_;
   OwnerMap gid_map_;
+  bool enable_path_filter_;
 
   // Not needed anymore since there are the glue buffers
   // Catalog *Inode2Catalog(const inode_t inode);
@@ -6,6 +6,7 @@
 #include "catalog_mgr_client.h"
 
 #include "cache_posix.h"
+#include "compression.h"
 #include "download.h"
 #include "fetch.h"
 #include "manifest.h"
@@ -148,9 +149,11 @@ LoadError ClientCatalogManager::LoadCatalog(
   }
   shash::Any cache_hash(shash::kSha1, shash::kSuffixCatalog);
   uint64_t cache_last_modified = 0;
+  shash::Any cache_dictionary;
 
   retval = manifest::Manifest::ReadChecksum(
-    repo_name_, checksum_dir, &cache_hash, &cache_last_modified);
+    repo_name_, checksum_dir, &cache_hash, &cache_last_modified,
+    &cache_dictionary);
   if (retval) {
     LogCvmfs(kLogCache, kLogDebug, "cached copy publish date %s",
              StringifyTime(cache_last_modified, true).c_str());
@@ -175,6 +178,12 @@ LoadError ClientCatalogManager::LoadCatalog(
       if (error != catalog::kLoadNew)
         return error;
     }
+    // Cached objects are stored uncompressed, so a missing dictionary only
+    // affects downloads and does not prevent the offline mount
+    if (LoadCompressionDictionary(cache_dictionary) != catalog::kLoadNew) {
+      LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+               "compression dictionary of the cached manifest unavailable");
+    }
     loaded_catalogs_[mountpoint] = cache_hash;
     *catalog_hash = cache_hash;
     offline_mode_ = true;
@@ -182,6 +191,10 @@ LoadError ClientCatalogManager::LoadCatalog(
   }
 
   offline_mode_ = false;
+  const LoadError dictionary_error =
+    LoadCompressionDictionary(ensemble.manifest->compression_dictionary());
+  if (dictionary_error != catalog::kLoadNew)
+    return dictionary_error;
   cvmfs_path += " (" + ensemble.manifest->catalog_hash().ToString() + ")";
   LogCvmfs(kLogCache, kLogDebug, "remote checksum is %s",
            ensemble.manifest->catalog_hash().ToString().c_str());
@@ -249,6 +262,50 @@ LoadError ClientCatalogManager::LoadCatalogCas(
 }
 
 
+/**
+ * Makes the repository's zstd dictionary known to the decompressors.  Without
+ * it, objects compressed with the dictionary fail to download, so the catalog
+ * must not be loaded either.  Returns kLoadNew if the dictionary is registered
+ * or if there is none.
+ */
+LoadError ClientCatalogManager::LoadCompressionDictionary(
+  const shash::Any &hash)
+{
+  if (hash.IsNull() || (hash == compression_dictionary_))
+    return kLoadNew;
+
+  const string name = "compression dictionary for " + repo_name_;
+  int fd = fetcher_->Fetch(hash, CacheManager::kSizeUnknown, name,
+    zlib::kZlibDefault, CacheManager::kTypeRegular);
+  if (fd < 0) {
+    LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogErr,
+             "failed to load %s (%d)", name.c_str(), fd);
+    return (fd == -ENOSPC) ? kLoadNoSpace : kLoadFail;
+  }
+  CacheManager *cache_mgr = fetcher_->cache_mgr();
+  const int64_t size = cache_mgr->GetSize(fd);
+  string buffer(size > 0 ? size : 0, '\0');
+  const int64_t nbytes = (size > 0) ?
+    cache_mgr->Pread(fd, &buffer[0], size, 0) : size;
+  cache_mgr->Close(fd);
+  zlib::Dictionary *dictionary = NULL;
+  if (nbytes == size) {
+    dictionary = zlib::Dictionary::Create(
+      buffer.data(), buffer.size(), zlib::ZstdCompressor::kDefaultLevel);
+  }
+  if (dictionary == NULL) {
+    LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogErr, "invalid %s",
+             name.c_str());
+    return kLoadFail;
+  }
+  LogCvmfs(kLogCatalog, kLogDebug, "registering zstd dictionary %u",
+           dictionary->id());
+  zlib::Dictionary::Register(dictionary);
+  compression_dictionary_ = hash;
+  return kLoadNew;
+}
+
+
 void ClientCatalogManager::UnloadCatalog(const Catalog *catalog) {
   LogCvmfs(kLogCache, kLogDebug, "unloading catalog %s",
            catalog->mountpoint().c_str());
@@ -81,6 +81,7 @@ class ClientCatalogManager : public AbstractCatalogManager<Catalog> {
                            const std::string &name,
                            const std::string &alt_catalog_path,
                            std::string *catalog_path);
+  LoadError LoadCompressionDictionary(const shash::Any &hash);
 
   /**
    * Required for unpinning
@@ -95,6 +96,7 @@ class ClientCatalogManager : public AbstractCatalogManager<Catalog> {
   uint64_t all_inodes_;
   uint64_t loaded_inodes_;
   bool fixed_alt_root_catalog_;  /**< fixed root hash but alternative url */
+  shash::Any compression_dictionary_;  /**< last registered zstd dictionary */
   BackoffThrottle backoff_throttle_;
   perf::Counter *n_certificate_hits_;
   perf::Counter *n_certificate_misses_;
@@ -34,6 +34,7 @@ AbstractCatalogManager<CatalogT>::AbstractCatalogManager(
   has_authz_cache_ = false;
   inode_annotation_ = NULL;
   incarnation_ = 0;
+  enable_path_filter_ = true;
   rwlock_ =
     reinterpret_cast<pthread_rwlock_t *>(smalloc(sizeof(pthread_rwlock_t)));
   int retval = pthread_rwlock_init(rwlock_, NULL);
@@ -662,6 +663,8 @@ bool AbstractCatalogManager<CatalogT>::AttachCatalog(const string &db_path,
   new_catalog->set_inode_range(range);
   new_catalog->SetInodeAnnotation(inode_annotation_);
   new_catalog->SetOwnerMaps(&uid_map_, &gid_map_);
+  if (enable_path_filter_)
+    new_catalog->EnablePathFilter(&statistics_);
 
   // Add catalog to the manager
   if (!new_catalog->IsInitialized()) {
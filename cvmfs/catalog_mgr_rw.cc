@@ -13,6 +13,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 #include "catalog_balancer.h"
 #include "catalog_rw.h"
@@ -41,6 +42,7 @@ WritableCatalogManager::WritableCatalogManager(
   : SimpleCatalogManager(base_hash, stratum0, dir_temp, download_manager,
       statistics)
   , spooler_(spooler)
+  , num_finalizer_threads_(GetNumberOfCpuCores())
   , catalog_entry_warn_threshold_(catalog_entry_warn_threshold)
   , is_balanceable_(is_balanceable)
   , max_weight_(max_weight)
@@ -55,6 +57,10 @@ WritableCatalogManager::WritableCatalogManager(
     reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
   retval = pthread_mutex_init(catalog_processing_lock_, NULL);
   assert(retval == 0);
+  nested_catalog_lock_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  retval = pthread_mutex_init(nested_catalog_lock_, NULL);
+  assert(retval == 0);
 }
 
 
@@ -63,6 +69,8 @@ WritableCatalogManager::~WritableCatalogManager() {
   free(sync_lock_);
   pthread_mutex_destroy(catalog_processing_lock_);
   free(catalog_processing_lock_);
+  pthread_mutex_destroy(nested_catalog_lock_);
+  free(nested_catalog_lock_);
 }
 
 
@@ -757,23 +765,41 @@ bool WritableCatalogManager::Commit(const bool           stop_for_tweaks,
  *     --> done through a Future<> in WritableCatalogManager::SnapshotCatalogs
  *
  * Note: The catalog finalisation (see WritableCatalogManager::FinalizeCatalog)
- *       happens in a worker thread (i.e. the callback method) for non-leaf
- *       catalogs.
- *
- * TODO(rmeusel): since all leaf catalogs are finalized in the main thread, we
- *                sacrafice some potential concurrency for simplicity.
+ *       happens in a pool of finalizer threads that take catalogs from a
+ *       queue of ready catalogs, see WritableCatalogManager::MainFinalize().
+ *       Independent subtrees are thus finalized concurrently and the upload
+ *       callback never blocks on the SQLite commit of a parent catalog.  In
+ *       order to allow for interactive tweaks, there is only a single
+ *       finalizer thread if stop_for_tweaks is set.
  */
 WritableCatalogManager::CatalogInfo WritableCatalogManager::SnapshotCatalogs(
                                                    const bool stop_for_tweaks) {
+  const unsigned num_threads = stop_for_tweaks ? 1 : num_finalizer_threads_;
+  // every catalog is queued at most once, plus a terminator for every thread
+  const size_t max_queue_length = GetNumCatalogs() + num_threads;
+  FifoChannel<WritableCatalog *> ready_catalogs(max_queue_length,
+                                                max_queue_length);
+
   // prepare environment for parallel processing
   Future<CatalogInfo>  root_catalog_info_future;
   CatalogUploadContext upload_context;
   upload_context.root_catalog_info = &root_catalog_info_future;
   upload_context.stop_for_tweaks   = stop_for_tweaks;
+  upload_context.ready_catalogs    = &ready_catalogs;
 
   spooler_->RegisterListener(
     &WritableCatalogManager::CatalogUploadCallback, this, upload_context);
 
+  FinalizeThreadContext thread_context;
+  thread_context.catalog_manager = this;
+  thread_context.upload_context  = upload_context;
+  std::vector<pthread_t> threads(num_threads);
+  for (unsigned t = 0; t < num_threads; ++t) {
+    int retval = pthread_create(&threads[t], NULL, MainFinalize,
+                                &thread_context);
+    assert(retval == 0);
+  }
+
   // find dirty leaf catalogs and annotate non-leaf catalogs (dirty child count)
   // post-condition: the entire catalog tree is ready for concurrent processing
   WritableCatalogList leafs_to_snapshot;
@@ -783,12 +809,15 @@ WritableCatalogManager::CatalogInfo WritableCatalogManager::SnapshotCatalogs(
         WritableCatalogList::const_iterator i    = leafs_to_snapshot.begin();
   const WritableCatalogList::const_iterator iend = leafs_to_snapshot.end();
   for (; i != iend; ++i) {
-    FinalizeCatalog(*i, stop_for_tweaks);
-    ScheduleCatalogProcessing(*i);
+    ready_catalogs.Enqueue(*i);
   }
 
   LogCvmfs(kLogCatalog, kLogVerboseMsg, "waiting for upload of catalogs");
   CatalogInfo& root_catalog_info = root_catalog_info_future.Get();
+  for (unsigned t = 0; t < num_threads; ++t)
+    ready_catalogs.Enqueue(NULL);
+  for (unsigned t = 0; t < num_threads; ++t)
+    pthread_join(threads[t], NULL);
   spooler_->WaitForUpload();
 
   spooler_->UnregisterListeners();
@@ -796,6 +825,27 @@ WritableCatalogManager::CatalogInfo WritableCatalogManager::SnapshotCatalogs(
 }
 
 
+/**
+ * Finalizes and schedules catalogs from the queue of ready catalogs until it
+ * finds a NULL pointer.
+ */
+void *WritableCatalogManager::MainFinalize(void *data) {
+  FinalizeThreadContext *context = reinterpret_cast<FinalizeThreadContext *>(
+    data);
+  WritableCatalogManager *catalog_manager = context->catalog_manager;
+  FifoChannel<WritableCatalog *> *ready_catalogs =
+    context->upload_context.ready_catalogs;
+
+  WritableCatalog *catalog;
+  while ((catalog = ready_catalogs->Dequeue()) != NULL) {
+    catalog_manager->FinalizeCatalog(catalog,
+                                     context->upload_context.stop_for_tweaks);
+    catalog_manager->ScheduleCatalogProcessing(catalog);
+  }
+  return NULL;
+}
+
+
 void WritableCatalogManager::FinalizeCatalog(WritableCatalog *catalog,
                                              const bool stop_for_tweaks) {
   // update meta information of this catalog
@@ -804,6 +854,7 @@ void WritableCatalogManager::FinalizeCatalog(WritableCatalog *catalog,
 
   catalog->UpdateCounters();
   catalog->UpdateLastModified();
+  catalog->UpdateCompressionSchema();
   catalog->IncrementRevision();
 
   // update the previous catalog revision pointer
@@ -815,9 +866,12 @@ void WritableCatalogManager::FinalizeCatalog(WritableCatalog *catalog,
   } else {
     shash::Any hash_previous;
     uint64_t size_previous;
-    const bool retval =
-      catalog->parent()->FindNested(catalog->mountpoint(),
-                                    &hash_previous, &size_previous);
+    bool retval;
+    {
+      MutexLockGuard guard(nested_catalog_lock_);
+      retval = catalog->parent()->FindNested(catalog->mountpoint(),
+                                             &hash_previous, &size_previous);
+    }
     assert(retval);
     LogCvmfs(kLogCatalog, kLogVerboseMsg, "found '%s' as previous revision "
                                           "for nested catalog '%s'",
@@ -853,10 +907,13 @@ void WritableCatalogManager::FinalizeCatalog(WritableCatalog *catalog,
 
 void WritableCatalogManager::ScheduleCatalogProcessing(
                                                      WritableCatalog *catalog) {
-  MutexLockGuard guard(catalog_processing_lock_);
-
-  // register catalog object for WritableCatalogManager::CatalogUploadCallback
-  catalog_processing_map_[catalog->database_path()] = catalog;
+  {
+    MutexLockGuard guard(catalog_processing_lock_);
+    // register catalog object for WritableCatalogManager::CatalogUploadCallback
+    catalog_processing_map_[catalog->database_path()] = catalog;
+  }
+  // The spooler might block until previous uploads are reported, which
+  // requires the lock in WritableCatalogManager::CatalogUploadCallback
   spooler_->ProcessCatalog(catalog->database_path());
 }
 
@@ -890,10 +947,13 @@ void WritableCatalogManager::CatalogUploadCallback(
     LogCvmfs(kLogCatalog, kLogVerboseMsg, "updating nested catalog link");
     WritableCatalog *parent = catalog->GetWritableParent();
 
-    parent->UpdateNestedCatalog(catalog->mountpoint().ToString(),
-                                result.content_hash,
-                                catalog_size,
-                                catalog->delta_counters_);
+    {
+      MutexLockGuard guard(nested_catalog_lock_);
+      parent->UpdateNestedCatalog(catalog->mountpoint().ToString(),
+                                  result.content_hash,
+                                  catalog_size,
+                                  catalog->delta_counters_);
+    }
     catalog->delta_counters_.SetZero();
 
     const int remaining_dirty_children =
@@ -901,10 +961,8 @@ void WritableCatalogManager::CatalogUploadCallback(
 
     // continuation of the dirty catalog tree traversal
     // see WritableCatalogManager::SnapshotCatalogs()
-    if (remaining_dirty_children == 0) {
-      FinalizeCatalog(parent, catalog_upload_context.stop_for_tweaks);
-      ScheduleCatalogProcessing(parent);
-    }
+    if (remaining_dirty_children == 0)
+      catalog_upload_context.ready_catalogs->Enqueue(parent);
 
   } else if (catalog->IsRoot()) {
     // once the root catalog is reached, we are done with processing and report
@@ -38,6 +38,7 @@
 
 #include "catalog_mgr_ro.h"
 #include "catalog_rw.h"
+#include "gtest/gtest_prod.h"
 #include "upload_spooler_result.h"
 #include "util_concurrency.h"
 #include "xattr.h"
@@ -71,6 +72,8 @@ class WritableCatalogManager : public SimpleCatalogManager {
   // TODO(jblomer): only needed to get Spooler's hash algorithm.  Remove me
   // after refactoring of the swissknife utility.
   friend class VirtualCatalog;
+  FRIEND_TEST(T_WritableCatalogManager, CommitNestedTree);
+  FRIEND_TEST(T_WritableCatalogManager, CommitPartialTree);
 
  public:
   WritableCatalogManager(const shash::Any  &base_hash,
@@ -170,12 +173,23 @@ class WritableCatalogManager : public SimpleCatalogManager {
   struct CatalogUploadContext {
     Future<CatalogInfo>* root_catalog_info;
     bool                 stop_for_tweaks;
+    /**
+     * Catalogs whose dirty children are all uploaded, see
+     * WritableCatalogManager::MainFinalize()
+     */
+    FifoChannel<WritableCatalog *> *ready_catalogs;
+  };
+
+  struct FinalizeThreadContext {
+    WritableCatalogManager *catalog_manager;
+    CatalogUploadContext    upload_context;
   };
 
   CatalogInfo SnapshotCatalogs(const bool stop_for_tweaks);
   void FinalizeCatalog(WritableCatalog *catalog,
                        const bool stop_for_tweaks);
   void ScheduleCatalogProcessing(WritableCatalog *catalog);
+  static void *MainFinalize(void *data);
 
   void GetModifiedCatalogLeafs(WritableCatalogList *result) const {
     const bool dirty = GetModifiedCatalogLeafsRecursively(GetRootCatalog(),
@@ -201,6 +215,16 @@ class WritableCatalogManager : public SimpleCatalogManager {
 
   pthread_mutex_t                         *catalog_processing_lock_;
   std::map<std::string, WritableCatalog*>  catalog_processing_map_;
+  /**
+   * Serializes access to the nested catalog references of parent catalogs,
+   * which are read and written by concurrent snapshots of their children.
+   */
+  pthread_mutex_t                         *nested_catalog_lock_;
+  /**
+   * Size of the finalizer thread pool used by SnapshotCatalogs(), one per
+   * core by default.
+   */
+  unsigned num_finalizer_threads_;
 
   uint64_t catalog_entry_warn_threshold_;
 
@@ -11,6 +11,7 @@
 #include <cstdlib>
 
 #include "logging.h"
+#include "util/string.h"
 #include "util_concurrency.h"
 #include "xattr.h"
 
@@ -20,6 +21,7 @@ namespace catalog {
 
 const double WritableCatalog::kMaximalFreePageRatio = 0.20;
 const double WritableCatalog::kMaximalRowIdWasteRatio = 0.25;
+const unsigned WritableCatalog::kBulkInsertRows;
 
 
 WritableCatalog::WritableCatalog(const string      &path,
@@ -31,6 +33,7 @@ WritableCatalog::WritableCatalog(const string      &path,
           parent,
           is_not_root),
   sql_insert_(NULL),
+  sql_bulk_insert_(NULL),
   sql_unlink_(NULL),
   sql_touch_(NULL),
   sql_update_(NULL),
@@ -39,7 +42,9 @@ WritableCatalog::WritableCatalog(const string      &path,
   sql_chunks_count_(NULL),
   sql_max_link_id_(NULL),
   sql_inc_linkcount_(NULL),
-  dirty_(false)
+  dirty_(false),
+  bulk_insert_(false),
+  saved_synchronous_(0)
 {
   atomic_init32(&dirty_children_);
 }
@@ -77,6 +82,7 @@ void WritableCatalog::Transaction() {
 
 
 void WritableCatalog::Commit() {
+  assert(!bulk_insert_);
   LogCvmfs(kLogCatalog, kLogVerboseMsg, "closing SQLite transaction for '%s'",
                                         mountpoint().c_str());
   const bool retval = database().CommitTransaction();
@@ -106,6 +112,7 @@ void WritableCatalog::FinalizePreparedStatements() {
   // no polymorphism: no up call (see Catalog.h -
   // near the definition of this method)
   delete sql_insert_;
+  delete sql_bulk_insert_;
   delete sql_unlink_;
   delete sql_touch_;
   delete sql_update_;
@@ -155,6 +162,15 @@ void WritableCatalog::AddEntry(
   DirectoryEntry effective_entry(entry);
   effective_entry.set_has_xattrs(!xattrs.IsEmpty());
 
+  if (bulk_insert_) {
+    staged_entries_.push_back(
+      StagedEntry(path_hash, parent_hash, effective_entry, xattrs));
+    if (staged_entries_.size() == kBulkInsertRows)
+      FlushStagedEntries();
+    delta_counters_.Increment(effective_entry);
+    return;
+  }
+
   bool retval =
     sql_insert_->BindPathHash(path_hash) &&
     sql_insert_->BindParentPathHash(parent_hash) &&
@@ -174,6 +190,119 @@ void WritableCatalog::AddEntry(
 }
 
 
+void WritableCatalog::BeginBulkInsert() {
+  assert(!bulk_insert_);
+  LogCvmfs(kLogCatalog, kLogVerboseMsg, "start bulk insert into '%s'",
+           mountpoint().c_str());
+
+  bool retval;
+  {
+    SqlCatalog sql_journal_mode(database(), "PRAGMA journal_mode;");
+    SqlCatalog sql_synchronous(database(), "PRAGMA synchronous;");
+    retval = sql_journal_mode.FetchRow() && sql_synchronous.FetchRow();
+    assert(retval);
+    saved_journal_mode_ =
+      reinterpret_cast<const char *>(sql_journal_mode.RetrieveText(0));
+    saved_synchronous_ = sql_synchronous.RetrieveInt(0);
+  }
+
+  // The journal mode can only be changed outside transactions.  The catalog
+  // is a temporary copy anyway, if publishing fails it is thrown away.
+  const bool in_transaction = dirty_;
+  if (in_transaction) {
+    retval = database().CommitTransaction();
+    assert(retval);
+  }
+  retval =
+    SqlCatalog(database(), "PRAGMA journal_mode = OFF;").Execute() &&
+    SqlCatalog(database(), "PRAGMA synchronous = OFF;").Execute();
+  assert(retval);
+  if (in_transaction)
+    Transaction();
+  else
+    SetDirty();
+
+  retval = SqlCatalog(database(),
+                      "DROP INDEX IF EXISTS idx_catalog_parent;").Execute();
+  assert(retval);
+
+  if (sql_bulk_insert_ == NULL)
+    sql_bulk_insert_ = new SqlDirentInsert(database(), kBulkInsertRows);
+  bulk_insert_ = true;
+}
+
+
+void WritableCatalog::EndBulkInsert() {
+  assert(bulk_insert_);
+  FlushStagedEntries();
+  bulk_insert_ = false;
+
+  bool retval = SqlCatalog(database(),
+    "CREATE INDEX idx_catalog_parent "
+    "ON catalog (parent_1, parent_2);").Execute();
+  assert(retval);
+
+  // Checkpoint: the loaded rows are committed before the previous settings are
+  // restored, both can only be changed outside transactions.  The next commit
+  // of the catalog syncs the database file again.
+  retval = database().CommitTransaction();
+  assert(retval);
+  retval =
+    SqlCatalog(database(), "PRAGMA journal_mode = " +
+               saved_journal_mode_ + ";").Execute() &&
+    SqlCatalog(database(), "PRAGMA synchronous = " +
+               StringifyInt(saved_synchronous_) + ";").Execute();
+  assert(retval);
+  Transaction();
+  LogCvmfs(kLogCatalog, kLogVerboseMsg, "finished bulk insert into '%s'",
+           mountpoint().c_str());
+}
+
+
+/**
+ * Writes the staged entries, all of them in a single statement if possible.
+ */
+void WritableCatalog::FlushStagedEntries() {
+  bool retval;
+  if (staged_entries_.size() == kBulkInsertRows) {
+    for (unsigned i = 0; i < kBulkInsertRows; ++i) {
+      const StagedEntry &staged = staged_entries_[i];
+      retval =
+        sql_bulk_insert_->BindPathHash(staged.path_hash, i) &&
+        sql_bulk_insert_->BindParentPathHash(staged.parent_hash, i) &&
+        sql_bulk_insert_->BindDirent(staged.entry, i);
+      assert(retval);
+      if (staged.xattrs.IsEmpty())
+        retval = sql_bulk_insert_->BindXattrEmpty(i);
+      else
+        retval = sql_bulk_insert_->BindXattr(staged.xattrs, i);
+      assert(retval);
+    }
+    retval = sql_bulk_insert_->Execute();
+    assert(retval);
+    sql_bulk_insert_->Reset();
+  } else {
+    for (unsigned i = 0; i < staged_entries_.size(); ++i) {
+      const StagedEntry &staged = staged_entries_[i];
+      retval =
+        sql_insert_->BindPathHash(staged.path_hash) &&
+        sql_insert_->BindParentPathHash(staged.parent_hash) &&
+        sql_insert_->BindDirent(staged.entry);
+      assert(retval);
+      if (staged.xattrs.IsEmpty())
+        retval = sql_insert_->BindXattrEmpty();
+      else
+        retval = sql_insert_->BindXattr(staged.xattrs);
+      assert(retval);
+      retval = sql_insert_->Execute();
+      assert(retval);
+      sql_insert_->Reset();
+    }
+  }
+  staged_entries_.clear();
+}
+
+
 /**
  * Removes the specified entry from the catalog.
  * Note: removing a directory which is non-empty results in dangling entries.
@@ -259,6 +388,10 @@ void WritableCatalog::AddFileChunk(const std::string &entry_path,
 
   delta_counters_.self.file_chunks++;
 
+  // The chunks reference their file entry
+  if (bulk_insert_)
+    FlushStagedEntries();
+
   bool retval =
     sql_chunk_insert_->BindPathHash(path_hash) &&
     sql_chunk_insert_->BindFileChunk(chunk) &&
@@ -302,6 +435,16 @@ void WritableCatalog::UpdateLastModified() {
 }
 
 
+/**
+ * Sets the schema version according to the compression algorithms of the
+ * entries, see CatalogDatabase::UpdateCompressionSchema().
+ */
+void WritableCatalog::UpdateCompressionSchema() {
+  const bool retval = database().UpdateCompressionSchema();
+  assert(retval);
+}
+
+
 /**
  * Increments the revision of the catalog in the database.
  */
@@ -346,8 +489,10 @@ void WritableCatalog::Partition(WritableCatalog *new_nested_catalog) {
   // if we hit nested catalog mountpoints on the way, we return them through
   // the passed list
   vector<string> GrandChildMountpoints;
+  new_nested_catalog->BeginBulkInsert();
   MoveToNested(new_nested_catalog->mountpoint().ToString(), new_nested_catalog,
                &GrandChildMountpoints);
+  new_nested_catalog->EndBulkInsert();
 
   // Nested catalog mountpoints found in the moved directory structure are now
   // links to nested catalogs of the newly created nested catalog.
@@ -601,6 +746,8 @@ void WritableCatalog::UpdateNestedCatalog(const std::string   &path,
                                           const uint64_t       size,
                                           const DeltaCounters &child_counters) {
   MutexLockGuard guard(lock_);
+  // The parent might not have changed by itself but it is committed as well
+  SetDirty();
 
   child_counters.PopulateToParent(&delta_counters_);
 
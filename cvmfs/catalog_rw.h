@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "catalog.h"
+#include "xattr.h"
 #include "util/posix.h"
 
 class XattrList;
@@ -34,6 +35,7 @@ namespace catalog {
 class WritableCatalogManager;
 
 class WritableCatalog : public Catalog {
+  FRIEND_TEST(T_Catalog, BulkInsert);
   friend class WritableCatalogManager;
   friend class swissknife::CommandMigrate;  // needed for catalog migrations
   friend class VirtualCatalog;  // needed for /.cvmfs creation
@@ -54,6 +56,20 @@ class WritableCatalog : public Catalog {
   void Transaction();
   void Commit();
 
+  /**
+   * In bulk insert mode, new entries are staged in memory and written by
+   * multi-row inserts, journaling is switched off and the parent index is only
+   * rebuilt at the end.  Until EndBulkInsert(), the catalog must not be read
+   * and only AddEntry(), AddFileChunk() and InsertNestedCatalog() are allowed.
+   * EndBulkInsert() commits the loaded rows and restores the previous journal
+   * mode and synchronous setting.
+   *
+   * Only Partition() uses the bulk mode.  The sync path looks up the parent
+   * directory of every new entry, which would miss the staged rows.
+   */
+  void BeginBulkInsert();
+  void EndBulkInsert();
+
   inline bool IsDirty() const { return dirty_; }
   inline bool IsWritable() const { return true; }
   uint32_t GetMaxLinkId() const;
@@ -95,6 +111,7 @@ class WritableCatalog : public Catalog {
   void RemoveBindMountpoint(const std::string &mountpoint);
 
   void UpdateLastModified();
+  void UpdateCompressionSchema();
   void IncrementRevision();
   void SetRevision(const uint64_t new_revision);
   void SetPreviousRevision(const shash::Any &hash);
@@ -104,6 +121,11 @@ class WritableCatalog : public Catalog {
  protected:
   static const double kMaximalFreePageRatio;  // = 0.2
   static const double kMaximalRowIdWasteRatio;  // = 0.25;
+  /**
+   * Rows per multi-row insert, stays below SQLite's default limit of 999
+   * bound parameters per statement.
+   */
+  static const unsigned kBulkInsertRows = 64;
 
   CatalogDatabase::OpenMode DatabaseOpenMode() const {
     return CatalogDatabase::kOpenReadWrite;
@@ -143,7 +165,18 @@ class WritableCatalog : public Catalog {
   }
 
  private:
+  struct StagedEntry {
+    StagedEntry(const shash::Md5 &p, const shash::Md5 &pp,
+                const DirectoryEntry &e, const XattrList &x)
+      : path_hash(p), parent_hash(pp), entry(e), xattrs(x) { }
+    shash::Md5 path_hash;
+    shash::Md5 parent_hash;
+    DirectoryEntry entry;
+    XattrList xattrs;
+  };
+
   SqlDirentInsert     *sql_insert_;
+  SqlDirentInsert     *sql_bulk_insert_;
   SqlDirentUnlink     *sql_unlink_;
   SqlDirentTouch      *sql_touch_;
   SqlDirentUpdate     *sql_update_;
@@ -154,6 +187,13 @@ class WritableCatalog : public Catalog {
   SqlIncLinkcount     *sql_inc_linkcount_;
 
   bool dirty_;  /**< Indicates if the catalog has been changed */
+  bool bulk_insert_;
+  std::vector<StagedEntry> staged_entries_;
+  /**
+   * SQLite settings before BeginBulkInsert(), restored by EndBulkInsert()
+   */
+  std::string saved_journal_mode_;
+  int saved_synchronous_;
 
   DeltaCounters delta_counters_;
 
@@ -191,6 +231,8 @@ class WritableCatalog : public Catalog {
   void CopyToParent();
   void CopyCatalogsToParent();
 
+  void FlushStagedEntries();
+
   void UpdateCounters();
   void VacuumDatabaseIfNecessary();
 };  // class WritableCatalog
@@ -29,6 +29,11 @@ namespace catalog {
  */
 
 // ChangeLog
+// 2.6 (Oct 18 2026)
+//     * same structure as 2.5 revision 4
+//     * set on catalogs with entries compressed by algorithms other than zlib
+//       so that older clients refuse them instead of misreading the objects
+//
 // 2.5 (Jun 26 2013 - Git: e79baec22c6abd6ddcdf8f8d7d33921027a052ab)
 //     * add (backward compatible) schema revision - see below
 //     * add statistics counters for chunked files
@@ -50,7 +55,8 @@ namespace catalog {
 // 1.x (earlier - based on SVN :-) )
 //     * pre-historic times
 const float CatalogDatabase::kLatestSchema = 2.5;
-const float CatalogDatabase::kLatestSupportedSchema = 2.5;  // + 1.X (r/o)
+const float CatalogDatabase::kLatestSupportedSchema = 2.6;  // + 1.X (r/o)
+const float CatalogDatabase::kCompressionSchema = 2.6;
 
 // ChangeLog
 //   0 --> 1: (Jan  6 2014 - Git: 3667fe7a669d0d65e07275b753a7c6f23fc267df)
@@ -72,8 +78,9 @@ const unsigned CatalogDatabase::kLatestSchemaRevision = 4;
 bool CatalogDatabase::CheckSchemaCompatibility() {
   return !( (schema_version() >= 2.0-kSchemaEpsilon)                   &&
             (!IsEqualSchema(schema_version(), kLatestSupportedSchema)) &&
+            (!IsEqualSchema(schema_version(), kLatestSchema))          &&
             (!IsEqualSchema(schema_version(), 2.4)           ||
-             !IsEqualSchema(kLatestSupportedSchema, 2.5)) );
+             !IsEqualSchema(kLatestSchema, 2.5)) );
 }
 
 
@@ -320,6 +327,36 @@ CatalogDatabase::SetVOMSAuthz(const std::string &voms_authz) {
 }
 
 
+/**
+ * Marks the catalog as schema 2.6 if any of its entries is compressed with an
+ * algorithm other than zlib and reverts it to 2.5 otherwise.  Clients that
+ * predate zstd and LZ4 support refuse 2.6 catalogs.
+ */
+bool CatalogDatabase::UpdateCompressionSchema() {
+  assert(read_write());
+  if (!IsEqualSchema(schema_version(), kLatestSchema) &&
+      !IsEqualSchema(schema_version(), kCompressionSchema))
+  {
+    return true;
+  }
+
+  const int compression_mask = 7 << SqlDirent::kFlagPosCompression;
+  SqlCatalog new_compression_query(*this,
+    "SELECT 1 FROM catalog WHERE ((flags&" + StringifyInt(compression_mask) +
+    ") >> " + StringifyInt(SqlDirent::kFlagPosCompression) + ") > " +
+    StringifyInt(zlib::kNoCompression) + " LIMIT 1;");
+  const float new_schema = new_compression_query.FetchRow()
+                           ? kCompressionSchema : kLatestSchema;
+  if (IsEqualSchema(schema_version(), new_schema))
+    return true;
+
+  LogCvmfs(kLogCatalog, kLogDebug, "changing catalog schema %.1f --> %.1f",
+           schema_version(), new_schema);
+  set_schema_version(new_schema);
+  return StoreSchemaRevision();
+}
+
+
 double CatalogDatabase::GetRowIdWasteRatio() const {
   SqlCatalog rowid_waste_ratio_query(*this,
     "SELECT 1.0 - CAST(COUNT(*) AS DOUBLE) / MAX(rowid) "
@@ -811,11 +848,12 @@ SqlNestedCatalogLookup::SqlNestedCatalogLookup(const CatalogDatabase &database)
   static const char *stmt_2_5_lt_1 =
     "SELECT sha1, 0 FROM nested_catalogs WHERE path=:path;";
 
-  if (database.IsEqualSchema(database.schema_version(), 2.5) &&
+  if ((database.schema_version() >= 2.5 - CatalogDatabase::kSchemaEpsilon) &&
      (database.schema_revision() >= 4))
   {
     DeferredInit(database.sqlite_db(), stmt_2_5_ge_4);
-  } else if (database.IsEqualSchema(database.schema_version(), 2.5) &&
+  } else if ((database.schema_version() >=
+              2.5 - CatalogDatabase::kSchemaEpsilon) &&
             (database.schema_revision() >= 1))
   {
     DeferredInit(database.sqlite_db(), stmt_2_5_ge_1_lt_4);
@@ -858,11 +896,12 @@ SqlNestedCatalogListing::SqlNestedCatalogListing(
   static const char *stmt_2_5_lt_1 =
     "SELECT path, sha1, 0 FROM nested_catalogs;";
 
-  if (database.IsEqualSchema(database.schema_version(), 2.5) &&
+  if ((database.schema_version() >= 2.5 - CatalogDatabase::kSchemaEpsilon) &&
      (database.schema_revision() >= 4))
   {
     DeferredInit(database.sqlite_db(), stmt_2_5_ge_4);
-  } else if (database.IsEqualSchema(database.schema_version(), 2.5) &&
+  } else if ((database.schema_version() >=
+              2.5 - CatalogDatabase::kSchemaEpsilon) &&
             (database.schema_revision() >= 1))
   {
     DeferredInit(database.sqlite_db(), stmt_2_5_ge_1_lt_4);
@@ -903,7 +942,7 @@ SqlOwnNestedCatalogListing::SqlOwnNestedCatalogListing(
   static const char *stmt_2_5_lt_1 =
     "SELECT path, sha1, 0 FROM nested_catalogs;";
 
-  if (database.IsEqualSchema(database.schema_version(), 2.5) &&
+  if ((database.schema_version() >= 2.5 - CatalogDatabase::kSchemaEpsilon) &&
      (database.schema_revision() >= 1))
   {
     DeferredInit(database.sqlite_db(), stmt_2_5_ge_1);
@@ -935,45 +974,79 @@ uint64_t SqlOwnNestedCatalogListing::GetSize() const {
 //------------------------------------------------------------------------------
 
 
-SqlDirentInsert::SqlDirentInsert(const CatalogDatabase &database) {
-  DeferredInit(database.sqlite_db(),
+const unsigned SqlDirentInsert::kNumColumns;
+
+SqlDirentInsert::SqlDirentInsert(const CatalogDatabase &database,
+                                 const unsigned rows)
+{
+  assert(rows > 0);
+  if (rows == 1) {
+    DeferredInit(database.sqlite_db(),
+      "INSERT INTO catalog "
+      "(md5path_1, md5path_2, parent_1, parent_2, hash, hardlinks, size, mode,"
+      //    1           2         3         4       5       6        7     8
+      "mtime, flags, name, symlink, uid, gid, xattr) "
+      // 9,     10    11     12     13   14   15
+      "VALUES (:md5_1, :md5_2, :p_1, :p_2, :hash, :links, :size, :mode, "
+      ":mtime, :flags, :name, :symlink, :uid, :gid, :xattr);");
+    return;
+  }
+
+  // Same columns as above, the parameters of row i start at i * kNumColumns
+  std::string statement =
     "INSERT INTO catalog "
     "(md5path_1, md5path_2, parent_1, parent_2, hash, hardlinks, size, mode,"
-    //    1           2         3         4       5       6        7     8
-    "mtime, flags, name, symlink, uid, gid, xattr) "
-    // 9,     10    11     12     13   14   15
-    "VALUES (:md5_1, :md5_2, :p_1, :p_2, :hash, :links, :size, :mode, :mtime,"
-    " :flags, :name, :symlink, :uid, :gid, :xattr);");
+    "mtime, flags, name, symlink, uid, gid, xattr) VALUES ";
+  for (unsigned i = 0; i < rows; ++i) {
+    statement += (i == 0) ? "(" : ", (";
+    for (unsigned j = 0; j < kNumColumns; ++j)
+      statement += (j == 0) ? "?" : ", ?";
+    statement += ")";
+  }
+  statement += ";";
+  const bool retval = Init(database.sqlite_db(), statement);
+  assert(retval);
 }
 
 
-bool SqlDirentInsert::BindPathHash(const shash::Md5 &hash) {
-  return BindMd5(1, 2, hash);
+bool SqlDirentInsert::BindPathHash(const shash::Md5 &hash,
+                                   const unsigned row)
+{
+  const int offset = row * kNumColumns;
+  return BindMd5(offset + 1, offset + 2, hash);
 }
 
 
-bool SqlDirentInsert::BindParentPathHash(const shash::Md5 &hash) {
-  return BindMd5(3, 4, hash);
+bool SqlDirentInsert::BindParentPathHash(const shash::Md5 &hash,
+                                         const unsigned row)
+{
+  const int offset = row * kNumColumns;
+  return BindMd5(offset + 3, offset + 4, hash);
 }
 
 
-bool SqlDirentInsert::BindDirent(const DirectoryEntry &entry) {
-  return BindDirentFields(5, 6, 7, 8, 9, 10, 11, 12, 13, 14, entry);
+bool SqlDirentInsert::BindDirent(const DirectoryEntry &entry,
+                                 const unsigned row)
+{
+  const int offset = row * kNumColumns;
+  return BindDirentFields(offset + 5, offset + 6, offset + 7, offset + 8,
+                          offset + 9, offset + 10, offset + 11, offset + 12,
+                          offset + 13, offset + 14, entry);
 }
 
 
-bool SqlDirentInsert::BindXattr(const XattrList &xattrs) {
+bool SqlDirentInsert::BindXattr(const XattrList &xattrs, const unsigned row) {
   unsigned char *packed_xattrs;
   unsigned size;
   xattrs.Serialize(&packed_xattrs, &size);
   if (packed_xattrs == NULL)
-    return BindNull(15);
-  return BindBlobTransient(15, packed_xattrs, size);
+    return BindNull(row * kNumColumns + 15);
+  return BindBlobTransient(row * kNumColumns + 15, packed_xattrs, size);
 }
 
 
-bool SqlDirentInsert::BindXattrEmpty() {
-  return BindNull(15);
+bool SqlDirentInsert::BindXattrEmpty(const unsigned row) {
+  return BindNull(row * kNumColumns + 15);
 }
 
 
@@ -1286,6 +1359,28 @@ bool SqlAllChunks::Close() {
 //------------------------------------------------------------------------------
 
 
+SqlAllPathHashes::SqlAllPathHashes(const CatalogDatabase &database) {
+  DeferredInit(database.sqlite_db(),
+               "SELECT md5path_1, md5path_2 FROM catalog "
+               "WHERE (rowid >= :first) AND (rowid <= :last);");
+}
+
+
+bool SqlAllPathHashes::BindRowIdRange(const uint64_t first,
+                                      const uint64_t last)
+{
+  return BindInt64(1, first) && BindInt64(2, last);
+}
+
+
+shash::Md5 SqlAllPathHashes::GetPathHash() const {
+  return RetrieveMd5(0, 1);
+}
+
+
+//------------------------------------------------------------------------------
+
+
 SqlLookupXattrs::SqlLookupXattrs(const CatalogDatabase &database) {
   DeferredInit(database.sqlite_db(),
     "SELECT xattr FROM catalog "
@@ -42,6 +42,8 @@ class CatalogDatabase : public sqlite::Database<CatalogDatabase> {
  public:
   static const float kLatestSchema;
   static const float kLatestSupportedSchema;  // + 1.X catalogs (r/o)
+  // Set instead of kLatestSchema if zstd or LZ4 compressed objects are used
+  static const float kCompressionSchema;
   // Backwards-compatible schema changes
   static const unsigned kLatestSchemaRevision;
 
@@ -54,6 +56,7 @@ class CatalogDatabase : public sqlite::Database<CatalogDatabase> {
 
   bool CheckSchemaCompatibility();
   bool LiveSchemaUpgradeIfNecessary();
+  bool UpdateCompressionSchema();
   bool CompactDatabase() const;
 
   double GetRowIdWasteRatio() const;
@@ -429,14 +432,22 @@ class SqlOwnNestedCatalogListing : public SqlCatalog {
 //------------------------------------------------------------------------------
 
 
+/**
+ * Inserts one or, for bulk loading, several directory entries at once.  The
+ * row parameter of the bind methods selects the entry in a multi-row insert.
+ */
 class SqlDirentInsert : public SqlDirentWrite {
  public:
-  explicit SqlDirentInsert(const CatalogDatabase &database);
-  bool BindPathHash(const shash::Md5 &hash);
-  bool BindParentPathHash(const shash::Md5 &hash);
-  bool BindDirent(const DirectoryEntry &entry);
-  bool BindXattr(const XattrList &xattrs);
-  bool BindXattrEmpty();
+  static const unsigned kNumColumns = 15;
+
+  explicit SqlDirentInsert(const CatalogDatabase &database,
+                           const unsigned rows = 1);
+  bool BindPathHash(const shash::Md5 &hash, const unsigned row = 0);
+  bool BindParentPathHash(const shash::Md5 &hash, const unsigned row = 0);
+  bool BindDirent(const DirectoryEntry &entry) { return BindDirent(entry, 0); }
+  bool BindDirent(const DirectoryEntry &entry, const unsigned row);
+  bool BindXattr(const XattrList &xattrs, const unsigned row = 0);
+  bool BindXattrEmpty(const unsigned row = 0);
 };
 
 
@@ -578,6 +589,21 @@ class SqlAllChunks : public SqlCatalog {
 //------------------------------------------------------------------------------
 
 
+/**
+ * Iterates over the path hashes of the entries in a range of row ids, so that
+ * all entries of the catalog can be read in batches.
+ */
+class SqlAllPathHashes : public SqlCatalog {
+ public:
+  explicit SqlAllPathHashes(const CatalogDatabase &database);
+  bool BindRowIdRange(const uint64_t first, const uint64_t last);
+  shash::Md5 GetPathHash() const;
+};
+
+
+//------------------------------------------------------------------------------
+
+
 class SqlLookupXattrs : public SqlCatalog {
  public:
   explicit SqlLookupXattrs(const CatalogDatabase &database);
@@ -5,8 +5,12 @@
 #ifndef CVMFS_CATALOG_TRAVERSAL_H_
 #define CVMFS_CATALOG_TRAVERSAL_H_
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include <cassert>
 #include <limits>
+#include <map>
 #include <set>
 #include <stack>
 #include <string>
@@ -19,6 +23,8 @@
 #include "manifest.h"
 #include "object_fetcher.h"
 #include "signature.h"
+#include "util/pointer.h"
+#include "util/single_copy.h"
 #include "util_concurrency.h"
 
 namespace catalog {
@@ -79,6 +85,239 @@ class CatalogTraversalInfoShim {
 };
 
 
+/**
+ * Downloads catalogs in the background on behalf of CatalogTraversal<>, so
+ * that the traversal does not wait for one catalog download at a time.
+ * Catalogs are requested as soon as they are pushed on the traversal stack.
+ * Requests are served newest first, which matches the order in which the
+ * traversal pops them.  At most max_prefetched catalogs are downloaded but not
+ * yet claimed at any time, which bounds the required temporary disk space.
+ *
+ * Prefetch(), Claim(), and Discard() must be called from a single thread.
+ */
+template <class ObjectFetcherT>
+class CatalogPrefetcher : SingleCopy {
+ public:
+  typedef typename ObjectFetcherT::Failures Failures;
+
+  CatalogPrefetcher(ObjectFetcherT *object_fetcher,
+                    const unsigned  num_threads,
+                    const unsigned  max_prefetched)
+    : object_fetcher_(object_fetcher)
+    , max_prefetched_(max_prefetched)
+    , num_outstanding_(0)
+    , stop_(false)
+  {
+    assert(num_threads > 0);
+    assert(max_prefetched > 0);
+    int retval = pthread_mutex_init(&lock_, NULL);
+    assert(retval == 0);
+    retval = pthread_cond_init(&cond_request_, NULL);
+    assert(retval == 0);
+    retval = pthread_cond_init(&cond_done_, NULL);
+    assert(retval == 0);
+
+    threads_.resize(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+      retval = pthread_create(&threads_[i], NULL, MainPrefetch, this);
+      assert(retval == 0);
+    }
+  }
+
+  ~CatalogPrefetcher() {
+    {
+      MutexLockGuard guard(lock_);
+      stop_ = true;
+      pthread_cond_broadcast(&cond_request_);
+    }
+    for (unsigned i = 0; i < threads_.size(); ++i) {
+      int retval = pthread_join(threads_[i], NULL);
+      assert(retval == 0);
+    }
+    DiscardAll();
+    pthread_cond_destroy(&cond_done_);
+    pthread_cond_destroy(&cond_request_);
+    pthread_mutex_destroy(&lock_);
+  }
+
+  void Prefetch(const shash::Any &catalog_hash) {
+    MutexLockGuard guard(lock_);
+    typename EntryMap::iterator i = entries_.find(catalog_hash);
+    if (i != entries_.end()) {
+      i->second.discarded = false;
+      return;
+    }
+    entries_[catalog_hash] = Entry();
+    requests_.push_back(catalog_hash);
+    pthread_cond_signal(&cond_request_);
+  }
+
+  /**
+   * Hands out a prefetched catalog, waiting for its download if necessary.  On
+   * success, the caller owns the database file.  Returns false if the catalog
+   * was not requested or its download has not started yet.  In this case, the
+   * caller needs to fetch the catalog by itself.
+   */
+  bool Claim(const shash::Any  &catalog_hash,
+             Failures          *result,
+             std::string       *file_path) {
+    MutexLockGuard guard(lock_);
+    while (true) {
+      typename EntryMap::iterator i = entries_.find(catalog_hash);
+      if ((i == entries_.end()) || i->second.discarded)
+        return false;
+
+      switch (i->second.state) {
+        case kStatePending:
+          entries_.erase(i);
+          return false;
+        case kStateFetching:
+          pthread_cond_wait(&cond_done_, &lock_);
+          break;
+        case kStateDone:
+          *result = i->second.result;
+          *file_path = i->second.file_path;
+          entries_.erase(i);
+          ReleaseSlot();
+          return true;
+      }
+    }
+  }
+
+  /**
+   * Drops a requested catalog that the traversal does not need anymore.
+   */
+  void Discard(const shash::Any &catalog_hash) {
+    MutexLockGuard guard(lock_);
+    typename EntryMap::iterator i = entries_.find(catalog_hash);
+    if (i != entries_.end())
+      DiscardEntry(i);
+  }
+
+  void DiscardAll() {
+    MutexLockGuard guard(lock_);
+    typename EntryMap::iterator i = entries_.begin();
+    while (i != entries_.end()) {
+      typename EntryMap::iterator next = i;
+      ++next;
+      DiscardEntry(i);
+      i = next;
+    }
+    requests_.clear();
+  }
+
+ private:
+  enum State {
+    kStatePending,
+    kStateFetching,
+    kStateDone
+  };
+
+  struct Entry {
+    Entry()
+      : state(kStatePending)
+      , result(ObjectFetcherT::kFailOk)
+      , discarded(false) {}
+
+    State        state;
+    Failures     result;
+    std::string  file_path;
+    /**
+     * Set if the entry is discarded while it is being downloaded.  The
+     * downloading thread removes it once it is finished.
+     */
+    bool         discarded;
+  };
+  typedef std::map<shash::Any, Entry> EntryMap;
+
+  static void *MainPrefetch(void *data) {
+    CatalogPrefetcher *prefetcher = static_cast<CatalogPrefetcher *>(data);
+    while (prefetcher->FetchNext()) { }
+    return NULL;
+  }
+
+  /**
+   * Downloads the most recently requested catalog.  Returns false once the
+   * prefetcher is stopped.
+   */
+  bool FetchNext() {
+    shash::Any catalog_hash;
+    {
+      MutexLockGuard guard(lock_);
+      while (true) {
+        if (stop_)
+          return false;
+        if (!requests_.empty() && (num_outstanding_ < max_prefetched_)) {
+          catalog_hash = requests_.back();
+          requests_.pop_back();
+          typename EntryMap::iterator i = entries_.find(catalog_hash);
+          if ((i == entries_.end()) || (i->second.state != kStatePending))
+            continue;
+          i->second.state = kStateFetching;
+          ++num_outstanding_;
+          break;
+        }
+        pthread_cond_wait(&cond_request_, &lock_);
+      }
+    }
+
+    std::string file_path;
+    const Failures result =
+      object_fetcher_->FetchCatalogFile(catalog_hash, &file_path);
+
+    MutexLockGuard guard(lock_);
+    typename EntryMap::iterator i = entries_.find(catalog_hash);
+    assert((i != entries_.end()) && (i->second.state == kStateFetching));
+    i->second.state = kStateDone;
+    i->second.result = result;
+    i->second.file_path = file_path;
+    if (i->second.discarded)
+      DiscardEntry(i);
+    pthread_cond_broadcast(&cond_done_);
+    return true;
+  }
+
+  /**
+   * Needs to be called with the lock held
+   */
+  void DiscardEntry(typename EntryMap::iterator i) {
+    switch (i->second.state) {
+      case kStatePending:
+        entries_.erase(i);
+        break;
+      case kStateFetching:
+        i->second.discarded = true;
+        break;
+      case kStateDone:
+        if (i->second.result == ObjectFetcherT::kFailOk)
+          unlink(i->second.file_path.c_str());
+        entries_.erase(i);
+        ReleaseSlot();
+        break;
+    }
+  }
+
+  void ReleaseSlot() {
+    --num_outstanding_;
+    pthread_cond_signal(&cond_request_);
+  }
+
+  ObjectFetcherT          *object_fetcher_;
+  const unsigned           max_prefetched_;
+  /**
+   * Catalogs that are being downloaded or are downloaded but not yet claimed
+   */
+  unsigned                 num_outstanding_;
+  bool                     stop_;
+  EntryMap                 entries_;
+  std::vector<shash::Any>  requests_;
+  std::vector<pthread_t>   threads_;
+  pthread_mutex_t          lock_;
+  pthread_cond_t           cond_request_;
+  pthread_cond_t           cond_done_;
+};
+
+
 /**
  * This class traverses the catalog hierarchy of a CVMFS repository recursively.
  * Also historic catalog trees can be traversed. The user needs to specify a
@@ -95,6 +334,7 @@ class CatalogTraversalInfoShim {
  *   -> Traverse starting from a provided catalog
  *   -> Traverse catalogs that were previously skipped
  *   -> Produce various flavours of catalogs (writable, mocked, ...)
+ *   -> Download catalogs ahead of the traversal in background threads
  *
  * Breadth First Traversal Strategy
  *   Catalogs are handed out to the user identical as they are traversed.
@@ -114,6 +354,14 @@ class CatalogTraversalInfoShim {
  *   Note: This method needs more disk space to temporarily store downloaded but
  *         not yet processed catalogs.
  *
+ * Prefetching
+ *   With num_threads > 0, the referenced catalogs of a catalog are downloaded
+ *   in the background as soon as the catalog is opened (see
+ *   CatalogPrefetcher<>).  The traversal order, the pruning thresholds, and the
+ *   callbacks are unaffected; callbacks are still invoked one at a time from
+ *   the thread that runs the traversal.  The object fetcher needs to support
+ *   concurrent downloads.
+ *
  * Note: Since all CVMFS catalog files together can grow to several gigabytes in
  *       file size, each catalog is loaded, processed and removed immediately
  *       afterwards. Except if no_close is specified, which allows the user to
@@ -161,6 +409,9 @@ class CatalogTraversal
    *                             could not be loaded (i.e. was sweeped before by
    *                             a garbage collection run)
    * @param quiet                silence messages that would go to stderr
+   * @param num_threads          number of threads that download catalogs ahead
+   *                             of the traversal (default: 0 - catalogs are
+   *                             downloaded one by one when they are visited)
    * @param tmp_dir              path to the temporary directory to be used
    *                             (default: /tmp)
    */
@@ -172,7 +423,8 @@ class CatalogTraversal
       , no_repeat_history(false)
       , no_close(false)
       , ignore_load_failure(false)
-      , quiet(false) {}
+      , quiet(false)
+      , num_threads(0) {}
 
     static const unsigned int kFullHistory;
     static const unsigned int kNoHistory;
@@ -186,6 +438,7 @@ class CatalogTraversal
     bool            no_close;
     bool            ignore_load_failure;
     bool            quiet;
+    unsigned int    num_threads;
   };
 
  public:
@@ -196,6 +449,12 @@ class CatalogTraversal
 
  protected:
   typedef std::set<shash::Any> HashSet;
+  typedef CatalogPrefetcher<ObjectFetcherT> PrefetcherTN;
+
+  /**
+   * Number of catalogs per prefetch thread that may wait for the traversal
+   */
+  static const unsigned int kPrefetchedPerThread = 4;
 
  protected:
   /**
@@ -285,6 +544,10 @@ class CatalogTraversal
     , error_sink_((params.quiet) ? kLogDebug : kLogStderr)
   {
     assert(object_fetcher_ != NULL);
+    if (params.num_threads > 0) {
+      prefetcher_ = new PrefetcherTN(object_fetcher_, params.num_threads,
+                                     params.num_threads * kPrefetchedPerThread);
+    }
   }
 
 
@@ -440,6 +703,15 @@ class CatalogTraversal
    * @return      true on successful traversal and false on abort
    */
   bool DoTraverse(TraversalContext *ctx) {
+    const bool retval = TraverseStack(ctx);
+    // catalogs left over from an aborted traversal or skipped as duplicates
+    if (prefetcher_.IsValid())
+      prefetcher_->DiscardAll();
+    return retval;
+  }
+
+
+  bool TraverseStack(TraversalContext *ctx) {
     assert(ctx->callback_stack.empty());
 
     while (!ctx->catalog_stack.empty()) {
@@ -481,16 +753,13 @@ class CatalogTraversal
   bool PrepareCatalog(const TraversalContext &ctx, CatalogJob *job) {
     // skipping duplicate catalogs might also yield postponed catalogs
     if (ShouldBeSkipped(*job)) {
+      if (prefetcher_.IsValid())
+        prefetcher_->Discard(job->hash);
       job->ignore = true;
       return true;
     }
 
-    const typename ObjectFetcherT::Failures retval =
-      object_fetcher_->FetchCatalog(job->hash,
-                                    job->path,
-                                    &job->catalog,
-                                    !job->IsRootCatalog(),
-                                    job->parent);
+    const typename ObjectFetcherT::Failures retval = FetchCatalog(job);
     switch (retval) {
       case ObjectFetcherT::kFailOk:
         break;
@@ -523,6 +792,30 @@ class CatalogTraversal
   }
 
 
+  typename ObjectFetcherT::Failures FetchCatalog(CatalogJob *job) {
+    typename ObjectFetcherT::Failures retval;
+    std::string file_path;
+    if (!prefetcher_.IsValid() ||
+        !prefetcher_->Claim(job->hash, &retval, &file_path))
+    {
+      return object_fetcher_->FetchCatalog(job->hash,
+                                           job->path,
+                                           &job->catalog,
+                                           !job->IsRootCatalog(),
+                                           job->parent);
+    }
+
+    if (retval != ObjectFetcherT::kFailOk)
+      return retval;
+    return object_fetcher_->OpenCatalog(job->hash,
+                                        job->path,
+                                        file_path,
+                                        &job->catalog,
+                                        !job->IsRootCatalog(),
+                                        job->parent);
+  }
+
+
   bool ReopenCatalog(CatalogJob *job) {
     assert(!job->ignore);
     assert(job->catalog == NULL);
@@ -782,6 +1075,8 @@ class CatalogTraversal
 
   void Push(const CatalogJob &job, TraversalContext *ctx) {
     ctx->catalog_stack.push(job);
+    if (prefetcher_.IsValid() && !ShouldBeSkipped(job))
+      prefetcher_->Prefetch(job.hash);
   }
 
   CatalogJob Pop(TraversalContext *ctx) {
@@ -835,6 +1130,7 @@ class CatalogTraversal
   const time_t            default_timestamp_threshold_;
   HashSet                 visited_catalogs_;
   LogFacilities           error_sink_;
+  UniquePtr<PrefetcherTN> prefetcher_;
 };
 
 template <class ObjectFetcherT>
@@ -15,15 +15,23 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 
+#include <lz4frame.h>
+#include <pthread.h>
+#include <zdict.h>
+#include <zstd.h>
+
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <map>
 
 #include "hash.h"
 #include "logging.h"
 #include "platform.h"
 #include "smalloc.h"
+#include "util/pointer.h"
 #include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -141,14 +149,28 @@ namespace zlib {
 
 const unsigned kBufferSize = 32768;
 
-/**
- * Aborts if string doesn't match any of the algorithms.
- */
-Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option) {
+Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option,
+                                     int *level)
+{
+  if (level != NULL)
+    *level = 0;
   if ((algorithm_option == "default") || (algorithm_option == "zlib"))
     return kZlibDefault;
   if (algorithm_option == "none")
     return kNoCompression;
+  if (algorithm_option == "zstd")
+    return kZstd;
+  if (HasPrefix(algorithm_option, "zstd:", false)) {
+    // Level given as zstd:<level>
+    const int64_t zstd_level = String2Int64(algorithm_option.substr(5));
+    if ((zstd_level >= 1) && (zstd_level <= ZSTD_maxCLevel())) {
+      if (level != NULL)
+        *level = zstd_level;
+      return kZstd;
+    }
+  }
+  if (algorithm_option == "lz4")
+    return kLz4;
   LogCvmfs(kLogCompress, kLogStderr, "unknown compression algorithms: %s",
            algorithm_option.c_str());
   assert(false);
@@ -163,6 +185,12 @@ std::string AlgorithmName(const zlib::Algorithms alg) {
     case kNoCompression:
       return "none";
       break;
+    case kZstd:
+      return "zstd";
+      break;
+    case kLz4:
+      return "lz4";
+      break;
     // Purposely did not add a 'default' statement here: this will
     // cause the compiler to generate a warning if a new algorithm
     // is added but this function is not updated.
@@ -171,6 +199,18 @@ std::string AlgorithmName(const zlib::Algorithms alg) {
 }
 
 
+bool IsSupportedAlgorithm(const zlib::Algorithms alg) {
+  switch (alg) {
+    case kZlibDefault:
+    case kNoCompression:
+    case kZstd:
+    case kLz4:
+      return true;
+  }
+  return false;
+}
+
+
 void CompressInit(z_stream *strm) {
   strm->zalloc = Z_NULL;
   strm->zfree = Z_NULL;
@@ -637,7 +677,24 @@ bool CompressFile2File(FILE *fsrc, FILE *fdest, shash::Any *compressed_hash) {
 }
 
 
-bool DecompressFile2File(FILE *fsrc, FILE *fdest) {
+bool DecompressFile2File(FILE *fsrc, FILE *fdest, const Algorithms alg) {
+  if (alg != kZlibDefault) {
+    UniquePtr<Decompressor> decompressor(Decompressor::Construct(alg));
+    cvmfs::FileSink sink(fdest);
+    StreamStates stream_state = kStreamIOError;
+    size_t have;
+    unsigned char buf[kBufferSize];
+    while ((have = fread(buf, 1, kBufferSize, fsrc)) > 0) {
+      stream_state = decompressor->Inflate(buf, have, &sink);
+      if ((stream_state == kStreamDataError) ||
+          (stream_state == kStreamIOError))
+      {
+        return false;
+      }
+    }
+    return (stream_state == kStreamEnd) && !ferror(fsrc);
+  }
+
   bool result = false;
   StreamStates stream_state = kStreamIOError;
   z_stream strm;
@@ -664,12 +721,14 @@ bool DecompressFile2File(FILE *fsrc, FILE *fdest) {
 }
 
 
-bool DecompressPath2File(const string &src, FILE *fdest) {
+bool DecompressPath2File(const string &src, FILE *fdest,
+                         const Algorithms alg)
+{
   FILE *fsrc = fopen(src.c_str(), "r");
   if (!fsrc)
     return false;
 
-  bool retval = DecompressFile2File(fsrc, fdest);
+  bool retval = DecompressFile2File(fsrc, fdest, alg);
   fclose(fsrc);
   return retval;
 }
@@ -733,12 +792,85 @@ bool CompressMem2File(const unsigned char *buf, const size_t size,
 }
 
 
+/**
+ * Collects the output of a Decompressor in a growing memory buffer.
+ */
+class MemSink : public cvmfs::Sink {
+ public:
+  MemSink() : size_(0), capacity_(kZChunk) {
+    data_ = static_cast<unsigned char *>(smalloc(capacity_));
+  }
+  virtual ~MemSink() { free(data_); }
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    if (size_ + sz > capacity_) {
+      while (size_ + sz > capacity_)
+        capacity_ *= 2;
+      data_ = static_cast<unsigned char *>(srealloc(data_, capacity_));
+    }
+    memcpy(data_ + size_, buf, sz);
+    size_ += sz;
+    return sz;
+  }
+  virtual int Reset() {
+    size_ = 0;
+    return 0;
+  }
+  /**
+   * Hands out the buffer, the caller needs to free it.
+   */
+  void Release(void **data, uint64_t *size) {
+    *data = data_;
+    *size = size_;
+    data_ = NULL;
+  }
+
+ private:
+  unsigned char *data_;
+  uint64_t size_;
+  uint64_t capacity_;
+};
+
+
+/**
+ * Runs the input through a Compressor of the given algorithm.
+ */
+static bool CompressorMem2Mem(const Algorithms alg,
+                              const void *buf, const int64_t size,
+                              void **out_buf, uint64_t *out_size)
+{
+  UniquePtr<Compressor> compressor(Compressor::Construct(alg));
+  unsigned char *inbuf =
+    static_cast<unsigned char *>(const_cast<void *>(buf));
+  size_t inbufsize = size;
+  uint64_t alloc_size = compressor->DeflateBound(size);
+  *out_buf = smalloc(alloc_size);
+  *out_size = 0;
+
+  bool done = false;
+  while (!done) {
+    if (alloc_size - *out_size < kZChunk) {
+      alloc_size *= 2;
+      *out_buf = srealloc(*out_buf, alloc_size);
+    }
+    unsigned char *outbuf = static_cast<unsigned char *>(*out_buf) + *out_size;
+    size_t outbufsize = alloc_size - *out_size;
+    done = compressor->Deflate(true, &inbuf, &inbufsize, &outbuf, &outbufsize);
+    *out_size += outbufsize;
+  }
+  return true;
+}
+
+
 /**
  * User of this function has to free out_buf.
  */
 bool CompressMem2Mem(const void *buf, const int64_t size,
-                    void **out_buf, uint64_t *out_size)
+                    void **out_buf, uint64_t *out_size,
+                    const Algorithms alg)
 {
+  if (alg != kZlibDefault)
+    return CompressorMem2Mem(alg, buf, size, out_buf, out_size);
+
   unsigned char out[kZChunk];
   int z_ret;
   int flush;
@@ -795,8 +927,23 @@ bool CompressMem2Mem(const void *buf, const int64_t size,
  * User of this function has to free out_buf.
  */
 bool DecompressMem2Mem(const void *buf, const int64_t size,
-                       void **out_buf, uint64_t *out_size)
+                       void **out_buf, uint64_t *out_size,
+                       const Algorithms alg)
 {
+  if (alg != kZlibDefault) {
+    UniquePtr<Decompressor> decompressor(Decompressor::Construct(alg));
+    MemSink sink;
+    if (!decompressor.IsValid() ||
+        (decompressor->Inflate(buf, size, &sink) != kStreamEnd))
+    {
+      *out_buf = NULL;
+      *out_size = 0;
+      return false;
+    }
+    sink.Release(out_buf, out_size);
+    return true;
+  }
+
   unsigned char out[kZChunk];
   int z_ret;
   z_stream strm;
@@ -858,6 +1005,8 @@ bool DecompressMem2Mem(const void *buf, const int64_t size,
 void Compressor::RegisterPlugins() {
   RegisterPlugin<ZlibCompressor>();
   RegisterPlugin<EchoCompressor>();
+  RegisterPlugin<ZstdCompressor>();
+  RegisterPlugin<Lz4Compressor>();
 }
 
 
@@ -975,4 +1124,616 @@ size_t EchoCompressor::DeflateBound(const size_t bytes) {
   return (bytes == 0) ? 1 : bytes;
 }
 
+
+//------------------------------------------------------------------------------
+
+
+FrameCompressor::FrameCompressor(const Algorithms &alg)
+  : Compressor(alg)
+  , in_buf_(static_cast<unsigned char *>(smalloc(kFrameSize)))
+  , in_size_(0)
+  , out_buf_(NULL)
+  , out_capacity_(0)
+  , out_size_(0)
+  , out_pos_(0)
+  , finished_(false)
+{
+}
+
+
+FrameCompressor::~FrameCompressor() {
+  free(in_buf_);
+  free(out_buf_);
+}
+
+
+void FrameCompressor::CopyStateTo(FrameCompressor *other) const {
+  memcpy(other->in_buf_, in_buf_, in_size_);
+  other->in_size_ = in_size_;
+  other->out_size_ = out_size_ - out_pos_;
+  other->out_pos_ = 0;
+  if (other->out_size_ > other->out_capacity_) {
+    other->out_buf_ = static_cast<unsigned char *>(
+      srealloc(other->out_buf_, other->out_size_));
+    other->out_capacity_ = other->out_size_;
+  }
+  if (other->out_size_ > 0)
+    memcpy(other->out_buf_, out_buf_ + out_pos_, other->out_size_);
+  other->finished_ = finished_;
+}
+
+
+/**
+ * Compresses the buffered input into a frame, which is then handed out in
+ * pieces by Deflate().
+ */
+void FrameCompressor::EmitFrame() {
+  assert(out_pos_ == out_size_);
+  const size_t bound = FrameBound(in_size_);
+  if (bound > out_capacity_) {
+    out_buf_ = static_cast<unsigned char *>(srealloc(out_buf_, bound));
+    out_capacity_ = bound;
+  }
+  out_size_ = CompressFrame(in_buf_, in_size_, out_buf_, out_capacity_);
+  out_pos_ = 0;
+  in_size_ = 0;
+}
+
+
+bool FrameCompressor::Deflate(
+  const bool flush,
+  unsigned char **inbuf, size_t *inbufsize,
+  unsigned char **outbuf, size_t *outbufsize)
+{
+  size_t out_used = 0;
+  while (true) {
+    // Hand out what's left from the last frame
+    const size_t out_bytes =
+      min(*outbufsize - out_used, out_size_ - out_pos_);
+    if (out_bytes > 0) {
+      memcpy(*outbuf + out_used, out_buf_ + out_pos_, out_bytes);
+      out_used += out_bytes;
+      out_pos_ += out_bytes;
+    }
+    if (out_pos_ < out_size_)
+      break;
+
+    const size_t in_bytes = min(*inbufsize, kFrameSize - in_size_);
+    if (in_bytes > 0) {
+      memcpy(in_buf_ + in_size_, *inbuf, in_bytes);
+      in_size_ += in_bytes;
+      *inbuf += in_bytes;
+      *inbufsize -= in_bytes;
+    }
+    if (in_size_ == kFrameSize) {
+      EmitFrame();
+      continue;
+    }
+    if (flush && !finished_) {
+      EmitFrame();
+      finished_ = true;
+      continue;
+    }
+    break;
+  }
+
+  *outbufsize = out_used;
+  const bool drained = (out_pos_ == out_size_) && (*inbufsize == 0);
+  return drained && (!flush || finished_);
+}
+
+
+size_t FrameCompressor::DeflateBound(const size_t bytes) {
+  const size_t num_frames = (in_size_ + bytes) / kFrameSize + 1;
+  return (out_size_ - out_pos_) + FrameBound(in_size_ + bytes) +
+         num_frames * FrameBound(0);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+Dictionary::~Dictionary() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+}
+
+
+Dictionary *Dictionary::Create(
+  const void *buf,
+  const size_t size,
+  const int level)
+{
+  const uint32_t id = ZSTD_getDictID_fromDict(buf, size);
+  if (id == 0)
+    return NULL;
+  Dictionary *dictionary = new Dictionary();
+  dictionary->id_ = id;
+  dictionary->cdict_ = ZSTD_createCDict(buf, size, level);
+  dictionary->ddict_ = ZSTD_createDDict(buf, size);
+  if ((dictionary->cdict_ == NULL) || (dictionary->ddict_ == NULL)) {
+    delete dictionary;
+    return NULL;
+  }
+  return dictionary;
+}
+
+
+bool Dictionary::Train(
+  const vector<string> &samples,
+  const size_t max_size,
+  string *dictionary)
+{
+  string samples_buffer;
+  vector<size_t> sample_sizes;
+  for (unsigned i = 0; i < samples.size(); ++i) {
+    if (samples[i].empty())
+      continue;
+    samples_buffer += samples[i];
+    sample_sizes.push_back(samples[i].size());
+  }
+  if (sample_sizes.empty())
+    return false;
+
+  dictionary->resize(max_size);
+  const size_t retval = ZDICT_trainFromBuffer(&(*dictionary)[0], max_size,
+    samples_buffer.data(), &sample_sizes[0], sample_sizes.size());
+  if (ZDICT_isError(retval)) {
+    LogCvmfs(kLogCompress, kLogDebug, "failed to train dictionary (%s)",
+             ZDICT_getErrorName(retval));
+    dictionary->clear();
+    return false;
+  }
+  dictionary->resize(retval);
+  return true;
+}
+
+
+static pthread_mutex_t lock_dictionaries = PTHREAD_MUTEX_INITIALIZER;
+static map<uint32_t, Dictionary *> *dictionaries = NULL;
+
+
+void Dictionary::Register(Dictionary *dictionary) {
+  pthread_mutex_lock(&lock_dictionaries);
+  if (dictionaries == NULL)
+    dictionaries = new map<uint32_t, Dictionary *>();
+  map<uint32_t, Dictionary *>::const_iterator i =
+    dictionaries->find(dictionary->id());
+  if (i == dictionaries->end()) {
+    (*dictionaries)[dictionary->id()] = dictionary;
+    dictionary = NULL;
+  }
+  pthread_mutex_unlock(&lock_dictionaries);
+  // Already known
+  delete dictionary;
+}
+
+
+const Dictionary *Dictionary::Find(const uint32_t id) {
+  const Dictionary *result = NULL;
+  pthread_mutex_lock(&lock_dictionaries);
+  if (dictionaries != NULL) {
+    map<uint32_t, Dictionary *>::const_iterator i = dictionaries->find(id);
+    if (i != dictionaries->end())
+      result = i->second;
+  }
+  pthread_mutex_unlock(&lock_dictionaries);
+  return result;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool ZstdCompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZstd;
+}
+
+
+ZstdCompressor::ZstdCompressor(const Algorithms &alg)
+  : FrameCompressor(alg)
+  , level_(kDefaultLevel)
+  , dictionary_(NULL)
+  , context_(ZSTD_createCCtx())
+{
+  assert(context_ != NULL);
+}
+
+
+ZstdCompressor::~ZstdCompressor() {
+  ZSTD_freeCCtx(context_);
+}
+
+
+/**
+ * Dictionary compression uses the level the dictionary was prepared with.
+ */
+void ZstdCompressor::SetLevel(const int level) {
+  level_ = (level > 0) ? level : kDefaultLevel;
+}
+
+
+void ZstdCompressor::SetDictionary(const Dictionary *dictionary) {
+  dictionary_ = dictionary;
+}
+
+
+Compressor* ZstdCompressor::Clone() {
+  ZstdCompressor *other = new ZstdCompressor(kZstd);
+  other->level_ = level_;
+  other->dictionary_ = dictionary_;
+  CopyStateTo(other);
+  return other;
+}
+
+
+size_t ZstdCompressor::CompressFrame(
+  const unsigned char *src, const size_t size,
+  unsigned char *dest, const size_t dest_size)
+{
+  size_t retval;
+  if (dictionary_ != NULL) {
+    retval = ZSTD_compress_usingCDict(context_, dest, dest_size, src, size,
+                                      dictionary_->cdict());
+  } else {
+    retval = ZSTD_compressCCtx(context_, dest, dest_size, src, size, level_);
+  }
+  assert(!ZSTD_isError(retval));
+  return retval;
+}
+
+
+size_t ZstdCompressor::FrameBound(const size_t bytes) {
+  return ZSTD_compressBound(bytes);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool Lz4Compressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kLz4;
+}
+
+
+Lz4Compressor::Lz4Compressor(const Algorithms &alg) : FrameCompressor(alg) { }
+
+
+Compressor* Lz4Compressor::Clone() {
+  Lz4Compressor *other = new Lz4Compressor(kLz4);
+  CopyStateTo(other);
+  return other;
+}
+
+
+size_t Lz4Compressor::CompressFrame(
+  const unsigned char *src, const size_t size,
+  unsigned char *dest, const size_t dest_size)
+{
+  const size_t retval = LZ4F_compressFrame(dest, dest_size, src, size, NULL);
+  assert(!LZ4F_isError(retval));
+  return retval;
+}
+
+
+size_t Lz4Compressor::FrameBound(const size_t bytes) {
+  return LZ4F_compressFrameBound(bytes, NULL);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+void Decompressor::RegisterPlugins() {
+  RegisterPlugin<ZlibDecompressor>();
+  RegisterPlugin<EchoDecompressor>();
+  RegisterPlugin<ZstdDecompressor>();
+  RegisterPlugin<Lz4Decompressor>();
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool ZlibDecompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZlibDefault;
+}
+
+
+ZlibDecompressor::ZlibDecompressor(const Algorithms &alg)
+  : Decompressor(alg)
+{
+  DecompressInit(&stream_);
+}
+
+
+ZlibDecompressor::~ZlibDecompressor() {
+  DecompressFini(&stream_);
+}
+
+
+StreamStates ZlibDecompressor::Inflate(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  return DecompressZStream2Sink(buf, size, &stream_, sink);
+}
+
+
+void ZlibDecompressor::Reset() {
+  const int retval = inflateReset(&stream_);
+  assert(retval == Z_OK);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool EchoDecompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kNoCompression;
+}
+
+
+EchoDecompressor::EchoDecompressor(const Algorithms &alg)
+  : Decompressor(alg)
+{
+}
+
+
+StreamStates EchoDecompressor::Inflate(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  const int64_t written = sink->Write(buf, size);
+  if (written != size)
+    return kStreamIOError;
+  return kStreamEnd;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool ZstdDecompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZstd;
+}
+
+
+ZstdDecompressor::ZstdDecompressor(const Algorithms &alg)
+  : Decompressor(alg)
+  , stream_(ZSTD_createDCtx())
+  , frame_complete_(false)
+  , in_header_(true)
+  , header_size_(0)
+{
+  assert(stream_ != NULL);
+}
+
+
+ZstdDecompressor::~ZstdDecompressor() {
+  ZSTD_freeDCtx(stream_);
+}
+
+
+/**
+ * Returns the number of bytes from the beginning of the frame that contain the
+ * dictionary id (see the zstd frame format).
+ */
+static unsigned GetZstdHeaderPrefixSize(
+  const unsigned char *header,
+  const unsigned header_size)
+{
+  const unsigned kMagicAndDescriptor = 5;
+  const unsigned char kMagic[] = {0x28, 0xB5, 0x2F, 0xFD};
+  if ((header_size < kMagicAndDescriptor) || memcmp(header, kMagic, 4) != 0)
+    return kMagicAndDescriptor;
+  const unsigned char descriptor = header[4];
+  const bool single_segment = descriptor & 0x20;
+  const unsigned kDictionaryIdSize[] = {0, 1, 2, 4};
+  return kMagicAndDescriptor + (single_segment ? 0 : 1) +
+         kDictionaryIdSize[descriptor & 0x03];
+}
+
+
+bool ZstdDecompressor::ParseFrameHeader(uint32_t *dictionary_id) {
+  const unsigned prefix_size = GetZstdHeaderPrefixSize(header_, header_size_);
+  if (header_size_ < prefix_size)
+    return false;
+  const unsigned char kDictionaryIdSize[] = {0, 1, 2, 4};
+  const unsigned id_size = kDictionaryIdSize[header_[4] & 0x03];
+  *dictionary_id = 0;
+  for (unsigned i = 0; i < id_size; ++i)
+    *dictionary_id |= uint32_t(header_[prefix_size - id_size + i]) << (8 * i);
+  return true;
+}
+
+
+bool ZstdDecompressor::StartFrame(const uint32_t dictionary_id) {
+  ZSTD_DDict_s *ddict = NULL;
+  if (dictionary_id != 0) {
+    const Dictionary *dictionary = Dictionary::Find(dictionary_id);
+    if (dictionary == NULL) {
+      LogCvmfs(kLogCompress, kLogDebug | kLogSyslogErr,
+               "missing zstd dictionary %u", dictionary_id);
+      return false;
+    }
+    ddict = dictionary->ddict();
+  }
+  size_t retval = ZSTD_DCtx_reset(stream_, ZSTD_reset_session_only);
+  assert(!ZSTD_isError(retval));
+  retval = ZSTD_DCtx_refDDict(stream_, ddict);
+  return !ZSTD_isError(retval);
+}
+
+
+/**
+ * Decompresses until the end of the current frame or the end of the input.
+ * The number of consumed bytes is returned in size.
+ */
+StreamStates ZstdDecompressor::Decompress(
+  const void *buf,
+  size_t *size,
+  cvmfs::Sink *sink)
+{
+  unsigned char out[kZChunk];
+  ZSTD_inBuffer input = { buf, *size, 0 };
+  bool output_full;
+  do {
+    ZSTD_outBuffer output = { out, kZChunk, 0 };
+    const size_t retval = ZSTD_decompressStream(stream_, &output, &input);
+    if (ZSTD_isError(retval)) {
+      LogCvmfs(kLogCompress, kLogDebug, "zstd decompression failed (%s)",
+               ZSTD_getErrorName(retval));
+      return kStreamDataError;
+    }
+    if (output.pos > 0) {
+      const int64_t written = sink->Write(out, output.pos);
+      if ((written < 0) || (static_cast<size_t>(written) != output.pos))
+        return kStreamIOError;
+    }
+    if (retval == 0) {
+      // Frame completely decoded and flushed
+      frame_complete_ = true;
+      in_header_ = true;
+      header_size_ = 0;
+      break;
+    }
+    output_full = (output.pos == output.size);
+  } while ((input.pos < input.size) || output_full);
+
+  *size = input.pos;
+  return frame_complete_ ? kStreamEnd : kStreamContinue;
+}
+
+
+/**
+ * A sequence of frames, as written by the ZstdCompressor, is decompressed as
+ * one stream.  The stream is complete if the input ends with a frame.  At the
+ * beginning of every frame, the frame header is inspected for the dictionary
+ * it requires.
+ */
+StreamStates ZstdDecompressor::Inflate(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  const unsigned char *in = static_cast<const unsigned char *>(buf);
+  size_t remaining = size;
+  while (remaining > 0) {
+    if (in_header_) {
+      frame_complete_ = false;
+      const unsigned prefix_size =
+        GetZstdHeaderPrefixSize(header_, header_size_);
+      const size_t nbytes = min(remaining,
+                                static_cast<size_t>(prefix_size - header_size_));
+      memcpy(header_ + header_size_, in, nbytes);
+      header_size_ += nbytes;
+      in += nbytes;
+      remaining -= nbytes;
+
+      uint32_t dictionary_id;
+      if (!ParseFrameHeader(&dictionary_id))
+        continue;
+      if (!StartFrame(dictionary_id))
+        return kStreamDataError;
+      in_header_ = false;
+      size_t header_size = header_size_;
+      const StreamStates state = Decompress(header_, &header_size, sink);
+      if ((state == kStreamDataError) || (state == kStreamIOError))
+        return state;
+      continue;
+    }
+
+    size_t nbytes = remaining;
+    const StreamStates state = Decompress(in, &nbytes, sink);
+    if ((state == kStreamDataError) || (state == kStreamIOError))
+      return state;
+    in += nbytes;
+    remaining -= nbytes;
+  }
+
+  return frame_complete_ ? kStreamEnd : kStreamContinue;
+}
+
+
+void ZstdDecompressor::Reset() {
+  const size_t retval = ZSTD_DCtx_reset(stream_, ZSTD_reset_session_only);
+  assert(!ZSTD_isError(retval));
+  frame_complete_ = false;
+  in_header_ = true;
+  header_size_ = 0;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool Lz4Decompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kLz4;
+}
+
+
+Lz4Decompressor::Lz4Decompressor(const Algorithms &alg)
+  : Decompressor(alg)
+  , context_(NULL)
+  , frame_complete_(false)
+{
+  const size_t retval =
+    LZ4F_createDecompressionContext(&context_, LZ4F_VERSION);
+  assert(!LZ4F_isError(retval));
+}
+
+
+Lz4Decompressor::~Lz4Decompressor() {
+  LZ4F_freeDecompressionContext(context_);
+}
+
+
+/**
+ * Like the zstd decompressor, reads a sequence of frames as one stream.
+ */
+StreamStates Lz4Decompressor::Inflate(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  unsigned char out[kZChunk];
+  const unsigned char *in = static_cast<const unsigned char *>(buf);
+  size_t remaining = size;
+  bool output_full;
+  do {
+    size_t out_size = kZChunk;
+    size_t in_size = remaining;
+    const size_t retval =
+      LZ4F_decompress(context_, out, &out_size, in, &in_size, NULL);
+    if (LZ4F_isError(retval)) {
+      LogCvmfs(kLogCompress, kLogDebug, "lz4 decompression failed (%s)",
+               LZ4F_getErrorName(retval));
+      return kStreamDataError;
+    }
+    in += in_size;
+    remaining -= in_size;
+    if (out_size > 0) {
+      const int64_t written = sink->Write(out, out_size);
+      if ((written < 0) || (static_cast<size_t>(written) != out_size))
+        return kStreamIOError;
+    }
+    frame_complete_ = (retval == 0);
+    output_full = (out_size == kZChunk);
+  } while ((remaining > 0) || output_full);
+
+  return frame_complete_ ? kStreamEnd : kStreamContinue;
+}
+
+
+void Lz4Decompressor::Reset() {
+  LZ4F_freeDecompressionContext(context_);
+  const size_t retval =
+    LZ4F_createDecompressionContext(&context_, LZ4F_VERSION);
+  assert(!LZ4F_isError(retval));
+  frame_complete_ = false;
+}
+
 }  // namespace zlib
@@ -1,172 +1,418 @@
-/**
- * This file is part of the CernVM File System.
- */
-
-#ifndef CVMFS_COMPRESSION_H_
-#define CVMFS_COMPRESSION_H_
-
-#include <errno.h>
-#include <stdint.h>
-#include <stdio.h>
-
-#include <string>
-
-#include "duplex_zlib.h"
-#include "sink.h"
-#include "util/plugin.h"
-
-namespace shash {
-struct Any;
-class ContextPtr;
-}
-
-bool CopyPath2Path(const std::string &src, const std::string &dest);
-bool CopyPath2File(const std::string &src, FILE *fdest);
-bool CopyMem2Path(const unsigned char *buffer, const unsigned buffer_size,
-                  const std::string &path);
-bool CopyMem2File(const unsigned char *buffer, const unsigned buffer_size,
-                  FILE *fdest);
-bool CopyPath2Mem(const std::string &path,
-                  unsigned char **buffer, unsigned *buffer_size);
-
-namespace zlib {
-
-const unsigned kZChunk = 16384;
-
-enum StreamStates {
-  kStreamDataError = 0,
-  kStreamIOError,
-  kStreamContinue,
-  kStreamEnd,
-};
-
-// Do not change order of algorithms.  Used as flags in the catalog
-enum Algorithms {
-  kZlibDefault = 0,
-  kNoCompression,
-};
-
-/**
- * Abstract Compression class which is inherited by implementations of
- * compression engines such as zlib.
- *
- * In order to add a new compression method, you simply need to add a new class
- * which is a sub-class of the Compressor.  The subclass needs to implement the
- * Deflate, DeflateBound, Clone, and WillHandle functions.  For information on
- * the WillHandle function, read up on the PolymorphicConstruction class.
- * The new sub-class must be listed in the implemention of the
- * Compressor::RegisterPlugins function.
- *
- */
-class Compressor: public PolymorphicConstruction<Compressor, Algorithms> {
- public:
-  explicit Compressor(const Algorithms &alg) { }
-  virtual ~Compressor() { }
-  /**
-   * Deflate function.  The arguments and returns closely match the input and
-   * output of the zlib deflate function.
-   * Input:
-   *   - outbuf - Ouput buffer to write the compressed data.
-   *   - outbufsize - Size of the output buffer
-   *   - inbuf - Input data to be compressed
-   *   - inbufsize - Size of the input buffer
-   *   - flush - Whether the compression stream should be flushed / finished
-   * Upon return:
-   *   returns: true - if done compressing, false otherwise
-   *   - outbuf - output buffer pointer (unchanged from input)
-   *   - outbufsize - The number of bytes used in the outbuf
-   *   - inbuf - Pointer to the next byte of input to read in
-   *   - inbufsize - the remaining bytes of input to read in.
-   *   - flush - unchanged from input
-   */
-  virtual bool Deflate(const bool flush,
-                       unsigned char **inbuf, size_t *inbufsize,
-                       unsigned char **outbuf, size_t *outbufsize) = 0;
-
-  /**
-   * Return an upper bound on the number of bytes required in order to compress
-   * an input number of bytes.
-   * Returns: Upper bound on the number of bytes required to compress.
-   */
-  virtual size_t DeflateBound(const size_t bytes) = 0;
-  virtual Compressor* Clone() = 0;
-
-  static void RegisterPlugins();
-};
-
-
-class ZlibCompressor: public Compressor {
- public:
-  explicit ZlibCompressor(const Algorithms &alg);
-  explicit ZlibCompressor(const ZlibCompressor &other);
-  ~ZlibCompressor();
-
-  bool Deflate(const bool flush,
-               unsigned char **inbuf, size_t *inbufsize,
-               unsigned char **outbuf, size_t *outbufsize);
-  size_t DeflateBound(const size_t bytes);
-  Compressor* Clone();
-  static bool WillHandle(const zlib::Algorithms &alg);
-
- private:
-  z_stream stream_;
-};
-
-
-class EchoCompressor: public Compressor {
- public:
-  explicit EchoCompressor(const Algorithms &alg);
-  bool Deflate(const bool flush,
-               unsigned char **inbuf, size_t *inbufsize,
-               unsigned char **outbuf, size_t *outbufsize);
-  size_t DeflateBound(const size_t bytes);
-  Compressor* Clone();
-  static bool WillHandle(const zlib::Algorithms &alg);
-};
-
-
-Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option);
-std::string AlgorithmName(const zlib::Algorithms alg);
-
-
-void CompressInit(z_stream *strm);
-void DecompressInit(z_stream *strm);
-void CompressFini(z_stream *strm);
-void DecompressFini(z_stream *strm);
-
-StreamStates CompressZStream2Null(
-  const void *buf, const int64_t size, const bool eof,
-  z_stream *strm, shash::ContextPtr *hash_context);
-StreamStates DecompressZStream2File(const void *buf, const int64_t size,
-                                    z_stream *strm, FILE *f);
-StreamStates DecompressZStream2Sink(const void *buf, const int64_t size,
-                                    z_stream *strm, cvmfs::Sink *sink);
-
-bool CompressPath2Path(const std::string &src, const std::string &dest);
-bool CompressPath2Path(const std::string &src, const std::string &dest,
-                       shash::Any *compressed_hash);
-bool DecompressPath2Path(const std::string &src, const std::string &dest);
-
-bool CompressPath2Null(const std::string &src, shash::Any *compressed_hash);
-bool CompressFile2Null(FILE *fsrc, shash::Any *compressed_hash);
-bool CompressFd2Null(int fd_src, shash::Any *compressed_hash,
-                     uint64_t* size = NULL);
-bool CompressFile2File(FILE *fsrc, FILE *fdest);
-bool CompressFile2File(FILE *fsrc, FILE *fdest, shash::Any *compressed_hash);
-bool CompressPath2File(const std::string &src, FILE *fdest,
-                       shash::Any *compressed_hash);
-bool DecompressFile2File(FILE *fsrc, FILE *fdest);
-bool DecompressPath2File(const std::string &src, FILE *fdest);
-
-bool CompressMem2File(const unsigned char *buf, const size_t size,
-                      FILE *fdest, shash::Any *compressed_hash);
-
-// User of these functions has to free out_buf, if successful
-bool CompressMem2Mem(const void *buf, const int64_t size,
-                     void **out_buf, uint64_t *out_size);
-bool DecompressMem2Mem(const void *buf, const int64_t size,
-                       void **out_buf, uint64_t *out_size);
-
-}  // namespace zlib
-
-#endif  // CVMFS_COMPRESSION_H_
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_COMPRESSION_H_
+#define CVMFS_COMPRESSION_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "duplex_zlib.h"
+#include "sink.h"
+#include "util/plugin.h"
+#include "util/single_copy.h"
+
+namespace shash {
+struct Any;
+class ContextPtr;
+}
+
+struct LZ4F_dctx_s;
+struct ZSTD_CCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_DDict_s;
+
+bool CopyPath2Path(const std::string &src, const std::string &dest);
+bool CopyPath2File(const std::string &src, FILE *fdest);
+bool CopyMem2Path(const unsigned char *buffer, const unsigned buffer_size,
+                  const std::string &path);
+bool CopyMem2File(const unsigned char *buffer, const unsigned buffer_size,
+                  FILE *fdest);
+bool CopyPath2Mem(const std::string &path,
+                  unsigned char **buffer, unsigned *buffer_size);
+
+namespace zlib {
+
+const unsigned kZChunk = 16384;
+
+enum StreamStates {
+  kStreamDataError = 0,
+  kStreamIOError,
+  kStreamContinue,
+  kStreamEnd,
+};
+
+// Do not change order of algorithms.  Used as flags in the catalog
+enum Algorithms {
+  kZlibDefault = 0,
+  kNoCompression,
+  kZstd,
+  kLz4,
+};
+
+class Dictionary;
+
+/**
+ * Abstract Compression class which is inherited by implementations of
+ * compression engines such as zlib.
+ *
+ * In order to add a new compression method, you simply need to add a new class
+ * which is a sub-class of the Compressor.  The subclass needs to implement the
+ * Deflate, DeflateBound, Clone, and WillHandle functions.  For information on
+ * the WillHandle function, read up on the PolymorphicConstruction class.
+ * The new sub-class must be listed in the implemention of the
+ * Compressor::RegisterPlugins function.
+ *
+ */
+class Compressor: public PolymorphicConstruction<Compressor, Algorithms> {
+ public:
+  explicit Compressor(const Algorithms &alg) { }
+  virtual ~Compressor() { }
+  /**
+   * Deflate function.  The arguments and returns closely match the input and
+   * output of the zlib deflate function.
+   * Input:
+   *   - outbuf - Ouput buffer to write the compressed data.
+   *   - outbufsize - Size of the output buffer
+   *   - inbuf - Input data to be compressed
+   *   - inbufsize - Size of the input buffer
+   *   - flush - Whether the compression stream should be flushed / finished
+   * Upon return:
+   *   returns: true - if done compressing, false otherwise
+   *   - outbuf - output buffer pointer (unchanged from input)
+   *   - outbufsize - The number of bytes used in the outbuf
+   *   - inbuf - Pointer to the next byte of input to read in
+   *   - inbufsize - the remaining bytes of input to read in.
+   *   - flush - unchanged from input
+   */
+  virtual bool Deflate(const bool flush,
+                       unsigned char **inbuf, size_t *inbufsize,
+                       unsigned char **outbuf, size_t *outbufsize) = 0;
+
+  /**
+   * Return an upper bound on the number of bytes required in order to compress
+   * an input number of bytes.
+   * Returns: Upper bound on the number of bytes required to compress.
+   */
+  virtual size_t DeflateBound(const size_t bytes) = 0;
+  virtual Compressor* Clone() = 0;
+  /**
+   * Sets the compression level for algorithms that support levels.  0 selects
+   * the default level of the algorithm.  Must be called before compressing.
+   */
+  virtual void SetLevel(const int level) { }
+  /**
+   * Sets a trained dictionary for algorithms that support dictionaries.  NULL
+   * disables dictionary compression.  The caller keeps the ownership.
+   */
+  virtual void SetDictionary(const Dictionary *dictionary) { }
+
+  static void RegisterPlugins();
+};
+
+
+class ZlibCompressor: public Compressor {
+ public:
+  explicit ZlibCompressor(const Algorithms &alg);
+  explicit ZlibCompressor(const ZlibCompressor &other);
+  ~ZlibCompressor();
+
+  bool Deflate(const bool flush,
+               unsigned char **inbuf, size_t *inbufsize,
+               unsigned char **outbuf, size_t *outbufsize);
+  size_t DeflateBound(const size_t bytes);
+  Compressor* Clone();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  z_stream stream_;
+};
+
+
+class EchoCompressor: public Compressor {
+ public:
+  explicit EchoCompressor(const Algorithms &alg);
+  bool Deflate(const bool flush,
+               unsigned char **inbuf, size_t *inbufsize,
+               unsigned char **outbuf, size_t *outbufsize);
+  size_t DeflateBound(const size_t bytes);
+  Compressor* Clone();
+  static bool WillHandle(const zlib::Algorithms &alg);
+};
+
+
+/**
+ * Base class for compressors whose libraries cannot copy the state of a
+ * running stream, which is required by Clone().  The input is cut into blocks
+ * of kFrameSize bytes and every block is compressed into a frame of its own.
+ * The decompressors read a sequence of frames as a single stream.  Between
+ * frames, the entire state consists of the buffered input and the not yet
+ * collected output, so that it can be copied.
+ */
+class FrameCompressor: public Compressor {
+ public:
+  static const size_t kFrameSize = 256 * 1024;
+
+  explicit FrameCompressor(const Algorithms &alg);
+  virtual ~FrameCompressor();
+  bool Deflate(const bool flush,
+               unsigned char **inbuf, size_t *inbufsize,
+               unsigned char **outbuf, size_t *outbufsize);
+  size_t DeflateBound(const size_t bytes);
+
+ protected:
+  /**
+   * Compresses size bytes from src into a complete frame at dest.  Returns the
+   * size of the frame.
+   */
+  virtual size_t CompressFrame(const unsigned char *src, const size_t size,
+                               unsigned char *dest, const size_t dest_size) = 0;
+  virtual size_t FrameBound(const size_t bytes) = 0;
+  void CopyStateTo(FrameCompressor *other) const;
+
+ private:
+  void EmitFrame();
+
+  unsigned char *in_buf_;
+  size_t in_size_;
+  unsigned char *out_buf_;
+  size_t out_capacity_;
+  size_t out_size_;
+  size_t out_pos_;
+  bool finished_;
+};
+
+
+/**
+ * A trained zstd dictionary that improves the compression ratio of small
+ * objects.  A repository has at most one dictionary, it is referenced from the
+ * manifest.  zstd frames carry the id of the dictionary they were compressed
+ * with, so decompressors find the right one in the process-wide registry.
+ */
+class Dictionary : SingleCopy {
+ public:
+  /**
+   * Suggested maximum size of a trained dictionary
+   */
+  static const size_t kDefaultMaxSize = 110 * 1024;
+
+  /**
+   * Returns NULL if the buffer is not a zstd dictionary.  The compression
+   * level is fixed for the dictionary.
+   */
+  static Dictionary *Create(const void *buf, const size_t size,
+                            const int level);
+  /**
+   * Trains a dictionary of at most max_size bytes from the given samples.
+   */
+  static bool Train(const std::vector<std::string> &samples,
+                    const size_t max_size,
+                    std::string *dictionary);
+
+  /**
+   * Makes the dictionary known to decompressors.  Takes ownership.
+   */
+  static void Register(Dictionary *dictionary);
+  static const Dictionary *Find(const uint32_t id);
+
+  ~Dictionary();
+  uint32_t id() const { return id_; }
+  ZSTD_CDict_s *cdict() const { return cdict_; }
+  ZSTD_DDict_s *ddict() const { return ddict_; }
+
+ private:
+  Dictionary() : id_(0), cdict_(NULL), ddict_(NULL) { }
+  uint32_t id_;
+  ZSTD_CDict_s *cdict_;
+  ZSTD_DDict_s *ddict_;
+};
+
+
+class ZstdCompressor: public FrameCompressor {
+ public:
+  static const int kDefaultLevel = 3;
+
+  explicit ZstdCompressor(const Algorithms &alg);
+  ~ZstdCompressor();
+  Compressor* Clone();
+  static bool WillHandle(const zlib::Algorithms &alg);
+  void SetLevel(const int level);
+  void SetDictionary(const Dictionary *dictionary);
+
+ protected:
+  size_t CompressFrame(const unsigned char *src, const size_t size,
+                       unsigned char *dest, const size_t dest_size);
+  size_t FrameBound(const size_t bytes);
+
+ private:
+  int level_;
+  const Dictionary *dictionary_;
+  ZSTD_CCtx_s *context_;
+};
+
+
+class Lz4Compressor: public FrameCompressor {
+ public:
+  explicit Lz4Compressor(const Algorithms &alg);
+  Compressor* Clone();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ protected:
+  size_t CompressFrame(const unsigned char *src, const size_t size,
+                       unsigned char *dest, const size_t dest_size);
+  size_t FrameBound(const size_t bytes);
+};
+
+
+/**
+ * Counterpart of the Compressor classes for streamed decompression, e.g. of
+ * downloaded data.  Inflate() can be called with arbitrary pieces of the
+ * compressed input, the decompressed data are written into a sink.  Reset()
+ * prepares for a new stream.
+ */
+class Decompressor: public PolymorphicConstruction<Decompressor, Algorithms> {
+ public:
+  explicit Decompressor(const Algorithms &alg) { }
+  virtual ~Decompressor() { }
+  /**
+   * Returns kStreamEnd if the input so far forms a complete compressed stream,
+   * kStreamContinue if more input is required.
+   */
+  virtual StreamStates Inflate(const void *buf, const int64_t size,
+                               cvmfs::Sink *sink) = 0;
+  virtual void Reset() = 0;
+
+  static void RegisterPlugins();
+};
+
+
+class ZlibDecompressor: public Decompressor {
+ public:
+  explicit ZlibDecompressor(const Algorithms &alg);
+  ~ZlibDecompressor();
+  StreamStates Inflate(const void *buf, const int64_t size, cvmfs::Sink *sink);
+  void Reset();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  z_stream stream_;
+};
+
+
+class EchoDecompressor: public Decompressor {
+ public:
+  explicit EchoDecompressor(const Algorithms &alg);
+  StreamStates Inflate(const void *buf, const int64_t size, cvmfs::Sink *sink);
+  void Reset() { }
+  static bool WillHandle(const zlib::Algorithms &alg);
+};
+
+
+class ZstdDecompressor: public Decompressor {
+ public:
+  explicit ZstdDecompressor(const Algorithms &alg);
+  ~ZstdDecompressor();
+  StreamStates Inflate(const void *buf, const int64_t size, cvmfs::Sink *sink);
+  void Reset();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  /**
+   * Magic number, frame header descriptor, window descriptor, dictionary id
+   */
+  static const unsigned kMaxHeaderPrefix = 10;
+
+  bool ParseFrameHeader(uint32_t *dictionary_id);
+  bool StartFrame(const uint32_t dictionary_id);
+  StreamStates Decompress(const void *buf, size_t *size, cvmfs::Sink *sink);
+
+  ZSTD_DCtx_s *stream_;
+  bool frame_complete_;
+  /**
+   * The start of a frame is collected until the dictionary id is known
+   */
+  bool in_header_;
+  unsigned char header_[kMaxHeaderPrefix];
+  unsigned header_size_;
+};
+
+
+class Lz4Decompressor: public Decompressor {
+ public:
+  explicit Lz4Decompressor(const Algorithms &alg);
+  ~Lz4Decompressor();
+  StreamStates Inflate(const void *buf, const int64_t size, cvmfs::Sink *sink);
+  void Reset();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  LZ4F_dctx_s *context_;
+  bool frame_complete_;
+};
+
+
+/**
+ * Aborts if string doesn't match any of the algorithms.  If level is given, it
+ * is set to the level of "zstd:<level>" or to 0 (default level) otherwise.
+ */
+Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option,
+                                     int *level = NULL);
+std::string AlgorithmName(const zlib::Algorithms alg);
+/**
+ * False for algorithm values stored by newer publishers that this version
+ * cannot decompress.  Such objects must not be served as file content.
+ */
+bool IsSupportedAlgorithm(const zlib::Algorithms alg);
+
+
+void CompressInit(z_stream *strm);
+void DecompressInit(z_stream *strm);
+void CompressFini(z_stream *strm);
+void DecompressFini(z_stream *strm);
+
+StreamStates CompressZStream2Null(
+  const void *buf, const int64_t size, const bool eof,
+  z_stream *strm, shash::ContextPtr *hash_context);
+StreamStates DecompressZStream2File(const void *buf, const int64_t size,
+                                    z_stream *strm, FILE *f);
+StreamStates DecompressZStream2Sink(const void *buf, const int64_t size,
+                                    z_stream *strm, cvmfs::Sink *sink);
+
+bool CompressPath2Path(const std::string &src, const std::string &dest);
+bool CompressPath2Path(const std::string &src, const std::string &dest,
+                       shash::Any *compressed_hash);
+bool DecompressPath2Path(const std::string &src, const std::string &dest);
+
+bool CompressPath2Null(const std::string &src, shash::Any *compressed_hash);
+bool CompressFile2Null(FILE *fsrc, shash::Any *compressed_hash);
+bool CompressFd2Null(int fd_src, shash::Any *compressed_hash,
+                     uint64_t* size = NULL);
+bool CompressFile2File(FILE *fsrc, FILE *fdest);
+bool CompressFile2File(FILE *fsrc, FILE *fdest, shash::Any *compressed_hash);
+bool CompressPath2File(const std::string &src, FILE *fdest,
+                       shash::Any *compressed_hash);
+bool DecompressFile2File(FILE *fsrc, FILE *fdest,
+                         const Algorithms alg = kZlibDefault);
+bool DecompressPath2File(const std::string &src, FILE *fdest,
+                         const Algorithms alg = kZlibDefault);
+
+bool CompressMem2File(const unsigned char *buf, const size_t size,
+                      FILE *fdest, shash::Any *compressed_hash);
+
+// User of these functions has to free out_buf, if successful
+bool CompressMem2Mem(const void *buf, const int64_t size,
+                     void **out_buf, uint64_t *out_size,
+                     const Algorithms alg = kZlibDefault);
+bool DecompressMem2Mem(const void *buf, const int64_t size,
+                       void **out_buf, uint64_t *out_size,
+                       const Algorithms alg = kZlibDefault);
+
+}  // namespace zlib
+
+#endif  // CVMFS_COMPRESSION_H_
@@ -1012,7 +1012,14 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
 
   perf::Inc(file_system_->n_fs_open());  // Count actual open / fetch operations
 
-  if (!dirent.IsChunkedFile()) {
+  // Large uncompressed external files are read block-wise by range requests
+  const uint64_t block_size = mount_point_->external_fetcher()->block_size();
+  const bool read_blocks = dirent.IsExternalFile() &&
+    !dirent.IsChunkedFile() &&
+    (dirent.compression_algorithm() == zlib::kNoCompression) &&
+    (block_size > 0) && (dirent.size() > block_size);
+
+  if (!dirent.IsChunkedFile() && !read_blocks) {
     fence_remount_->Leave();
   } else {
     LogCvmfs(kLogCvmfs, kLogDebug,
@@ -1047,9 +1054,12 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
 
       // Retrieve File chunks from the catalog
       UniquePtr<FileChunkList> chunks(new FileChunkList());
-      if (!catalog_mgr->ListFileChunks(path, dirent.hash_algorithm(),
-                                       chunks.weak_ref()) ||
-          chunks->IsEmpty())
+      if (read_blocks) {
+        FileChunkReflist::MakeBlockList(dirent.checksum(), dirent.size(),
+                                        block_size, chunks.weak_ref());
+      } else if (!catalog_mgr->ListFileChunks(path, dirent.hash_algorithm(),
+                                              chunks.weak_ref()) ||
+                 chunks->IsEmpty())
       {
         fence_remount_->Leave();
         LogCvmfs(kLogCvmfs, kLogDebug| kLogSyslogErr, "file %s is marked as "
@@ -1205,7 +1215,17 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
       if ((chunk_fd.fd == -1) || (chunk_fd.chunk_idx != chunk_idx)) {
         if (chunk_fd.fd != -1) file_system_->cache_mgr()->Close(chunk_fd.fd);
         string verbose_path = "Part of " + chunks.path.ToString();
-        if (chunks.external_data) {
+        if (chunks.IsBlockList()) {
+          chunk_fd.fd = mount_point_->external_fetcher()->FetchBlock(
+            chunks.list->AtPtr(chunk_idx)->content_hash(),
+            chunks.FileSize(),
+            chunks.list->AtPtr(chunk_idx)->offset(),
+            verbose_path,
+            mount_point_->catalog_mgr()->volatile_flag()
+              ? CacheManager::kTypeVolatile
+              : CacheManager::kTypeRegular,
+            chunks.path.ToString());
+        } else if (chunks.external_data) {
           chunk_fd.fd = mount_point_->external_fetcher()->Fetch(
             chunks.list->AtPtr(chunk_idx)->content_hash(),
             chunks.list->AtPtr(chunk_idx)->size(),
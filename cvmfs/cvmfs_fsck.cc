@@ -21,15 +21,19 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <string>
 
 #include "atomic.h"
 #include "compression.h"
+#include "fsck_index.h"
 #include "hash.h"
 #include "logging.h"
 #include "platform.h"
 #include "smalloc.h"
+#include "throttle.h"
 #include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -42,8 +46,18 @@ enum Errors {
   kErrorUsage = 16,
 };
 
+/**
+ * Name of the index of verified objects in the cache directory
+ */
+const char *kIndexFile = "fsckindex";
+/**
+ * Interval for writing the index of verified objects during a run
+ */
+const unsigned kCheckpointIntervalSec = 60;
+
 string *g_cache_dir;
 atomic_int32 g_num_files;
+atomic_int32 g_num_skipped;
 atomic_int32 g_num_err_fixed;
 atomic_int32 g_num_err_unfixed;
 atomic_int32 g_num_err_operational;
@@ -61,6 +75,22 @@ bool g_fix_errors = false;
 bool g_verbose = false;
 atomic_int32 g_force_rebuild;
 atomic_int32 g_modified_cache;
+atomic_int32 g_num_workers_done;
+
+/**
+ * Set in incremental mode, NULL otherwise
+ */
+FsckIndex *g_index = NULL;
+/**
+ * In incremental mode, objects verified longer ago are verified again
+ */
+uint64_t g_reverify_after_sec = 0;
+/**
+ * Limit the bytes read per second and the processing time per second,
+ * NULL if unlimited
+ */
+RateThrottle *g_io_throttle = NULL;
+RateThrottle *g_cpu_throttle = NULL;
 
 
 static void Usage() {
@@ -69,17 +99,26 @@ static void Usage() {
            "This tool checks a cvmfs cache directory for consistency.\n"
            "If necessary, the managed cache db is removed so that\n"
            "it will be rebuilt on next mount.\n\n"
-           "Usage: cvmfs_fsck [-v] [-p] [-f] [-j #threads] <cache directory>\n"
+           "Usage: cvmfs_fsck [-v] [-p] [-f] [-j #threads] [-i [-r days]]\n"
+           "                  [-b MB/s] [-u percent] <cache directory>\n"
            "Options:\n"
            "  -v verbose output\n"
            "  -p try to fix automatically\n"
            "  -f force rebuild of managed cache db on next mount\n"
-           "  -j number of concurrent integrity check worker threads\n",
-           VERSION);
+           "  -j number of concurrent integrity check worker threads\n"
+           "  -i incremental: only verify objects that are new or changed\n"
+           "     since the last run (remembered in <cache directory>/%s)\n"
+           "  -r with -i, verify again objects verified more than days ago\n"
+           "  -b limit disk reads to MB/s\n"
+           "  -u limit processing time to percent of a CPU core\n",
+           VERSION, kIndexFile);
 }
 
 
-static bool GetNextFile(string *relative_path, string *hash_name) {
+static bool GetNextFile(string *relative_path,
+                        string *hash_name,
+                        platform_stat64 *info)
+{
   platform_dirent64 *d = NULL;
 
   pthread_mutex_lock(&g_lock_traverse);
@@ -88,17 +127,16 @@ static bool GetNextFile(string *relative_path, string *hash_name) {
     const string name = d->d_name;
     if ((name == ".") || (name == "..")) continue;
 
-    platform_stat64 info;
     *relative_path = *g_current_dir + "/" + name;
     *hash_name = *g_current_dir + name;
     const string path = *g_cache_dir + "/" + *relative_path;
-    if (platform_lstat(relative_path->c_str(), &info) != 0) {
+    if (platform_lstat(relative_path->c_str(), info) != 0) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Warning: failed to stat() %s (%d)",
                path.c_str(), errno);
       continue;
     }
 
-    if (!S_ISREG(info.st_mode)) {
+    if (!S_ISREG(info->st_mode)) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Warning: %s is not a regular file",
                path.c_str());
       continue;
@@ -142,8 +180,9 @@ static bool GetNextFile(string *relative_path, string *hash_name) {
 static void *MainCheck(void *data __attribute__((unused))) {
   string relative_path;
   string hash_name;
+  platform_stat64 info;
 
-  while (GetNextFile(&relative_path, &hash_name)) {
+  while (GetNextFile(&relative_path, &hash_name, &info)) {
     const string path = *g_cache_dir + "/" + relative_path;
 
     int n = atomic_xadd32(&g_num_files, 1);
@@ -169,6 +208,21 @@ static void *MainCheck(void *data __attribute__((unused))) {
       continue;
     }
 
+    shash::Any expected_hash = shash::MkFromHexPtr(shash::HexPtr(hash_name));
+    const uint64_t now = time(NULL);
+    if (g_index != NULL) {
+      const uint64_t verified_at =
+        g_index->GetVerificationTime(expected_hash, info);
+      if ((verified_at > 0) && ((g_reverify_after_sec == 0) ||
+                                (now < verified_at + g_reverify_after_sec)))
+      {
+        g_index->MarkVerified(expected_hash, info, verified_at);
+        atomic_inc32(&g_num_skipped);
+        continue;
+      }
+    }
+
+    const uint64_t start_ns = platform_monotonic_time_ns();
     int fd_src = open(relative_path.c_str() , O_RDONLY);
     if (fd_src < 0) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Error: cannot open %s", path.c_str());
@@ -179,7 +233,6 @@ static void *MainCheck(void *data __attribute__((unused))) {
     platform_disable_kcache(fd_src);
 
     // Compress every file and calculate SHA-1 of stream
-    shash::Any expected_hash = shash::MkFromHexPtr(shash::HexPtr(hash_name));
     shash::Any hash(expected_hash.algorithm);
     if (!zlib::CompressFd2Null(fd_src, &hash)) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Error: could not compress %s",
@@ -237,8 +290,18 @@ static void *MainCheck(void *data __attribute__((unused))) {
       }
     }
     close(fd_src);
+
+    if ((g_index != NULL) && (hash == expected_hash))
+      g_index->MarkVerified(expected_hash, info, now);
+    if (g_cpu_throttle != NULL) {
+      const uint64_t busy_us = (platform_monotonic_time_ns() - start_ns) / 1000;
+      g_cpu_throttle->Consume(busy_us);
+    }
+    if (g_io_throttle != NULL)
+      g_io_throttle->Consume(info.st_size);
   }
 
+  atomic_inc32(&g_num_workers_done);
   return NULL;
 }
 
@@ -248,8 +311,11 @@ int main(int argc, char **argv) {
   atomic_init32(&g_modified_cache);
   g_current_dir = new string();
 
+  bool incremental = false;
+  uint64_t io_limit_mb = 0;
+  unsigned cpu_limit_percent = 0;
   int c;
-  while ((c = getopt(argc, argv, "hvpfj:")) != -1) {
+  while ((c = getopt(argc, argv, "hvpfj:ir:b:u:")) != -1) {
     switch (c) {
       case 'h':
         Usage();
@@ -271,6 +337,23 @@ int main(int argc, char **argv) {
           return kErrorUsage;
         }
         break;
+      case 'i':
+        incremental = true;
+        break;
+      case 'r':
+        g_reverify_after_sec = String2Uint64(optarg) * 24 * 3600;
+        break;
+      case 'b':
+        io_limit_mb = String2Uint64(optarg);
+        break;
+      case 'u':
+        cpu_limit_percent = String2Uint64(optarg);
+        if ((cpu_limit_percent < 1) || (cpu_limit_percent > 100)) {
+          LogCvmfs(kLogCvmfs, kLogStdout,
+                   "The processing time limit must be between 1 and 100");
+          return kErrorUsage;
+        }
+        break;
       case '?':
       default:
         Usage();
@@ -311,8 +394,24 @@ int main(int argc, char **argv) {
   }
   closedir(dirp_txn);
 
+  if (incremental) {
+    g_index = FsckIndex::Open(*g_cache_dir + "/" + kIndexFile);
+    if (g_index == NULL)
+      return kErrorOperational;
+    if (g_verbose) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "Loaded %u verified objects from %s",
+               g_index->GetNumPrevious(), g_index->path().c_str());
+    }
+  }
+  if (io_limit_mb > 0)
+    g_io_throttle = new RateThrottle(io_limit_mb * 1024 * 1024);
+  if (cpu_limit_percent > 0)
+    g_cpu_throttle = new RateThrottle(cpu_limit_percent * 10000);
+
   // Run workers to recalculate checksums
   atomic_init32(&g_num_files);
+  atomic_init32(&g_num_skipped);
+  atomic_init32(&g_num_workers_done);
   atomic_init32(&g_num_err_fixed);
   atomic_init32(&g_num_err_unfixed);
   atomic_init32(&g_num_err_operational);
@@ -329,6 +428,19 @@ int main(int argc, char **argv) {
       return kErrorOperational;
     }
   }
+  // Save the progress regularly, so that an interrupted incremental run does
+  // not need to start over
+  uint64_t last_checkpoint = platform_monotonic_time();
+  while (atomic_read32(&g_num_workers_done) < g_num_threads) {
+    SafeSleepMs(250);
+    if ((g_index != NULL) &&
+        (platform_monotonic_time() >= last_checkpoint + kCheckpointIntervalSec))
+    {
+      if (!g_index->Checkpoint())
+        LogCvmfs(kLogCvmfs, kLogStdout, "Warning: failed to write index");
+      last_checkpoint = platform_monotonic_time();
+    }
+  }
   for (int i = g_num_threads-1; i >= 0; --i) {
     pthread_join(workers[i], NULL);
     if (g_verbose)
@@ -338,7 +450,19 @@ int main(int argc, char **argv) {
   if (!g_verbose)
     LogCvmfs(kLogCvmfs, kLogStdout, "");
   LogCvmfs(kLogCvmfs, kLogStdout, "Verified %d files",
-           atomic_read32(&g_num_files));
+           atomic_read32(&g_num_files) - atomic_read32(&g_num_skipped));
+  if (g_index != NULL) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Skipped %d unchanged verified files",
+             atomic_read32(&g_num_skipped));
+    if (!g_index->Commit()) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "Error: failed to write index %s",
+               g_index->path().c_str());
+      atomic_inc32(&g_num_err_operational);
+    }
+    delete g_index;
+  }
+  delete g_io_throttle;
+  delete g_cpu_throttle;
 
   if (atomic_read32(&g_num_tmp_catalog) > 0)
     LogCvmfs(kLogCvmfs, kLogStdout, "Temporary file catalogs were found.");
@@ -52,6 +52,7 @@
 #include "duplex_curl.h"
 #include "hash.h"
 #include "logging.h"
+#include "platform.h"
 #include "prng.h"
 #include "sanitizer.h"
 #include "smalloc.h"
@@ -165,6 +166,39 @@ static Failures PrepareDownloadDestination(JobInfo *info) {
 }
 
 
+/**
+ * Allocates the receive buffer for kDestinationMem.  Compressed objects are
+ * only buffered until they are inflated, so their buffers come from the pool.
+ */
+static void AllocMemDestination(const size_t size, JobInfo *info) {
+  if (info->compressed && info->mem_pool)
+    info->destination_mem.data = info->mem_pool->Get(size);
+  else
+    info->destination_mem.data = static_cast<char *>(smalloc(size));
+  info->destination_mem.size = size;
+  info->destination_mem.pos = 0;
+}
+
+
+/**
+ * Counterpart to AllocMemDestination.  Only valid as long as the buffer still
+ * holds the received (and not yet inflated) data.
+ */
+static void FreeMemDestination(JobInfo *info) {
+  if (info->destination_mem.data == NULL)
+    return;
+  if (info->compressed && info->mem_pool) {
+    info->mem_pool->Put(info->destination_mem.data,
+                        info->destination_mem.size);
+  } else {
+    free(info->destination_mem.data);
+  }
+  info->destination_mem.data = NULL;
+  info->destination_mem.size = 0;
+  info->destination_mem.pos = 0;
+}
+
+
 /**
  * Called by curl for every HTTP header. Not called for file:// transfers.
  */
@@ -241,12 +275,13 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
         info->error_code = kFailTooBig;
         return 0;
       }
-      info->destination_mem.data = static_cast<char *>(smalloc(length));
+      // Headers of redirect replies carry their own Content-Length
+      FreeMemDestination(info);
+      AllocMemDestination(length, info);
     } else {
       // Empty resource
-      info->destination_mem.data = NULL;
+      FreeMemDestination(info);
     }
-    info->destination_mem.size = length;
   } else if (HasPrefix(header_line, "LOCATION:", true)) {
     // This comes along with redirects
     LogCvmfs(kLogDownload, kLogDebug, "%s", header_line.c_str());
@@ -276,8 +311,7 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
   if (info->destination == kDestinationSink) {
     if (info->compressed) {
       zlib::StreamStates retval =
-        zlib::DecompressZStream2Sink(ptr, num_bytes,
-                                     &info->zstream, info->destination_sink);
+        info->decompressor->Inflate(ptr, num_bytes, info->destination_sink);
       if (retval == zlib::kStreamDataError) {
         LogCvmfs(kLogDownload, kLogDebug, "failed to decompress %s",
                  info->url->c_str());
@@ -323,9 +357,9 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
     if (info->compressed) {
       // LogCvmfs(kLogDownload, kLogDebug, "REMOVE-ME: writing %d bytes for %s",
       //          num_bytes, info->url->c_str());
+      cvmfs::FileSink file_sink(info->destination_file);
       zlib::StreamStates retval =
-        zlib::DecompressZStream2File(ptr, num_bytes,
-                                     &info->zstream, info->destination_file);
+        info->decompressor->Inflate(ptr, num_bytes, &file_sink);
       if (retval == zlib::kStreamDataError) {
         LogCvmfs(kLogDownload, kLogDebug, "failed to decompress %s",
                  info->url->c_str());
@@ -359,6 +393,7 @@ const int DownloadManager::kProbeUnprobed = -1;
 const int DownloadManager::kProbeDown     = -2;
 const int DownloadManager::kProbeGeo      = -3;
 const unsigned DownloadManager::kMaxMemSize = 1024*1024;
+const string DownloadManager::kWarmupUrl = "/.cvmfspublished";
 
 
 /**
@@ -452,6 +487,62 @@ int DownloadManager::CallbackCurlSocket(CURL *easy,
 }
 
 
+/**
+ * Opens num_warmup_ connections in parallel to the active host through the
+ * active proxy by sending HEAD requests for the repository manifest.  The
+ * connections stay in the connection cache of the multi handle and are picked
+ * up by the next transfers, whichever pooled curl handle they use.  Repeated
+ * by the I/O thread every kWarmupRefreshS seconds of idleness in order to keep
+ * the connections alive, until there was no transfer for kWarmupMaxIdleS
+ * seconds.  Failing warm-up requests are not retried and do not trigger the
+ * proxy or host fail-over.  Only called from the I/O thread.
+ */
+void DownloadManager::WarmupConnections(int *still_running) {
+  timestamp_warmup_ = platform_monotonic_time();
+  if (num_warmup_ == 0)
+    return;
+  pthread_mutex_lock(lock_options_);
+  bool has_host = (opt_host_chain_ != NULL) && !opt_host_chain_->empty();
+  pthread_mutex_unlock(lock_options_);
+  if (!has_host)
+    return;
+
+  LogCvmfs(kLogDownload, kLogDebug, "warming up %u connections", num_warmup_);
+  for (unsigned i = 0; i < num_warmup_; ++i) {
+    JobInfo *info = &warmup_jobs_[i];
+    info->Init();
+    info->url = &kWarmupUrl;
+    info->probe_hosts = true;
+    info->head_request = true;
+    CURL *handle = AcquireCurlHandle();
+    InitializeRequest(info, handle);
+    SetUrlOptions(info);
+    curl_multi_add_handle(curl_multi_, handle);
+  }
+  curl_multi_socket_action(curl_multi_, CURL_SOCKET_TIMEOUT, 0, still_running);
+}
+
+
+bool DownloadManager::IsWarmupJob(const JobInfo *info) const {
+  return (num_warmup_ > 0) && (info >= warmup_jobs_) &&
+         (info < warmup_jobs_ + num_warmup_);
+}
+
+
+/**
+ * Returns the monotonic time of the next warm-up or 0 if there is none, either
+ * because warm-up is disabled or because the connections have been idle for
+ * more than kWarmupMaxIdleS seconds.
+ */
+uint64_t DownloadManager::GetWarmupDeadline() const {
+  if (num_warmup_ == 0)
+    return 0;
+  if (timestamp_warmup_ > timestamp_last_job_ + kWarmupMaxIdleS)
+    return 0;
+  return timestamp_warmup_ + kWarmupRefreshS;
+}
+
+
 /**
  * Worker thread event loop.  Waits on new JobInfo structs on a pipe.
  */
@@ -492,6 +583,12 @@ void *DownloadManager::MainDownload(void *data) {
       int64_t delta = static_cast<int64_t>(
         1000 * DiffTimeSeconds(timeval_start, timeval_stop));
       perf::Xadd(download_mgr->counters_->sz_transfer_time, delta);
+      // Wake up for warming up and for keeping idle connections alive
+      const uint64_t due = download_mgr->GetWarmupDeadline();
+      if (due > 0) {
+        const uint64_t now = platform_monotonic_time();
+        timeout = (due > now) ? (due - now) * 1000 : 0;
+      }
     }
     int retval = poll(download_mgr->watch_fds_, download_mgr->watch_fds_inuse_,
                       timeout);
@@ -505,6 +602,9 @@ void *DownloadManager::MainDownload(void *data) {
                                         CURL_SOCKET_TIMEOUT,
                                         0,
                                         &still_running);
+      const uint64_t due = download_mgr->GetWarmupDeadline();
+      if (!still_running && (due > 0) && (platform_monotonic_time() >= due))
+        download_mgr->WarmupConnections(&still_running);
     }
 
     // Terminate I/O thread
@@ -518,6 +618,8 @@ void *DownloadManager::MainDownload(void *data) {
       ReadPipe(download_mgr->pipe_jobs_[0], &info, sizeof(info));
       if (!still_running)
         gettimeofday(&timeval_start, NULL);
+      download_mgr->timestamp_warmup_ = platform_monotonic_time();
+      download_mgr->timestamp_last_job_ = download_mgr->timestamp_warmup_;
       CURL *handle = download_mgr->AcquireCurlHandle();
       download_mgr->InitializeRequest(info, handle);
       download_mgr->SetUrlOptions(info);
@@ -574,6 +676,11 @@ void *DownloadManager::MainDownload(void *data) {
           // Return easy handle into pool and write result back
           download_mgr->ReleaseCurlHandle(easy_handle);
 
+          if (download_mgr->IsWarmupJob(info)) {
+            LogCvmfs(kLogDownload, kLogDebug, "connection warm-up: %s",
+                     Code2Ascii(info->error_code));
+            continue;
+          }
           WritePipe(info->wait_at[1], &info->error_code,
                     sizeof(info->error_code));
         }
@@ -598,6 +705,111 @@ void *DownloadManager::MainDownload(void *data) {
 //------------------------------------------------------------------------------
 
 
+const size_t MemBufferPool::kMinSize = 4096;
+const unsigned MemBufferPool::kMaxIdle = 2;
+
+
+MemBufferPool::MemBufferPool(
+  const size_t max_size,
+  perf::Counter *n_hits,
+  perf::Counter *n_misses)
+  : max_size_(GetCapacity(max_size))
+  , num_hits_(0)
+  , num_misses_(0)
+  , n_hits_(n_hits)
+  , n_misses_(n_misses)
+{
+  idle_buffers_.resize(GetSizeClass(max_size_) + 1);
+  lock_ = reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  int retval = pthread_mutex_init(lock_, NULL);
+  assert(retval == 0);
+}
+
+
+MemBufferPool::~MemBufferPool() {
+  for (unsigned i = 0; i < idle_buffers_.size(); ++i) {
+    for (unsigned j = 0; j < idle_buffers_[i].size(); ++j)
+      free(idle_buffers_[i][j]);
+  }
+  pthread_mutex_destroy(lock_);
+  free(lock_);
+}
+
+
+/**
+ * Size of the buffer that is handed out for a request of the given size.
+ */
+size_t MemBufferPool::GetCapacity(const size_t size) {
+  size_t capacity = kMinSize;
+  while (capacity < size)
+    capacity <<= 1;
+  return capacity;
+}
+
+
+unsigned MemBufferPool::GetSizeClass(const size_t size) const {
+  unsigned size_class = 0;
+  while ((kMinSize << size_class) < size)
+    ++size_class;
+  return size_class;
+}
+
+
+char *MemBufferPool::Get(const size_t size) {
+  if (size > max_size_)
+    return static_cast<char *>(smalloc(size));
+
+  const unsigned size_class = GetSizeClass(size);
+  char *buffer = NULL;
+  pthread_mutex_lock(lock_);
+  if (!idle_buffers_[size_class].empty()) {
+    buffer = idle_buffers_[size_class].back();
+    idle_buffers_[size_class].pop_back();
+    num_hits_++;
+  } else {
+    num_misses_++;
+  }
+  pthread_mutex_unlock(lock_);
+
+  if (buffer == NULL) {
+    if (n_misses_ != NULL)
+      perf::Inc(n_misses_);
+    buffer = static_cast<char *>(smalloc(kMinSize << size_class));
+  } else if (n_hits_ != NULL) {
+    perf::Inc(n_hits_);
+  }
+  return buffer;
+}
+
+
+/**
+ * The size has to be the one that was passed to Get().
+ */
+void MemBufferPool::Put(char *buffer, const size_t size) {
+  if (buffer == NULL)
+    return;
+  if (size > max_size_) {
+    free(buffer);
+    return;
+  }
+
+  const unsigned size_class = GetSizeClass(size);
+  bool recycled = false;
+  pthread_mutex_lock(lock_);
+  if (idle_buffers_[size_class].size() < kMaxIdle) {
+    idle_buffers_[size_class].push_back(buffer);
+    recycled = true;
+  }
+  pthread_mutex_unlock(lock_);
+
+  if (!recycled)
+    free(buffer);
+}
+
+
+//------------------------------------------------------------------------------
+
+
 HeaderLists::~HeaderLists() {
   for (unsigned i = 0; i < blocks_.size(); ++i) {
     delete[] blocks_[i];
@@ -788,6 +1000,7 @@ void DownloadManager::ReleaseCurlHandle(CURL *handle) {
 void DownloadManager::InitializeRequest(JobInfo *info, CURL *handle) {
   // Initialize internal download state
   info->curl_handle = handle;
+  info->mem_pool = mem_pool_;
   info->error_code = kFailOk;
   info->http_code = -1;
   info->follow_redirects = follow_redirects_;
@@ -804,8 +1017,8 @@ void DownloadManager::InitializeRequest(JobInfo *info, CURL *handle) {
   } else {
     info->nocache = false;
   }
-  if (info->compressed) {
-    zlib::DecompressInit(&(info->zstream));
+  if (info->compressed && (info->destination != kDestinationMem)) {
+    info->decompressor = zlib::Decompressor::Construct(info->compression_alg);
   }
   if (info->expected_hash) {
     assert(info->hash_context.buffer != NULL);
@@ -1001,8 +1214,7 @@ void DownloadManager::SetUrlOptions(JobInfo *info) {
       (info->destination_mem.size == 0) &&
       HasPrefix(url, "file://", false))
   {
-    info->destination_mem.size = 64*1024;
-    info->destination_mem.data = static_cast<char *>(smalloc(64*1024));
+    AllocMemDestination(64*1024, info);
   }
 
   curl_easy_setopt(curl_handle, CURLOPT_URL, EscapeUrl(url).c_str());
@@ -1015,6 +1227,9 @@ void DownloadManager::SetUrlOptions(JobInfo *info) {
  * changed, gather new set of resolved IPs and, if different, exchange them in
  * the load-balance group on the fly.  In the latter case, also rebalance the
  * proxies.  The options mutex needs to be open.
+ *
+ * Usually, the DNS refresh thread has already renewed the entry before it
+ * expires (see RefreshProxyIps()), so that this is only a fallback.
  */
 void DownloadManager::ValidateProxyIpsUnlocked(
   const string &url,
@@ -1025,10 +1240,10 @@ void DownloadManager::ValidateProxyIpsUnlocked(
   LogCvmfs(kLogDownload, kLogDebug, "validate DNS entry for %s",
            host.name().c_str());
 
-  unsigned group_idx = opt_proxy_groups_current_;
+  pthread_mutex_lock(lock_resolver_);
   dns::Host new_host = resolver_->Resolve(host.name());
+  pthread_mutex_unlock(lock_resolver_);
 
-  bool update_only = true;  // No changes to the list of IP addresses.
   if (new_host.status() != dns::kFailOk) {
     // Try again later in case resolving fails.
     LogCvmfs(kLogDownload, kLogDebug | kLogSyslogWarn,
@@ -1036,32 +1251,54 @@ void DownloadManager::ValidateProxyIpsUnlocked(
              host.name().c_str(), new_host.status(),
              dns::Code2Ascii(new_host.status()));
     new_host = dns::Host::ExtendDeadline(host, dns::Resolver::kMinTtl);
-  } else if (!host.IsEquivalent(new_host)) {
-    update_only = false;
   }
+  UpdateProxyHostUnlocked(opt_proxy_groups_current_, url, host, new_host);
+}
 
-  if (update_only) {
-    for (unsigned i = 0; i < (*opt_proxy_groups_)[group_idx].size(); ++i) {
-      if ((*opt_proxy_groups_)[group_idx][i].host.id() == host.id())
-        (*opt_proxy_groups_)[group_idx][i].host = new_host;
+
+/**
+ * Exchanges the host object old_host in the load-balance group group_idx by
+ * new_host.  If both resolve to the same IP addresses, only the host objects
+ * (and thereby the deadlines) are replaced.  Otherwise, the proxy entries of
+ * old_host are removed, new entries are created from url and the new IP
+ * addresses, and, if group_idx is the active group, the proxies are
+ * rebalanced.  Nothing happens if old_host is not (anymore) in the group.  The
+ * options mutex needs to be locked.
+ */
+void DownloadManager::UpdateProxyHostUnlocked(
+  const unsigned group_idx,
+  const string &url,
+  const dns::Host &old_host,
+  const dns::Host &new_host)
+{
+  vector<ProxyInfo> *group = &((*opt_proxy_groups_)[group_idx]);
+
+  if ((new_host.status() != dns::kFailOk) || old_host.IsEquivalent(new_host)) {
+    // No changes to the list of IP addresses.
+    for (unsigned i = 0; i < group->size(); ++i) {
+      if ((*group)[i].host.id() == old_host.id())
+        (*group)[i].host = new_host;
     }
     return;
   }
 
-  assert(new_host.status() == dns::kFailOk);
-
   // Remove old host objects, insert new objects, and rebalance.
-  LogCvmfs(kLogDownload, kLogDebug | kLogSyslog,
-           "DNS entries for proxy %s changed, adjusting", host.name().c_str());
-  vector<ProxyInfo> *group = &((*opt_proxy_groups_)[opt_proxy_groups_current_]);
-  opt_num_proxies_ -= group->size();
+  unsigned num_removed = 0;
   for (unsigned i = 0; i < group->size(); ) {
-    if ((*group)[i].host.id() == host.id()) {
+    if ((*group)[i].host.id() == old_host.id()) {
       group->erase(group->begin() + i);
+      num_removed++;
     } else {
       i++;
     }
   }
+  if (num_removed == 0)
+    return;
+  LogCvmfs(kLogDownload, kLogDebug | kLogSyslog,
+           "DNS entries for proxy %s changed, adjusting",
+           old_host.name().c_str());
+  opt_num_proxies_ -= num_removed;
+
   vector<ProxyInfo> new_infos;
   set<string> best_addresses = new_host.ViewBestAddresses(opt_ip_preference_);
   set<string>::const_iterator iter_ips = best_addresses.begin();
@@ -1072,7 +1309,132 @@ void DownloadManager::ValidateProxyIpsUnlocked(
   group->insert(group->end(), new_infos.begin(), new_infos.end());
   opt_num_proxies_ += new_infos.size();
 
-  RebalanceProxiesUnlocked();
+  if (group_idx == opt_proxy_groups_current_)
+    RebalanceProxiesUnlocked();
+}
+
+
+/**
+ * Re-creates refresh_resolver_ if the settings of resolver_ changed since it
+ * was created.  Only used by the DNS refresh thread.
+ */
+void DownloadManager::UpdateRefreshResolver() {
+  pthread_mutex_lock(lock_resolver_);
+  if ((refresh_resolver_ == NULL) ||
+      (refresh_resolver_generation_ != resolver_generation_))
+  {
+    dns::Resolver *new_resolver = dns::NormalResolver::Create(
+      resolver_->ipv4_only(), resolver_->retries(), resolver_->timeout_ms());
+    if (new_resolver != NULL) {
+      if (!resolver_->resolvers().empty())
+        new_resolver->SetResolvers(resolver_->resolvers());
+      new_resolver->set_throttle(resolver_->throttle());
+      delete refresh_resolver_;
+      refresh_resolver_ = new_resolver;
+      refresh_resolver_generation_ = resolver_generation_;
+    }
+  }
+  pthread_mutex_unlock(lock_resolver_);
+}
+
+
+/**
+ * Re-resolves all proxy names whose DNS entries expire before horizon and
+ * exchanges the results in the proxy groups.  Name resolution runs on the
+ * private refresh_resolver_ without holding any lock, so that neither
+ * concurrent downloads nor name resolution on resolver_ are blocked.  The
+ * results are swapped in under the options mutex.  Failed name resolutions
+ * are ignored; the entry is then validated again when it expires.  Returns
+ * the number of successfully refreshed names.
+ */
+unsigned DownloadManager::RefreshProxyIps(const time_t horizon) {
+  vector<string> names;
+  vector<ProxyInfo> proxies;
+  vector<unsigned> group_idxs;
+
+  pthread_mutex_lock(lock_options_);
+  if (opt_proxy_groups_) {
+    set<int64_t> seen_hosts;
+    for (unsigned i = 0; i < opt_proxy_groups_->size(); ++i) {
+      for (unsigned j = 0; j < (*opt_proxy_groups_)[i].size(); ++j) {
+        const ProxyInfo &proxy = (*opt_proxy_groups_)[i][j];
+        if ((proxy.url == "DIRECT") || proxy.host.name().empty())
+          continue;
+        if (proxy.host.deadline() > horizon)
+          continue;
+        if (!seen_hosts.insert(proxy.host.id()).second)
+          continue;
+        names.push_back(proxy.host.name());
+        proxies.push_back(proxy);
+        group_idxs.push_back(i);
+      }
+    }
+  }
+  pthread_mutex_unlock(lock_options_);
+  if (names.empty())
+    return 0;
+
+  LogCvmfs(kLogDownload, kLogDebug, "refreshing %u proxy addresses",
+           names.size());
+  UpdateRefreshResolver();
+  if (refresh_resolver_ == NULL) {
+    LogCvmfs(kLogDownload, kLogDebug, "no resolver for refreshing proxies");
+    return 0;
+  }
+  vector<dns::Host> hosts;
+  refresh_resolver_->ResolveMany(names, &hosts);
+
+  unsigned num_refreshed = 0;
+  pthread_mutex_lock(lock_options_);
+  for (unsigned i = 0; i < names.size(); ++i) {
+    if (hosts[i].status() != dns::kFailOk) {
+      LogCvmfs(kLogDownload, kLogDebug,
+               "failed to refresh IP addresses for %s (%d - %s)",
+               names[i].c_str(), hosts[i].status(),
+               dns::Code2Ascii(hosts[i].status()));
+      continue;
+    }
+    // The proxy chain might have been replaced in the meantime
+    if (!opt_proxy_groups_ || (group_idxs[i] >= opt_proxy_groups_->size()))
+      continue;
+    UpdateProxyHostUnlocked(group_idxs[i], proxies[i].url, proxies[i].host,
+                            hosts[i]);
+    num_refreshed++;
+  }
+  pthread_mutex_unlock(lock_options_);
+  return num_refreshed;
+}
+
+
+/**
+ * Renews proxy DNS entries kDnsRefreshAheadS seconds before they expire, so
+ * that downloads do not need to wait for name resolution.  Runs until
+ * something is written to pipe_terminate_dns_.
+ */
+void *DownloadManager::MainDnsRefresh(void *data) {
+  LogCvmfs(kLogDownload, kLogDebug, "DNS refresh thread started");
+  DownloadManager *download_mgr = static_cast<DownloadManager *>(data);
+
+  struct pollfd watch_term;
+  watch_term.fd = download_mgr->pipe_terminate_dns_[0];
+  watch_term.events = POLLIN | POLLPRI;
+  watch_term.revents = 0;
+  while (true) {
+    int retval = poll(&watch_term, 1, kDnsRefreshIntervalMs);
+    if (retval < 0) {
+      if (errno == EINTR)
+        continue;
+      LogCvmfs(kLogDownload, kLogSyslogErr,
+               "DNS refresh thread failed to poll (%d)", errno);
+      break;
+    }
+    if (retval > 0)
+      break;
+    download_mgr->RefreshProxyIps(time(NULL) + kDnsRefreshAheadS);
+  }
+
+  LogCvmfs(kLogDownload, kLogDebug, "DNS refresh thread terminated");
+  return NULL;
 }
 
 
@@ -1202,9 +1564,10 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
         uint64_t size;
         bool retval = zlib::DecompressMem2Mem(info->destination_mem.data,
                                               info->destination_mem.pos,
-                                              &buf, &size);
+                                              &buf, &size,
+                                              info->compression_alg);
         if (retval) {
-          free(info->destination_mem.data);
+          FreeMemDestination(info);
           info->destination_mem.data = static_cast<char *>(buf);
           info->destination_mem.pos = info->destination_mem.size = size;
         } else {
@@ -1270,10 +1633,12 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
 
   std::vector<std::string> *host_chain = opt_host_chain_;
 
-  // Determination if download should be repeated
+  // Determination if download should be repeated.  Warm-up requests are best
+  // effort; their failures must not switch proxies or hosts under the feet of
+  // the regular transfers.
   bool try_again = false;
   bool same_url_retry = CanRetry(info);
-  if (info->error_code != kFailOk) {
+  if ((info->error_code != kFailOk) && !IsWarmupJob(info)) {
     pthread_mutex_lock(lock_options_);
     if (info->error_code == kFailBadData) {
       if (!info->nocache) {
@@ -1347,12 +1712,8 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     LogCvmfs(kLogDownload, kLogDebug, "Trying again on same curl handle, "
              "same url: %d, error code %d", same_url_retry, info->error_code);
     // Reset internal state and destination
-    if ((info->destination == kDestinationMem) && info->destination_mem.data) {
-      free(info->destination_mem.data);
-      info->destination_mem.data = NULL;
-      info->destination_mem.size = 0;
-      info->destination_mem.pos = 0;
-    }
+    if (info->destination == kDestinationMem)
+      FreeMemDestination(info);
     if ((info->destination == kDestinationFile) ||
         (info->destination == kDestinationPath))
     {
@@ -1372,8 +1733,8 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     }
     if (info->expected_hash)
       shash::Init(info->hash_context);
-    if (info->compressed)
-      zlib::DecompressInit(&info->zstream);
+    if (info->decompressor)
+      info->decompressor->Reset();
     SetRegularCache(info);
 
     // Failure handling
@@ -1434,8 +1795,8 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     info->destination_file = NULL;
   }
 
-  if (info->compressed)
-    zlib::DecompressFini(&info->zstream);
+  delete info->decompressor;
+  info->decompressor = NULL;
 
   if (info->headers) {
     header_lists_->PutList(info->headers);
@@ -1451,10 +1812,12 @@ DownloadManager::DownloadManager() {
   pool_handles_inuse_ = NULL;
   pool_max_handles_ = 0;
   curl_multi_ = NULL;
+  mem_pool_ = NULL;
   default_headers_ = NULL;
 
   atomic_init32(&multi_threaded_);
   pipe_terminate_[0] = pipe_terminate_[1] = -1;
+  pipe_terminate_dns_[0] = pipe_terminate_dns_[1] = -1;
 
   pipe_jobs_[0] = pipe_jobs_[1] = -1;
   watch_fds_ = NULL;
@@ -1470,6 +1833,10 @@ DownloadManager::DownloadManager() {
   reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
   retval = pthread_mutex_init(lock_synchronous_mode_, NULL);
   assert(retval == 0);
+  lock_resolver_ =
+  reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  retval = pthread_mutex_init(lock_resolver_, NULL);
+  assert(retval == 0);
 
   opt_dns_server_ = NULL;
   opt_ip_preference_ = dns::kIpPreferSystem;
@@ -1492,6 +1859,9 @@ DownloadManager::DownloadManager() {
   use_system_proxy_ = false;
 
   resolver_ = NULL;
+  resolver_generation_ = 0;
+  refresh_resolver_ = NULL;
+  refresh_resolver_generation_ = 0;
 
   opt_timestamp_backup_proxies_ = 0;
   opt_timestamp_failover_proxies_ = 0;
@@ -1501,6 +1871,11 @@ DownloadManager::DownloadManager() {
 
   credentials_attachment_ = NULL;
 
+  num_warmup_ = 0;
+  warmup_jobs_ = NULL;
+  timestamp_warmup_ = 0;
+  timestamp_last_job_ = 0;
+
   counters_ = NULL;
 }
 
@@ -1508,8 +1883,10 @@ DownloadManager::DownloadManager() {
 DownloadManager::~DownloadManager() {
   pthread_mutex_destroy(lock_options_);
   pthread_mutex_destroy(lock_synchronous_mode_);
+  pthread_mutex_destroy(lock_resolver_);
   free(lock_options_);
   free(lock_synchronous_mode_);
+  free(lock_resolver_);
 }
 
 void DownloadManager::InitHeaders() {
@@ -1565,6 +1942,8 @@ void DownloadManager::Init(const unsigned max_pool_handles,
   opt_ip_preference_ = dns::kIpPreferSystem;
 
   counters_ = new Counters(statistics, name);
+  mem_pool_ = new MemBufferPool(kMaxMemSize, counters_->n_mem_pool_hits,
+                                counters_->n_mem_pool_misses);
 
   user_agent_ = NULL;
   InitHeaders();
@@ -1605,8 +1984,12 @@ void DownloadManager::Init(const unsigned max_pool_handles,
 
 void DownloadManager::Fini() {
   if (atomic_xadd32(&multi_threaded_, 0) == 1) {
-    // Shutdown I/O thread
+    // Shutdown I/O thread and DNS refresh thread
     char buf = 'T';
+    WritePipe(pipe_terminate_dns_[1], &buf, 1);
+    pthread_join(thread_dns_refresh_, NULL);
+    close(pipe_terminate_dns_[1]);
+    close(pipe_terminate_dns_[0]);
     WritePipe(pipe_terminate_[1], &buf, 1);
     pthread_join(thread_download_, NULL);
     // All handles are removed from the multi stack
@@ -1624,6 +2007,9 @@ void DownloadManager::Fini() {
   delete pool_handles_idle_;
   delete pool_handles_inuse_;
   curl_multi_cleanup(curl_multi_);
+  delete[] warmup_jobs_;
+  warmup_jobs_ = NULL;
+  num_warmup_ = 0;
   pool_handles_idle_ = NULL;
   pool_handles_inuse_ = NULL;
   curl_multi_ = NULL;
@@ -1635,6 +2021,8 @@ void DownloadManager::Fini() {
 
   delete counters_;
   counters_ = NULL;
+  delete mem_pool_;
+  mem_pool_ = NULL;
 
   delete opt_host_chain_;
   delete opt_host_chain_rtt_;
@@ -1647,20 +2035,32 @@ void DownloadManager::Fini() {
 
   delete resolver_;
   resolver_ = NULL;
+  delete refresh_resolver_;
+  refresh_resolver_ = NULL;
 }
 
 
 /**
- * Spawns the I/O worker thread and switches the module in multi-threaded mode.
- * No way back except Fini(); Init();
+ * Spawns the I/O worker thread and the DNS refresh thread and switches the
+ * module in multi-threaded mode.  No way back except Fini(); Init();
  */
 void DownloadManager::Spawn() {
   MakePipe(pipe_terminate_);
   MakePipe(pipe_jobs_);
+  MakePipe(pipe_terminate_dns_);
+
+  if (num_warmup_ > 0) {
+    warmup_jobs_ = new JobInfo[num_warmup_];
+    timestamp_warmup_ = 0;  // Due immediately
+    timestamp_last_job_ = platform_monotonic_time();
+  }
 
   int retval = pthread_create(&thread_download_, NULL, MainDownload,
                               static_cast<void *>(this));
   assert(retval == 0);
+  retval = pthread_create(&thread_dns_refresh_, NULL, MainDnsRefresh,
+                          static_cast<void *>(this));
+  assert(retval == 0);
 
   atomic_inc32(&multi_threaded_);
 }
@@ -1674,6 +2074,14 @@ Failures DownloadManager::Fetch(JobInfo *info) {
   assert(info->url != NULL);
 
   Failures result;
+  if (info->compressed && !zlib::IsSupportedAlgorithm(info->compression_alg)) {
+    LogCvmfs(kLogDownload, kLogDebug | kLogSyslogErr,
+             "refusing to download %s: unsupported compression algorithm %d",
+             info->url->c_str(), info->compression_alg);
+    info->error_code = kFailBadData;
+    return kFailBadData;
+  }
+
   result = PrepareDownloadDestination(info);
   if (result != kFailOk)
     return result;
@@ -1735,11 +2143,8 @@ Failures DownloadManager::Fetch(JobInfo *info) {
     if (info->destination == kDestinationPath)
       unlink(info->destination_path->c_str());
 
-    if (info->destination_mem.data) {
-      free(info->destination_mem.data);
-      info->destination_mem.data = NULL;
-      info->destination_mem.size = 0;
-    }
+    if (info->destination == kDestinationMem)
+      FreeMemDestination(info);
   }
 
   return result;
@@ -1771,7 +2176,10 @@ void DownloadManager::SetDnsServer(const string &address) {
 
     vector<string> servers;
     servers.push_back(address);
+    pthread_mutex_lock(lock_resolver_);
     bool retval = resolver_->SetResolvers(servers);
+    resolver_generation_++;
+    pthread_mutex_unlock(lock_resolver_);
     assert(retval);
   }
   pthread_mutex_unlock(lock_options_);
@@ -1787,9 +2195,11 @@ void DownloadManager::SetDnsParameters(
   const unsigned timeout_ms)
 {
   pthread_mutex_lock(lock_options_);
+  pthread_mutex_lock(lock_resolver_);
   if ((resolver_->retries() == retries) &&
       (resolver_->timeout_ms() == timeout_ms))
   {
+    pthread_mutex_unlock(lock_resolver_);
     pthread_mutex_unlock(lock_options_);
     return;
   }
@@ -1798,6 +2208,8 @@ void DownloadManager::SetDnsParameters(
   resolver_ =
     dns::NormalResolver::Create(opt_ipv4_only_, retries, timeout_ms);
   assert(resolver_);
+  resolver_generation_++;
+  pthread_mutex_unlock(lock_resolver_);
   pthread_mutex_unlock(lock_options_);
 }
 
@@ -2455,7 +2867,9 @@ void DownloadManager::SetProxyChain(
   vector<dns::Host> hosts;
   LogCvmfs(kLogDownload, kLogDebug, "resolving %u proxy addresses",
            hostnames.size());
+  pthread_mutex_lock(lock_resolver_);
   resolver_->ResolveMany(hostnames, &hosts);
+  pthread_mutex_unlock(lock_resolver_);
 
   // Construct opt_proxy_groups_: traverse proxy list in same order and expand
   // names to resolved IP addresses.
@@ -2648,7 +3062,10 @@ void DownloadManager::SetRetryParameters(const unsigned max_retries,
 
 void DownloadManager::SetMaxIpaddrPerProxy(unsigned limit) {
   pthread_mutex_lock(lock_options_);
+  pthread_mutex_lock(lock_resolver_);
   resolver_->set_throttle(limit);
+  resolver_generation_++;
+  pthread_mutex_unlock(lock_resolver_);
   pthread_mutex_unlock(lock_options_);
 }
 
@@ -2679,6 +3096,18 @@ void DownloadManager::EnableRedirects() {
 }
 
 
+/**
+ * Number of connections that are opened in parallel to the active host when
+ * the I/O thread starts and that are kept alive while idle.  Zero disables
+ * connection warm-up.  Needs to be set before Spawn().  Limited by the number
+ * of pooled curl handles.
+ */
+void DownloadManager::SetConnectionWarmup(const unsigned num_connections) {
+  assert(atomic_read32(&multi_threaded_) == 0);
+  num_warmup_ = std::min(num_connections, pool_max_handles_);
+}
+
+
 /**
  * Creates a copy of the existing download manager.  Must only be called in
  * single-threaded stage because it calls curl_global_init().
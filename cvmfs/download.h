@@ -25,6 +25,7 @@
 #include "prng.h"
 #include "sink.h"
 #include "statistics.h"
+#include "util/single_copy.h"
 
 
 namespace download {
@@ -95,6 +96,8 @@ struct Counters {
   perf::Counter *n_retries;
   perf::Counter *n_proxy_failover;
   perf::Counter *n_host_failover;
+  perf::Counter *n_mem_pool_hits;
+  perf::Counter *n_mem_pool_misses;
 
   Counters(perf::Statistics *statistics, const std::string &name) {
     sz_transferred_bytes = statistics->Register(name + ".sz_transferred_bytes",
@@ -108,16 +111,65 @@ struct Counters {
         "Number of proxy failovers");
     n_host_failover = statistics->Register(name + ".n_host_failover",
         "Number of host failovers");
+    n_mem_pool_hits = statistics->Register(name + ".n_mem_pool_hits",
+        "Number of recycled receive buffers");
+    n_mem_pool_misses = statistics->Register(name + ".n_mem_pool_misses",
+        "Number of newly allocated receive buffers");
   }
 };  // Counters
 
 
+/**
+ * Recycles the buffers that receive compressed objects downloaded to memory.
+ * These buffers only hold the data until it is inflated in one go, so they can
+ * be reused for the next download instead of being freed.  Buffers are grouped
+ * in power-of-two size classes between kMinSize and max_size; a few idle
+ * buffers are kept per size class.  Larger requests are served by plain
+ * allocations.  Pooled buffers are allocated with malloc(), so handing one out
+ * to code that calls free() on it is safe (only it is not recycled).
+ * Hits and misses are optionally reported to the given counters, too.
+ * Thread-safe.
+ */
+class MemBufferPool : SingleCopy {
+ public:
+  static const size_t kMinSize;
+  static const unsigned kMaxIdle;
+
+  explicit MemBufferPool(const size_t max_size,
+                         perf::Counter *n_hits = NULL,
+                         perf::Counter *n_misses = NULL);
+  ~MemBufferPool();
+  static size_t GetCapacity(const size_t size);
+  char *Get(const size_t size);
+  void Put(char *buffer, const size_t size);
+
+  uint64_t num_hits() const { return num_hits_; }
+  uint64_t num_misses() const { return num_misses_; }
+
+ private:
+  unsigned GetSizeClass(const size_t size) const;
+
+  size_t max_size_;
+  /**
+   * Idle buffers per size class, size class i holds buffers of kMinSize << i
+   * bytes.
+   */
+  std::vector<std::vector<char *> > idle_buffers_;
+  uint64_t num_hits_;
+  uint64_t num_misses_;
+  perf::Counter *n_hits_;
+  perf::Counter *n_misses_;
+  pthread_mutex_t *lock_;
+};
+
+
 /**
  * Contains all the information to specify a download job.
  */
 struct JobInfo {
   const std::string *url;
   bool compressed;
+  zlib::Algorithms compression_alg;  // Only looked at if compressed is set
   bool probe_hosts;
   bool head_request;
   bool follow_redirects;
@@ -146,6 +198,7 @@ struct JobInfo {
   void Init() {
     url = NULL;
     compressed = false;
+    compression_alg = zlib::kZlibDefault;
     probe_hosts = false;
     head_request = false;
     follow_redirects = false;
@@ -165,7 +218,8 @@ struct JobInfo {
 
     curl_handle = NULL;
     headers = NULL;
-    memset(&zstream, 0, sizeof(zstream));
+    mem_pool = NULL;
+    decompressor = NULL;
     info_header = NULL;
     wait_at[0] = wait_at[1] = -1;
     nocache = false;
@@ -240,8 +294,9 @@ struct JobInfo {
   // Internal state, don't touch
   CURL *curl_handle;
   curl_slist *headers;
+  MemBufferPool *mem_pool;
   char *info_header;
-  z_stream zstream;
+  zlib::Decompressor *decompressor;
   shash::ContextPtr hash_context;
   int wait_at[2];  /**< Pipe used for the return value */
   std::string proxy;
@@ -308,6 +363,9 @@ class CredentialsAttachment {
 class DownloadManager {
   FRIEND_TEST(T_Download, ValidateGeoReply);
   FRIEND_TEST(T_Download, StripDirect);
+  FRIEND_TEST(T_Download, RefreshProxyIps);
+  FRIEND_TEST(T_Download, ConnectionWarmupIdle);
+  FRIEND_TEST(T_Download, LocalCompressedFile2Mem);
 
  public:
   struct ProxyInfo {
@@ -349,6 +407,23 @@ class DownloadManager {
 
   static const unsigned kDnsDefaultRetries = 1;
   static const unsigned kDnsDefaultTimeoutMs = 3000;
+  /**
+   * Proxy DNS entries are renewed in the background this many seconds before
+   * they expire.  Must be smaller than dns::Resolver::kMinTtl.
+   */
+  static const unsigned kDnsRefreshAheadS = 20;
+  static const unsigned kDnsRefreshIntervalMs = 5000;
+
+  /**
+   * Warm connections are refreshed after this many seconds of idleness, below
+   * the typical keep-alive timeout of proxy servers.
+   */
+  static const unsigned kWarmupRefreshS = 60;
+  /**
+   * Warm connections are not refreshed anymore if there was no transfer for
+   * this many seconds, so that idle clients do not keep proxies busy.
+   */
+  static const unsigned kWarmupMaxIdleS = 600;
 
   DownloadManager();
   ~DownloadManager();
@@ -402,11 +477,18 @@ class DownloadManager {
   void EnableInfoHeader();
   void EnablePipelining();
   void EnableRedirects();
+  void SetConnectionWarmup(const unsigned num_connections);
 
  private:
+  /**
+   * The object requested by connection warm-up, relative to the host url.
+   */
+  static const std::string kWarmupUrl;
+
   static int CallbackCurlSocket(CURL *easy, curl_socket_t s, int action,
                                 void *userp, void *socketp);
   static void *MainDownload(void *data);
+  static void *MainDnsRefresh(void *data);
 
   bool StripDirect(const std::string &proxy_list, std::string *cleaned_list);
   bool ValidateGeoReply(const std::string &reply_order,
@@ -420,6 +502,15 @@ class DownloadManager {
   void InitializeRequest(JobInfo *info, CURL *handle);
   void SetUrlOptions(JobInfo *info);
   void ValidateProxyIpsUnlocked(const std::string &url, const dns::Host &host);
+  void UpdateProxyHostUnlocked(const unsigned group_idx,
+                               const std::string &url,
+                               const dns::Host &old_host,
+                               const dns::Host &new_host);
+  unsigned RefreshProxyIps(const time_t horizon);
+  void UpdateRefreshResolver();
+  void WarmupConnections(int *still_running);
+  bool IsWarmupJob(const JobInfo *info) const;
+  uint64_t GetWarmupDeadline() const;
   void UpdateStatistics(CURL *handle);
   bool CanRetry(const JobInfo *info);
   void Backoff(JobInfo *info);
@@ -436,6 +527,7 @@ class DownloadManager {
   uint32_t pool_max_handles_;
   CURLM *curl_multi_;
   HeaderLists *header_lists_;
+  MemBufferPool *mem_pool_;
   curl_slist *default_headers_;
   char *user_agent_;
 
@@ -443,6 +535,26 @@ class DownloadManager {
   atomic_int32 multi_threaded_;
   int pipe_terminate_[2];
 
+  pthread_t thread_dns_refresh_;
+  int pipe_terminate_dns_[2];
+
+  /**
+   * Number of connections opened by WarmupConnections(), zero if disabled.
+   */
+  unsigned num_warmup_;
+  /**
+   * Array of num_warmup_ jobs, only touched by the I/O thread.
+   */
+  JobInfo *warmup_jobs_;
+  /**
+   * Last warm-up or last new job, monotonic clock.
+   */
+  uint64_t timestamp_warmup_;
+  /**
+   * Last new job, monotonic clock.
+   */
+  uint64_t timestamp_last_job_;
+
   int pipe_jobs_[2];
   struct pollfd *watch_fds_;
   uint32_t watch_fds_size_;
@@ -451,6 +563,11 @@ class DownloadManager {
 
   pthread_mutex_t *lock_options_;
   pthread_mutex_t *lock_synchronous_mode_;
+  /**
+   * Protects resolver_ and resolver_generation_.  Lock order: lock_options_
+   * before lock_resolver_.
+   */
+  pthread_mutex_t *lock_resolver_;
   char *opt_dns_server_;
   unsigned opt_timeout_proxy_;
   unsigned opt_timeout_direct_;
@@ -504,7 +621,19 @@ class DownloadManager {
   /**
    * Used to resolve proxy addresses (host addresses are resolved by the proxy).
    */
-  dns::NormalResolver *resolver_;
+  dns::Resolver *resolver_;
+  /**
+   * Incremented whenever the settings of resolver_ change
+   */
+  uint64_t resolver_generation_;
+
+  /**
+   * Private resolver of the DNS refresh thread, so that the refresh does not
+   * block resolver_ while it waits for the name servers.  Created from the
+   * settings of resolver_ and re-created when they change.
+   */
+  dns::Resolver *refresh_resolver_;
+  uint64_t refresh_resolver_generation_;
 
   /**
    * If a proxy has IPv4 and IPv6 addresses, which one to prefer
@@ -5,8 +5,11 @@
 #include "cvmfs_config.h"
 #include "fetch.h"
 
+#include <alloca.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "backoff.h"
 #include "cache.h"
 #include "clientctx.h"
@@ -14,12 +17,17 @@
 #include "logging.h"
 #include "quota.h"
 #include "statistics.h"
+#include "smalloc.h"
 #include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
 namespace cvmfs {
 
+const unsigned Fetcher::kMaxSparseObjects;
+const unsigned Fetcher::kNumVerifyThreads;
+
 void TLSDestructor(void *data) {
   Fetcher::ThreadLocalStorage *tls =
     static_cast<Fetcher::ThreadLocalStorage *>(data);
@@ -82,6 +90,273 @@ int Fetcher::Fetch(
   const CacheManager::ObjectType object_type,
   const std::string &alt_url,
   off_t range_offset)
+{
+  return FetchObject(id, &id, size, name, compression_algorithm, object_type,
+                     alt_url, range_offset);
+}
+
+
+/**
+ * Fetches the block at block_offset of an uncompressed external object with a
+ * range request and stores it as a cache object of its own.  The first access
+ * to an object queues its verification as a whole with one of the
+ * verification threads and returns the block right away.  Once the object is
+ * verified, blocks are checked against their digests.  If verification fails,
+ * the blocks are evicted and -EIO is returned from then on.
+ */
+int Fetcher::FetchBlock(
+  const shash::Any &id,
+  const uint64_t size,
+  const off_t block_offset,
+  const std::string &name,
+  const CacheManager::ObjectType object_type,
+  const std::string &alt_url)
+{
+  assert(external_ && (block_size_ > 0));
+  assert((block_offset >= 0) && (static_cast<uint64_t>(block_offset) < size));
+  assert((block_offset % block_size_) == 0);
+  const uint64_t block_size =
+    std::min(block_size_, size - static_cast<uint64_t>(block_offset));
+
+  shash::Any block_hash;
+  const SparseObject::State state =
+    GetSparseState(VerifyJob(id, size, name, object_type, alt_url),
+                   &block_hash, block_offset / block_size_);
+  if (state == SparseObject::kFailed)
+    return -EIO;
+  // Blocks that dropped out of the cache are checked by the download manager
+  // once the object is verified
+  return FetchObject(MakeBlockId(id, block_offset, block_size),
+                     (state == SparseObject::kVerified) ? &block_hash : NULL,
+                     block_size, name, zlib::kNoCompression, object_type,
+                     alt_url, block_offset);
+}
+
+
+/**
+ * The cache id of a block is derived from the content hash of the object and
+ * the byte range covered by the block.
+ */
+shash::Any Fetcher::MakeBlockId(
+  const shash::Any &id,
+  const off_t block_offset,
+  const uint64_t block_size)
+{
+  shash::Any block_id(id.algorithm, shash::kSuffixPartial);
+  shash::HashString(id.ToString() + "/" + StringifyInt(block_offset) + "+" +
+                    StringifyInt(block_size), &block_id);
+  return block_id;
+}
+
+
+void Fetcher::SetBlockSize(const uint64_t block_size) {
+  block_size_ = block_size;
+  if ((block_size_ == 0) || !verify_threads_.empty())
+    return;
+  verify_threads_.resize(kNumVerifyThreads);
+  for (unsigned i = 0; i < kNumVerifyThreads; ++i) {
+    int retval = pthread_create(&verify_threads_[i], NULL, MainVerify, this);
+    assert(retval == 0);
+  }
+}
+
+
+/**
+ * Returns the verification state of the object of the job and queues its
+ * verification if the object is unknown.  Objects that failed verification
+ * before are verified again; in this case, the function waits for the result.
+ * If the object is verified, block_hash is set to the digest of the block
+ * with index block_idx.
+ */
+Fetcher::SparseObject::State Fetcher::GetSparseState(
+  const VerifyJob &job,
+  shash::Any *block_hash,
+  const unsigned block_idx)
+{
+  bool waited = false;
+  pthread_mutex_lock(lock_sparse_objects_);
+  while (true) {
+    SparseObjects::iterator i = sparse_objects_.find(job.id);
+    // Also if the object was pruned from sparse_objects_ in the meantime
+    if ((i == sparse_objects_.end()) && waited) {
+      pthread_mutex_unlock(lock_sparse_objects_);
+      return SparseObject::kFailed;
+    }
+    if (i == sparse_objects_.end()) {
+      sparse_objects_[job.id] = SparseObject();
+      verify_queue_.push_back(job);
+      pthread_cond_signal(cond_verify_queued_);
+      pthread_mutex_unlock(lock_sparse_objects_);
+      return SparseObject::kVerifying;
+    }
+
+    SparseObject *object = &i->second;
+    switch (object->state) {
+      case SparseObject::kVerified:
+        assert(block_idx < object->block_hashes.size());
+        *block_hash = object->block_hashes[block_idx];
+        pthread_mutex_unlock(lock_sparse_objects_);
+        return SparseObject::kVerified;
+      case SparseObject::kVerifying:
+        if (!object->retry) {
+          pthread_mutex_unlock(lock_sparse_objects_);
+          return SparseObject::kVerifying;
+        }
+        break;
+      case SparseObject::kFailed:
+        if (waited) {
+          pthread_mutex_unlock(lock_sparse_objects_);
+          return SparseObject::kFailed;
+        }
+        sparse_objects_finished_.erase(std::find(
+          sparse_objects_finished_.begin(), sparse_objects_finished_.end(),
+          job.id));
+        object->state = SparseObject::kVerifying;
+        object->retry = true;
+        verify_queue_.push_back(job);
+        pthread_cond_signal(cond_verify_queued_);
+        break;
+    }
+    pthread_cond_wait(cond_verify_done_, lock_sparse_objects_);
+    waited = true;
+  }
+}
+
+
+/**
+ * Fetches all the blocks of an object, hashes them in order and compares the
+ * result with the content hash of the object.  The digests of the individual
+ * blocks are stored in block_hashes.  On a hash mismatch, the blocks are
+ * evicted from the cache.
+ */
+bool Fetcher::VerifyBlocks(
+  const VerifyJob &job,
+  std::vector<shash::Any> *block_hashes)
+{
+  const unsigned num_blocks = (job.size + block_size_ - 1) / block_size_;
+  shash::ContextPtr hash_context(job.id.algorithm);
+  hash_context.buffer = alloca(hash_context.size);
+  shash::Init(hash_context);
+  shash::ContextPtr block_context(job.id.algorithm);
+  block_context.buffer = alloca(block_context.size);
+
+  const uint64_t kBufSize = 64 * 1024;
+  unsigned char *buf = static_cast<unsigned char *>(smalloc(kBufSize));
+  for (unsigned i = 0; i < num_blocks; ++i) {
+    const off_t block_offset = static_cast<off_t>(i) * block_size_;
+    const uint64_t block_size = std::min(block_size_, job.size - block_offset);
+    const int fd = FetchObject(MakeBlockId(job.id, block_offset, block_size),
+                               NULL, block_size, job.name, zlib::kNoCompression,
+                               job.object_type, job.alt_url, block_offset);
+    if (fd < 0)
+      break;
+    shash::Init(block_context);
+    uint64_t pos = 0;
+    while (pos < block_size) {
+      const int64_t nbytes =
+        cache_mgr_->Pread(fd, buf, std::min(kBufSize, block_size - pos), pos);
+      if (nbytes <= 0)
+        break;
+      shash::Update(buf, nbytes, hash_context);
+      shash::Update(buf, nbytes, block_context);
+      pos += nbytes;
+    }
+    cache_mgr_->Close(fd);
+    if (pos != block_size)
+      break;
+    block_hashes->push_back(shash::Any(job.id.algorithm));
+    shash::Final(block_context, &block_hashes->back());
+  }
+  free(buf);
+
+  if (block_hashes->size() != num_blocks) {
+    LogCvmfs(kLogCache, kLogDebug | kLogSyslogErr,
+             "failed to read all blocks of %s", job.name.c_str());
+    return false;
+  }
+
+  shash::Any actual_id(job.id.algorithm);
+  shash::Final(hash_context, &actual_id);
+  if (actual_id == job.id) {
+    LogCvmfs(kLogCache, kLogDebug, "verified all blocks of %s",
+             job.name.c_str());
+    return true;
+  }
+
+  LogCvmfs(kLogCache, kLogDebug | kLogSyslogErr,
+           "hash mismatch for blocks of %s (expected %s, got %s)",
+           job.name.c_str(), job.id.ToString().c_str(),
+           actual_id.ToString().c_str());
+  for (unsigned i = 0; i < num_blocks; ++i) {
+    const off_t block_offset = static_cast<off_t>(i) * block_size_;
+    const uint64_t block_size = std::min(block_size_, job.size - block_offset);
+    cache_mgr_->quota_mgr()->Remove(
+      MakeBlockId(job.id, block_offset, block_size));
+  }
+  return false;
+}
+
+
+/**
+ * Called with lock_sparse_objects_ held.  Forgets about the oldest finished
+ * objects.
+ */
+void Fetcher::PruneSparseObjects() {
+  while (sparse_objects_finished_.size() > kMaxSparseObjects) {
+    sparse_objects_.erase(sparse_objects_finished_.front());
+    sparse_objects_finished_.pop_front();
+  }
+}
+
+
+void *Fetcher::MainVerify(void *data) {
+  Fetcher *fetcher = reinterpret_cast<Fetcher *>(data);
+  pthread_mutex_lock(fetcher->lock_sparse_objects_);
+  while (true) {
+    while (!fetcher->verify_terminate_ && fetcher->verify_queue_.empty()) {
+      pthread_cond_wait(fetcher->cond_verify_queued_,
+                        fetcher->lock_sparse_objects_);
+    }
+    if (fetcher->verify_terminate_)
+      break;
+    const VerifyJob job = fetcher->verify_queue_.front();
+    fetcher->verify_queue_.pop_front();
+    pthread_mutex_unlock(fetcher->lock_sparse_objects_);
+
+    std::vector<shash::Any> block_hashes;
+    const bool retval = fetcher->VerifyBlocks(job, &block_hashes);
+
+    pthread_mutex_lock(fetcher->lock_sparse_objects_);
+    SparseObject *object = &fetcher->sparse_objects_[job.id];
+    if (retval) {
+      object->state = SparseObject::kVerified;
+      object->block_hashes.swap(block_hashes);
+    } else {
+      object->state = SparseObject::kFailed;
+    }
+    fetcher->sparse_objects_finished_.push_back(job.id);
+    fetcher->PruneSparseObjects();
+    pthread_cond_broadcast(fetcher->cond_verify_done_);
+  }
+  pthread_mutex_unlock(fetcher->lock_sparse_objects_);
+  return NULL;
+}
+
+
+/**
+ * Downloads id (or the given byte range of alt_url in external mode) into the
+ * cache unless it is already there.  The downloaded data are verified against
+ * expected_hash unless it is NULL.
+ */
+int Fetcher::FetchObject(
+  const shash::Any &id,
+  const shash::Any *expected_hash,
+  const uint64_t size,
+  const std::string &name,
+  const zlib::Algorithms compression_algorithm,
+  const CacheManager::ObjectType object_type,
+  const std::string &alt_url,
+  off_t range_offset)
 {
   int fd_return;  // Read-only file descriptor that is returned
   int retval;
@@ -145,7 +420,7 @@ int Fetcher::Fetch(
   TransactionSink sink(cache_mgr_, txn);
   tls->download_job.url = &url;
   tls->download_job.destination_sink = &sink;
-  tls->download_job.expected_hash = &id;
+  tls->download_job.expected_hash = expected_hash;
   tls->download_job.extra_info = &name;
   ClientCtx *ctx = ClientCtx::GetInstance();
   if (ctx->IsSet()) {
@@ -153,7 +428,9 @@ int Fetcher::Fetch(
              &tls->download_job.gid,
              &tls->download_job.pid);
   }
-  tls->download_job.compressed = (compression_algorithm == zlib::kZlibDefault);
+  tls->download_job.compressed =
+    (compression_algorithm != zlib::kNoCompression);
+  tls->download_job.compression_alg = compression_algorithm;
   tls->download_job.range_offset = range_offset;
   tls->download_job.range_size = size;
   download_mgr_->Fetch(&tls->download_job);
@@ -198,8 +475,13 @@ Fetcher::Fetcher(
   const std::string &name,
   bool external)
   : external_(external)
+  , block_size_(0)
   , lock_queues_download_(NULL)
   , lock_tls_blocks_(NULL)
+  , lock_sparse_objects_(NULL)
+  , cond_verify_queued_(NULL)
+  , cond_verify_done_(NULL)
+  , verify_terminate_(false)
   , cache_mgr_(cache_mgr)
   , download_mgr_(download_mgr)
   , backoff_throttle_(backoff_throttle)
@@ -215,6 +497,18 @@ Fetcher::Fetcher(
     smalloc(sizeof(pthread_mutex_t)));
   retval = pthread_mutex_init(lock_tls_blocks_, NULL);
   assert(retval == 0);
+  lock_sparse_objects_ = reinterpret_cast<pthread_mutex_t *>(
+    smalloc(sizeof(pthread_mutex_t)));
+  retval = pthread_mutex_init(lock_sparse_objects_, NULL);
+  assert(retval == 0);
+  cond_verify_queued_ = reinterpret_cast<pthread_cond_t *>(
+    smalloc(sizeof(pthread_cond_t)));
+  retval = pthread_cond_init(cond_verify_queued_, NULL);
+  assert(retval == 0);
+  cond_verify_done_ = reinterpret_cast<pthread_cond_t *>(
+    smalloc(sizeof(pthread_cond_t)));
+  retval = pthread_cond_init(cond_verify_done_, NULL);
+  assert(retval == 0);
   n_downloads = statistics->Register(name + ".n_downloads",
     "overall number of downloaded files (incl. catalogs, chunks)");
 }
@@ -223,6 +517,13 @@ Fetcher::Fetcher(
 Fetcher::~Fetcher() {
   int retval;
 
+  pthread_mutex_lock(lock_sparse_objects_);
+  verify_terminate_ = true;
+  pthread_cond_broadcast(cond_verify_queued_);
+  pthread_mutex_unlock(lock_sparse_objects_);
+  for (unsigned i = 0; i < verify_threads_.size(); ++i)
+    pthread_join(verify_threads_[i], NULL);
+
   pthread_mutex_lock(lock_tls_blocks_);
   for (unsigned i = 0; i < tls_blocks_.size(); ++i)
     CleanupTls(tls_blocks_[i]);
@@ -232,6 +533,16 @@ Fetcher::~Fetcher() {
   assert(retval == 0);
   free(lock_tls_blocks_);
 
+  retval = pthread_cond_destroy(cond_verify_done_);
+  assert(retval == 0);
+  free(cond_verify_done_);
+  retval = pthread_cond_destroy(cond_verify_queued_);
+  assert(retval == 0);
+  free(cond_verify_queued_);
+  retval = pthread_mutex_destroy(lock_sparse_objects_);
+  assert(retval == 0);
+  free(lock_sparse_objects_);
+
   retval = pthread_mutex_destroy(lock_queues_download_);
   assert(retval == 0);
   free(lock_queues_download_);
@@ -7,6 +7,7 @@
 
 #include <pthread.h>
 
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
@@ -59,11 +60,13 @@ class TransactionSink : public Sink {
  * Concurrent download requests for the same id are collapsed.
  */
 class Fetcher : SingleCopy {
+  FRIEND_TEST(T_Fetcher, ExternalFetchBlock);
   FRIEND_TEST(T_Fetcher, GetTls);
   FRIEND_TEST(T_Fetcher, SignalWaitingThreads);
   friend void *TestGetTls(void *data);
   friend void *TestFetchCollapse(void *data);
   friend void *TestFetchCollapse2(void *data);
+  friend void TestWaitVerified(Fetcher *fetcher);
   friend void TLSDestructor(void *data);
 
  public:
@@ -82,6 +85,24 @@ class Fetcher : SingleCopy {
             const CacheManager::ObjectType object_type,
             const std::string &alt_url = "",
             off_t range_offset = -1);
+  int FetchBlock(const shash::Any &id,
+                 const uint64_t size,
+                 const off_t block_offset,
+                 const std::string &name,
+                 const CacheManager::ObjectType object_type,
+                 const std::string &alt_url);
+  static shash::Any MakeBlockId(const shash::Any &id,
+                                const off_t block_offset,
+                                const uint64_t block_size);
+
+  /**
+   * In external data mode, uncompressed files larger than the block size can
+   * be read block by block with HTTP range requests (see FetchBlock()).
+   * Zero disables block-wise reading.  Must be called before the first
+   * FetchBlock(), it starts the threads that verify such files.
+   */
+  void SetBlockSize(const uint64_t block_size);
+  uint64_t block_size() const { return block_size_; }
 
   CacheManager *cache_mgr() { return cache_mgr_; }
   download::DownloadManager *download_mgr() { return download_mgr_; }
@@ -128,6 +149,62 @@ class Fetcher : SingleCopy {
    */
   typedef std::map< shash::Any, std::vector<int> * > ThreadQueues;
 
+  /**
+   * Verification state of an object read by FetchBlock().  There are no block
+   * hashes in the catalog, so the first access to the object queues a job that
+   * fetches all the blocks in the background and compares them, in order, with
+   * the content hash.  Blocks are handed out right away while the job runs.
+   * The digests of the blocks are recorded on the way, blocks that are fetched
+   * after the object is verified are checked against them by the download
+   * manager.  Objects that failed verification are verified again before any
+   * further block is handed out (retry).
+   */
+  struct SparseObject {
+    enum State {
+      kVerifying,
+      kVerified,
+      kFailed
+    };
+    SparseObject() : state(kVerifying), retry(false) { }
+    State state;
+    bool retry;
+    std::vector<shash::Any> block_hashes;
+  };
+  typedef std::map<shash::Any, SparseObject> SparseObjects;
+
+  struct VerifyJob {
+    VerifyJob(const shash::Any &i, const uint64_t s, const std::string &n,
+              const CacheManager::ObjectType t, const std::string &u)
+      : id(i), size(s), name(n), object_type(t), alt_url(u) { }
+    shash::Any id;
+    uint64_t size;
+    std::string name;
+    CacheManager::ObjectType object_type;
+    std::string alt_url;
+  };
+
+  /**
+   * Verified and failed objects whose state is kept.  Beyond that, the oldest
+   * ones are forgotten and verified again on the next access.
+   */
+  static const unsigned kMaxSparseObjects = 256;
+  static const unsigned kNumVerifyThreads = 2;
+
+  int FetchObject(const shash::Any &id,
+                  const shash::Any *expected_hash,
+                  const uint64_t size,
+                  const std::string &name,
+                  const zlib::Algorithms compression_algorithm,
+                  const CacheManager::ObjectType object_type,
+                  const std::string &alt_url,
+                  off_t range_offset);
+  SparseObject::State GetSparseState(const VerifyJob &job,
+                                     shash::Any *block_hash,
+                                     const unsigned block_idx);
+  bool VerifyBlocks(const VerifyJob &job,
+                    std::vector<shash::Any> *block_hashes);
+  void PruneSparseObjects();
+  static void *MainVerify(void *data);
   ThreadLocalStorage *GetTls();
   void CleanupTls(ThreadLocalStorage *tls);
   void SignalWaitingThreads(const int fd, const shash::Any &id,
@@ -143,6 +220,11 @@ class Fetcher : SingleCopy {
    */
   bool external_;
 
+  /**
+   * Granularity of range requests for partially read external objects.
+   */
+  uint64_t block_size_;
+
   /**
    * Key to the thread's ThreadLocalStorage memory
    */
@@ -158,6 +240,18 @@ class Fetcher : SingleCopy {
   std::vector<ThreadLocalStorage *> tls_blocks_;
   pthread_mutex_t *lock_tls_blocks_;
 
+  SparseObjects sparse_objects_;
+  /**
+   * Finished objects in sparse_objects_, oldest first
+   */
+  std::deque<shash::Any> sparse_objects_finished_;
+  std::deque<VerifyJob> verify_queue_;
+  pthread_mutex_t *lock_sparse_objects_;
+  pthread_cond_t *cond_verify_queued_;
+  pthread_cond_t *cond_verify_done_;
+  std::vector<pthread_t> verify_threads_;
+  bool verify_terminate_;
+
   CacheManager *cache_mgr_;
   download::DownloadManager *download_mgr_;
   BackoffThrottle *backoff_throttle_;
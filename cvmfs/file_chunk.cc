@@ -5,6 +5,7 @@
 #include "cvmfs_config.h"
 #include "file_chunk.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "murmur.h"
@@ -42,6 +43,40 @@ unsigned FileChunkReflist::FindChunkIdx(const uint64_t off) {
 }
 
 
+uint64_t FileChunkReflist::FileSize() const {
+  assert(list && (list->size() > 0));
+  const FileChunk *last = list->AtPtr(list->size() - 1);
+  return static_cast<uint64_t>(last->offset()) + last->size();
+}
+
+
+/**
+ * External files that are read by range requests (Fetcher::FetchBlock()) are
+ * represented by a list of fixed-size blocks that all carry the content hash
+ * of the entire file.  Regular chunks have the partial suffix in their hash.
+ * Encoding this in the list keeps the layout of the chunk tables, which are
+ * carried over on reload, unchanged.
+ */
+bool FileChunkReflist::IsBlockList() const {
+  return external_data && list && (list->size() > 0) &&
+         !list->AtPtr(0)->content_hash().HasSuffix();
+}
+
+
+void FileChunkReflist::MakeBlockList(
+  const shash::Any &content_hash,
+  const uint64_t size,
+  const uint64_t block_size,
+  FileChunkList *blocks)
+{
+  assert((block_size > 0) && !content_hash.HasSuffix());
+  for (uint64_t offset = 0; offset < size; offset += block_size) {
+    blocks->PushBack(FileChunk(content_hash, offset,
+                               std::min(block_size, size - offset)));
+  }
+}
+
+
 //------------------------------------------------------------------------------
 
 
@@ -64,6 +64,12 @@ struct FileChunkReflist {
     , external_data(external) { }
 
   unsigned FindChunkIdx(const uint64_t offset);
+  uint64_t FileSize() const;
+  bool IsBlockList() const;
+  static void MakeBlockList(const shash::Any &content_hash,
+                            const uint64_t size,
+                            const uint64_t block_size,
+                            FileChunkList *blocks);
 
   FileChunkList     *list;
   PathString         path;
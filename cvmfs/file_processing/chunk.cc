@@ -62,6 +62,8 @@ void Chunk::Initialize() {
   // has a Construct function to create the appropriate object
   // from a parameter, a zlib::Algorithms in this case
   compressor_ = zlib::Compressor::Construct(compression_algorithm_);
+  compressor_->SetLevel(file_->compression_level());
+  compressor_->SetDictionary(file_->compression_dictionary());
 
   zlib_initialized_         = true;
   content_hash_initialized_ = true;
@@ -103,7 +105,7 @@ Chunk::Chunk(const Chunk &other) :
   deferred_write_(other.deferred_write_),
   deferred_buffers_(other.deferred_buffers_),
   zlib_initialized_(false),
-  compression_algorithm_(zlib::kZlibDefault),
+  compression_algorithm_(other.compression_algorithm_),
   content_hash_context_(other.content_hash_context_),
   content_hash_(other.content_hash_),
   content_hash_initialized_(other.content_hash_initialized_),
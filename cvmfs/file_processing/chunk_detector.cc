@@ -120,4 +120,132 @@ off_t Xor32Detector::FindNextCutMark(CharBuffer *buffer) {
   }
 }
 
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * The Gear table maps every byte value to a random 64-bit number.  It is
+ * generated by the splitmix64 generator from a fixed seed.  You should never
+ * change the generator or the seed, since it affects the definition of cut
+ * marks.
+ */
+struct GearTable {
+  GearTable() {
+    uint64_t state = 0x6376666367656172ULL;
+    for (unsigned i = 0; i < 256; ++i) {
+      state += 0x9E3779B97F4A7C15ULL;
+      uint64_t z = state;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      values[i] = z ^ (z >> 31);
+    }
+  }
+  uint64_t values[256];
+};
+static const GearTable kGearTable;
+const uint64_t *GearDetector::gear_table_ = kGearTable.values;
+
+
+/**
+ * Creates a mask with the given number of bits set in the most significant
+ * bits.  The high bits of the Gear hash depend on all the bytes of the rolling
+ * window whereas the lower bits depend only on the most recent bytes.
+ */
+uint64_t GearDetector::MakeMask(const unsigned bits) {
+  assert((bits > 0) && (bits < 64));
+  return ((uint64_t(1) << bits) - 1) << (64 - bits);
+}
+
+
+static unsigned Log2(size_t value) {
+  unsigned result = 0;
+  while (value >>= 1)
+    ++result;
+  return result;
+}
+
+
+GearDetector::GearDetector(const size_t minimal_chunk_size,
+                           const size_t average_chunk_size,
+                           const size_t maximal_chunk_size) :
+  minimal_chunk_size_(minimal_chunk_size),
+  average_chunk_size_(average_chunk_size),
+  maximal_chunk_size_(maximal_chunk_size),
+  gear_ptr_(0), gear_(0),
+  mask_strict_(MakeMask(
+    std::min(Log2(average_chunk_size) + normalization_level, 63U))),
+  mask_relaxed_(MakeMask(
+    std::max(Log2(average_chunk_size), normalization_level + 1) -
+    normalization_level))
+{
+  assert(minimal_chunk_size_ > 0);
+  assert(minimal_chunk_size_ < average_chunk_size_);
+  assert(average_chunk_size_ < maximal_chunk_size_);
+}
+
+
+off_t GearDetector::FindNextCutMark(CharBuffer *buffer) {
+  assert(minimal_chunk_size_ >= gear_influence);
+  const unsigned char *data = buffer->ptr();
+  const off_t used_bytes = static_cast<off_t>(buffer->used_bytes());
+  const off_t base_offset = buffer->base_offset();
+
+  // the bytes of the minimal chunk region are skipped apart from the last
+  // 64 bytes, which fill the rolling hash window
+  const off_t global_offset =
+    std::max(last_cut() +
+             static_cast<off_t>(minimal_chunk_size_ - gear_influence),
+             gear_ptr_);
+  if (global_offset >= base_offset + used_bytes) {
+    return NoCut(global_offset);
+  }
+
+  off_t internal_offset = global_offset - base_offset;
+  assert(internal_offset >= 0);
+
+  // keep the rolling hash in a register for the inner loops
+  uint64_t hash = gear_;
+
+  // fill the rolling hash window without looking for cut marks
+  const off_t internal_precompute_end =
+    std::min(last_cut() + static_cast<off_t>(minimal_chunk_size_) -
+             base_offset, used_bytes);
+  for (; internal_offset < internal_precompute_end; ++internal_offset) {
+    hash = (hash << 1) + gear_table_[data[internal_offset]];
+  }
+
+  // below the average chunk size, cut marks must match the strict mask
+  const off_t internal_average_end =
+    std::min(last_cut() + static_cast<off_t>(average_chunk_size_) -
+             base_offset, used_bytes);
+  for (; internal_offset < internal_average_end; ++internal_offset) {
+    hash = (hash << 1) + gear_table_[data[internal_offset]];
+    if ((hash & mask_strict_) == 0) {
+      return DoCut(internal_offset + base_offset);
+    }
+  }
+
+  // above the average chunk size, the relaxed mask makes cut marks more likely
+  const off_t internal_max_chunk_size_end =
+    last_cut() + static_cast<off_t>(maximal_chunk_size_) - base_offset;
+  const off_t internal_compute_end =
+    std::min(internal_max_chunk_size_end, used_bytes);
+  for (; internal_offset < internal_compute_end; ++internal_offset) {
+    hash = (hash << 1) + gear_table_[data[internal_offset]];
+    if ((hash & mask_relaxed_) == 0) {
+      return DoCut(internal_offset + base_offset);
+    }
+  }
+
+  // hard cut when reaching the maximal chunk size, otherwise continue with
+  // the next buffer
+  gear_ = hash;
+  if (internal_offset == internal_max_chunk_size_end) {
+    return DoCut(internal_offset + base_offset);
+  } else {
+    return NoCut(internal_offset + base_offset);
+  }
+}
+
 }  // namespace upload
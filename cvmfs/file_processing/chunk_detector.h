@@ -6,6 +6,7 @@
 #define CVMFS_FILE_PROCESSING_CHUNK_DETECTOR_H_
 
 #include <gtest/gtest_prod.h>
+#include <inttypes.h>
 #include <sys/types.h>
 
 #include <algorithm>
@@ -140,6 +141,76 @@ class Xor32Detector : public ChunkDetector {
   const int32_t threshold_;
 };
 
+/**
+ * The GearDetector implements the content-defined chunking algorithm FastCDC
+ * by Xia et al. [1].  It is based on the Gear rolling hash that needs only a
+ * shift, an addition and a table lookup per byte.  The 64-bit Gear hash only
+ * depends on the last 64 bytes of the data stream.
+ *
+ * Compared to the Xor32Detector, the GearDetector
+ *   - skips hashing the minimal chunk region (apart from the 64 bytes that
+ *     are needed to fill the rolling hash window)
+ *   - uses normalized chunking: before the average chunk size is reached, a
+ *     cut mark has to match a stricter mask than afterwards.  This narrows the
+ *     chunk size distribution around the average chunk size, which allows for
+ *     a smaller minimal chunk size and thus better deduplication.
+ *
+ * [1]     "FastCDC: a Fast and Efficient Content-Defined Chunking Approach
+ *          for Data Deduplication", USENIX ATC 2016
+ */
+class GearDetector : public ChunkDetector {
+  FRIEND_TEST(T_ChunkDetectors, Gear);
+
+ protected:
+  // the gear hash only depends on a window of the last 64 bytes
+  static const size_t gear_influence = 64;
+  // the strict mask has two bits more than log2(average chunk size), the
+  // relaxed mask two bits less
+  static const unsigned normalization_level = 2;
+
+ public:
+  GearDetector(const size_t minimal_chunk_size,
+               const size_t average_chunk_size,
+               const size_t maximal_chunk_size);
+
+  bool MightFindChunks(const size_t size) const {
+    return size > minimal_chunk_size_;
+  }
+
+  off_t FindNextCutMark(CharBuffer *buffer);
+
+ protected:
+  virtual off_t DoCut(const off_t offset) {
+    gear_     = 0;
+    gear_ptr_ = offset;
+    return ChunkDetector::DoCut(offset);
+  }
+
+  virtual off_t NoCut(const off_t offset) {
+    gear_ptr_ = offset;
+    return ChunkDetector::NoCut(offset);
+  }
+
+  inline void gear(const unsigned char byte) {
+    gear_ = (gear_ << 1) + gear_table_[byte];
+  }
+
+  static uint64_t MakeMask(const unsigned bits);
+
+ private:
+  const size_t minimal_chunk_size_;
+  const size_t average_chunk_size_;
+  const size_t maximal_chunk_size_;
+
+  off_t    gear_ptr_;
+  uint64_t gear_;
+
+  const uint64_t mask_strict_;
+  const uint64_t mask_relaxed_;
+
+  static const uint64_t *gear_table_;
+};
+
 }  // namespace upload
 
 #endif  // CVMFS_FILE_PROCESSING_CHUNK_DETECTOR_H_
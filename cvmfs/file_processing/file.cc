@@ -16,13 +16,17 @@ File::File(const std::string    &path,
            ChunkDetector        *chunk_detector,
            shash::Algorithms     hash_algorithm,
            zlib::Algorithms      compression_alg,
-           const shash::Suffix   hash_suffix) :
+           const shash::Suffix   hash_suffix,
+           const int             compression_level,
+           const zlib::Dictionary *compression_dictionary) :
   AbstractFile(path, GetFileSize(path)),
   might_become_chunked_(chunk_detector != NULL &&
                         chunk_detector->MightFindChunks(size())),
   hash_algorithm_(hash_algorithm),
   hash_suffix_(hash_suffix),
   compression_alg_(compression_alg),
+  compression_level_(compression_level),
+  compression_dictionary_(compression_dictionary),
   bulk_chunk_(NULL),
   io_dispatcher_(io_dispatcher),
   chunk_detector_(chunk_detector)
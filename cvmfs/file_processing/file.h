@@ -36,7 +36,9 @@ class File : public AbstractFile {
        ChunkDetector        *chunk_detector,
        shash::Algorithms     hash_algorithm,
        zlib::Algorithms      compression_alg,
-       const shash::Suffix   hash_suffix = shash::kSuffixNone);
+       const shash::Suffix   hash_suffix = shash::kSuffixNone,
+       const int             compression_level = 0,
+       const zlib::Dictionary *compression_dictionary = NULL);
   ~File();
 
   bool MightBecomeChunked() const { return might_become_chunked_; }
@@ -75,6 +77,10 @@ class File : public AbstractFile {
   const Chunk*        bulk_chunk()  const { return bulk_chunk_;  }
   const ChunkVector&  chunks()      const { return chunks_;      }
         shash::Suffix hash_suffix() const { return hash_suffix_; }
+        int compression_level()     const { return compression_level_; }
+  const zlib::Dictionary *compression_dictionary() const {
+    return compression_dictionary_;
+  }
 
   Chunk* current_chunk() {
     return (chunks_.size() > 0) ? chunks_.back() : NULL;
@@ -106,6 +112,8 @@ class File : public AbstractFile {
    * Compression algorithm for the chunks
    */
   const zlib::Algorithms compression_alg_;
+  const int compression_level_;
+  const zlib::Dictionary *compression_dictionary_;
 
   ChunkVector chunks_;  ///< List of generated Chunks
   Chunk *bulk_chunk_;  ///< Associated bulk Chunk
@@ -22,11 +22,14 @@ FileProcessor::FileProcessor(AbstractUploader         *uploader,
                                   this,
                                   spooler_definition.number_of_threads)),
   compression_alg_(spooler_definition.compression_alg),
+  compression_level_(spooler_definition.compression_level),
+  compression_dictionary_(spooler_definition.compression_dictionary),
   hash_algorithm_(spooler_definition.hash_algorithm),
   chunking_enabled_(spooler_definition.use_file_chunking),
   minimal_chunk_size_(spooler_definition.min_file_chunk_size),
   average_chunk_size_(spooler_definition.avg_file_chunk_size),
-  maximal_chunk_size_(spooler_definition.max_file_chunk_size)
+  maximal_chunk_size_(spooler_definition.max_file_chunk_size),
+  chunking_algorithm_(spooler_definition.chunking_algorithm)
 {
   assert(io_dispatcher_ != NULL);
   assert(!chunking_enabled_ || minimal_chunk_size_ > 0);
@@ -46,17 +49,29 @@ FileProcessor::~FileProcessor() {
 void FileProcessor::Process(const std::string   &local_path,
                             const bool           allow_chunking,
                             const shash::Suffix  hash_suffix) {
-  ChunkDetector *chunk_detector = (chunking_enabled_ && allow_chunking)
-                                        ? new Xor32Detector(minimal_chunk_size_,
-                                                            average_chunk_size_,
-                                                            maximal_chunk_size_)
-                                        : NULL;
+  ChunkDetector *chunk_detector = NULL;
+  if (chunking_enabled_ && allow_chunking) {
+    switch (chunking_algorithm_) {
+      case SpoolerDefinition::Gear:
+        chunk_detector = new GearDetector(minimal_chunk_size_,
+                                          average_chunk_size_,
+                                          maximal_chunk_size_);
+        break;
+      case SpoolerDefinition::Xor32:
+        chunk_detector = new Xor32Detector(minimal_chunk_size_,
+                                           average_chunk_size_,
+                                           maximal_chunk_size_);
+        break;
+    }
+  }
   File *file = new File(local_path,
                         io_dispatcher_,
                         chunk_detector,
                         hash_algorithm_,
                         compression_alg_,
-                        hash_suffix);
+                        hash_suffix,
+                        compression_level_,
+                        compression_dictionary_);
 
   LogCvmfs(kLogSpooler, kLogVerboseMsg, "Scheduling '%s' for processing ("
                                         "chunking: %s, hash_suffix: %c)",
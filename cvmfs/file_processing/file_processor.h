@@ -8,6 +8,7 @@
 #include <string>
 
 #include "hash.h"
+#include "upload_spooler_definition.h"
 #include "upload_spooler_result.h"
 #include "util_concurrency.h"
 
@@ -62,7 +63,6 @@ namespace upload {
 class AbstractUploader;
 class IoDispatcher;
 class File;
-struct SpoolerDefinition;
 
 /**
  * This is the outer most wrapper class that should be used by the Spooler.
@@ -91,11 +91,14 @@ class FileProcessor : public Observable<SpoolerResult> {
   IoDispatcher  *io_dispatcher_;
 
   zlib::Algorithms   compression_alg_;
+  const int          compression_level_;
+  const zlib::Dictionary *compression_dictionary_;
   shash::Algorithms  hash_algorithm_;
   const bool         chunking_enabled_;
   const size_t       minimal_chunk_size_;
   const size_t       average_chunk_size_;
   const size_t       maximal_chunk_size_;
+  const SpoolerDefinition::ChunkingAlgorithm chunking_algorithm_;
 };
 
 }  // namespace upload
@@ -9,13 +9,17 @@
 #define CVMFS_FS_TRAVERSAL_H_
 
 #include <errno.h>
+#include <pthread.h>
 
 #include <cassert>
 #include <cstdlib>
 
+#include <map>
 #include <set>
 #include <string>
+#include <vector>
 
+#include "gtest/gtest_prod.h"
 #include "logging.h"
 #include "platform.h"
 #include "util/async.h"
@@ -99,11 +103,24 @@ class FileSystemTraversal {
     fn_new_dir_postfix(NULL),
     delegate_(delegate),
     relative_to_directory_(relative_to_directory),
-    recurse_(recurse)
+    recurse_(recurse),
+    num_threads_(1)
   {
     Init();
   }
 
+  /**
+   * With more than one thread, directories are read and their entries are
+   * lstat'ed by a pool of threads ahead of the traversal.  The callbacks are
+   * still called from the thread that runs Recurse() and in the same order as
+   * in the serial traversal.  Only suitable for traversals that do not modify
+   * the traversed directory tree.
+   */
+  void SetNumThreads(const unsigned num_threads) {
+    assert(num_threads > 0);
+    num_threads_ = num_threads;
+  }
+
   /**
    * Start the recursion.
    * @param dir_path The directory to start the recursion at
@@ -123,23 +140,262 @@ class FileSystemTraversal {
            dir_path.substr(0, relative_to_directory_.length()) ==
              relative_to_directory_);
 
-    DoRecursion(dir_path, "");
+    if (num_threads_ > 1) {
+      Prefetcher prefetcher(num_threads_);
+      DoRecursion(dir_path, "", &prefetcher);
+    } else {
+      DoRecursion(dir_path, "", NULL);
+    }
   }
 
  private:
+  FRIEND_TEST(T_FsTraversal, PrefetcherDiscard);
+
+  /**
+   * The result of reading a directory and lstat'ing its entries.  For failed
+   * lstat calls, the mode is zero and the errno is kept.
+   */
+  struct Listing {
+    struct Entry {
+      Entry(const std::string &n, const mode_t m, const int e) :
+        name(n), mode(m), lstat_errno(e) {}
+      std::string name;
+      mode_t mode;
+      int lstat_errno;
+    };
+
+    enum State {
+      kQueued,
+      kScanning,
+      kDone
+    };
+
+    explicit Listing(const std::string &p) :
+      path(p), state(kQueued), discarded(false), opendir_errno(0) {}
+
+    /**
+     * Reads the directory.  Returns the subdirectories to prefetch.
+     */
+    void Scan(std::vector<std::string> *subdirs) {
+      DIR *dip = opendir(path.c_str());
+      if (!dip) {
+        opendir_errno = errno;
+        return;
+      }
+      platform_dirent64 *dit;
+      while ((dit = platform_readdir(dip)) != NULL) {
+        const std::string name(dit->d_name);
+        if (name == "." || name == "..")
+          continue;
+        platform_stat64 info;
+        const int retval = platform_lstat((path + "/" + name).c_str(), &info);
+        if (retval != 0) {
+          entries.push_back(Entry(name, 0, errno));
+          continue;
+        }
+        entries.push_back(Entry(name, info.st_mode, 0));
+        if (S_ISDIR(info.st_mode))
+          subdirs->push_back(path + "/" + name);
+      }
+      closedir(dip);
+    }
+
+    std::string path;
+    State state;
+    bool discarded;  ///< set if the scanning thread should throw it away
+    int opendir_errno;
+    std::vector<Entry> entries;
+  };
+
+  /**
+   * Reads directories ahead of the traversal with a pool of threads.  Whoever
+   * scans a directory (a pool thread or the traversal thread) queues its
+   * subdirectories.  The queue is a stack, so that the pool threads roughly
+   * follow the depth-first order of the traversal.  If the traversal needs a
+   * directory that is still queued, it takes it off the queue and scans it
+   * itself.
+   */
+  class Prefetcher {
+   public:
+    // Bounds the memory used by listings that are read ahead
+    static const unsigned kMaxListings = 1024;
+
+    explicit Prefetcher(const unsigned num_threads) : terminate_(false) {
+      int retval = pthread_mutex_init(&lock_, NULL);
+      assert(retval == 0);
+      retval = pthread_cond_init(&cond_queued_, NULL);
+      assert(retval == 0);
+      retval = pthread_cond_init(&cond_scanned_, NULL);
+      assert(retval == 0);
+      threads_.resize(num_threads);
+      for (unsigned i = 0; i < num_threads; ++i) {
+        retval = pthread_create(&threads_[i], NULL, MainScan, this);
+        assert(retval == 0);
+      }
+    }
+
+    ~Prefetcher() {
+      pthread_mutex_lock(&lock_);
+      terminate_ = true;
+      pthread_cond_broadcast(&cond_queued_);
+      pthread_mutex_unlock(&lock_);
+      for (unsigned i = 0; i < threads_.size(); ++i)
+        pthread_join(threads_[i], NULL);
+      typename std::map<std::string, Listing *>::iterator i =
+        listings_.begin();
+      for (; i != listings_.end(); ++i)
+        delete i->second;
+      pthread_cond_destroy(&cond_scanned_);
+      pthread_cond_destroy(&cond_queued_);
+      pthread_mutex_destroy(&lock_);
+    }
+
+    /**
+     * Returns the listing of the given directory, which is owned by the
+     * caller from then on.
+     */
+    Listing *Get(const std::string &path) {
+      pthread_mutex_lock(&lock_);
+      typename std::map<std::string, Listing *>::iterator i =
+        listings_.find(path);
+      if (i != listings_.end()) {
+        Listing *listing = i->second;
+        while (listing->state == Listing::kScanning)
+          pthread_cond_wait(&cond_scanned_, &lock_);
+        listings_.erase(i);
+        if (listing->state == Listing::kDone) {
+          pthread_mutex_unlock(&lock_);
+          return listing;
+        }
+        // Still queued, the stale queue entry is skipped by the pool threads
+        delete listing;
+      }
+      pthread_mutex_unlock(&lock_);
+
+      Listing *listing = new Listing(path);
+      std::vector<std::string> subdirs;
+      listing->Scan(&subdirs);
+      listing->state = Listing::kDone;
+      pthread_mutex_lock(&lock_);
+      Enqueue(subdirs);
+      pthread_mutex_unlock(&lock_);
+      return listing;
+    }
+
+    /**
+     * Drops the listings of a directory the traversal does not descend into
+     * together with the listings of its subdirectories.
+     */
+    void Discard(const std::string &path) {
+      pthread_mutex_lock(&lock_);
+      typename std::map<std::string, Listing *>::iterator i =
+        listings_.find(path);
+      if (i != listings_.end())
+        Drop(i++);
+      // Siblings such as path-foo sort between path and path/..., so the
+      // subdirectories are searched from path/ on
+      const std::string prefix = path + "/";
+      i = listings_.lower_bound(prefix);
+      while ((i != listings_.end()) &&
+             (i->first.compare(0, prefix.length(), prefix) == 0))
+      {
+        Drop(i++);
+      }
+      pthread_mutex_unlock(&lock_);
+    }
+
+   private:
+    FRIEND_TEST(T_FsTraversal, PrefetcherDiscard);
+
+    /**
+     * Called with the lock held.  A listing that is being scanned is deleted
+     * by the scanning thread.
+     */
+    void Drop(typename std::map<std::string, Listing *>::iterator i) {
+      if (i->second->state == Listing::kScanning)
+        i->second->discarded = true;
+      else
+        delete i->second;
+      listings_.erase(i);
+    }
+
+    /**
+     * Called with the lock held
+     */
+    void Enqueue(const std::vector<std::string> &subdirs) {
+      // Reverse order, such that the first subdirectory is on top of the stack
+      for (unsigned i = subdirs.size(); i > 0; --i) {
+        if (listings_.size() >= kMaxListings)
+          return;
+        if (listings_.find(subdirs[i - 1]) != listings_.end())
+          continue;
+        listings_[subdirs[i - 1]] = new Listing(subdirs[i - 1]);
+        queue_.push_back(subdirs[i - 1]);
+        pthread_cond_signal(&cond_queued_);
+      }
+    }
+
+    static void *MainScan(void *data) {
+      Prefetcher *prefetcher = reinterpret_cast<Prefetcher *>(data);
+      pthread_mutex_lock(&prefetcher->lock_);
+      while (true) {
+        while (!prefetcher->terminate_ && prefetcher->queue_.empty())
+          pthread_cond_wait(&prefetcher->cond_queued_, &prefetcher->lock_);
+        if (prefetcher->terminate_)
+          break;
+
+        const std::string path = prefetcher->queue_.back();
+        prefetcher->queue_.pop_back();
+        typename std::map<std::string, Listing *>::iterator i =
+          prefetcher->listings_.find(path);
+        if ((i == prefetcher->listings_.end()) ||
+            (i->second->state != Listing::kQueued))
+        {
+          continue;
+        }
+        Listing *listing = i->second;
+        listing->state = Listing::kScanning;
+        pthread_mutex_unlock(&prefetcher->lock_);
+
+        std::vector<std::string> subdirs;
+        listing->Scan(&subdirs);
+
+        pthread_mutex_lock(&prefetcher->lock_);
+        if (listing->discarded) {
+          delete listing;
+          continue;
+        }
+        listing->state = Listing::kDone;
+        pthread_cond_broadcast(&prefetcher->cond_scanned_);
+        prefetcher->Enqueue(subdirs);
+      }
+      pthread_mutex_unlock(&prefetcher->lock_);
+      return NULL;
+    }
+
+    pthread_mutex_t lock_;
+    pthread_cond_t cond_queued_;
+    pthread_cond_t cond_scanned_;
+    bool terminate_;
+    std::vector<pthread_t> threads_;
+    std::map<std::string, Listing *> listings_;
+    std::vector<std::string> queue_;
+  };
+
   // The delegate all hooks are called on
   T *delegate_;
 
   /** dir_path in callbacks will be relative to this directory */
   std::string relative_to_directory_;
   bool recurse_;
+  unsigned num_threads_;
 
 
   void Init() {
   }
 
-  void DoRecursion(const std::string &parent_path, const std::string &dir_name)
-    const
+  void DoRecursion(const std::string &parent_path, const std::string &dir_name,
+                   Prefetcher *prefetcher) const
   {
     DIR *dip;
     platform_dirent64 *dit;
@@ -149,6 +405,10 @@ class FileSystemTraversal {
     // Change into directory and notify the user
     LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "entering %s (%s -- %s)",
              path.c_str(), parent_path.c_str(), dir_name.c_str());
+    if (prefetcher != NULL) {
+      DoPrefetchedRecursion(parent_path, dir_name, path, prefetcher);
+      return;
+    }
     dip = opendir(path.c_str());
     if (!dip) {
       LogCvmfs(kLogFsTraversal, kLogStderr, "Failed to open %s (%d).\n"
@@ -183,42 +443,7 @@ class FileSystemTraversal {
                  (path + "/" + dit->d_name).c_str(), errno);
         abort();
       }
-      if (S_ISDIR(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing directory %s/%s",
-                 path.c_str(), dit->d_name);
-        if (Notify(fn_new_dir_prefix, path, dit->d_name) && recurse_) {
-          DoRecursion(path, dit->d_name);
-        }
-        Notify(fn_new_dir_postfix, path, dit->d_name);
-      } else if (S_ISREG(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing regular file %s/%s",
-                 path.c_str(), dit->d_name);
-        Notify(fn_new_file, path, dit->d_name);
-      } else if (S_ISLNK(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing symlink %s/%s",
-                 path.c_str(), dit->d_name);
-        Notify(fn_new_symlink, path, dit->d_name);
-      } else if (S_ISSOCK(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing socket %s/%s",
-                 path.c_str(), dit->d_name);
-        Notify(fn_new_socket, path, dit->d_name);
-      } else if (S_ISBLK(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing block-device %s/%s",
-                 path.c_str(), dit->d_name);
-        Notify(fn_new_block_dev, path, dit->d_name);
-      } else if (S_ISCHR(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing character-device "
-                                                  "%s/%s",
-                 path.c_str(), dit->d_name);
-        Notify(fn_new_character_dev, path, dit->d_name);
-      } else if (S_ISFIFO(info.st_mode)) {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing FIFO %s/%s",
-                 path.c_str(), dit->d_name);
-        Notify(fn_new_fifo, path, dit->d_name);
-      } else {
-        LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "unknown file type %s/%s",
-                 path.c_str(), dit->d_name);
-      }
+      ProcessEntry(path, dit->d_name, info.st_mode, NULL);
     }
 
     // Close directory and notify user
@@ -227,6 +452,90 @@ class FileSystemTraversal {
     Notify(fn_leave_dir, parent_path, dir_name);
   }
 
+  void DoPrefetchedRecursion(const std::string &parent_path,
+                             const std::string &dir_name,
+                             const std::string &path,
+                             Prefetcher *prefetcher) const
+  {
+    Listing *listing = prefetcher->Get(path);
+    if (listing->opendir_errno != 0) {
+      LogCvmfs(kLogFsTraversal, kLogStderr, "Failed to open %s (%d).\n"
+               "Please check directory permissions.",
+               path.c_str(), listing->opendir_errno);
+      abort();
+    }
+    Notify(fn_enter_dir, parent_path, dir_name);
+
+    for (unsigned i = 0; i < listing->entries.size(); ++i) {
+      const typename Listing::Entry &entry = listing->entries[i];
+      if (fn_ignore_file != NULL) {
+        if (Notify(fn_ignore_file, path, entry.name)) {
+          LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "ignoring %s/%s",
+                   path.c_str(), entry.name.c_str());
+          if (S_ISDIR(entry.mode))
+            prefetcher->Discard(path + "/" + entry.name);
+          continue;
+        }
+      }
+      if (entry.lstat_errno != 0) {
+        LogCvmfs(kLogFsTraversal, kLogStderr, "failed to lstat '%s' errno: %d",
+                 (path + "/" + entry.name).c_str(), entry.lstat_errno);
+        abort();
+      }
+      ProcessEntry(path, entry.name, entry.mode, prefetcher);
+    }
+
+    delete listing;
+    LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "leaving %s", path.c_str());
+    Notify(fn_leave_dir, parent_path, dir_name);
+  }
+
+  /**
+   * Notifies the user about a directory entry and recurses into directories
+   */
+  void ProcessEntry(const std::string &path, const std::string &name,
+                    const mode_t mode, Prefetcher *prefetcher) const
+  {
+    if (S_ISDIR(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing directory %s/%s",
+               path.c_str(), name.c_str());
+      if (Notify(fn_new_dir_prefix, path, name) && recurse_) {
+        DoRecursion(path, name, prefetcher);
+      } else if (prefetcher != NULL) {
+        prefetcher->Discard(path + "/" + name);
+      }
+      Notify(fn_new_dir_postfix, path, name);
+    } else if (S_ISREG(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing regular file %s/%s",
+               path.c_str(), name.c_str());
+      Notify(fn_new_file, path, name);
+    } else if (S_ISLNK(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing symlink %s/%s",
+               path.c_str(), name.c_str());
+      Notify(fn_new_symlink, path, name);
+    } else if (S_ISSOCK(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing socket %s/%s",
+               path.c_str(), name.c_str());
+      Notify(fn_new_socket, path, name);
+    } else if (S_ISBLK(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing block-device %s/%s",
+               path.c_str(), name.c_str());
+      Notify(fn_new_block_dev, path, name);
+    } else if (S_ISCHR(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing character-device "
+                                                "%s/%s",
+               path.c_str(), name.c_str());
+      Notify(fn_new_character_dev, path, name);
+    } else if (S_ISFIFO(mode)) {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "passing FIFO %s/%s",
+               path.c_str(), name.c_str());
+      Notify(fn_new_fifo, path, name);
+    } else {
+      LogCvmfs(kLogFsTraversal, kLogVerboseMsg, "unknown file type %s/%s",
+               path.c_str(), name.c_str());
+    }
+  }
+
   inline bool Notify(const BoolCallback callback,
                      const std::string &parent_path,
                      const std::string &entry_name) const
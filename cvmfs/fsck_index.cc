@@ -0,0 +1,197 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#define __STDC_FORMAT_MACROS
+
+#include "cvmfs_config.h"
+#include "fsck_index.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "logging.h"
+#include "smalloc.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+
+FsckIndex::FsckIndex(const string &path) : path_(path) {
+  lock_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  int retval = pthread_mutex_init(lock_, NULL);
+  assert(retval == 0);
+}
+
+
+FsckIndex::~FsckIndex() {
+  pthread_mutex_destroy(lock_);
+  free(lock_);
+}
+
+
+FsckIndex *FsckIndex::Open(const string &path) {
+  FsckIndex *index = new FsckIndex(path);
+  if (!index->Load()) {
+    delete index;
+    return NULL;
+  }
+  return index;
+}
+
+
+bool FsckIndex::Load() {
+  FILE *f = fopen(path_.c_str(), "r");
+  if (f == NULL) {
+    if (errno == ENOENT)
+      return true;
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to open index %s (%d)",
+             path_.c_str(), errno);
+    return false;
+  }
+
+  string line;
+  while (GetLineFile(f, &line)) {
+    const vector<string> fields = SplitString(line, ' ');
+    if (fields.size() != 5)
+      continue;
+    Record record;
+    record.hash = shash::MkFromSuffixedHexPtr(shash::HexPtr(fields[0]));
+    // Discards garbled lines
+    if (record.hash.IsNull() || (record.hash.ToString(true) != fields[0]) ||
+        !String2Uint64Parse(fields[1], &record.inode) ||
+        !String2Uint64Parse(fields[2], &record.size) ||
+        !String2Uint64Parse(fields[3], &record.mtime) ||
+        !String2Uint64Parse(fields[4], &record.timestamp))
+    {
+      continue;
+    }
+    previous_.push_back(record);
+  }
+  fclose(f);
+
+  sort(previous_.begin(), previous_.end());
+  return true;
+}
+
+
+uint64_t FsckIndex::GetVerificationTime(
+  const shash::Any &hash,
+  const platform_stat64 &info) const
+{
+  Record key;
+  key.hash = hash;
+  vector<Record>::const_iterator i =
+    lower_bound(previous_.begin(), previous_.end(), key);
+  if ((i == previous_.end()) || (i->hash != hash))
+    return 0;
+  if ((i->inode != static_cast<uint64_t>(info.st_ino)) ||
+      (i->size != static_cast<uint64_t>(info.st_size)) ||
+      (i->mtime != static_cast<uint64_t>(info.st_mtime)))
+  {
+    return 0;
+  }
+  return i->timestamp;
+}
+
+
+void FsckIndex::MarkVerified(
+  const shash::Any &hash,
+  const platform_stat64 &info,
+  const uint64_t timestamp)
+{
+  Record record;
+  record.hash = hash;
+  record.inode = info.st_ino;
+  record.size = info.st_size;
+  record.mtime = info.st_mtime;
+  record.timestamp = timestamp;
+
+  pthread_mutex_lock(lock_);
+  recorded_.push_back(record);
+  pthread_mutex_unlock(lock_);
+}
+
+
+unsigned FsckIndex::GetNumRecorded() const {
+  pthread_mutex_lock(lock_);
+  const unsigned result = recorded_.size();
+  pthread_mutex_unlock(lock_);
+  return result;
+}
+
+
+bool FsckIndex::Checkpoint() {
+  pthread_mutex_lock(lock_);
+  vector<Record> recorded(recorded_);
+  pthread_mutex_unlock(lock_);
+  sort(recorded.begin(), recorded.end());
+
+  // Merge-join, records of this run take precedence
+  vector<Record> merged;
+  merged.reserve(max(previous_.size(), recorded.size()));
+  vector<Record>::const_iterator i = previous_.begin();
+  vector<Record>::const_iterator j = recorded.begin();
+  while ((i != previous_.end()) || (j != recorded.end())) {
+    if ((j == recorded.end()) || ((i != previous_.end()) && (*i < *j))) {
+      merged.push_back(*i);
+      ++i;
+      continue;
+    }
+    if ((i != previous_.end()) && (i->hash == j->hash))
+      ++i;
+    merged.push_back(*j);
+    ++j;
+  }
+  return Write(merged);
+}
+
+
+bool FsckIndex::Commit() {
+  pthread_mutex_lock(lock_);
+  vector<Record> recorded(recorded_);
+  pthread_mutex_unlock(lock_);
+  sort(recorded.begin(), recorded.end());
+  return Write(recorded);
+}
+
+
+bool FsckIndex::Write(const vector<Record> &records) const {
+  const string tmp_path = path_ + ".tmp";
+  FILE *f = fopen(tmp_path.c_str(), "w");
+  if (f == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to write index %s (%d)",
+             tmp_path.c_str(), errno);
+    return false;
+  }
+  for (unsigned i = 0; i < records.size(); ++i) {
+    const int retval = fprintf(f, "%s %" PRIu64 " %" PRIu64 " %" PRIu64
+                               " %" PRIu64 "\n",
+                               records[i].hash.ToString(true).c_str(),
+                               records[i].inode, records[i].size,
+                               records[i].mtime, records[i].timestamp);
+    if (retval < 0) {
+      fclose(f);
+      unlink(tmp_path.c_str());
+      return false;
+    }
+  }
+  if (fclose(f) != 0) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to replace index %s (%d)",
+             path_.c_str(), errno);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,93 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_FSCK_INDEX_H_
+#define CVMFS_FSCK_INDEX_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "hash.h"
+#include "platform.h"
+#include "util/single_copy.h"
+
+/**
+ * Remembers which objects of a cache directory were verified by cvmfs_fsck,
+ * and when, so that an incremental run only rehashes new and changed objects.
+ * An object counts as unchanged if its inode, size, and mtime match the
+ * record.  Objects enter the cache through a temporary file that is renamed
+ * into place, so a replaced object has a new inode.
+ *
+ * The index is a text file with one "<hash> <inode> <size> <mtime> <time>"
+ * line per object, sorted by hash.  It is rewritten through a temporary file
+ * and rename(), so an interrupted run leaves the last checkpoint intact.
+ * Lookups do not lock; MarkVerified() is thread-safe.
+ */
+class FsckIndex : SingleCopy {
+ public:
+  /**
+   * Loads an existing index file.  A missing file yields an empty index.
+   * Returns NULL if the file cannot be read.
+   */
+  static FsckIndex *Open(const std::string &path);
+  ~FsckIndex();
+
+  /**
+   * Returns the time of the last verification of the object, or 0 if the
+   * object is not in the index or changed since.
+   */
+  uint64_t GetVerificationTime(const shash::Any &hash,
+                               const platform_stat64 &info) const;
+  /**
+   * Records an object for the new index.  Objects skipped because of a valid
+   * record should be recorded with the time of their last verification.
+   */
+  void MarkVerified(const shash::Any &hash,
+                    const platform_stat64 &info,
+                    const uint64_t timestamp);
+
+  /**
+   * Writes the objects recorded so far together with the records of the
+   * previous index that were not yet revisited.
+   */
+  bool Checkpoint();
+  /**
+   * Writes only the objects recorded in this run and thereby forgets objects
+   * that disappeared from the cache.  Only valid after a complete pass.
+   */
+  bool Commit();
+
+  unsigned GetNumPrevious() const { return previous_.size(); }
+  unsigned GetNumRecorded() const;
+  std::string path() const { return path_; }
+
+ private:
+  struct Record {
+    Record() : inode(0), size(0), mtime(0), timestamp(0) { }
+    bool operator <(const Record &other) const { return hash < other.hash; }
+
+    shash::Any hash;
+    uint64_t   inode;
+    uint64_t   size;
+    uint64_t   mtime;
+    uint64_t   timestamp;
+  };
+
+  explicit FsckIndex(const std::string &path);
+  bool Load();
+  bool Write(const std::vector<Record> &records) const;
+
+  std::string path_;
+  /**
+   * Sorted by hash, not modified after loading
+   */
+  std::vector<Record> previous_;
+  std::vector<Record> recorded_;
+  pthread_mutex_t *lock_;
+};
+
+#endif  // CVMFS_FSCK_INDEX_H_
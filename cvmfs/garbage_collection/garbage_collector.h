@@ -23,6 +23,10 @@
  *               The initialized HashFilterT is presented with all content
  *               hashes found in condemned catalogs and decides if they are
  *               referenced by the preserved catalog revisions or not.
+ *               Condemned objects are removed in batches through the uploader
+ *               while the traversal continues.  A condemned revision is
+ *               dropped from the reflog only once all of its objects are
+ *               removed, so that a failed sweep is repeated by the next run.
  *
  * The GarbageCollector is templated with CatalogTraversalT mainly for
  * testability and with HashFilterT as an instance of the Strategy Pattern to
@@ -36,6 +40,8 @@
 
 #include <vector>
 
+#include "atomic.h"
+#include "bloom_filter.h"
 #include "catalog_traversal.h"
 #include "garbage_collection/hash_filter.h"
 #include "upload_facility.h"
@@ -66,7 +72,9 @@ class GarbageCollector {
       , keep_history_timestamp(kNoTimestamp)
       , dry_run(false)
       , verbose(false)
-      , deleted_objects_logfile(NULL) {}
+      , deleted_objects_logfile(NULL)
+      , existence_filter(NULL)
+      , num_threads(0) {}
 
     bool has_deletion_log() const { return deleted_objects_logfile != NULL; }
 
@@ -78,6 +86,15 @@ class GarbageCollector {
     bool                       dry_run;
     bool                       verbose;
     FILE                      *deleted_objects_logfile;
+    /**
+     * If set, receives the hashes of all preserved objects, i.e. the objects
+     * that remain in the backend storage (see upload::AbstractUploader)
+     */
+    BloomFilter               *existence_filter;
+    /**
+     * Number of threads that download catalogs ahead of the traversal
+     */
+    unsigned int               num_threads;
   };
 
  public:
@@ -90,6 +107,7 @@ class GarbageCollector {
   unsigned int condemned_catalog_count() const { return condemned_catalogs_; }
   unsigned int condemned_objects_count() const { return condemned_objects_;  }
   uint64_t oldest_trunk_catalog() const { return oldest_trunk_catalog_; }
+  HashFilterT *hash_filter() { return &hash_filter_; }
 
  protected:
   TraversalParameters GetTraversalParams(const Configuration &configuration);
@@ -103,6 +121,9 @@ class GarbageCollector {
 
   void CheckAndSweep(const shash::Any &hash);
   void Sweep(const shash::Any &hash);
+  void FlushDeletions();
+  bool WaitForDeletions();
+  void OnObjectsRemoved(const upload::UploaderResults &results);
   bool RemoveCatalogFromReflog(const shash::Any &catalog);
 
   void PrintCatalogTreeEntry(const unsigned int  tree_level,
@@ -144,6 +165,14 @@ class GarbageCollector {
   unsigned int          condemned_catalogs_;
 
   unsigned int          condemned_objects_;
+
+  /**
+   * Condemned objects are collected and handed to the uploader in batches.
+   * The number of failed deletions is updated by the uploader's thread.
+   */
+  static const unsigned kDeletionBatchSize = 1000;
+  HashVector            deletion_batch_;
+  atomic_int64          failed_deletions_;
 };
 
 #include "garbage_collector_impl.h"
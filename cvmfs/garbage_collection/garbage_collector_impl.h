@@ -43,6 +43,7 @@ GarbageCollector<CatalogTraversalT, HashFilterT>::GarbageCollector(
   , condemned_objects_(0)
 {
   assert(configuration_.uploader != NULL);
+  atomic_init64(&failed_deletions_);
 }
 
 
@@ -65,6 +66,7 @@ typename GarbageCollector<CatalogTraversalT, HashFilterT>::TraversalParameters
   params.no_repeat_history   = true;
   params.ignore_load_failure = true;
   params.quiet               = !config.verbose;
+  params.num_threads         = config.num_threads;
   return params;
 }
 
@@ -95,6 +97,8 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::PreserveDataObjects(
 
   // the hash of the actual catalog needs to preserved
   hash_filter_.Fill(data.catalog->hash());
+  if (configuration_.existence_filter != NULL)
+    configuration_.existence_filter->Add(data.catalog->hash());
 
   // all the objects referenced from this catalog need to be preserved
   const HashVector &referenced_hashes = data.catalog->GetReferencedObjects();
@@ -102,6 +106,8 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::PreserveDataObjects(
   const typename HashVector::const_iterator iend = referenced_hashes.end();
   for (; i != iend; ++i) {
     hash_filter_.Fill(*i);
+    if (configuration_.existence_filter != NULL)
+      configuration_.existence_filter->Add(*i);
   }
 }
 
@@ -156,7 +162,46 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::Sweep(
     return;
   }
 
-  configuration_.uploader->Remove(hash);
+  deletion_batch_.push_back(hash);
+  if (deletion_batch_.size() >= kDeletionBatchSize)
+    FlushDeletions();
+}
+
+
+template <class CatalogTraversalT, class HashFilterT>
+void GarbageCollector<CatalogTraversalT, HashFilterT>::FlushDeletions() {
+  if (deletion_batch_.empty())
+    return;
+
+  // Blocks if too many batches are in flight
+  configuration_.uploader->ScheduleRemoval(deletion_batch_,
+    upload::AbstractUploader::MakeCallback(
+      &GarbageCollector<CatalogTraversalT, HashFilterT>::OnObjectsRemoved,
+      this));
+  deletion_batch_.clear();
+}
+
+
+/**
+ * Waits for all scheduled deletions.  Returns false if any of the deletions
+ * since the last call failed.
+ */
+template <class CatalogTraversalT, class HashFilterT>
+bool GarbageCollector<CatalogTraversalT, HashFilterT>::WaitForDeletions() {
+  FlushDeletions();
+  configuration_.uploader->WaitForUpload();
+  const bool success = (atomic_read64(&failed_deletions_) == 0);
+  atomic_init64(&failed_deletions_);
+  return success;
+}
+
+
+template <class CatalogTraversalT, class HashFilterT>
+void GarbageCollector<CatalogTraversalT, HashFilterT>::OnObjectsRemoved(
+  const upload::UploaderResults &results)
+{
+  assert(results.type == upload::UploaderResults::kRemoval);
+  atomic_xadd64(&failed_deletions_, results.return_code);
 }
 
 
@@ -173,8 +218,11 @@ bool GarbageCollector<CatalogTraversalT, HashFilterT>::
 
 template <class CatalogTraversalT, class HashFilterT>
 bool GarbageCollector<CatalogTraversalT, HashFilterT>::Collect() {
-  return AnalyzePreservedCatalogTree() &&
-         CheckPreservedRevisions()     &&
+  if (!AnalyzePreservedCatalogTree())
+    return false;
+  // All preserved objects are known, the sweep only queries the filter
+  hash_filter_.Freeze();
+  return CheckPreservedRevisions() &&
          SweepReflog();
 }
 
@@ -236,13 +284,21 @@ bool GarbageCollector<CatalogTraversalT, HashFilterT>::SweepReflog() {
         std::vector<shash::Any>::const_iterator i    = catalogs.begin();
   const std::vector<shash::Any>::const_iterator iend = catalogs.end();
   for (; i != iend && success; ++i) {
-    if (!hash_filter_.Contains(*i)) {
-      success =
-        success                                         &&
-        traversal_.TraverseRevision(*i, traversal_type) &&
-        RemoveCatalogFromReflog(*i);
+    if (hash_filter_.Contains(*i))
+      continue;
+
+    success = traversal_.TraverseRevision(*i, traversal_type);
+    // The reflog entry is the only reference to the condemned objects, keep it
+    // until they are all removed
+    if (!WaitForDeletions()) {
+      LogCvmfs(kLogGc, kLogStderr, "failed to remove all objects of %s, "
+                                   "keeping it in the reference log",
+               i->ToString().c_str());
+      continue;
     }
+    success = success && RemoveCatalogFromReflog(*i);
   }
+  WaitForDeletions();
 
   traversal_.UnregisterListener(callback);
 
@@ -30,6 +30,8 @@ bool GarbageCollectorAux<CatalogTraversalT, HashFilterT>::CollectOlderThan(
     LogCvmfs(kLogGc, kLogStdout, "Sweeping auxiliary objects older than %s",
              StringifyTime(timestamp, true).c_str());
   }
+  // Compression dictionaries are never swept: objects compressed with them can
+  // be referenced by any revision of the repository
   std::vector<SqlReflog::ReferenceType> aux_types;
   aux_types.push_back(SqlReflog::kRefCertificate);
   aux_types.push_back(SqlReflog::kRefHistory);
@@ -79,6 +81,8 @@ std::string GarbageCollectorAux<CatalogTraversalT, HashFilterT>::PrintAuxType(
       return "tag database";
     case SqlReflog::kRefMetainfo:
       return "repository meta information";
+    case SqlReflog::kRefDictionary:
+      return "compression dictionary";
   }
   // Never here
   return "UNKNOWN";
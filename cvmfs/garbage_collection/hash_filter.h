@@ -9,10 +9,24 @@
 #ifndef CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
 #define CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "hash.h"
+#include "logging.h"
 #include "smallhash.h"
+#include "util/posix.h"
 
 /**
  * Abstract base class of a HashFilter to define the common interface.
@@ -124,4 +138,439 @@ class SmallhashFilter : public AbstractHashFilter {
   bool                                frozen_;
 };
 
+//------------------------------------------------------------------------------
+
+
+/**
+ * Exact implementation of AbstractHashFilter for large numbers of hashes.  The
+ * hashes are stored as fixed-size fingerprints of hash algorithm and digest
+ * (21 bytes, the suffix is ignored anyway) in a sorted array.  Unlike the
+ * SmallhashFilter, there are no empty hash table slots and no values.
+ *
+ * New hashes are collected in an unsorted buffer that is merged into the
+ * sorted array once it grows beyond a quarter of the array.  That removes the
+ * many duplicates that result from traversing multiple revisions early.
+ * Lookups are binary searches, narrowed down by an index over the first two
+ * digest bytes that is built by Freeze().
+ *
+ * Note: Before Freeze(), Count() and Contains() merge the buffered hashes and
+ *       must not be used concurrently.  After Freeze(), Contains() is safe to
+ *       be called by multiple threads.
+ */
+class CompactHashFilter : public AbstractHashFilter {
+ public:
+  CompactHashFilter() : frozen_(false), frozen_begin_(NULL), frozen_size_(0) {}
+
+  void Fill(const shash::Any &hash) {
+    assert(!frozen_);
+    pending_.push_back(Fingerprint(hash));
+    const size_t max_pending = sorted_.size() / 4;
+    if (pending_.size() >= ((max_pending > kMinPending) ? max_pending
+                                                         : kMinPending))
+    {
+      Merge();
+    }
+  }
+
+  bool Contains(const shash::Any &hash) const {
+    const Fingerprint fingerprint(hash);
+    if (!frozen_) {
+      Merge();
+      return std::binary_search(sorted_.begin(), sorted_.end(), fingerprint);
+    }
+
+    const Fingerprint *begin = frozen_begin_;
+    const Fingerprint *end   = frozen_begin_ + frozen_size_;
+    if (!index_.empty()) {
+      const unsigned bucket = fingerprint.Bucket();
+      begin = frozen_begin_ + index_[bucket];
+      end   = frozen_begin_ + index_[bucket + 1];
+    }
+    return std::binary_search(begin, end, fingerprint);
+  }
+
+  void Freeze() {
+    Merge();
+    std::vector<Fingerprint>().swap(pending_);
+    SetFrozen(sorted_.empty() ? NULL : &sorted_[0], sorted_.size());
+  }
+
+  size_t Count() const {
+    if (frozen_)
+      return frozen_size_;
+    Merge();
+    return sorted_.size();
+  }
+
+ protected:
+  /**
+   * Hash algorithm followed by the (zero padded) digest, so that memcmp()
+   * orders the fingerprints by algorithm first like shash::Any::operator<
+   */
+  struct Fingerprint {
+    static const unsigned kSize = 1 + shash::kMaxDigestSize;
+
+    Fingerprint() { memset(bytes, 0, kSize); }
+    explicit Fingerprint(const shash::Any &hash) {
+      memset(bytes, 0, kSize);
+      bytes[0] = static_cast<unsigned char>(hash.algorithm);
+      memcpy(bytes + 1, hash.digest, shash::kDigestSizes[hash.algorithm]);
+    }
+
+    unsigned Bucket() const { return (bytes[0] << 16) | (bytes[1] << 8) |
+                                     bytes[2]; }
+
+    bool operator <(const Fingerprint &other) const {
+      return memcmp(bytes, other.bytes, kSize) < 0;
+    }
+    bool operator ==(const Fingerprint &other) const {
+      return memcmp(bytes, other.bytes, kSize) == 0;
+    }
+
+    unsigned char bytes[kSize];
+  };
+
+  /**
+   * Sorts the buffered fingerprints and merges them into the sorted array
+   */
+  void Merge() const {
+    if (pending_.empty())
+      return;
+    std::sort(pending_.begin(), pending_.end());
+    pending_.erase(std::unique(pending_.begin(), pending_.end()),
+                   pending_.end());
+
+    std::vector<Fingerprint> merged;
+    merged.reserve(sorted_.size() + pending_.size());
+    std::merge(sorted_.begin(), sorted_.end(),
+               pending_.begin(), pending_.end(),
+               std::back_inserter(merged));
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+    sorted_.swap(merged);
+    pending_.clear();
+  }
+
+  /**
+   * Switches lookups to the given sorted and duplicate free array
+   */
+  void SetFrozen(const Fingerprint *begin, const size_t size) {
+    frozen_        = true;
+    frozen_begin_  = begin;
+    frozen_size_   = size;
+    index_.clear();
+    if (size < kMinIndexed)
+      return;
+
+    // index_[b] is the position of the first fingerprint in bucket >= b
+    index_.resize(kNumBuckets + 1);
+    size_t pos = 0;
+    for (unsigned b = 0; b <= kNumBuckets; ++b) {
+      while ((pos < size) && (begin[pos].Bucket() < b))
+        ++pos;
+      index_[b] = pos;
+    }
+  }
+
+  bool is_frozen() const { return frozen_; }
+
+  mutable std::vector<Fingerprint>  sorted_;
+  mutable std::vector<Fingerprint>  pending_;
+
+ private:
+  static const size_t   kMinPending  = 64 * 1024;
+  /**
+   * The index has a fixed size of 2MB, it pays off for large filters only
+   */
+  static const size_t   kMinIndexed  = 1024 * 1024;
+  static const unsigned kNumBuckets  = shash::kAny << 16;
+
+  bool                 frozen_;
+  const Fingerprint   *frozen_begin_;
+  size_t               frozen_size_;
+  std::vector<size_t>  index_;
+};
+
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * CompactHashFilter with a bound on the number of fingerprints kept in memory,
+ * for repositories whose preserved objects do not fit in memory.  Once the
+ * bound is reached, the fingerprints are written as a sorted run into a
+ * temporary file.  Freeze() merge-joins all runs into a single sorted and
+ * duplicate free file that is memory mapped, so that only the recently used
+ * pages of it stay in memory.
+ *
+ * Spilling needs to be enabled by SetSpillDirectory(), otherwise the filter
+ * behaves like the CompactHashFilter.  Once runs have been spilled, the filter
+ * needs to be frozen before Contains() is used.  If the temporary files cannot
+ * be written or read, the filter conservatively reports every hash as
+ * contained, so that the garbage collection does not delete anything.
+ */
+class SpillingHashFilter : public CompactHashFilter {
+ public:
+  SpillingHashFilter()
+    : max_in_memory_(0)
+    , failed_(false)
+    , merged_(false)
+    , num_merged_(0)
+    , mapping_(NULL)
+    , mapping_size_(0) {}
+
+  ~SpillingHashFilter() {
+    if (mapping_ != NULL)
+      munmap(mapping_, mapping_size_);
+    for (unsigned i = 0; i < runs_.size(); ++i)
+      unlink(runs_[i].c_str());
+  }
+
+  /**
+   * @param temp_dir       location of the sorted runs
+   * @param max_in_memory  number of fingerprints that trigger spilling
+   */
+  void SetSpillDirectory(const std::string &temp_dir,
+                         const size_t max_in_memory)
+  {
+    temp_dir_      = temp_dir;
+    max_in_memory_ = max_in_memory;
+  }
+
+  void Fill(const shash::Any &hash) {
+    if (failed_)
+      return;
+    CompactHashFilter::Fill(hash);
+    if ((max_in_memory_ > 0) &&
+        (sorted_.size() + pending_.size() >= max_in_memory_))
+    {
+      Merge();
+      if (sorted_.size() >= max_in_memory_ / 2)
+        Spill();
+    }
+  }
+
+  bool Contains(const shash::Any &hash) const {
+    if (failed_)
+      return true;
+    assert(runs_.empty() || is_frozen());
+    return CompactHashFilter::Contains(hash);
+  }
+
+  void Freeze() {
+    if (runs_.empty() || failed_) {
+      CompactHashFilter::Freeze();
+      return;
+    }
+
+    Spill();
+    MergeRuns();
+    if (failed_ || !MapRun()) {
+      failed_ = true;
+      CompactHashFilter::Freeze();
+    }
+  }
+
+  /**
+   * Note: Before Freeze(), counting merges all spilled runs
+   */
+  size_t Count() const {
+    if (runs_.empty() || is_frozen())
+      return CompactHashFilter::Count();
+    Spill();
+    MergeRuns();
+    return num_merged_;
+  }
+
+  unsigned num_runs() const { return runs_.size(); }
+  bool failed() const { return failed_; }
+
+ private:
+  static const size_t kReadBufferSize = 4096;
+
+  /**
+   * Sequential reader of the fingerprints in a run file
+   */
+  class RunReader {
+   public:
+    explicit RunReader(FILE *file) : file_(file), pos_(0), size_(0) {
+      buffer_.resize(kReadBufferSize);
+    }
+    /**
+     * @return  false at the end of the run, a read failure sets *failed
+     */
+    bool Next(Fingerprint *fingerprint, bool *failed) {
+      if (pos_ == size_) {
+        size_ = fread(&buffer_[0], Fingerprint::kSize, kReadBufferSize, file_);
+        pos_ = 0;
+        if (size_ == 0) {
+          *failed = *failed || ferror(file_);
+          return false;
+        }
+      }
+      *fingerprint = buffer_[pos_++];
+      return true;
+    }
+   private:
+    FILE                     *file_;
+    std::vector<Fingerprint>  buffer_;
+    size_t                    pos_;
+    size_t                    size_;
+  };
+
+  bool WriteRun(const std::vector<Fingerprint> &fingerprints,
+                FILE *file) const
+  {
+    return fingerprints.empty() ||
+           (fwrite(&fingerprints[0], Fingerprint::kSize, fingerprints.size(),
+                   file) == fingerprints.size());
+  }
+
+  FILE *CreateRun(std::string *path) const {
+    FILE *file = CreateTempFile(temp_dir_ + "/hashfilter", 0600, "w+", path);
+    if (file == NULL) {
+      LogCvmfs(kLogGc, kLogStderr, "failed to create hash filter run in %s "
+                                   "(errno: %d)", temp_dir_.c_str(), errno);
+    }
+    return file;
+  }
+
+  void Fail() const {
+    LogCvmfs(kLogGc, kLogStderr, "hash filter failed to spill to %s, "
+                                 "preserving all objects", temp_dir_.c_str());
+    failed_ = true;
+    std::vector<Fingerprint>().swap(sorted_);
+    std::vector<Fingerprint>().swap(pending_);
+  }
+
+  /**
+   * Writes the fingerprints in memory as a new sorted run
+   */
+  void Spill() const {
+    Merge();
+    if (sorted_.empty())
+      return;
+
+    std::string path;
+    FILE *file = CreateRun(&path);
+    if (file == NULL) {
+      Fail();
+      return;
+    }
+    runs_.push_back(path);
+    merged_ = false;
+    const bool retval = WriteRun(sorted_, file);
+    if ((fclose(file) != 0) || !retval) {
+      Fail();
+      return;
+    }
+    std::vector<Fingerprint>().swap(sorted_);
+  }
+
+  /**
+   * Merge-joins all runs into a single, duplicate free run
+   */
+  void MergeRuns() const {
+    if (failed_ || merged_)
+      return;
+
+    std::string path;
+    FILE *output = CreateRun(&path);
+    if (output == NULL) {
+      Fail();
+      return;
+    }
+
+    std::vector<FILE *>     inputs;
+    std::vector<RunReader>  readers;
+    std::vector<Fingerprint> heads;
+    std::vector<bool>        valid;
+    bool failed = false;
+    for (unsigned i = 0; i < runs_.size(); ++i) {
+      FILE *input = fopen(runs_[i].c_str(), "r");
+      if (input == NULL) {
+        failed = true;
+        break;
+      }
+      inputs.push_back(input);
+      readers.push_back(RunReader(input));
+      heads.push_back(Fingerprint());
+      valid.push_back(readers.back().Next(&heads.back(), &failed));
+    }
+
+    std::vector<Fingerprint> buffer;
+    buffer.reserve(kReadBufferSize);
+    size_t num_merged = 0;
+    Fingerprint last;
+    while (!failed) {
+      int min = -1;
+      for (unsigned i = 0; i < heads.size(); ++i) {
+        if (valid[i] && ((min < 0) || (heads[i] < heads[min])))
+          min = i;
+      }
+      if (min < 0)
+        break;
+      if ((num_merged == 0) || !(heads[min] == last)) {
+        last = heads[min];
+        buffer.push_back(last);
+        ++num_merged;
+        if (buffer.size() == kReadBufferSize) {
+          failed = !WriteRun(buffer, output);
+          buffer.clear();
+        }
+      }
+      valid[min] = readers[min].Next(&heads[min], &failed);
+    }
+    failed = failed || !WriteRun(buffer, output);
+
+    for (unsigned i = 0; i < inputs.size(); ++i)
+      fclose(inputs[i]);
+    failed = (fclose(output) != 0) || failed;
+    for (unsigned i = 0; i < runs_.size(); ++i)
+      unlink(runs_[i].c_str());
+    runs_.clear();
+    runs_.push_back(path);
+    if (failed) {
+      Fail();
+      return;
+    }
+    merged_     = true;
+    num_merged_ = num_merged;
+  }
+
+  /**
+   * Memory maps the single run that is left after MergeRuns()
+   */
+  bool MapRun() {
+    assert(runs_.size() == 1);
+    mapping_size_ = num_merged_ * Fingerprint::kSize;
+    if (mapping_size_ == 0) {
+      SetFrozen(NULL, 0);
+      return true;
+    }
+
+    const int fd = open(runs_[0].c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    void *mapping = mmap(NULL, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      LogCvmfs(kLogGc, kLogStderr, "failed to map hash filter run %s "
+                                   "(errno: %d)", runs_[0].c_str(), errno);
+      return false;
+    }
+    mapping_ = mapping;
+    SetFrozen(reinterpret_cast<const Fingerprint *>(mapping_), num_merged_);
+    return true;
+  }
+
+  std::string                       temp_dir_;
+  size_t                            max_in_memory_;
+  mutable bool                      failed_;
+  mutable bool                      merged_;
+  mutable std::vector<std::string>  runs_;
+  mutable size_t                    num_merged_;
+  void                             *mapping_;
+  size_t                            mapping_size_;
+};
+
 #endif  // CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
@@ -14,9 +14,19 @@
 #include <unistd.h>
 
 #include <cstdio>
+#include <vector>
 
 #include "KeccakHash.h"
 
+// The accelerated SHA-1 batch kernels need compiler support for the target
+// function attribute
+#if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ > 4) || \
+    ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define CVMFS_HASH_X86_KERNELS
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 using namespace std;  // NOLINT
 
 #ifdef CVMFS_NAMESPACE_GUARD
@@ -267,6 +277,432 @@ void HashString(const std::string &content, Any *any_digest) {
 }
 
 
+//------------------------------------------------------------------------------
+
+
+static const uint32_t kSha1Iv[5] =
+  {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+
+/**
+ * Creates the final one or two blocks of a SHA-1 message, i.e. the remaining
+ * bytes followed by the padding and the message length in bits.  Returns the
+ * number of blocks.
+ */
+static unsigned Sha1Tail(const unsigned char *buffer, const unsigned size,
+                         unsigned char tail[128])
+{
+  const unsigned remainder = size % 64;
+  const unsigned nblocks = (remainder + 9 <= 64) ? 1 : 2;
+  memset(tail, 0, 64 * nblocks);
+  memcpy(tail, buffer + (size - remainder), remainder);
+  tail[remainder] = 0x80;
+  const uint64_t nbits = static_cast<uint64_t>(size) * 8;
+  for (unsigned i = 0; i < 8; ++i)
+    tail[64 * nblocks - 1 - i] = static_cast<unsigned char>(nbits >> (8 * i));
+  return nblocks;
+}
+
+
+static void Sha1Digest(const uint32_t state[5], Any *any_digest) {
+  for (unsigned i = 0; i < 5; ++i) {
+    any_digest->digest[4*i]     = static_cast<unsigned char>(state[i] >> 24);
+    any_digest->digest[4*i + 1] = static_cast<unsigned char>(state[i] >> 16);
+    any_digest->digest[4*i + 2] = static_cast<unsigned char>(state[i] >> 8);
+    any_digest->digest[4*i + 3] = static_cast<unsigned char>(state[i]);
+  }
+}
+
+
+#ifdef CVMFS_HASH_X86_KERNELS
+
+/**
+ * Checks the CPU (and the operating system for the AVX registers) for the
+ * SHA extensions and for AVX2.
+ */
+static void DetectX86Kernels(bool *has_sha_ni, bool *has_avx2) {
+  *has_sha_ni = *has_avx2 = false;
+  unsigned eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0, NULL) < 7)
+    return;
+  __cpuid(1, eax, ebx, ecx, edx);
+  const bool has_ssse3 = ecx & (1 << 9);
+  const bool has_sse41 = ecx & (1 << 19);
+  const bool has_osxsave = ecx & (1 << 27);
+  const bool has_avx = ecx & (1 << 28);
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  *has_sha_ni = has_ssse3 && has_sse41 && (ebx & (1 << 29));
+  if (has_osxsave && has_avx && (ebx & (1 << 5))) {
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    *has_avx2 = (xcr0_lo & 0x6) == 0x6;
+  }
+}
+
+
+// One group of four rounds of the SHA extensions.  Group g uses message
+// register msg_g, feeds msg_g into the schedule of the following groups and
+// keeps the current ABCD in e_next for the next group.
+#define SHA1NI_GROUP(g, e_this, e_next, msg_g, msg_g1, msg_g2, msg_g3)        \
+  e_this = _mm_sha1nexte_epu32(e_this, msg_g);                                \
+  e_next = abcd;                                                              \
+  if (((g) >= 3) && ((g) <= 18)) msg_g1 = _mm_sha1msg2_epu32(msg_g1, msg_g);  \
+  abcd = _mm_sha1rnds4_epu32(abcd, e_this, (g) / 5);                          \
+  if (((g) >= 1) && ((g) <= 16)) msg_g3 = _mm_sha1msg1_epu32(msg_g3, msg_g);  \
+  if (((g) >= 2) && ((g) <= 17)) msg_g2 = _mm_xor_si128(msg_g2, msg_g);
+
+/**
+ * SHA-1 compression function using the x86 SHA extensions.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void Sha1CompressShaNi(uint32_t state[5], const unsigned char *data,
+                              unsigned nblocks)
+{
+  const __m128i mask =
+    _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_shuffle_epi32(
+    _mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1B);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+  __m128i e1;
+  __m128i msg0, msg1, msg2, msg3;
+
+  for (; nblocks > 0; --nblocks, data += 64) {
+    const __m128i abcd_save = abcd;
+    const __m128i e0_save = e0;
+
+    msg0 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), mask);
+    msg1 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16)), mask);
+    msg2 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32)), mask);
+    msg3 = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48)), mask);
+
+    // Rounds 0-3 add the first message words instead of using nexte
+    e0 = _mm_add_epi32(e0, msg0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    SHA1NI_GROUP(1,  e1, e0, msg1, msg2, msg3, msg0)
+    SHA1NI_GROUP(2,  e0, e1, msg2, msg3, msg0, msg1)
+    SHA1NI_GROUP(3,  e1, e0, msg3, msg0, msg1, msg2)
+    SHA1NI_GROUP(4,  e0, e1, msg0, msg1, msg2, msg3)
+    SHA1NI_GROUP(5,  e1, e0, msg1, msg2, msg3, msg0)
+    SHA1NI_GROUP(6,  e0, e1, msg2, msg3, msg0, msg1)
+    SHA1NI_GROUP(7,  e1, e0, msg3, msg0, msg1, msg2)
+    SHA1NI_GROUP(8,  e0, e1, msg0, msg1, msg2, msg3)
+    SHA1NI_GROUP(9,  e1, e0, msg1, msg2, msg3, msg0)
+    SHA1NI_GROUP(10, e0, e1, msg2, msg3, msg0, msg1)
+    SHA1NI_GROUP(11, e1, e0, msg3, msg0, msg1, msg2)
+    SHA1NI_GROUP(12, e0, e1, msg0, msg1, msg2, msg3)
+    SHA1NI_GROUP(13, e1, e0, msg1, msg2, msg3, msg0)
+    SHA1NI_GROUP(14, e0, e1, msg2, msg3, msg0, msg1)
+    SHA1NI_GROUP(15, e1, e0, msg3, msg0, msg1, msg2)
+    SHA1NI_GROUP(16, e0, e1, msg0, msg1, msg2, msg3)
+    SHA1NI_GROUP(17, e1, e0, msg1, msg2, msg3, msg0)
+    SHA1NI_GROUP(18, e0, e1, msg2, msg3, msg0, msg1)
+    SHA1NI_GROUP(19, e1, e0, msg3, msg0, msg1, msg2)
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state),
+                   _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#undef SHA1NI_GROUP
+
+
+static void HashSha1ShaNi(const unsigned char *buffer, const unsigned size,
+                          Any *any_digest)
+{
+  uint32_t state[5];
+  memcpy(state, kSha1Iv, sizeof(state));
+  Sha1CompressShaNi(state, buffer, size / 64);
+  unsigned char tail[128];
+  const unsigned ntail = Sha1Tail(buffer, size, tail);
+  Sha1CompressShaNi(state, tail, ntail);
+  Sha1Digest(state, any_digest);
+}
+
+
+static const unsigned kAvx2Lanes = 8;
+
+#define CVMFS_ROTL(x, n) \
+  _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+/**
+ * SHA-1 compression function for 8 independent blocks using AVX2.  The state
+ * is stored word-wise, i.e. state[i][j] is the i-th word of the j-th stream.
+ */
+__attribute__((target("avx2")))
+static void Sha1CompressAvx2(uint32_t state[5][kAvx2Lanes],
+                             const unsigned char *blocks[kAvx2Lanes])
+{
+  const __m256i bswap = _mm256_set_epi8(
+    12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+    12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+  // Transpose the message blocks such that w[t] holds word t of all streams
+  __m256i w[16];
+  for (unsigned half = 0; half < 2; ++half) {
+    __m256i r[kAvx2Lanes];
+    for (unsigned j = 0; j < kAvx2Lanes; ++j) {
+      r[j] = _mm256_shuffle_epi8(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(blocks[j] + 32 * half)), bswap);
+    }
+    const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    __m256i *out = w + 8 * half;
+    out[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    out[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    out[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    out[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    out[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    out[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    out[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    out[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+  }
+
+  __m256i h[5];
+  for (unsigned i = 0; i < 5; ++i)
+    h[i] = _mm256_loadu_si256(reinterpret_cast<__m256i *>(state[i]));
+  __m256i a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+  for (unsigned t = 0; t < 80; ++t) {
+    if (t >= 16) {
+      const __m256i x = _mm256_xor_si256(
+        _mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]),
+        _mm256_xor_si256(w[(t - 14) & 15], w[t & 15]));
+      w[t & 15] = CVMFS_ROTL(x, 1);
+    }
+    __m256i f, k;
+    if (t < 20) {
+      // d ^ (b & (c ^ d))
+      f = _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+      k = _mm256_set1_epi32(0x5A827999);
+    } else if (t < 40) {
+      f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+      k = _mm256_set1_epi32(0x6ED9EBA1);
+    } else if (t < 60) {
+      // (b & c) | (d & (b | c))
+      f = _mm256_or_si256(_mm256_and_si256(b, c),
+                          _mm256_and_si256(d, _mm256_or_si256(b, c)));
+      k = _mm256_set1_epi32(0x8F1BBCDC);
+    } else {
+      f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+      k = _mm256_set1_epi32(0xCA62C1D6);
+    }
+    const __m256i tmp = _mm256_add_epi32(
+      _mm256_add_epi32(CVMFS_ROTL(a, 5), f),
+      _mm256_add_epi32(_mm256_add_epi32(e, k), w[t & 15]));
+    e = d;
+    d = c;
+    c = CVMFS_ROTL(b, 30);
+    b = a;
+    a = tmp;
+  }
+
+  h[0] = _mm256_add_epi32(h[0], a);
+  h[1] = _mm256_add_epi32(h[1], b);
+  h[2] = _mm256_add_epi32(h[2], c);
+  h[3] = _mm256_add_epi32(h[3], d);
+  h[4] = _mm256_add_epi32(h[4], e);
+  for (unsigned i = 0; i < 5; ++i)
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[i]), h[i]);
+}
+
+#undef CVMFS_ROTL
+
+
+/**
+ * Hashes the SHA-1 buffers in 8 lanes.  Whenever a lane finishes its buffer,
+ * it continues with the next pending buffer.  Idle lanes process a dummy
+ * block.
+ */
+static void HashSha1Avx2(const unsigned char * const *buffers,
+                         const unsigned *buffer_sizes,
+                         const vector<unsigned> &indexes,
+                         Any *any_digests)
+{
+  struct Lane {
+    unsigned index;  // position in indexes, kIdle if the lane is idle
+    const unsigned char *data;
+    unsigned full_blocks;
+    unsigned tail_blocks;
+    unsigned char tail[128];
+  };
+  const unsigned kIdle = unsigned(-1);
+  static const unsigned char dummy_block[64] = { 0 };
+
+  uint32_t state[5][kAvx2Lanes];
+  Lane lanes[kAvx2Lanes];
+  unsigned next = 0;
+  unsigned active = 0;
+  for (unsigned j = 0; j < kAvx2Lanes; ++j) {
+    lanes[j].index = kIdle;
+  }
+
+  while (true) {
+    // Assign pending buffers to idle lanes
+    for (unsigned j = 0; (j < kAvx2Lanes) && (next < indexes.size()); ++j) {
+      if (lanes[j].index != kIdle)
+        continue;
+      const unsigned i = indexes[next];
+      lanes[j].index = next++;
+      lanes[j].data = buffers[i];
+      lanes[j].full_blocks = buffer_sizes[i] / 64;
+      lanes[j].tail_blocks =
+        Sha1Tail(buffers[i], buffer_sizes[i], lanes[j].tail);
+      for (unsigned k = 0; k < 5; ++k)
+        state[k][j] = kSha1Iv[k];
+      active++;
+    }
+    if (active == 0)
+      break;
+
+    const unsigned char *blocks[kAvx2Lanes];
+    for (unsigned j = 0; j < kAvx2Lanes; ++j) {
+      Lane *lane = &lanes[j];
+      if (lane->index == kIdle) {
+        blocks[j] = dummy_block;
+      } else if (lane->full_blocks > 0) {
+        blocks[j] = lane->data;
+      } else {
+        // the current tail block is always moved to the front
+        blocks[j] = lane->tail;
+      }
+    }
+
+    Sha1CompressAvx2(state, blocks);
+
+    for (unsigned j = 0; j < kAvx2Lanes; ++j) {
+      Lane *lane = &lanes[j];
+      if (lane->index == kIdle)
+        continue;
+      if (lane->full_blocks > 0) {
+        lane->full_blocks--;
+        lane->data += 64;
+        continue;
+      }
+      lane->tail_blocks--;
+      if (lane->tail_blocks > 0) {
+        memmove(lane->tail, lane->tail + 64, 64);
+        continue;
+      }
+      uint32_t lane_state[5];
+      for (unsigned k = 0; k < 5; ++k)
+        lane_state[k] = state[k][j];
+      Sha1Digest(lane_state, &any_digests[indexes[lane->index]]);
+      lane->index = kIdle;
+      active--;
+    }
+  }
+}
+
+#endif  // CVMFS_HASH_X86_KERNELS
+
+
+bool HasBatchKernel(const BatchKernel kernel) {
+#ifdef CVMFS_HASH_X86_KERNELS
+  static bool detected = false;
+  static bool has_sha_ni = false;
+  static bool has_avx2 = false;
+  if (!detected) {
+    DetectX86Kernels(&has_sha_ni, &has_avx2);
+    detected = true;
+  }
+  switch (kernel) {
+    case kBatchGeneric:
+      return true;
+    case kBatchShaNi:
+      return has_sha_ni;
+    case kBatchAvx2:
+      return has_avx2;
+  }
+  return false;
+#else
+  return kernel == kBatchGeneric;
+#endif
+}
+
+
+/**
+ * Prefers the SHA extensions, which are faster per stream than the AVX2 lanes.
+ */
+BatchKernel GetBatchKernel() {
+  if (HasBatchKernel(kBatchShaNi))
+    return kBatchShaNi;
+  if (HasBatchKernel(kBatchAvx2))
+    return kBatchAvx2;
+  return kBatchGeneric;
+}
+
+
+void HashMemBatch(const unsigned char * const *buffers,
+                  const unsigned *buffer_sizes,
+                  const unsigned nbuffers,
+                  Any *any_digests)
+{
+  HashMemBatch(buffers, buffer_sizes, nbuffers, any_digests, GetBatchKernel());
+}
+
+
+void HashMemBatch(const unsigned char * const *buffers,
+                  const unsigned *buffer_sizes,
+                  const unsigned nbuffers,
+                  Any *any_digests,
+                  const BatchKernel kernel)
+{
+  assert(HasBatchKernel(kernel));
+  // The accelerated kernels only deal with SHA-1
+  vector<unsigned> sha1_indexes;
+  for (unsigned i = 0; i < nbuffers; ++i) {
+    if ((kernel != kBatchGeneric) && (any_digests[i].algorithm == kSha1))
+      sha1_indexes.push_back(i);
+    else
+      HashMem(buffers[i], buffer_sizes[i], &any_digests[i]);
+  }
+  if (sha1_indexes.empty())
+    return;
+
+#ifdef CVMFS_HASH_X86_KERNELS
+  switch (kernel) {
+    case kBatchShaNi:
+      for (unsigned i = 0; i < sha1_indexes.size(); ++i) {
+        const unsigned idx = sha1_indexes[i];
+        HashSha1ShaNi(buffers[idx], buffer_sizes[idx], &any_digests[idx]);
+      }
+      break;
+    case kBatchAvx2:
+      HashSha1Avx2(buffers, buffer_sizes, sha1_indexes, any_digests);
+      break;
+    default:
+      abort();
+  }
+#else
+  abort();
+#endif
+}
+
+
 void Hmac(
   const string &key,
   const unsigned char *buffer,
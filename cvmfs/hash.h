@@ -56,6 +56,7 @@ const char kSuffixPartial      = 'P';
 const char kSuffixTemporary    = 'T';
 const char kSuffixCertificate  = 'X';
 const char kSuffixMetainfo     = 'M';
+const char kSuffixDictionary   = 'D';
 
 
 /**
@@ -497,6 +498,33 @@ bool HashFd(int fd, Any *any_digest);
 void HashMem(const unsigned char *buffer, const unsigned buffer_size,
              Any *any_digest);
 void HashString(const std::string &content, Any *any_digest);
+
+/**
+ * Implementations of batch hashing.  The accelerated kernels hash SHA-1 only
+ * and are available on x86_64 CPUs with the SHA extensions or with AVX2,
+ * respectively.  The AVX2 kernel hashes 8 buffers in parallel.
+ */
+enum BatchKernel {
+  kBatchGeneric = 0,
+  kBatchShaNi,
+  kBatchAvx2
+};
+bool HasBatchKernel(const BatchKernel kernel);
+BatchKernel GetBatchKernel();
+/**
+ * Hashes many independent buffers at once.  The algorithm is taken from the
+ * given digests, which can be mixed.  Uses the fastest available kernel
+ * unless a specific kernel is requested.
+ */
+void HashMemBatch(const unsigned char * const *buffers,
+                  const unsigned *buffer_sizes,
+                  const unsigned nbuffers,
+                  Any *any_digests);
+void HashMemBatch(const unsigned char * const *buffers,
+                  const unsigned *buffer_sizes,
+                  const unsigned nbuffers,
+                  Any *any_digests,
+                  const BatchKernel kernel);
 void Hmac(const std::string &key,
           const unsigned char *buffer, const unsigned buffer_size,
           Any *any_digest);
@@ -68,6 +68,7 @@ Manifest *Manifest::Load(const map<char, string> &content) {
   bool garbage_collectable = false;
   bool has_alt_catalog_path = false;
   shash::Any meta_info;
+  shash::Any compression_dictionary;
 
   if ((iter = content.find('B')) != content.end())
     catalog_size = String2Uint64(iter->second);
@@ -91,11 +92,15 @@ Manifest *Manifest::Load(const map<char, string> &content) {
   if ((iter = content.find('M')) != content.end())
     meta_info = MkFromHexPtr(shash::HexPtr(iter->second),
                              shash::kSuffixMetainfo);
+  if ((iter = content.find('Y')) != content.end())
+    compression_dictionary = MkFromHexPtr(shash::HexPtr(iter->second),
+                                          shash::kSuffixDictionary);
 
   return new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
                       micro_catalog_hash, repository_name, certificate,
                       history, publish_timestamp, garbage_collectable,
-                      has_alt_catalog_path, meta_info);
+                      has_alt_catalog_path, meta_info,
+                      compression_dictionary);
 }
 
 
@@ -138,6 +143,8 @@ string Manifest::ExportString() const {
     manifest += "T" + StringifyInt(publish_timestamp_) + "\n";
   if (!meta_info_.IsNull())
     manifest += "M" + meta_info_.ToString() + "\n";
+  if (!compression_dictionary_.IsNull())
+    manifest += "Y" + compression_dictionary_.ToString() + "\n";
   // Reserved: Z -> for identification of channel tips
 
   return manifest;
@@ -180,6 +187,8 @@ bool Manifest::ExportChecksum(const string &directory, const int mode) const {
     return false;
   string cache_checksum = catalog_hash_.ToString() + "T" +
                           StringifyInt(publish_timestamp_);
+  if (!compression_dictionary_.IsNull())
+    cache_checksum += "Y" + compression_dictionary_.ToString();
   int written = fwrite(&(cache_checksum[0]), 1, cache_checksum.length(),
                        fchksum);
   fclose(fchksum);
@@ -198,13 +207,16 @@ bool Manifest::ExportChecksum(const string &directory, const int mode) const {
 
 /**
  * Read the hash and the last-modified time stamp from the
- * cvmfschecksum.$repository file in the given directory.
+ * cvmfschecksum.$repository file in the given directory.  If requested, the
+ * hash of the compression dictionary is read as well; it remains a null hash
+ * if the file does not contain one.
  */
 bool Manifest::ReadChecksum(
   const std::string &repo_name,
   const std::string &directory,
   shash::Any *hash,
-  uint64_t *last_modified)
+  uint64_t *last_modified,
+  shash::Any *compression_dictionary)
 {
   bool result = false;
   const string checksum_path = directory + "/cvmfschecksum." + repo_name;
@@ -226,6 +238,16 @@ bool Manifest::ReadChecksum(
                             read_bytes-(separator_pos+1));
       *last_modified = String2Uint64(str_modified);
       result = true;
+
+      // Optional dictionary hash after the time stamp
+      const size_t dictionary_pos = str_modified.find('Y');
+      if ((compression_dictionary != NULL) &&
+          (dictionary_pos != string::npos))
+      {
+        *compression_dictionary = shash::MkFromHexPtr(
+          shash::HexPtr(str_modified.substr(dictionary_pos + 1)),
+          shash::kSuffixDictionary);
+      }
     }
   }
   if (file_checksum) fclose(file_checksum);
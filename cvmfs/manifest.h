@@ -38,7 +38,8 @@ class Manifest {
            const uint64_t publish_timestamp,
            const bool garbage_collectable,
            const bool has_alt_catalog_path,
-           const shash::Any &meta_info)
+           const shash::Any &meta_info,
+           const shash::Any &compression_dictionary)
   : catalog_hash_(catalog_hash)
   , catalog_size_(catalog_size)
   , root_path_(root_path)
@@ -51,7 +52,8 @@ class Manifest {
   , publish_timestamp_(publish_timestamp)
   , garbage_collectable_(garbage_collectable)
   , has_alt_catalog_path_(has_alt_catalog_path)
-  , meta_info_(meta_info) { }
+  , meta_info_(meta_info)
+  , compression_dictionary_(compression_dictionary) { }
 
   std::string ExportString() const;
   bool Export(const std::string &path) const;
@@ -59,7 +61,8 @@ class Manifest {
   static bool ReadChecksum(const std::string &repo_name,
                            const std::string &directory,
                            shash::Any *hash,
-                           uint64_t *last_modified);
+                           uint64_t *last_modified,
+                           shash::Any *compression_dictionary = NULL);
 
   shash::Algorithms GetHashAlgorithm() const { return catalog_hash_.algorithm; }
 
@@ -92,6 +95,9 @@ class Manifest {
   void set_meta_info(const shash::Any &meta_info) {
     meta_info_ = meta_info;
   }
+  void set_compression_dictionary(const shash::Any &compression_dictionary) {
+    compression_dictionary_ = compression_dictionary;
+  }
   void set_root_path(const std::string &root_path) {
     root_path_ = shash::Md5(shash::AsciiPtr(root_path));
   }
@@ -107,6 +113,9 @@ class Manifest {
   bool garbage_collectable() const { return garbage_collectable_; }
   bool has_alt_catalog_path() const { return has_alt_catalog_path_; }
   shash::Any meta_info() const { return meta_info_; }
+  shash::Any compression_dictionary() const {
+    return compression_dictionary_;
+  }
 
   std::string MakeCatalogPath() const {
     return has_alt_catalog_path_ ? catalog_hash_.MakeAlternativePath() :
@@ -144,6 +153,11 @@ class Manifest {
    * of recommended stratum 1s, ...)
    */
   shash::Any meta_info_;
+
+  /**
+   * Hash of the zstd dictionary used to compress small files
+   */
+  shash::Any compression_dictionary_;
 };  // class Manifest
 
 }  // namespace manifest
@@ -338,21 +338,23 @@ void FileSystem::CreateStatistics() {
   statistics_->Register("linkstring.n_instances", "Number of instances");
   statistics_->Register("linkstring.n_overflows", "Number of overflows");
 
-  // Callback counters
-  n_fs_open_ = statistics_->Register("cvmfs.n_fs_open",
-                                     "Overall number of file open operations");
-  n_fs_dir_open_ = statistics_->Register("cvmfs.n_fs_dir_open",
+  // Callback counters, sharded because they are hit by all fuse threads
+  n_fs_open_ = statistics_->RegisterSharded("cvmfs.n_fs_open",
+               "Overall number of file open operations");
+  n_fs_dir_open_ = statistics_->RegisterSharded("cvmfs.n_fs_dir_open",
                    "Overall number of directory open operations");
-  n_fs_lookup_ = statistics_->Register("cvmfs.n_fs_lookup",
-                                       "Number of lookups");
-  n_fs_lookup_negative_ = statistics_->Register("cvmfs.n_fs_lookup_negative",
-                                                "Number of negative lookups");
-  n_fs_stat_ = statistics_->Register("cvmfs.n_fs_stat", "Number of stats");
-  n_fs_read_ = statistics_->Register("cvmfs.n_fs_read", "Number of files read");
-  n_fs_readlink_ = statistics_->Register("cvmfs.n_fs_readlink",
-                                         "Number of links read");
-  n_fs_forget_ = statistics_->Register("cvmfs.n_fs_forget",
-                                       "Number of inode forgets");
+  n_fs_lookup_ = statistics_->RegisterSharded("cvmfs.n_fs_lookup",
+                                              "Number of lookups");
+  n_fs_lookup_negative_ = statistics_->RegisterSharded(
+    "cvmfs.n_fs_lookup_negative", "Number of negative lookups");
+  n_fs_stat_ = statistics_->RegisterSharded("cvmfs.n_fs_stat",
+                                            "Number of stats");
+  n_fs_read_ = statistics_->RegisterSharded("cvmfs.n_fs_read",
+                                            "Number of files read");
+  n_fs_readlink_ = statistics_->RegisterSharded("cvmfs.n_fs_readlink",
+                                                "Number of links read");
+  n_fs_forget_ = statistics_->RegisterSharded("cvmfs.n_fs_forget",
+                                              "Number of inode forgets");
   n_io_error_ = statistics_->Register("cvmfs.n_io_error",
                                       "Number of I/O errors");
   no_open_files_ = statistics_->Register("cvmfs.no_open_files",
@@ -959,6 +961,11 @@ bool MountPoint::CreateCatalogManager() {
   SetupInodeAnnotation();
   if (!SetupOwnerMaps())
     return false;
+  if (options_mgr_->GetValue("CVMFS_CATALOG_PATH_FILTER", &optarg) &&
+      !options_mgr_->IsOn(optarg))
+  {
+    catalog_mgr_->SetPathFilter(false);
+  }
   shash::Any root_hash;
   if (!DetermineRootHash(&root_hash))
     return false;
@@ -1053,6 +1060,10 @@ void MountPoint::CreateFetchers() {
     statistics_,
     "fetch-external",
     is_external_data);
+
+  string optarg;
+  if (options_mgr_->GetValue("CVMFS_EXTERNAL_BLOCK_SIZE", &optarg))
+    external_fetcher_->SetBlockSize(String2Uint64(optarg) * 1024);
 }
 
 
@@ -1512,6 +1523,8 @@ void MountPoint::SetupHttpTuning() {
   {
     download_mgr_->EnableInfoHeader();
   }
+  if (options_mgr_->GetValue("CVMFS_CONNECTION_WARMUP", &optarg))
+    download_mgr_->SetConnectionWarmup(String2Uint64(optarg));
 }
 
 
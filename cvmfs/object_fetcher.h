@@ -157,17 +157,43 @@ class AbstractObjectFetcher : public ObjectFetcherFailures {
                               CatalogTN   **catalog,
                         const bool          is_nested = false,
                               CatalogTN    *parent    = NULL) {
-    assert(!catalog_hash.IsNull());
-    assert(catalog_hash.suffix == shash::kSuffixCatalog);
-
     std::string path;
-    const Failures retval = Fetch(catalog_hash, &path);
+    const Failures retval = FetchCatalogFile(catalog_hash, &path);
     if (retval != kFailOk) {
       return retval;
     }
+    return OpenCatalog(catalog_hash, catalog_path, path, catalog, is_nested,
+                       parent);
+  }
 
+  /**
+   * Downloads and decompresses a catalog database without opening it.  This is
+   * safe to call concurrently if the concrete object fetcher's Fetch() is.
+   *
+   * @param catalog_hash   the content hash of the catalog object
+   * @param file_path      path of the decompressed catalog database
+   * @return               failure code, specifying the action's result
+   */
+  Failures FetchCatalogFile(const shash::Any  &catalog_hash,
+                                  std::string *file_path) {
+    assert(!catalog_hash.IsNull());
+    assert(catalog_hash.suffix == shash::kSuffixCatalog);
+    return Fetch(catalog_hash, file_path);
+  }
+
+  /**
+   * Opens a catalog database that was retrieved by FetchCatalogFile().  The
+   * catalog object takes ownership of the database file.  Parameters as for
+   * FetchCatalog().
+   */
+  Failures OpenCatalog(const shash::Any   &catalog_hash,
+                       const std::string  &catalog_path,
+                       const std::string  &file_path,
+                             CatalogTN   **catalog,
+                       const bool          is_nested = false,
+                             CatalogTN    *parent    = NULL) {
     *catalog = CatalogTN::AttachFreely(catalog_path,
-                                       path,
+                                       file_path,
                                        catalog_hash,
                                        parent,
                                        is_nested);
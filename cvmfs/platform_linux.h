@@ -277,6 +277,13 @@ inline void platform_disable_kcache(int filedes) {
   (void)posix_fadvise(filedes, 0, 0, POSIX_FADV_RANDOM | POSIX_FADV_NOREUSE);
 }
 
+/**
+ * Announces that the file is read once from beginning to end.
+ */
+inline void platform_sequential_read(int filedes) {
+  (void)posix_fadvise(filedes, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
 inline int platform_readahead(int filedes) {
   return readahead(filedes, 0, static_cast<size_t>(-1));
 }
@@ -338,6 +345,13 @@ inline uint64_t platform_monotonic_time() {
   return tp.tv_sec + (tp.tv_nsec >= 500000000);
 }
 
+inline uint64_t platform_monotonic_time_ns() {
+  struct timespec tp;
+  int retval = clock_gettime(CLOCK_MONOTONIC, &tp);
+  assert(retval == 0);
+  return static_cast<uint64_t>(tp.tv_sec) * 1000000000 + tp.tv_nsec;
+}
+
 inline uint64_t platform_memsize() {
   return sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
 }
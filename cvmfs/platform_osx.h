@@ -194,6 +194,10 @@ inline void platform_disable_kcache(int filedes) {
   fcntl(filedes, F_NOCACHE, 1);
 }
 
+inline void platform_sequential_read(int filedes) {
+  fcntl(filedes, F_RDAHEAD, 1);
+}
+
 inline void platform_invalidate_kcache(const int    fd,
                                        const off_t  offset,
                                        const size_t length) {
@@ -231,6 +235,13 @@ inline uint64_t platform_monotonic_time() {
   return val_ns * 1e-9;
 }
 
+inline uint64_t platform_monotonic_time_ns() {
+  uint64_t val_abs = mach_absolute_time();
+  mach_timebase_info_data_t info;
+  mach_timebase_info(&info);
+  return val_abs * info.numer / info.denom;
+}
+
 
 /**
  * strdupa does not exist on OSX
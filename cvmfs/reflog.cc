@@ -131,6 +131,13 @@ bool Reflog::AddMetainfo(const shash::Any &metainfo) {
 }
 
 
+bool Reflog::AddDictionary(const shash::Any &dictionary) {
+  assert(dictionary.HasSuffix() &&
+         dictionary.suffix == shash::kSuffixDictionary);
+  return AddReference(dictionary, SqlReflog::kRefDictionary);
+}
+
+
 uint64_t Reflog::CountEntries() {
   assert(database_);
   const bool success_exec = count_references_->Execute();
@@ -189,6 +196,9 @@ bool Reflog::Remove(const shash::Any &hash) {
     case shash::kSuffixMetainfo:
       type = SqlReflog::kRefMetainfo;
       break;
+    case shash::kSuffixDictionary:
+      type = SqlReflog::kRefDictionary;
+      break;
     default:
       return false;
   }
@@ -236,6 +246,13 @@ bool Reflog::ContainsMetainfo(const shash::Any &metainfo) const {
 }
 
 
+bool Reflog::ContainsDictionary(const shash::Any &dictionary) const {
+  assert(dictionary.HasSuffix() &&
+         dictionary.suffix == shash::kSuffixDictionary);
+  return ContainsReference(dictionary, SqlReflog::kRefDictionary);
+}
+
+
 bool Reflog::AddReference(const shash::Any               &hash,
                           const SqlReflog::ReferenceType  type) {
   return
@@ -50,6 +50,7 @@ class Reflog {
   bool AddCatalog(const shash::Any &catalog);
   bool AddHistory(const shash::Any &history);
   bool AddMetainfo(const shash::Any &metainfo);
+  bool AddDictionary(const shash::Any &dictionary);
 
   uint64_t CountEntries();
   bool List(SqlReflog::ReferenceType type,
@@ -64,6 +65,7 @@ class Reflog {
   bool ContainsCatalog(const shash::Any &catalog) const;
   bool ContainsHistory(const shash::Any &history) const;
   bool ContainsMetainfo(const shash::Any &metainfo) const;
+  bool ContainsDictionary(const shash::Any &dictionary) const;
 
   bool GetCatalogTimestamp(const shash::Any &catalog,
                            uint64_t *timestamp) const;
@@ -81,6 +81,8 @@ shash::Suffix SqlReflog::ToSuffix(const ReferenceType type) {
       return shash::kSuffixHistory;
     case kRefMetainfo:
       return shash::kSuffixMetainfo;
+    case kRefDictionary:
+      return shash::kSuffixDictionary;
     default:
       assert(false && "unknown reference type");
   }
@@ -46,7 +46,8 @@ class SqlReflog : public sqlite::Sql {
     kRefCatalog,
     kRefCertificate,
     kRefHistory,
-    kRefMetainfo
+    kRefMetainfo,
+    kRefDictionary
   };
 
   static shash::Suffix ToSuffix(const ReferenceType type);
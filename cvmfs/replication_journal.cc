@@ -0,0 +1,161 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "replication_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <vector>
+
+#include "logging.h"
+#include "smalloc.h"
+#include "util/posix.h"
+#include "util/string.h"
+#include "util_concurrency.h"
+
+using namespace std;  // NOLINT
+
+
+ReplicationJournal::ReplicationJournal(const string &path)
+  : path_(path)
+  , file_(NULL)
+{
+  lock_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  int retval = pthread_mutex_init(lock_, NULL);
+  assert(retval == 0);
+}
+
+
+ReplicationJournal::~ReplicationJournal() {
+  if (file_ != NULL)
+    fclose(file_);
+  pthread_mutex_destroy(lock_);
+  free(lock_);
+}
+
+
+ReplicationJournal *ReplicationJournal::Open(const string &path) {
+  ReplicationJournal *journal = new ReplicationJournal(path);
+  if (!journal->Load()) {
+    delete journal;
+    return NULL;
+  }
+  return journal;
+}
+
+
+bool ReplicationJournal::Load() {
+  string content;
+  const int fd = open(path_.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    const bool retval = SafeReadToString(fd, &content);
+    close(fd);
+    if (!retval) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "failed to read journal %s",
+               path_.c_str());
+      return false;
+    }
+  }
+
+  const vector<string> lines = SplitString(content, '\n');
+  for (unsigned i = 0; i < lines.size(); ++i) {
+    if (lines[i].length() < 3)
+      continue;
+    const string hex = lines[i].substr(2);
+    const shash::Any hash = shash::MkFromSuffixedHexPtr(shash::HexPtr(hex));
+    // Discards truncated and garbled lines
+    if (hash.IsNull() || (hash.ToString(true) != hex) || (lines[i][1] != ' '))
+      continue;
+    switch (lines[i][0]) {
+      case kTypeChunksComplete:
+        chunks_complete_.insert(hash);
+        break;
+      case kTypeCatalogComplete:
+        catalogs_complete_.insert(hash);
+        break;
+      default:
+        break;
+    }
+  }
+
+  file_ = fopen(path_.c_str(), "a");
+  if (file_ == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to open journal %s (errno: %d)",
+             path_.c_str(), errno);
+    return false;
+  }
+  // Terminate a truncated last line so that new entries start on a fresh line
+  if (!content.empty() && (*content.rbegin() != '\n')) {
+    if ((fputc('\n', file_) == EOF) || (fflush(file_) != 0))
+      return false;
+  }
+  return true;
+}
+
+
+bool ReplicationJournal::Append(
+  const char type,
+  const shash::Any &catalog_hash,
+  set<shash::Any> *entries)
+{
+  MutexLockGuard guard(lock_);
+  if (entries->find(catalog_hash) != entries->end())
+    return true;
+  const string line =
+    string(1, type) + " " + catalog_hash.ToString(true) + "\n";
+  if ((fputs(line.c_str(), file_) == EOF) || (fflush(file_) != 0)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to write to journal %s",
+             path_.c_str());
+    return false;
+  }
+  entries->insert(catalog_hash);
+  return true;
+}
+
+
+bool ReplicationJournal::MarkChunksComplete(const shash::Any &catalog_hash) {
+  return Append(kTypeChunksComplete, catalog_hash, &chunks_complete_);
+}
+
+
+bool ReplicationJournal::MarkCatalogComplete(const shash::Any &catalog_hash) {
+  return Append(kTypeCatalogComplete, catalog_hash, &catalogs_complete_);
+}
+
+
+bool ReplicationJournal::HasChunksComplete(
+  const shash::Any &catalog_hash) const
+{
+  MutexLockGuard guard(lock_);
+  return chunks_complete_.find(catalog_hash) != chunks_complete_.end();
+}
+
+
+bool ReplicationJournal::HasCatalogComplete(
+  const shash::Any &catalog_hash) const
+{
+  MutexLockGuard guard(lock_);
+  return catalogs_complete_.find(catalog_hash) != catalogs_complete_.end();
+}
+
+
+unsigned ReplicationJournal::GetNumEntries() const {
+  MutexLockGuard guard(lock_);
+  return chunks_complete_.size() + catalogs_complete_.size();
+}
+
+
+bool ReplicationJournal::Remove() {
+  MutexLockGuard guard(lock_);
+  if (file_ != NULL)
+    fclose(file_);
+  file_ = NULL;
+  chunks_complete_.clear();
+  catalogs_complete_.clear();
+  return (unlink(path_.c_str()) == 0) || (errno == ENOENT);
+}
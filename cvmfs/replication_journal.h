@@ -0,0 +1,77 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_REPLICATION_JOURNAL_H_
+#define CVMFS_REPLICATION_JOURNAL_H_
+
+#include <pthread.h>
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+#include "hash.h"
+#include "util/single_copy.h"
+
+/**
+ * Persistent record of the progress of a replication, so that an interrupted
+ * replication can resume where it stopped.  The journal remembers catalogs
+ * whose chunks are all stored and catalogs that are completely replicated,
+ * including the catalogs they refer to.  Since catalogs are content
+ * addressed, the entries stay valid for later replication runs as long as the
+ * target storage keeps the objects.  The journal should be removed once the
+ * replication succeeded or the target storage was garbage collected.
+ *
+ * Entries are appended to a text file, one "<type> <hash>" line per entry,
+ * and flushed immediately.  A truncated last line from an interrupted write is
+ * ignored on opening.  The journal is thread-safe.
+ */
+class ReplicationJournal : SingleCopy {
+ public:
+  /**
+   * Loads the entries of an existing journal file or creates an empty one.
+   * Returns NULL if the file cannot be opened for appending.
+   */
+  static ReplicationJournal *Open(const std::string &path);
+  ~ReplicationJournal();
+
+  /**
+   * The caller must make sure that all the chunks of the catalog are stored
+   * in the target storage.
+   */
+  bool MarkChunksComplete(const shash::Any &catalog_hash);
+  /**
+   * The caller must make sure that the catalog and its entire subtree are
+   * stored in the target storage.
+   */
+  bool MarkCatalogComplete(const shash::Any &catalog_hash);
+
+  bool HasChunksComplete(const shash::Any &catalog_hash) const;
+  bool HasCatalogComplete(const shash::Any &catalog_hash) const;
+
+  /**
+   * Deletes the journal file.  The object must not be used afterwards.
+   */
+  bool Remove();
+
+  unsigned GetNumEntries() const;
+  std::string path() const { return path_; }
+
+ private:
+  static const char kTypeChunksComplete = 'L';
+  static const char kTypeCatalogComplete = 'T';
+
+  explicit ReplicationJournal(const std::string &path);
+  bool Load();
+  bool Append(const char type, const shash::Any &catalog_hash,
+              std::set<shash::Any> *entries);
+
+  std::string path_;
+  FILE *file_;
+  std::set<shash::Any> chunks_complete_;
+  std::set<shash::Any> catalogs_complete_;
+  pthread_mutex_t *lock_;
+};
+
+#endif  // CVMFS_REPLICATION_JOURNAL_H_
@@ -67,12 +67,129 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
       }
       return 0;
     }
+  } else if (HasPrefix(header_line, "ETag:", true)) {
+    const size_t end = header_line.find_last_not_of(" \t\r\n");
+    if (end != string::npos && end >= 5)
+      info->etag = Trim(header_line.substr(5, end - 4));
   }
 
   return num_bytes;
 }
 
 
+/**
+ * Called by curl for the response body.  Only the replies to multipart
+ * initiate and complete requests and to multi-object deletes carry
+ * information, the rest is discarded.
+ */
+static size_t CallbackCurlBody(char *ptr, size_t size, size_t nmemb,
+                               void *info_link) {
+  const size_t num_bytes = size*nmemb;
+  JobInfo *info = static_cast<JobInfo *>(info_link);
+  if ((info->request == JobInfo::kReqMultipartInit) ||
+      (info->request == JobInfo::kReqMultipartComplete) ||
+      (info->request == JobInfo::kReqDeleteMulti))
+  {
+    info->response_body.append(ptr, num_bytes);
+  }
+  return num_bytes;
+}
+
+
+/**
+ * Returns the text of the first <tag>...</tag> element or the empty string.
+ */
+static string GetXmlElement(const string &xml, const string &tag) {
+  const string open_tag = "<" + tag + ">";
+  const string close_tag = "</" + tag + ">";
+  const size_t begin = xml.find(open_tag);
+  if (begin == string::npos)
+    return "";
+  const size_t end = xml.find(close_tag, begin + open_tag.length());
+  if (end == string::npos)
+    return "";
+  return xml.substr(begin + open_tag.length(),
+                    end - begin - open_tag.length());
+}
+
+
+/**
+ * Checks the response body of successful multipart requests.  The initiate
+ * request returns the upload id.  The complete request can fail after the
+ * server has sent "200 OK", in which case the body is an error document.  So
+ * can the individual keys of a multi-object delete.
+ */
+static void VerifyResponseBody(JobInfo *info) {
+  if (info->error_code != kFailOk)
+    return;
+
+  if (info->request == JobInfo::kReqMultipartInit) {
+    info->upload_id = GetXmlElement(info->response_body, "UploadId");
+    if (info->upload_id.empty()) {
+      LogCvmfs(kLogS3Fanout, kLogStderr, "no upload id for %s",
+               info->object_key.c_str());
+      info->error_code = kFailOther;
+    }
+  } else if (info->request == JobInfo::kReqMultipartComplete) {
+    if (info->response_body.find("<Error>") != string::npos) {
+      LogCvmfs(kLogS3Fanout, kLogStderr, "failed to complete %s: %s",
+               info->object_key.c_str(),
+               GetXmlElement(info->response_body, "Message").c_str());
+      info->error_code = kFailOther;
+    }
+  } else if (info->request == JobInfo::kReqDeleteMulti) {
+    if (info->response_body.find("<Error>") != string::npos) {
+      LogCvmfs(kLogS3Fanout, kLogStderr, "failed to delete %s: %s",
+               GetXmlElement(info->response_body, "Key").c_str(),
+               GetXmlElement(info->response_body, "Message").c_str());
+      info->error_code = kFailOther;
+    }
+  }
+}
+
+
+/**
+ * The body of the request that assembles the uploaded parts into the final
+ * object.  Parts are numbered from 1 in the order of the etags.
+ */
+string MkCompleteMultipartBody(const vector<string> &etags) {
+  string body = "<CompleteMultipartUpload>";
+  for (unsigned i = 0; i < etags.size(); ++i) {
+    body += "<Part><PartNumber>" + StringifyInt(i + 1) + "</PartNumber>" +
+            "<ETag>" + etags[i] + "</ETag></Part>";
+  }
+  body += "</CompleteMultipartUpload>";
+  return body;
+}
+
+
+/**
+ * The body of a multi-object delete request.  In quiet mode, the reply lists
+ * only the keys that could not be deleted.  S3 accepts up to 1000 keys.
+ */
+string MkDeleteObjectsBody(const vector<string> &object_keys) {
+  string body = "<Delete><Quiet>true</Quiet>";
+  for (unsigned i = 0; i < object_keys.size(); ++i)
+    body += "<Object><Key>" + object_keys[i] + "</Key></Object>";
+  body += "</Delete>";
+  return body;
+}
+
+
+/**
+ * The number of keys that failed to be deleted by a multi-object delete.
+ */
+unsigned CountDeleteErrors(const string &response_body) {
+  unsigned num_errors = 0;
+  size_t pos = 0;
+  while ((pos = response_body.find("<Error>", pos)) != string::npos) {
+    ++num_errors;
+    ++pos;
+  }
+  return num_errors;
+}
+
+
 /**
  * Called by curl for every new chunk to upload.
  */
@@ -341,6 +458,8 @@ CURL *S3FanoutManager::AcquireCurlHandle() const {
     assert(retval == CURLE_OK);
     retval = curl_easy_setopt(handle, CURLOPT_READFUNCTION, CallbackCurlData);
     assert(retval == CURLE_OK);
+    retval = curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, CallbackCurlBody);
+    assert(retval == CURLE_OK);
   } else {
     handle = *(pool_handles_idle_->begin());
     pool_handles_idle_->erase(pool_handles_idle_->begin());
@@ -514,8 +633,11 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   info->num_retries = 0;
   info->backoff_ms = 0;
   info->http_headers = NULL;
+  info->response_body.clear();
+  info->etag.clear();
 
   InitializeDnsSettings(handle, info->hostname);
+  const string signed_key = info->object_key + GetSubresource(info);
 
   // HEAD or PUT
   shash::Any content_md5;
@@ -523,7 +645,8 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   string timestamp;
   CURLcode retval;
   if (info->request == JobInfo::kReqHead ||
-      info->request == JobInfo::kReqDelete)
+      info->request == JobInfo::kReqDelete ||
+      info->request == JobInfo::kReqMultipartAbort)
   {
     retval = curl_easy_setopt(handle, CURLOPT_UPLOAD, 0);
     assert(retval == CURLE_OK);
@@ -539,11 +662,11 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
                                            req.c_str(),
                                            "",
                                            info->bucket,
-                                           info->object_key).c_str());
+                                           signed_key).c_str());
     info->http_headers =
         curl_slist_append(info->http_headers, "Content-Length: 0");
 
-    if (info->request == JobInfo::kReqDelete) {
+    if (info->request != JobInfo::kReqHead) {
       retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, req.c_str());
       assert(retval == CURLE_OK);
     } else {
@@ -551,7 +674,16 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
       assert(retval == CURLE_OK);
     }
   } else {
-    retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
+    // Initiating and completing multipart uploads and multi-object deletes
+    // are POST requests
+    if (info->request == JobInfo::kReqMultipartInit ||
+        info->request == JobInfo::kReqMultipartComplete ||
+        info->request == JobInfo::kReqDeleteMulti)
+    {
+      retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "POST");
+    } else {
+      retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
+    }
     assert(retval == CURLE_OK);
     retval = curl_easy_setopt(handle, CURLOPT_UPLOAD, 1);
     assert(retval == CURLE_OK);
@@ -599,19 +731,27 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
                           ("Content-MD5: " + content_md5_base64).c_str());
 
     // Authorization
+    const string method =
+        (info->request == JobInfo::kReqMultipartInit ||
+         info->request == JobInfo::kReqMultipartComplete ||
+         info->request == JobInfo::kReqDeleteMulti) ? "POST" : "PUT";
+    const string content_type =
+        (info->request == JobInfo::kReqMultipartComplete ||
+         info->request == JobInfo::kReqDeleteMulti) ?
+        "application/xml" : "binary/octet-stream";
     timestamp = RfcTimestamp();
     info->http_headers =
         curl_slist_append(info->http_headers,
                           MkAuthoritzation(info->access_key,
                                            info->secret_key,
-                                           timestamp, "binary/octet-stream",
-                                           "PUT", content_md5_base64,
+                                           timestamp, content_type,
+                                           method, content_md5_base64,
                                            info->bucket,
-                                           (info->object_key)).c_str());
+                                           signed_key).c_str());
 
     info->http_headers =
         curl_slist_append(info->http_headers,
-                          "Content-Type: binary/octet-stream");
+                          ("Content-Type: " + content_type).c_str());
 
     if (info->request == JobInfo::kReqPutNoCache) {
       std::string cache_control = "Cache-Control: no-cache";
@@ -642,6 +782,9 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   retval = curl_easy_setopt(handle, CURLOPT_WRITEHEADER,
                             static_cast<void *>(info));
   assert(retval == CURLE_OK);
+  retval = curl_easy_setopt(handle, CURLOPT_WRITEDATA,
+                            static_cast<void *>(info));
+  assert(retval == CURLE_OK);
   retval = curl_easy_setopt(handle, CURLOPT_READDATA,
                             static_cast<void *>(info));
   assert(retval == CURLE_OK);
@@ -671,12 +814,35 @@ void S3FanoutManager::SetUrlOptions(JobInfo *info) const {
   assert(retval == CURLE_OK);
   pthread_mutex_unlock(lock_options_);
 
-  string url = MkUrl(info->hostname, info->bucket, (info->object_key));
+  string url = MkUrl(info->hostname, info->bucket,
+                     info->object_key + GetSubresource(info));
   retval = curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
   assert(retval == CURLE_OK);
 }
 
 
+/**
+ * The query string that selects the multipart upload operation.  It is part
+ * of the signed resource, too.
+ */
+string S3FanoutManager::GetSubresource(const JobInfo *info) const {
+  switch (info->request) {
+    case JobInfo::kReqMultipartInit:
+      return "?uploads";
+    case JobInfo::kReqMultipartPart:
+      return "?partNumber=" + StringifyInt(info->part_number) +
+             "&uploadId=" + info->upload_id;
+    case JobInfo::kReqMultipartComplete:
+    case JobInfo::kReqMultipartAbort:
+      return "?uploadId=" + info->upload_id;
+    case JobInfo::kReqDeleteMulti:
+      return "?delete";
+    default:
+      return "";
+  }
+}
+
+
 /**
  * Adds transfer time and uploaded bytes to the global counters.
  */
@@ -772,6 +938,7 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       info->error_code = kFailOther;
       break;
   }
+  VerifyResponseBody(info);
 
   // Transform HEAD to PUT request
   if ((info->error_code == kFailNotFound) &&
@@ -805,8 +972,13 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     try_again = CanRetry(info);
   }
   if (try_again) {
+    info->response_body.clear();
+    info->etag.clear();
     if (info->request == JobInfo::kReqPut ||
-        info->request == JobInfo::kReqPutNoCache) {
+        info->request == JobInfo::kReqPutNoCache ||
+        info->request == JobInfo::kReqMultipartPart ||
+        info->request == JobInfo::kReqMultipartComplete ||
+        info->request == JobInfo::kReqDeleteMulti) {
       LogCvmfs(kLogS3Fanout, kLogDebug, "Trying again to upload %s",
                info->object_key.c_str());
       // Reset origin
@@ -1096,6 +1268,8 @@ bool S3FanoutManager::DoSingleJob(JobInfo *info) const {
   SetUrlOptions(info);
 
   CURLcode resl = curl_easy_perform(handle);
+  if (resl == CURLE_OK)
+    VerifyResponseBody(info);
   if (resl == CURLE_OK && info->error_code == kFailOk) {
     retme = true;
   }
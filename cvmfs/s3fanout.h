@@ -92,6 +92,11 @@ struct JobInfo {
     kReqPut,
     kReqPutNoCache,
     kReqDelete,
+    kReqMultipartInit,
+    kReqMultipartPart,
+    kReqMultipartComplete,
+    kReqMultipartAbort,
+    kReqDeleteMulti,
   };
 
   Origin origin;
@@ -110,6 +115,11 @@ struct JobInfo {
   bool test_and_set;
   void *callback;  // Callback to be called when job is finished
   MemoryMappedFile *mmf;
+  // Multipart uploads: the upload id is returned by kReqMultipartInit and
+  // identifies the parts, the etag is returned for every uploaded part
+  std::string upload_id;
+  unsigned part_number;
+  std::string etag;
 
   // One constructor per destination + head request
   JobInfo() { JobInfoInit(); }
@@ -148,6 +158,7 @@ struct JobInfo {
     origin_mem.data = NULL;
     callback = NULL;
     mmf = NULL;
+    part_number = 0;
     origin_file = NULL;
     request = kReqPut;
     error_code = kFailOk;
@@ -165,8 +176,14 @@ struct JobInfo {
   Failures error_code;
   unsigned char num_retries;
   unsigned backoff_ms;
+  std::string response_body;
 };  // JobInfo
 
+
+std::string MkCompleteMultipartBody(const std::vector<std::string> &etags);
+std::string MkDeleteObjectsBody(const std::vector<std::string> &object_keys);
+unsigned CountDeleteErrors(const std::string &response_body);
+
 struct S3FanOutDnsEntry {
   S3FanOutDnsEntry() : counter(0), dns_name(), ip(), port("80"),
      clist(NULL), sharehandle(NULL) {}
@@ -232,6 +249,7 @@ class S3FanoutManager : SingleCopy {
                                const std::string &content_md5_base64,
                                const std::string &bucket,
                                const std::string &object_key) const;
+  std::string GetSubresource(const JobInfo *info) const;
   std::string MkUrl(const std::string &host,
                     const std::string &bucket,
                     const std::string &objkey2) const {
@@ -19,10 +19,11 @@ cvmfs_server_check() {
   local check_integrity=0
   local subtree_path=""
   local tag=
+  local num_threads_param=
 
   # optional parameter handling
   OPTIND=1
-  while getopts "cit:s:" option
+  while getopts "cit:s:j:" option
   do
     case $option in
       c)
@@ -37,6 +38,9 @@ cvmfs_server_check() {
       s)
         subtree_path="$OPTARG"
       ;;
+      j)
+        num_threads_param="-j $OPTARG"
+      ;;
       ?)
         shift $(($OPTIND-2))
         usage "Command check: Unrecognized option: $1"
@@ -99,6 +103,7 @@ cvmfs_server_check() {
   local check_cmd
   check_cmd="$(__swissknife_cmd dbg) check $tag        \
                      $check_chunks_param               \
+                     $num_threads_param                \
                      $log_level_param                  \
                      $subtree_param                    \
                      -r $url                           \
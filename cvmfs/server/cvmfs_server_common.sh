@@ -465,6 +465,9 @@ sign_manifest() {
   if [ x"$CVMFS_GARBAGE_COLLECTION" = x"true" ]; then
     sign_command="$sign_command -g"
   fi
+  if [ x"$CVMFS_COMPRESSION_DICTIONARY" != x"" ]; then
+    sign_command="$sign_command -Y $CVMFS_COMPRESSION_DICTIONARY"
+  fi
   if [ x"$CVMFS_CATALOG_ALT_PATHS" = x"true" ]; then
     sign_command="$sign_command -A"
   fi
@@ -244,6 +244,11 @@ __run_gc() {
     additional_switches="$additional_switches -L $CVMFS_GC_DELETION_LOG"
   fi
 
+  # rebuild the filter of uploaded objects that lets publish skip re-uploads
+  if is_stratum0 $name && [ x"$CVMFS_UPLOAD_EXISTENCE_FILTER" = x"true" ]; then
+    additional_switches="$additional_switches -E ${CVMFS_SPOOL_DIR}/upload_existence_filter"
+  fi
+
   # do it!
   local user_shell="$(get_user_shell $name)"
 
@@ -273,6 +278,11 @@ __run_gc() {
                                             -R $(get_reflog_checksum $name) \
                                             $additional_switches"
 
+  # objects of an interrupted snapshot might be swept, don't resume from them
+  if is_stratum1 $name && [ $dry_run -eq 0 ]; then
+    $user_shell "rm -f ${CVMFS_SPOOL_DIR}/pull_journal"
+  fi
+
   if ! $user_shell "$gc_command"; then
     [ $dry_run -ne 0 ] || to_syslog_for_repo $name "failed to garbage collect"
     return 6
@@ -178,6 +178,9 @@ cvmfs_server_publish() {
        -l $CVMFS_MIN_CHUNK_SIZE \
        -a $CVMFS_AVG_CHUNK_SIZE \
        -h $CVMFS_MAX_CHUNK_SIZE"
+      if [ "x$CVMFS_CHUNKING_ALGORITHM" != "x" ]; then
+        sync_command="$sync_command -G $CVMFS_CHUNKING_ALGORITHM"
+      fi
     fi
     if [ "x$CVMFS_AUTOCATALOGS" = "xtrue" ]; then
       sync_command="$sync_command -A"
@@ -206,6 +209,15 @@ cvmfs_server_publish() {
     if [ "x$CVMFS_MAXIMAL_CONCURRENT_WRITES" != "x" ]; then
       sync_command="$sync_command -q $CVMFS_MAXIMAL_CONCURRENT_WRITES"
     fi
+    if [ "x$CVMFS_SCAN_THREADS" != "x" ]; then
+      sync_command="$sync_command -P $CVMFS_SCAN_THREADS"
+    fi
+    if [ "x$CVMFS_OBJECT_PACK_THRESHOLD" != "x" ]; then
+      sync_command="$sync_command -B $CVMFS_OBJECT_PACK_THRESHOLD"
+    fi
+    if [ "x$CVMFS_UPLOAD_EXISTENCE_FILTER" = "xtrue" ]; then
+      sync_command="$sync_command -E ${CVMFS_SPOOL_DIR}/upload_existence_filter"
+    fi
     if [ "x${CVMFS_VOMS_AUTHZ}" != x ]; then
       sync_command="$sync_command -V"
     fi
@@ -136,6 +136,7 @@ __do_snapshot() {
         -w $stratum1                                   \
         -r ${upstream}                                 \
         -x ${spool_dir}/tmp                            \
+        -j ${spool_dir}/pull_journal                   \
         -k $public_key                                 \
         -n $num_workers                                \
         -t $timeout                                    \
@@ -918,7 +918,7 @@ Supported Commands:
                   [-g disable auto tags] [-G Set timespan for auto tags]
                   [-a hash algorithm (default: SHA-1)]
                   [-z enable garbage collection] [-v volatile content]
-                  [-Z compression algorithm (default: zlib)]
+                  [-Z compression algorithm [zlib, zstd, lz4, none] (default: zlib)]
                   [-k path to existing keychain] [-p no apache config]
                   [-V VOMS authorization] [-X (external data)]
                   <fully qualified repository name>
@@ -978,6 +978,7 @@ Supported Commands:
                   [-i check data integrity] (may take some time)]
                   [-t tag (check given tag instead of trunk)]
                   [-s path to nested catalog subtree to check]
+                  [-j number of parallel threads]
                   <fully qualified name>
                   Checks if the repository is sane
   transaction     <fully qualified name>
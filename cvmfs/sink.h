@@ -5,7 +5,11 @@
 #ifndef CVMFS_SINK_H_
 #define CVMFS_SINK_H_
 
+#include <errno.h>
 #include <stdint.h>
+#include <unistd.h>
+
+#include <cstdio>
 
 namespace cvmfs {
 
@@ -31,6 +35,31 @@ class Sink {
   virtual int Reset() = 0;
 };
 
+
+/**
+ * Appends to an open file.
+ */
+class FileSink : public Sink {
+ public:
+  explicit FileSink(FILE *file) : file_(file) { }
+  virtual ~FileSink() { }
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    const size_t written = fwrite(buf, 1, sz, file_);
+    if ((written != sz) || ferror(file_))
+      return (errno != 0) ? -errno : -EIO;
+    return written;
+  }
+  virtual int Reset() {
+    if ((fflush(file_) != 0) || (ftruncate(fileno(file_), 0) != 0))
+      return -errno;
+    rewind(file_);
+    return 0;
+  }
+
+ private:
+  FILE *file_;
+};
+
 }  // namespace cvmfs
 
 #endif  // CVMFS_SINK_H_
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
 
 #include "platform.h"
 #include "smalloc.h"
@@ -20,6 +21,82 @@ namespace CVMFS_NAMESPACE_GUARD {
 
 namespace perf {
 
+__thread unsigned tls_counter_shard_ = 0;
+
+/**
+ * Source of shard indexes for threads that touch a sharded counter for the
+ * first time.  Threads are assigned round-robin.
+ */
+static atomic_int32 next_counter_shard_ = 0;
+
+
+/**
+ * Called once per thread.  Returns the shard index plus one.
+ */
+unsigned AssignCounterShard() {
+  unsigned shard =
+    (static_cast<uint32_t>(atomic_xadd32(&next_counter_shard_, 1)) %
+     Counter::kNumShards) + 1;
+  tls_counter_shard_ = shard;
+  return shard;
+}
+
+
+/**
+ * Copies the current (aggregated) value into a plain, unsharded counter.
+ */
+Counter::Counter(const Counter &other) : shards_(NULL) {
+  atomic_init64(&counter_);
+  atomic_write64(&counter_, const_cast<Counter &>(other).Get());
+}
+
+
+Counter::~Counter() {
+  free(shards_);
+}
+
+
+/**
+ * Converts the counter into a sharded counter.  The current value is
+ * preserved.  Must be called before the counter is shared among threads.
+ */
+void Counter::MakeSharded() {
+  if (shards_ != NULL)
+    return;
+  void *buffer;
+  int retval = posix_memalign(&buffer, sizeof(CounterShard),
+                              kNumShards * sizeof(CounterShard));
+  assert(retval == 0);
+  shards_ = reinterpret_cast<CounterShard *>(buffer);
+  for (unsigned i = 0; i < kNumShards; ++i)
+    atomic_init64(&shards_[i].value);
+  atomic_write64(&shards_[0].value, atomic_read64(&counter_));
+}
+
+
+int64_t Counter::GetSharded() {
+  int64_t result = 0;
+  for (unsigned i = 0; i < kNumShards; ++i)
+    result += atomic_read64(&shards_[i].value);
+  return result;
+}
+
+
+/**
+ * For sharded counters, the first slot takes the value and all others are
+ * reset.  Concurrent updates during Set() may or may not be preserved.
+ */
+void Counter::Set(const int64_t val) {
+  if (shards_ == NULL) {
+    atomic_write64(&counter_, val);
+    return;
+  }
+  for (unsigned i = 1; i < kNumShards; ++i)
+    atomic_write64(&shards_[i].value, 0);
+  atomic_write64(&shards_[0].value, val);
+}
+
+
 std::string Counter::ToString() { return StringifyInt(Get()); }
 std::string Counter::Print() { return StringifyInt(Get()); }
 std::string Counter::PrintK() { return StringifyInt(Get() / 1000); }
@@ -101,6 +178,17 @@ Counter *Statistics::Register(const string &name, const string &desc) {
 }
 
 
+/**
+ * Registers a counter that is sharded among threads, see Counter.  Use for
+ * event counters that are incremented concurrently on the hot path.
+ */
+Counter *Statistics::RegisterSharded(const string &name, const string &desc) {
+  Counter *counter = Register(name, desc);
+  counter->MakeSharded();
+  return counter;
+}
+
+
 Statistics::Statistics() {
   lock_ =
     reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
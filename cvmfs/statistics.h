@@ -21,17 +21,69 @@ namespace CVMFS_NAMESPACE_GUARD {
 
 namespace perf {
 
+/**
+ * Per-thread slot of a sharded counter.  Padded to a full cache line so that
+ * threads updating different slots do not invalidate each other's caches.
+ */
+struct CounterShard {
+  atomic_int64 value;
+  char padding[64 - sizeof(atomic_int64)];
+};
+
+/**
+ * Thread-local shard index plus one; zero means not yet assigned.
+ */
+extern __thread unsigned tls_counter_shard_;
+unsigned AssignCounterShard();
+
+
 /**
  * A wrapper around an atomic 64bit signed integer.
+ *
+ * Counters that are updated from many threads on the hot path can be turned
+ * into sharded counters by MakeSharded().  A sharded counter spreads its
+ * updates over kNumShards cache-line sized slots, one per thread (modulo the
+ * number of slots), and aggregates the slots on read.  Get() is then no longer
+ * an atomic snapshot and the return value of Xadd() is only approximate, so
+ * sharding should be used for event counters only.
  */
 class Counter {
  public:
-  Counter() { atomic_init64(&counter_); }
-  void Inc() { atomic_inc64(&counter_); }
-  void Dec() { atomic_dec64(&counter_); }
-  int64_t Get() { return atomic_read64(&counter_); }
-  void Set(const int64_t val) { atomic_write64(&counter_, val); }
-  int64_t Xadd(const int64_t delta) { return atomic_xadd64(&counter_, delta); }
+  static const unsigned kNumShards = 32;
+
+  Counter() : shards_(NULL) { atomic_init64(&counter_); }
+  Counter(const Counter &other);
+  ~Counter();
+  void MakeSharded();
+  bool IsSharded() const { return shards_ != NULL; }
+
+  void Inc() {
+    if (shards_ == NULL) {
+      atomic_inc64(&counter_);
+      return;
+    }
+    atomic_inc64(&shards_[GetShard()].value);
+  }
+  void Dec() {
+    if (shards_ == NULL) {
+      atomic_dec64(&counter_);
+      return;
+    }
+    atomic_dec64(&shards_[GetShard()].value);
+  }
+  int64_t Get() {
+    if (shards_ == NULL)
+      return atomic_read64(&counter_);
+    return GetSharded();
+  }
+  void Set(const int64_t val);
+  int64_t Xadd(const int64_t delta) {
+    if (shards_ == NULL)
+      return atomic_xadd64(&counter_, delta);
+    int64_t result = GetSharded();
+    atomic_xadd64(&shards_[GetShard()].value, delta);
+    return result;
+  }
 
   std::string Print();
   std::string PrintK();
@@ -42,7 +94,20 @@ class Counter {
   std::string ToString();
 
  private:
+  Counter& operator=(const Counter &other);
+  static unsigned GetShard() {
+    unsigned shard = tls_counter_shard_;
+    if (shard == 0)
+      shard = AssignCounterShard();
+    return shard - 1;
+  }
+  int64_t GetSharded();
+
   atomic_int64 counter_;
+  /**
+   * NULL for plain counters, kNumShards slots for sharded counters.
+   */
+  CounterShard *shards_;
 };
 
 // perf::Func(Counter) is more clear to read in the code
@@ -68,6 +133,7 @@ class Statistics {
   ~Statistics();
   Statistics *Fork();
   Counter *Register(const std::string &name, const std::string &desc);
+  Counter *RegisterSharded(const std::string &name, const std::string &desc);
   Counter *Lookup(const std::string &name);
   std::string LookupDesc(const std::string &name);
   std::string PrintList(const PrintOptions print_options);
@@ -12,6 +12,8 @@
 #include <unistd.h>
 
 #include <cassert>
+#include <cstdlib>
+#include <string>
 #include <vector>
 
 #include "logging.h"
@@ -198,6 +200,30 @@ manifest::Manifest* Command::FetchRemoteManifest(
 }
 
 
+/**
+ * Downloads the (decompressed) zstd dictionary referenced by a manifest.
+ */
+bool Command::FetchCompressionDictionary(
+                                        const std::string &repository_url,
+                                        const shash::Any  &dictionary_hash,
+                                        std::string       *dictionary) const {
+  const string url = repository_url + "/data/" + dictionary_hash.MakePath();
+  download::JobInfo download_dictionary(&url, true, false, &dictionary_hash);
+  const download::Failures retval =
+    download_manager()->Fetch(&download_dictionary);
+  if (retval != download::kFailOk) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to fetch compression dictionary "
+                                    "(%d - %s)",
+             retval, download::Code2Ascii(retval));
+    return false;
+  }
+  *dictionary = string(download_dictionary.destination_mem.data,
+                       download_dictionary.destination_mem.pos);
+  free(download_dictionary.destination_mem.data);
+  return true;
+}
+
+
 manifest::Reflog* swissknife::Command::CreateEmptyReflog(
                                               const std::string &temp_directory,
                                               const std::string &repo_name) {
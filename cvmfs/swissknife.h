@@ -100,6 +100,9 @@ class Command {
                              const std::string &repository_url,
                              const std::string &repository_name,
                              const shash::Any  &base_hash = shash::Any()) const;
+  bool FetchCompressionDictionary(const std::string &repository_url,
+                                  const shash::Any  &dictionary_hash,
+                                  std::string       *dictionary) const;
 
   template <class ObjectFetcherT>
   manifest::Reflog* FetchReflog(ObjectFetcherT    *object_fetcher,
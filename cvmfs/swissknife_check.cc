@@ -10,6 +10,7 @@
 #include "swissknife_check.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include <cassert>
@@ -28,13 +29,68 @@
 #include "manifest.h"
 #include "reflog.h"
 #include "shortstring.h"
+#include "sink.h"
 #include "util/pointer.h"
 #include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
+namespace {
+
+/**
+ * Discards downloaded data objects, only their content hash is of interest
+ */
+class NullSink : public cvmfs::Sink {
+ public:
+  virtual int64_t Write(const void *buf, uint64_t sz) { return sz; }
+  virtual int Reset() { return 0; }
+};
+
+}  // anonymous namespace
+
 namespace swissknife {
 
+CommandCheck::CatalogJob::CatalogJob(
+  const string                  &path,
+  const shash::Any              &hash,
+  const uint64_t                 size,
+  const bool                     is_nested_catalog,
+  const catalog::DirectoryEntry *transition_point,
+  CatalogJob                    *parent)
+  : path(path)
+  , hash(hash)
+  , size(size)
+  , is_nested_catalog(is_nested_catalog)
+  , has_transition_point(transition_point != NULL)
+  , transition_point((transition_point != NULL) ? *transition_point
+                                                : catalog::DirectoryEntry())
+  , parent(parent)
+{
+  atomic_init32(&pending);
+  atomic_inc32(&pending);
+}
+
+
+CommandCheck::CommandCheck()
+  : check_chunks_(false)
+  , verify_content_(false)
+  , is_remote_(false)
+  , num_threads_(1)
+  , catalog_queue_(NULL)
+  , chunk_queue_(NULL)
+{
+  atomic_init32(&num_failures_);
+  int retval = pthread_mutex_init(&lock_counters_, NULL);
+  assert(retval == 0);
+}
+
+
+CommandCheck::~CommandCheck() {
+  pthread_mutex_destroy(&lock_counters_);
+}
+
+
 bool CommandCheck::CompareEntries(const catalog::DirectoryEntry &a,
                                   const catalog::DirectoryEntry &b,
                                   const bool compare_names,
@@ -149,6 +205,63 @@ bool CommandCheck::Exists(const string &file)
 }
 
 
+/**
+ * Checks a data object referenced by a catalog entry.  In parallel mode, the
+ * check is queued for the chunk workers and failures are counted there.
+ */
+bool CommandCheck::CheckChunk(const shash::Any &hash,
+                              const string     &object_path,
+                              const string     &context)
+{
+  const ChunkJob job(hash, object_path, context);
+  if (chunk_queue_ != NULL) {
+    chunk_queue_->Enqueue(job);
+    return true;
+  }
+  return VerifyChunk(job);
+}
+
+
+bool CommandCheck::VerifyChunk(const ChunkJob &job) {
+  LogCvmfs(kLogCvmfs, kLogVerboseMsg, "[data object] %s",
+           job.object_path.c_str());
+  bool exists;
+  if (verify_content_) {
+    if (VerifyContentHash(job, &exists))
+      return true;
+  } else {
+    exists = Exists(job.object_path);
+    if (exists)
+      return true;
+  }
+
+  LogCvmfs(kLogCvmfs, kLogStderr, "data chunk %s (%s) %s",
+           job.hash.ToStringWithSuffix().c_str(), job.context.c_str(),
+           exists ? "corrupted" : "missing");
+  return false;
+}
+
+
+/**
+ * Reads the data object and compares its content hash.  Objects are stored
+ * as they are hashed, so the object does not need to be decompressed.
+ */
+bool CommandCheck::VerifyContentHash(const ChunkJob &job, bool *exists) {
+  if (!is_remote_) {
+    shash::Any content_hash(job.hash.algorithm, job.hash.suffix);
+    *exists = shash::HashFile(job.object_path, &content_hash);
+    return *exists && (content_hash == job.hash);
+  }
+
+  const string url = repo_base_path_ + "/" + job.object_path;
+  NullSink sink;
+  download::JobInfo download_object(&url, false, false, &sink, &job.hash);
+  const download::Failures retval = download_manager()->Fetch(&download_object);
+  *exists = (retval == download::kFailOk) || (retval == download::kFailBadData);
+  return retval == download::kFailOk;
+}
+
+
 /**
  * Copies a file from the repository into a temporary file.
  */
@@ -301,11 +414,8 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
       string chunk_path = "data/" + entries[i].checksum().MakePath();
       if (entries[i].IsDirectory())
         chunk_path += shash::kSuffixMicroCatalog;
-      if (!Exists(chunk_path)) {
-        LogCvmfs(kLogCvmfs, kLogStderr, "data chunk %s (%s) missing",
-                 entries[i].checksum().ToString().c_str(), full_path.c_str());
+      if (!CheckChunk(entries[i].checksum(), chunk_path, full_path.ToString()))
         retval = false;
-      }
     }
 
     // Add hardlinks to counting map
@@ -458,15 +568,11 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
         if (check_chunks_) {
           const shash::Any &chunk_hash = this_chunk.content_hash();
           const string chunk_path = "data/" + chunk_hash.MakePath();
-          if (!Exists(chunk_path)) {
-            LogCvmfs(kLogCvmfs, kLogStderr, "partial data chunk %s (%s -> "
-                                            "offset: %d | size: %d) missing",
-                     this_chunk.content_hash().ToStringWithSuffix().c_str(),
-                     full_path.c_str(),
-                     this_chunk.offset(),
-                     this_chunk.size());
+          const string context = full_path.ToString() + " -> offset: " +
+            StringifyInt(this_chunk.offset()) + " | size: " +
+            StringifyInt(this_chunk.size());
+          if (!CheckChunk(chunk_hash, chunk_path, context))
             retval = false;
-          }
         }
       }
 
@@ -519,13 +625,18 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
 
 string CommandCheck::DownloadPiece(const shash::Any catalog_hash) {
   string source = "data/" + catalog_hash.MakePath();
-  const string dest = temp_directory_ + "/" + catalog_hash.ToString();
+  // Unique per call, the same catalog might be checked by several threads
+  const string dest = CreateTempPath(temp_directory_ + "/catalog",
+                                     kDefaultFileMode);
+  if (dest.empty())
+    return "";
   const string url = repo_base_path_ + "/" + source;
   download::JobInfo download_catalog(&url, true, false, &dest, &catalog_hash);
   download::Failures retval = download_manager()->Fetch(&download_catalog);
   if (retval != download::kFailOk) {
     LogCvmfs(kLogCvmfs, kLogStderr, "failed to download catalog %s (%d)",
              catalog_hash.ToString().c_str(), retval);
+    unlink(dest.c_str());
     return "";
   }
 
@@ -535,9 +646,14 @@ string CommandCheck::DownloadPiece(const shash::Any catalog_hash) {
 
 string CommandCheck::DecompressPiece(const shash::Any catalog_hash) {
   string source = "data/" + catalog_hash.MakePath();
-  const string dest = temp_directory_ + "/" + catalog_hash.ToString();
-  if (!zlib::DecompressPath2Path(source, dest))
+  const string dest = CreateTempPath(temp_directory_ + "/catalog",
+                                     kDefaultFileMode);
+  if (dest.empty())
+    return "";
+  if (!zlib::DecompressPath2Path(source, dest)) {
+    unlink(dest.c_str());
     return "";
+  }
 
   return dest;
 }
@@ -619,21 +735,21 @@ bool CommandCheck::FindSubtreeRootCatalog(const string &subtree_path,
 
 
 /**
- * Recursion on nested catalog level.  No ownership of computed_counters.
+ * Checks a single catalog and creates the jobs for its nested catalogs.  The
+ * statistics counters are verified separately by VerifyCounters().
  */
-bool CommandCheck::InspectTree(const string                  &path,
-                               const shash::Any              &catalog_hash,
-                               const uint64_t                 catalog_size,
-                               const bool                     is_nested_catalog,
-                               const catalog::DirectoryEntry *transition_point,
-                               catalog::DeltaCounters        *computed_counters)
+bool CommandCheck::InspectCatalog(CatalogJob *job,
+                                  vector<CatalogJob *> *nested_jobs)
 {
+  const string &path = job->path;
+  const shash::Any &catalog_hash = job->hash;
+  catalog::DeltaCounters *computed_counters = &job->computed_counters;
   LogCvmfs(kLogCvmfs, kLogStdout, "[inspecting catalog] %s at %s",
            catalog_hash.ToString().c_str(), path == "" ? "/" : path.c_str());
 
   const catalog::Catalog *catalog = FetchCatalog(path,
                                                  catalog_hash,
-                                                 catalog_size);
+                                                 job->size);
   if (catalog == NULL) {
     LogCvmfs(kLogCvmfs, kLogStderr, "failed to open catalog %s",
              catalog_hash.ToString().c_str());
@@ -661,9 +777,9 @@ bool CommandCheck::InspectTree(const string                  &path,
              path.c_str());
     retval = false;
   }
-  if (is_nested_catalog) {
-    if (transition_point != NULL &&
-        !CompareEntries(*transition_point, root_entry, true, true)) {
+  if (job->is_nested_catalog) {
+    if (job->has_transition_point &&
+        !CompareEntries(job->transition_point, root_entry, true, true)) {
       LogCvmfs(kLogCvmfs, kLogStderr,
                "transition point and root entry differ (%s)", path.c_str());
       retval = false;
@@ -699,7 +815,7 @@ bool CommandCheck::InspectTree(const string                  &path,
     retval = false;
   }
 
-  // Recurse into nested catalogs
+  // Collect nested catalogs
   const catalog::Catalog::NestedCatalogList &nested_catalogs =
     catalog->ListNestedCatalogs();
   const catalog::Catalog::NestedCatalogList own_nested_catalogs =
@@ -745,32 +861,173 @@ bool CommandCheck::InspectTree(const string                  &path,
                i->mountpoint.c_str());
       retval = false;
     } else {
-      catalog::DeltaCounters nested_counters;
       const bool is_nested = true;
-      if (!InspectTree(i->mountpoint.ToString(), i->hash, i->size, is_nested,
-                       &nested_transition_point, &nested_counters))
-        retval = false;
-      nested_counters.PopulateToParent(computed_counters);
+      nested_jobs->push_back(new CatalogJob(i->mountpoint.ToString(), i->hash,
+                                            i->size, is_nested,
+                                            &nested_transition_point, job));
     }
   }
 
-  // Check statistics counters
+  job->stored_counters = catalog->GetCounters();
+  delete catalog;
+  return retval;
+}
+
+
+/**
+ * Compares the statistics counters of a catalog with the counted entries of
+ * the catalog and its nested catalogs.
+ */
+bool CommandCheck::VerifyCounters(CatalogJob *job) {
   // Additionally account for root directory
-  computed_counters->self.directories++;
+  job->computed_counters.self.directories++;
   catalog::Counters compare_counters;
-  compare_counters.ApplyDelta(*computed_counters);
-  const catalog::Counters stored_counters = catalog->GetCounters();
-  if (!CompareCounters(compare_counters, stored_counters)) {
+  compare_counters.ApplyDelta(job->computed_counters);
+  if (!CompareCounters(compare_counters, job->stored_counters)) {
     LogCvmfs(kLogCvmfs, kLogStderr, "statistics counter mismatch [%s]",
-             catalog_hash.ToString().c_str());
-    retval = false;
+             job->hash.ToString().c_str());
+    return false;
   }
+  return true;
+}
 
-  delete catalog;
+
+/**
+ * Recursion on nested catalog level.  No ownership of job.
+ */
+bool CommandCheck::InspectTree(CatalogJob *job) {
+  vector<CatalogJob *> nested_jobs;
+  bool retval = InspectCatalog(job, &nested_jobs);
+
+  for (unsigned i = 0; i < nested_jobs.size(); ++i) {
+    if (!InspectTree(nested_jobs[i]))
+      retval = false;
+    nested_jobs[i]->computed_counters.PopulateToParent(
+      &job->computed_counters);
+    delete nested_jobs[i];
+  }
+
+  if (!VerifyCounters(job))
+    retval = false;
   return retval;
 }
 
 
+/**
+ * Drops a reference to the catalog.  The last reference finishes the catalog
+ * and drops the reference held on the parent catalog in turn.
+ */
+void CommandCheck::ReleaseCatalog(CatalogJob *job) {
+  while ((job != NULL) && (atomic_xadd32(&job->pending, -1) == 1)) {
+    if (!VerifyCounters(job))
+      atomic_inc32(&num_failures_);
+    CatalogJob *parent = job->parent;
+    if (parent != NULL) {
+      MutexLockGuard guard(&lock_counters_);
+      job->computed_counters.PopulateToParent(&parent->computed_counters);
+    }
+    delete job;
+    job = parent;
+  }
+}
+
+
+void CommandCheck::ProcessCatalog(CatalogJob *job) {
+  vector<CatalogJob *> nested_jobs;
+  if (!InspectCatalog(job, &nested_jobs))
+    atomic_inc32(&num_failures_);
+
+  atomic_xadd32(&job->pending, nested_jobs.size());
+  for (unsigned i = 0; i < nested_jobs.size(); ++i) {
+    catalogs_in_flight_.Increment();
+    catalog_queue_->Enqueue(nested_jobs[i]);
+  }
+  ReleaseCatalog(job);
+}
+
+
+void *CommandCheck::MainCatalogWorker(void *data) {
+  CommandCheck *check = static_cast<CommandCheck *>(data);
+
+  while (true) {
+    CatalogJob *next_catalog = check->catalog_queue_->Dequeue();
+    if (next_catalog == NULL) {
+      // Leave the termination marker for the other workers
+      check->catalog_queue_->Enqueue(NULL);
+      break;
+    }
+    check->ProcessCatalog(next_catalog);
+    check->catalogs_in_flight_.Decrement();
+  }
+  return NULL;
+}
+
+
+/**
+ * Checks data objects in batches so that the workers do not contend on the
+ * queue for every object.  For remote repositories, every worker has a HEAD
+ * request (or download) in flight.
+ */
+void *CommandCheck::MainChunkWorker(void *data) {
+  CommandCheck *check = static_cast<CommandCheck *>(data);
+  vector<ChunkJob> batch;
+
+  while (true) {
+    batch.clear();
+    check->chunk_queue_->DequeueBatch(kChunkBatchSize, &batch);
+    for (unsigned i = 0; i < batch.size(); ++i) {
+      if (batch[i].IsTerminateJob()) {
+        check->chunk_queue_->Enqueue(batch[i]);
+        return NULL;
+      }
+      if (!check->VerifyChunk(batch[i]))
+        atomic_inc32(&check->num_failures_);
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * Inspects the catalogs in parallel and checks the data objects with a
+ * separate pool of workers.  Takes ownership of the root job.
+ */
+bool CommandCheck::InspectTreeParallel(CatalogJob *root_job) {
+  catalog_queue_ = new FifoChannel<CatalogJob *>(size_t(-1), 1);
+  chunk_queue_ = new FifoChannel<ChunkJob>(kChunkQueueLength,
+                                           kChunkQueueLength / 2);
+  atomic_init32(&num_failures_);
+
+  const unsigned num_workers = 2 * num_threads_;
+  vector<pthread_t> workers(num_workers);
+  LogCvmfs(kLogCvmfs, kLogStdout, "Starting %u catalog workers and %u "
+           "data object workers", num_threads_, num_threads_);
+  for (unsigned i = 0; i < num_workers; ++i) {
+    void *(*worker)(void *) =
+      (i < num_threads_) ? MainCatalogWorker : MainChunkWorker;
+    int retval = pthread_create(&workers[i], NULL, worker,
+                                static_cast<void *>(this));
+    assert(retval == 0);
+  }
+
+  catalogs_in_flight_.Increment();
+  catalog_queue_->Enqueue(root_job);
+  catalogs_in_flight_.WaitForZero();
+
+  // All chunk jobs are queued before the termination marker
+  catalog_queue_->Enqueue(NULL);
+  chunk_queue_->Enqueue(ChunkJob());
+  for (unsigned i = 0; i < num_workers; ++i)
+    pthread_join(workers[i], NULL);
+
+  delete catalog_queue_;
+  delete chunk_queue_;
+  catalog_queue_ = NULL;
+  chunk_queue_ = NULL;
+  return atomic_read32(&num_failures_) == 0;
+}
+
+
 int CommandCheck::Main(const swissknife::ArgumentList &args) {
   string tag_name;
   string subtree_path = "";
@@ -785,6 +1042,17 @@ int CommandCheck::Main(const swissknife::ArgumentList &args) {
     tag_name = *args.find('n')->second;
   if (args.find('c') != args.end())
     check_chunks_ = true;
+  if (args.find('d') != args.end()) {
+    check_chunks_ = true;
+    verify_content_ = true;
+  }
+  if (args.find('j') != args.end()) {
+    num_threads_ = String2Uint64(*args.find('j')->second);
+    if (num_threads_ == 0) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "at least one thread is required");
+      return 1;
+    }
+  }
   if (args.find('l') != args.end()) {
     unsigned log_level =
       1 << (kLogLevel0 + String2Uint64(*args.find('l')->second));
@@ -813,7 +1081,9 @@ int CommandCheck::Main(const swissknife::ArgumentList &args) {
   // initialize the (swissknife global) download and signature managers
   if (is_remote_) {
     const bool follow_redirects = (args.count('L') > 0);
-    if (!this->InitDownloadManager(follow_redirects)) {
+    // One connection for every catalog worker and data object worker
+    const unsigned max_pool_handles = 2 * num_threads_;
+    if (!this->InitDownloadManager(follow_redirects, max_pool_handles)) {
       return 1;
     }
 
@@ -933,13 +1203,15 @@ int CommandCheck::Main(const swissknife::ArgumentList &args) {
     return 1;
   }
 
-  catalog::DeltaCounters computed_counters;
-  const bool successful = InspectTree(subtree_path,
-                                      root_hash,
-                                      root_size,
-                                      is_nested_catalog,
-                                      NULL,
-                                      &computed_counters);
+  CatalogJob *root_job = new CatalogJob(subtree_path, root_hash, root_size,
+                                        is_nested_catalog, NULL, NULL);
+  bool successful;
+  if (num_threads_ > 1) {
+    successful = InspectTreeParallel(root_job);
+  } else {
+    successful = InspectTree(root_job);
+    delete root_job;
+  }
 
   delete manifest;
 
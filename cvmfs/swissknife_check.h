@@ -5,12 +5,17 @@
 #ifndef CVMFS_SWISSKNIFE_CHECK_H_
 #define CVMFS_SWISSKNIFE_CHECK_H_
 
+#include <pthread.h>
+
 #include <set>
 #include <string>
+#include <vector>
 
+#include "atomic.h"
 #include "catalog.h"
 #include "hash.h"
 #include "swissknife.h"
+#include "util_concurrency.h"
 
 namespace download {
 class DownloadManager;
@@ -23,10 +28,8 @@ namespace swissknife {
 
 class CommandCheck : public Command {
  public:
-  CommandCheck()
-    : check_chunks_(false)
-    , is_remote_(false) {}
-  ~CommandCheck() { }
+  CommandCheck();
+  ~CommandCheck();
   virtual std::string GetName() const { return "check"; }
   virtual std::string GetDescription() const {
     return "CernVM File System repository sanity checker\n"
@@ -44,19 +47,75 @@ class CommandCheck : public Command {
     r.push_back(Parameter::Optional('z', "trusted certificates"));
     r.push_back(Parameter::Optional('N', "name of the repository"));
     r.push_back(Parameter::Optional('R', "path to reflog.chksum file"));
+    r.push_back(Parameter::Optional('j', "number of parallel threads "
+                                         "(default: 1)"));
     r.push_back(Parameter::Switch('c', "check availability of data chunks"));
+    r.push_back(Parameter::Switch('d', "verify content hashes of data chunks "
+                                       "(implies -c)"));
     r.push_back(Parameter::Switch('L', "follow HTTP redirects"));
     return r;
   }
   int Main(const ArgumentList &args);
 
  protected:
-  bool InspectTree(const std::string               &path,
-                   const shash::Any                &catalog_hash,
-                   const uint64_t                   catalog_size,
-                   const bool                       is_nested_catalog,
-                   const catalog::DirectoryEntry  *transition_point,
-                   catalog::DeltaCounters         *computed_counters);
+  /**
+   * A catalog to be inspected.  The statistics counters of a catalog can only
+   * be verified once all of its nested catalogs are inspected.  In parallel
+   * mode, the pending counter holds one reference for the catalog itself and
+   * one for every unfinished nested catalog.  Whoever drops the last
+   * reference verifies the counters and populates them to the parent.
+   */
+  struct CatalogJob {
+    CatalogJob(const std::string             &path,
+               const shash::Any              &hash,
+               const uint64_t                 size,
+               const bool                     is_nested_catalog,
+               const catalog::DirectoryEntry *transition_point,
+               CatalogJob                    *parent);
+
+    const std::string             path;
+    const shash::Any              hash;
+    const uint64_t                size;
+    const bool                    is_nested_catalog;
+    const bool                    has_transition_point;
+    const catalog::DirectoryEntry transition_point;
+    CatalogJob * const            parent;
+    catalog::DeltaCounters        computed_counters;
+    catalog::Counters             stored_counters;
+    atomic_int32                  pending;
+  };
+
+  /**
+   * A data object to be checked for existence and, optionally, for its
+   * content hash.  The context describes the referring file for error
+   * messages.  Jobs without object path terminate the chunk workers.
+   */
+  struct ChunkJob {
+    ChunkJob() { }
+    ChunkJob(const shash::Any  &hash,
+             const std::string &object_path,
+             const std::string &context)
+      : hash(hash), object_path(object_path), context(context) { }
+    bool IsTerminateJob() const { return object_path.empty(); }
+
+    shash::Any  hash;
+    std::string object_path;
+    std::string context;
+  };
+
+  bool InspectTree(CatalogJob *job);
+  bool InspectTreeParallel(CatalogJob *root_job);
+  bool InspectCatalog(CatalogJob *job, std::vector<CatalogJob *> *nested_jobs);
+  bool VerifyCounters(CatalogJob *job);
+  void ProcessCatalog(CatalogJob *job);
+  void ReleaseCatalog(CatalogJob *job);
+  bool CheckChunk(const shash::Any  &hash,
+                  const std::string &object_path,
+                  const std::string &context);
+  bool VerifyChunk(const ChunkJob &job);
+  bool VerifyContentHash(const ChunkJob &job, bool *exists);
+  static void *MainCatalogWorker(void *data);
+  static void *MainChunkWorker(void *data);
   catalog::Catalog* FetchCatalog(const std::string  &path,
                                  const shash::Any   &catalog_hash,
                                  const uint64_t      catalog_size = 0);
@@ -82,10 +141,27 @@ class CommandCheck : public Command {
                       const bool is_transition_point = false);
 
  private:
+  /**
+   * Number of chunk jobs a worker dequeues at once
+   */
+  static const unsigned kChunkBatchSize = 64;
+  static const unsigned kChunkQueueLength = 8192;
+
   std::string temp_directory_;
   std::string repo_base_path_;
   bool        check_chunks_;
+  bool        verify_content_;
   bool        is_remote_;
+  unsigned    num_threads_;
+
+  /**
+   * Only used in parallel mode, NULL otherwise
+   */
+  FifoChannel<CatalogJob *> *catalog_queue_;
+  FifoChannel<ChunkJob>     *chunk_queue_;
+  SynchronizingCounter<int32_t> catalogs_in_flight_;
+  atomic_int32               num_failures_;
+  pthread_mutex_t            lock_counters_;
 };
 
 }  // namespace swissknife
@@ -0,0 +1,124 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "swissknife_dictionary.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+
+#include "compression.h"
+#include "fs_traversal.h"
+#include "logging.h"
+#include "platform.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+namespace swissknife {
+
+/**
+ * Reservoir sampling: every file below the size limit has the same chance to
+ * end up in the sample.
+ */
+void CommandTrainDictionary::SampleFile(
+  const string &relative_path,
+  const string &file_name)
+{
+  const string path = base_dir_ + "/" +
+    (relative_path.empty() ? file_name : (relative_path + "/" + file_name));
+  platform_stat64 info;
+  if ((platform_lstat(path.c_str(), &info) != 0) ||
+      (info.st_size == 0) ||
+      (static_cast<uint64_t>(info.st_size) > max_file_size_))
+  {
+    return;
+  }
+
+  unsigned slot = samples_.size();
+  if (samples_.size() >= max_samples_) {
+    slot = prng_.Next(num_candidates_ + 1);
+    if (slot >= max_samples_) {
+      num_candidates_++;
+      return;
+    }
+  }
+  num_candidates_++;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  string content;
+  const bool retval = SafeReadToString(fd, &content);
+  close(fd);
+  if (!retval)
+    return;
+  if (slot == samples_.size())
+    samples_.push_back(content);
+  else
+    samples_[slot] = content;
+}
+
+
+int CommandTrainDictionary::Main(const ArgumentList &args) {
+  base_dir_ = MakeCanonicalPath(*args.find('i')->second);
+  const string output_path = *args.find('o')->second;
+  uint64_t max_dictionary_size = zlib::Dictionary::kDefaultMaxSize;
+  if (args.find('s') != args.end())
+    max_dictionary_size = String2Uint64(*args.find('s')->second) * 1024;
+  max_file_size_ = 16 * 1024;
+  if (args.find('m') != args.end())
+    max_file_size_ = String2Uint64(*args.find('m')->second) * 1024;
+  max_samples_ = 100000;
+  if (args.find('n') != args.end())
+    max_samples_ = String2Uint64(*args.find('n')->second);
+  num_candidates_ = 0;
+  prng_.InitLocaltime();
+
+  if (!DirectoryExists(base_dir_)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "%s does not exist", base_dir_.c_str());
+    return 1;
+  }
+  if ((max_dictionary_size == 0) || (max_samples_ == 0)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "invalid parameters");
+    return 1;
+  }
+
+  FileSystemTraversal<CommandTrainDictionary> traversal(this, base_dir_, true);
+  traversal.fn_new_file = &CommandTrainDictionary::SampleFile;
+  traversal.Recurse(base_dir_);
+  LogCvmfs(kLogCvmfs, kLogStdout, "sampled %u out of %" PRIu64 " files",
+           static_cast<unsigned>(samples_.size()), num_candidates_);
+
+  string dictionary_buf;
+  if (!zlib::Dictionary::Train(samples_, max_dictionary_size,
+                               &dictionary_buf))
+  {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to train dictionary "
+             "(not enough samples?)");
+    return 1;
+  }
+  UniquePtr<zlib::Dictionary> dictionary(zlib::Dictionary::Create(
+    dictionary_buf.data(), dictionary_buf.size(),
+    zlib::ZstdCompressor::kDefaultLevel));
+  assert(dictionary.IsValid());
+
+  if (!SafeWriteToFile(dictionary_buf, output_path, 0644)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to write %s",
+             output_path.c_str());
+    return 1;
+  }
+  LogCvmfs(kLogCvmfs, kLogStdout, "wrote dictionary %u (%u bytes) to %s",
+           dictionary->id(), static_cast<unsigned>(dictionary_buf.size()),
+           output_path.c_str());
+  return 0;
+}
+
+}  // namespace swissknife
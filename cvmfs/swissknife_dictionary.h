@@ -0,0 +1,58 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SWISSKNIFE_DICTIONARY_H_
+#define CVMFS_SWISSKNIFE_DICTIONARY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "prng.h"
+#include "swissknife.h"
+
+namespace swissknife {
+
+/**
+ * Trains a zstd dictionary from the small files of a directory tree, e.g. the
+ * repository's mount point.  The dictionary is made known to the repository
+ * by `cvmfs_swissknife sign -Y`.
+ */
+class CommandTrainDictionary : public Command {
+ public:
+  ~CommandTrainDictionary() { }
+  virtual std::string GetName() const { return "train_dictionary"; }
+  virtual std::string GetDescription() const {
+    return "Trains a zstd compression dictionary from a sample of small files.";
+  }
+  virtual ParameterList GetParams() const {
+    ParameterList r;
+    r.push_back(Parameter::Mandatory('i', "directory with sample files"));
+    r.push_back(Parameter::Mandatory('o', "output dictionary file"));
+    r.push_back(Parameter::Optional('s', "maximum dictionary size in kB "
+                                         "(default: 110)"));
+    r.push_back(Parameter::Optional('m', "maximum size of sample files in kB "
+                                         "(default: 16)"));
+    r.push_back(Parameter::Optional('n', "maximum number of samples "
+                                         "(default: 100000)"));
+    return r;
+  }
+  int Main(const ArgumentList &args);
+
+ private:
+  void SampleFile(const std::string &relative_path,
+                  const std::string &file_name);
+
+  std::string base_dir_;
+  uint64_t max_file_size_;
+  unsigned max_samples_;
+  uint64_t num_candidates_;
+  std::vector<std::string> samples_;
+  Prng prng_;
+};
+
+}  // namespace swissknife
+
+#endif  // CVMFS_SWISSKNIFE_DICTIONARY_H_
@@ -0,0 +1,61 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "swissknife_diff.h"
+
+#include "catalog.h"
+
+namespace swissknife {
+
+ParameterList CommandDiff::GetParams() const {
+  ParameterList r;
+  r.push_back(Parameter::Mandatory(
+              'r', "repository URL (absolute local path or remote URL)"));
+  r.push_back(Parameter::Mandatory('s', "source revision (tag or root hash)"));
+  r.push_back(Parameter::Optional('d', "destination revision (default: HEAD)"));
+  r.push_back(Parameter::Optional('n', "fully qualified repository name"));
+  r.push_back(Parameter::Optional('k', "repository master key(s)"));
+  r.push_back(Parameter::Optional('l', "temporary directory"));
+  return r;
+}
+
+
+int CommandDiff::Main(const ArgumentList &args) {
+  const std::string &repo_url  = *args.find('r')->second;
+  const std::string &from      = *args.find('s')->second;
+  const std::string &to        =
+    (args.count('d') > 0) ? *args.find('d')->second : "HEAD";
+  const std::string &repo_name =
+    (args.count('n') > 0) ? *args.find('n')->second : "";
+  const std::string &repo_keys =
+    (args.count('k') > 0) ? *args.find('k')->second : "";
+  const std::string &tmp_dir   =
+    (args.count('l') > 0) ? *args.find('l')->second : "/tmp";
+
+  bool success = false;
+  if (IsHttpUrl(repo_url)) {
+    const bool follow_redirects = false;
+    if (!this->InitDownloadManager(follow_redirects) ||
+        !this->InitVerifyingSignatureManager(repo_keys)) {
+      LogCvmfs(kLogCatalog, kLogStderr, "Failed to init remote connection");
+      return 1;
+    }
+
+    HttpObjectFetcher<catalog::Catalog,
+                      history::SqliteHistory> fetcher(repo_name,
+                                                      repo_url,
+                                                      tmp_dir,
+                                                      download_manager(),
+                                                      signature_manager());
+    success = Run(&fetcher, from, to);
+  } else {
+    LocalObjectFetcher<> fetcher(repo_url, tmp_dir);
+    success = Run(&fetcher, from, to);
+  }
+
+  return (success) ? 0 : 1;
+}
+
+}  // namespace swissknife
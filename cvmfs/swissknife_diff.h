@@ -0,0 +1,139 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SWISSKNIFE_DIFF_H_
+#define CVMFS_SWISSKNIFE_DIFF_H_
+
+#include <string>
+
+#include "catalog_diff.h"
+#include "hash.h"
+#include "history_sqlite.h"
+#include "logging.h"
+#include "manifest.h"
+#include "object_fetcher.h"
+#include "swissknife.h"
+
+namespace swissknife {
+
+/**
+ * Prints the differences between two revisions of a repository, one line per
+ * added (A), removed (R), or modified (M) path.
+ */
+template <class ObjectFetcherT>
+class DiffPrinter : public CatalogDiff<ObjectFetcherT> {
+ public:
+  explicit DiffPrinter(ObjectFetcherT *object_fetcher)
+    : CatalogDiff<ObjectFetcherT>(object_fetcher) { }
+
+ protected:
+  virtual void ReportAddition(const PathString &path,
+                              const catalog::DirectoryEntry &entry)
+  {
+    Print('A', path, entry);
+  }
+  virtual void ReportRemoval(const PathString &path,
+                             const catalog::DirectoryEntry &entry)
+  {
+    Print('R', path, entry);
+  }
+  virtual void ReportModification(const PathString &path,
+                                  const catalog::DirectoryEntry &old_entry,
+                                  const catalog::DirectoryEntry &new_entry)
+  {
+    Print('M', path, new_entry);
+  }
+
+ private:
+  void Print(const char change,
+             const PathString &path,
+             const catalog::DirectoryEntry &entry)
+  {
+    LogCvmfs(kLogCvmfs, kLogStdout, "%c %s%s", change, path.c_str(),
+             entry.IsDirectory() ? "/" : "");
+  }
+};
+
+
+class CommandDiff : public Command {
+ public:
+  ~CommandDiff() { }
+  virtual std::string GetName() const { return "diff"; }
+  virtual std::string GetDescription() const {
+    return "CernVM File System Repository Diff\n"
+      "Lists the paths that were added (A), removed (R), or modified (M) "
+      "between two revisions of a repository.  Revisions are given as tag "
+      "names or as root catalog hashes.";
+  }
+  virtual ParameterList GetParams() const;
+
+  int Main(const ArgumentList &args);
+
+ protected:
+  template <class ObjectFetcherT>
+  bool Run(ObjectFetcherT *object_fetcher,
+           const std::string &from,
+           const std::string &to)
+  {
+    shash::Any from_hash;
+    shash::Any to_hash;
+    if (!ResolveRevision(object_fetcher, from, &from_hash) ||
+        !ResolveRevision(object_fetcher, to, &to_hash))
+    {
+      return false;
+    }
+    DiffPrinter<ObjectFetcherT> printer(object_fetcher);
+    return printer.Run(from_hash, to_hash);
+  }
+
+  /**
+   * Revisions are either "HEAD", a root catalog hash, or a tag name.
+   */
+  template <class ObjectFetcherT>
+  bool ResolveRevision(ObjectFetcherT *object_fetcher,
+                       const std::string &revision,
+                       shash::Any *root_hash)
+  {
+    if (revision == "HEAD") {
+      manifest::Manifest *manifest = NULL;
+      const typename ObjectFetcherT::Failures retval =
+        object_fetcher->FetchManifest(&manifest);
+      if (retval != ObjectFetcherT::kFailOk) {
+        LogCvmfs(kLogCvmfs, kLogStderr, "failed to load manifest (%d - %s)",
+                 retval, Code2Ascii(retval));
+        return false;
+      }
+      *root_hash = manifest->catalog_hash();
+      delete manifest;
+      return true;
+    }
+
+    *root_hash = shash::MkFromHexPtr(shash::HexPtr(revision),
+                                     shash::kSuffixCatalog);
+    if (!root_hash->IsNull())
+      return true;
+
+    typename ObjectFetcherT::HistoryTN *history = NULL;
+    const typename ObjectFetcherT::Failures retval =
+      object_fetcher->FetchHistory(&history);
+    if (retval != ObjectFetcherT::kFailOk) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "failed to load history (%d - %s)",
+               retval, Code2Ascii(retval));
+      return false;
+    }
+    history::History::Tag tag;
+    const bool found = history->GetByName(revision, &tag);
+    delete history;
+    if (!found) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "unknown revision %s", revision.c_str());
+      return false;
+    }
+    *root_hash = tag.root_hash;
+    return true;
+  }
+};
+
+}  // namespace swissknife
+
+#endif  // CVMFS_SWISSKNIFE_DIFF_H_
@@ -8,8 +8,10 @@
 #include "cvmfs_config.h"
 #include "swissknife_gc.h"
 
+#include <algorithm>
 #include <string>
 
+#include "bloom_filter.h"
 #include "garbage_collection/garbage_collector.h"
 #include "garbage_collection/gc_aux.h"
 #include "garbage_collection/hash_filter.h"
@@ -21,11 +23,14 @@ namespace swissknife {
 
 typedef HttpObjectFetcher<> ObjectFetcher;
 typedef CatalogTraversal<ObjectFetcher> ReadonlyCatalogTraversal;
-typedef SmallhashFilter HashFilter;
+typedef SpillingHashFilter HashFilter;
 typedef GarbageCollector<ReadonlyCatalogTraversal, HashFilter> GC;
 typedef GarbageCollectorAux<ReadonlyCatalogTraversal, HashFilter> GCAux;
 typedef GC::Configuration GcConfig;
 
+const unsigned kDefaultNumThreads = 4;
+const uint64_t kMinExistenceFilterCapacity = 1024 * 1024;
+
 
 ParameterList CommandGc::GetParams() const {
   ParameterList r;
@@ -38,6 +43,11 @@ ParameterList CommandGc::GetParams() const {
   r.push_back(Parameter::Optional('k', "repository master key(s)"));
   r.push_back(Parameter::Optional('t', "temporary directory"));
   r.push_back(Parameter::Optional('L', "path to deletion log file"));
+  r.push_back(Parameter::Optional('N', "number of catalog download threads"));
+  r.push_back(Parameter::Optional('M', "maximum number of preserved hashes "
+                                       "kept in memory"));
+  r.push_back(Parameter::Optional('E', "path to the rebuilt upload existence "
+                                       "filter"));
   r.push_back(Parameter::Switch('d', "dry run"));
   r.push_back(Parameter::Switch('l', "list objects to be removed"));
   return r;
@@ -63,6 +73,12 @@ int CommandGc::Main(const ArgumentList &args) {
     *args.find('t')->second : "/tmp";
   const std::string deletion_log_path = (args.count('L') > 0) ?
     *args.find('L')->second : "";
+  const std::string existence_filter_path = (args.count('E') > 0) ?
+    *args.find('E')->second : "";
+  const unsigned num_threads = (args.count('N') > 0) ?
+    String2Uint64(*args.find('N')->second) : kDefaultNumThreads;
+  const uint64_t max_hashes_in_memory = (args.count('M') > 0) ?
+    String2Uint64(*args.find('M')->second) : 0;
 
   if (revisions < 0) {
     LogCvmfs(kLogCvmfs, kLogStderr,
@@ -78,7 +94,8 @@ int CommandGc::Main(const ArgumentList &args) {
   }
 
   const bool follow_redirects = false;
-  if (!this->InitDownloadManager(follow_redirects) ||
+  // One download handle for every prefetch thread and for the traversal
+  if (!this->InitDownloadManager(follow_redirects, num_threads + 1) ||
       !this->InitVerifyingSignatureManager(repo_keys)) {
     LogCvmfs(kLogCatalog, kLogStderr, "failed to init repo connection");
     return 1;
@@ -141,6 +158,23 @@ int CommandGc::Main(const ArgumentList &args) {
   config.object_fetcher          = &object_fetcher;
   config.reflog                  = reflog.weak_ref();
   config.deleted_objects_logfile = deletion_log_file;
+  config.num_threads             = num_threads;
+
+  UniquePtr<BloomFilter> existence_filter;
+  if (!existence_filter_path.empty() && !dry_run) {
+    // The rebuilt filter is sized from the number of entries in the previous
+    // one; it grows anyway if the repository has more objects than that
+    uint64_t capacity = BloomFilter::kDefaultCapacity;
+    UniquePtr<BloomFilter> previous_filter(
+      BloomFilter::Load(existence_filter_path));
+    if (previous_filter.IsValid()) {
+      const uint64_t previous_count = previous_filter->count();
+      capacity = std::max(kMinExistenceFilterCapacity,
+                          previous_count + previous_count / 4);
+    }
+    existence_filter = new BloomFilter(capacity);
+    config.existence_filter = existence_filter.weak_ref();
+  }
 
 
   if (deletion_log_file != NULL) {
@@ -159,6 +193,10 @@ int CommandGc::Main(const ArgumentList &args) {
   // File catalogs
   GC collector(config);
   collector.UseReflogTimestamps();
+  if (max_hashes_in_memory > 0) {
+    collector.hash_filter()->SetSpillDirectory(temp_directory,
+                                               max_hashes_in_memory);
+  }
   bool success = collector.Collect();
 
   if (!success) {
@@ -172,6 +210,7 @@ int CommandGc::Main(const ArgumentList &args) {
   preserved_objects.Fill(manifest->certificate());
   preserved_objects.Fill(manifest->history());
   preserved_objects.Fill(manifest->meta_info());
+  preserved_objects.Freeze();
   GCAux collector_aux(config);
   success = collector_aux.CollectOlderThan(
     collector.oldest_trunk_catalog(), preserved_objects);
@@ -192,6 +231,12 @@ int CommandGc::Main(const ArgumentList &args) {
     fclose(deletion_log_file);
   }
 
+  // The filter lists exactly the preserved objects.  If it cannot be written,
+  // the old one stays in place, which is safe because the uploader verifies
+  // its hits.
+  if (existence_filter.IsValid())
+    existence_filter->Save(existence_filter_path);
+
   reflog->CommitTransaction();
   reflog->DropDatabaseFileOwnership();
   const std::string reflog_db = reflog->database_file();
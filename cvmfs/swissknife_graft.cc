@@ -158,9 +158,11 @@ int swissknife::CommandGraft::Main(const swissknife::ArgumentList &args) {
   verbose_ = args.find('v') != args.end();
   hash_alg_ = (args.find('a') == args.end()) ?
               shash::kSha1 : shash::ParseHashAlgorithm(*args.find('a')->second);
+  compression_level_ = 0;
   compression_alg_ = (args.find('Z') == args.end()) ?
                      zlib::kNoCompression :
-                     zlib::ParseCompressionAlgorithm(*args.find('Z')->second);
+                     zlib::ParseCompressionAlgorithm(*args.find('Z')->second,
+                                                     &compression_level_);
 
   std::string chunk_size = (args.find('c') == args.end()) ?
                            "32" : *args.find('c')->second;
@@ -239,6 +241,7 @@ int swissknife::CommandGraft::Publish(const std::string &input_file,
   std::vector<uint64_t> chunk_offsets;
   std::vector<shash::Any> chunk_checksums;
   zlib::Compressor * compressor = zlib::Compressor::Construct(compression_alg_);
+  compressor->SetLevel(compression_level_);
 
   bool retval = ChecksumFdWithChunks(fd,
                                      compressor,
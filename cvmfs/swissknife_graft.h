@@ -60,6 +60,7 @@ class CommandGraft : public Command {
   std::string input_file_;
   bool verbose_;
   zlib::Algorithms compression_alg_;
+  int compression_level_;
   shash::Algorithms hash_alg_;
   uint64_t chunk_size_;
 };
@@ -1032,12 +1032,12 @@ int CommandRollbackTag::Main(const ArgumentList &args) {
   }
 
   // check if the catalog has a supported schema version
-  if (catalog->schema() < catalog::CatalogDatabase::kLatestSupportedSchema -
+  if (catalog->schema() < catalog::CatalogDatabase::kLatestSchema -
                           catalog::CatalogDatabase::kSchemaEpsilon) {
     LogCvmfs(kLogCvmfs, kLogStderr, "not rolling back to outdated and "
                                     "incompatible catalog schema (%.1f < %.1f)",
              catalog->schema(),
-             catalog::CatalogDatabase::kLatestSupportedSchema);
+             catalog::CatalogDatabase::kLatestSchema);
     return 1;
   }
 
@@ -10,7 +10,9 @@
 #include "swissknife.h"
 
 #include "swissknife_check.h"
+#include "swissknife_dictionary.h"
 #include "swissknife_gc.h"
+#include "swissknife_diff.h"
 #include "swissknife_graft.h"
 #include "swissknife_hash.h"
 #include "swissknife_history.h"
@@ -83,6 +85,7 @@ int main(int argc, char **argv) {
   command_list.push_back(new swissknife::CommandLetter());
   command_list.push_back(new swissknife::CommandCheck());
   command_list.push_back(new swissknife::CommandListCatalogs());
+  command_list.push_back(new swissknife::CommandDiff());
   command_list.push_back(new swissknife::CommandPull());
   command_list.push_back(new swissknife::CommandZpipe());
   command_list.push_back(new swissknife::CommandGraft());
@@ -94,6 +97,7 @@ int main(int argc, char **argv) {
   command_list.push_back(new swissknife::CommandGc());
   command_list.push_back(new swissknife::CommandReconstructReflog());
   command_list.push_back(new swissknife::CommandLease());
+  command_list.push_back(new swissknife::CommandTrainDictionary());
 
   if (argc < 2) {
     Usage();
@@ -771,7 +771,7 @@ bool CommandMigrate::MigrationWorker_20x::RunMigration(PendingCatalog *data)
 {
   // double-check that we are generating compatible catalogs to the actual
   // catalog management classes
-  assert(kSchema         == catalog::CatalogDatabase::kLatestSupportedSchema);
+  assert(kSchema         == catalog::CatalogDatabase::kLatestSchema);
   assert(kSchemaRevision == catalog::CatalogDatabase::kLatestSchemaRevision);
 
   return CreateNewEmptyCatalog(data) &&
@@ -837,11 +837,11 @@ bool CommandMigrate::MigrationWorker_20x::CheckDatabaseSchemaCompatibility(
   const catalog::CatalogDatabase &new_catalog = data->new_catalog->database();
 
   if ((new_catalog.schema_version() <
-         catalog::CatalogDatabase::kLatestSupportedSchema -
+         catalog::CatalogDatabase::kLatestSchema -
          catalog::CatalogDatabase::kSchemaEpsilon
        ||
        new_catalog.schema_version() >
-         catalog::CatalogDatabase::kLatestSupportedSchema +
+         catalog::CatalogDatabase::kLatestSchema +
          catalog::CatalogDatabase::kSchemaEpsilon)
        ||
        (old_catalog.schema_version() > 2.1 +
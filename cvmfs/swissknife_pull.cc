@@ -16,13 +16,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "atomic.h"
 #include "catalog.h"
+#include "catalog_diff.h"
 #include "compression.h"
 #include "download.h"
 #include "hash.h"
@@ -33,9 +36,11 @@
 #include "object_fetcher.h"
 #include "path_filters/relaxed_path_filter.h"
 #include "reflog.h"
+#include "replication_journal.h"
 #include "signature.h"
 #include "smalloc.h"
 #include "upload.h"
+#include "util_concurrency.h"
 
 using namespace std;  // NOLINT
 
@@ -44,41 +49,115 @@ namespace swissknife {
 namespace {
 
 typedef HttpObjectFetcher<> ObjectFetcher;
+typedef CatalogDiff<ObjectFetcher> RevisionDiff;
+
+const unsigned kMaxCatalogWorkers = 4;
+const unsigned kCheckQueueLength = 8192;
+const unsigned kCheckBatchSize = 64;
 
 /**
- * This just stores an shash::Any in a predictable way to send it through a
- * POSIX pipe.
+ * A catalog on its way through the replication pipeline.  A catalog is stored
+ * only after all of its chunks and all of the catalogs it refers to (nested
+ * catalogs and previous revisions) are stored.  Hence, the presence of a
+ * catalog in the target storage still implies the presence of its subtree.
+ *
+ * The pending counter holds one reference for the listing of the catalog
+ * itself plus one reference for every outstanding chunk and referenced
+ * catalog.  Whoever drops the last reference hands the catalog over to the
+ * store stage.  The pending_chunks counter tracks the chunks alone, for the
+ * replication journal.
+ *
+ * The base_hash refers to the catalog at the same path in the revision that
+ * the target storage already holds.  Objects referenced by the base catalog
+ * are in place and need not be checked.
  */
-class ChunkJob {
- public:
-  ChunkJob()
-    : suffix(shash::kSuffixNone)
-    , hash_algorithm(shash::kAny)
-    , compression_alg(zlib::kZlibDefault) {}
-
-  ChunkJob(const shash::Any &hash, zlib::Algorithms compression_alg)
-    : suffix(hash.suffix)
-    , hash_algorithm(hash.algorithm)
-    , compression_alg(compression_alg)
+struct CatalogJob {
+  CatalogJob(const shash::Any &hash,
+             const string &path,
+             CatalogJob *parent,
+             const bool apply_threshold,
+             const bool pull_history,
+             const shash::Any &base_hash = shash::Any())
+    : hash(hash)
+    , base_hash(base_hash)
+    , path(path)
+    , parent(parent)
+    , apply_threshold(apply_threshold)
+    , pull_history(pull_history)
+    , failed(false)
+    , mark_complete(false)
   {
-    memcpy(digest, hash.digest, hash.GetDigestSize());
+    atomic_init64(&pending);
+    atomic_inc64(&pending);
+    atomic_init64(&pending_chunks);
+    atomic_inc64(&pending_chunks);
+    atomic_init64(&num_chunks);
+    atomic_init64(&num_new);
   }
 
-  bool IsTerminateJob() const {
-    return (hash_algorithm == shash::kAny);
-  }
+  const shash::Any   hash;
+  const shash::Any   base_hash;
+  const string       path;
+  CatalogJob * const parent;
+  const bool         apply_threshold;
+  const bool         pull_history;
+  /**
+   * Set if the catalog or any catalog in its subtree failed to replicate
+   */
+  bool               failed;
+  /**
+   * Set if the catalog is to be journaled as complete once it is finished
+   */
+  bool               mark_complete;
+  /**
+   * The compressed catalog as downloaded.  Empty if there is nothing to store,
+   * e.g. because the catalog is already present or was pruned.
+   */
+  string             file_vanilla;
+  atomic_int64       pending;
+  atomic_int64       pending_chunks;
+  atomic_int64       num_chunks;
+  atomic_int64       num_new;
+};
 
-  shash::Any hash() const {
-    assert(!IsTerminateJob());
-    return shash::Any(hash_algorithm,
-                      digest,
-                      suffix);
-  }
+/**
+ * A chunk passing through the existence check, download, and store stages.
+ * Jobs without a catalog terminate the worker threads of a stage.  In the
+ * store stage, a job without local_path indicates that the catalog itself is
+ * complete.
+ */
+struct ChunkJob {
+  ChunkJob() : compression_alg(zlib::kZlibDefault), catalog(NULL) { }
+
+  ChunkJob(const shash::Any &hash,
+           const zlib::Algorithms compression_alg,
+           CatalogJob *catalog)
+    : hash(hash)
+    , compression_alg(compression_alg)
+    , catalog(catalog)
+  { }
+
+  bool IsTerminateJob() const { return catalog == NULL; }
 
-  const shash::Suffix      suffix;
-  const shash::Algorithms  hash_algorithm;
-  const zlib::Algorithms   compression_alg;
-  unsigned char            digest[shash::kMaxDigestSize];
+  shash::Any        hash;
+  zlib::Algorithms  compression_alg;
+  CatalogJob       *catalog;
+  string            local_path;
+};
+
+/**
+ * A journal entry is queued once its condition is met in the pipeline.  It is
+ * written only after the following WaitForUpload(), when the objects are
+ * actually in the target storage.
+ */
+struct JournalEntry {
+  JournalEntry(const shash::Any &catalog_hash, const bool subtree)
+    : catalog_hash(catalog_hash), subtree(subtree) { }
+  shash::Any catalog_hash;
+  /**
+   * The entire subtree is replicated, otherwise only the catalog's chunks
+   */
+  bool       subtree;
 };
 
 static void SpoolerOnUpload(const upload::SpoolerResult &result) {
@@ -97,19 +176,26 @@ string              *stratum1_url = NULL;
 string              *temp_dir = NULL;
 unsigned             num_parallel = 1;
 bool                 pull_history = false;
-bool                 apply_timestamp_threshold = false;
 uint64_t             timestamp_threshold = 0;
 bool                 is_garbage_collectable = false;
 bool                 initial_snapshot = false;
 upload::Spooler     *spooler = NULL;
-int                  pipe_chunks[2];
-// required for concurrent reading
-pthread_mutex_t      lock_pipe = PTHREAD_MUTEX_INITIALIZER;
 unsigned             retries = 3;
 catalog::RelaxedPathFilter   *pathfilter = NULL;
 atomic_int64         overall_chunks;
 atomic_int64         overall_new;
-atomic_int64         chunk_queue;
+// Pipeline stages: catalog listing -> existence check -> download -> store
+FifoChannel<CatalogJob *> *catalog_queue = NULL;
+FifoChannel<ChunkJob>     *check_queue = NULL;
+FifoChannel<ChunkJob>     *download_queue = NULL;
+FifoChannel<ChunkJob>     *store_queue = NULL;
+SynchronizingCounter<int32_t> pending_roots;
+atomic_int32         failed_roots;
+// the reflog is shared by the catalog workers
+pthread_mutex_t      lock_reflog = PTHREAD_MUTEX_INITIALIZER;
+ReplicationJournal  *journal = NULL;
+vector<JournalEntry> journal_backlog;
+pthread_mutex_t      lock_journal_backlog = PTHREAD_MUTEX_INITIALIZER;
 bool                 preload_cache = false;
 string              *preload_cachedir = NULL;
 bool                 inspect_existing_catalogs = false;
@@ -173,10 +259,10 @@ static void ReportDownloadError(const shash::Any &failed_hash,
 static void Store(
   const string &local_path,
   const string &remote_path,
-  const bool compressed_src)
+  const zlib::Algorithms compression_alg)
 {
   if (preload_cache) {
-    if (!compressed_src) {
+    if (compression_alg == zlib::kNoCompression) {
       int retval = rename(local_path.c_str(), remote_path.c_str());
       if (retval != 0) {
         LogCvmfs(kLogCvmfs, kLogStderr, "Failed to move '%s' to '%s'",
@@ -192,7 +278,8 @@ static void Store(
                  remote_path.c_str());
         abort();
       }
-      int retval = zlib::DecompressPath2File(local_path, fdest);
+      int retval =
+        zlib::DecompressPath2File(local_path, fdest, compression_alg);
       if (!retval) {
         LogCvmfs(kLogCvmfs, kLogStderr, "Failed to preload %s to %s",
                  local_path.c_str(), remote_path.c_str());
@@ -211,9 +298,9 @@ static void Store(
 static void Store(
   const string &local_path,
   const shash::Any &remote_hash,
-  const bool compressed_src = true)
+  const zlib::Algorithms compression_alg = zlib::kZlibDefault)
 {
-  Store(local_path, MakePath(remote_hash), compressed_src);
+  Store(local_path, MakePath(remote_hash), compression_alg);
 }
 
 
@@ -231,7 +318,7 @@ static void StoreBuffer(const unsigned char *buffer, const unsigned size,
   }
   assert(retval);
   fclose(ftmp);
-  Store(tmp_file, dest_path, true);
+  Store(tmp_file, dest_path, zlib::kZlibDefault);
 }
 
 static void StoreBuffer(const unsigned char *buffer, const unsigned size,
@@ -245,98 +332,209 @@ static void WaitForStorage() {
 }
 
 
+static void QueueJournalEntry(const shash::Any &catalog_hash,
+                              const bool subtree)
+{
+  if (journal == NULL)
+    return;
+  pthread_mutex_lock(&lock_journal_backlog);
+  journal_backlog.push_back(JournalEntry(catalog_hash, subtree));
+  pthread_mutex_unlock(&lock_journal_backlog);
+}
+
+
+/**
+ * Waits for the uploads and then writes the journal entries that were queued
+ * before.  Entries queued while waiting remain for the next round.
+ */
+static void WaitForStorageAndJournal() {
+  vector<JournalEntry> entries;
+  pthread_mutex_lock(&lock_journal_backlog);
+  entries.swap(journal_backlog);
+  pthread_mutex_unlock(&lock_journal_backlog);
+
+  WaitForStorage();
+  for (unsigned i = 0; i < entries.size(); ++i) {
+    if (entries[i].subtree)
+      journal->MarkCatalogComplete(entries[i].catalog_hash);
+    else
+      journal->MarkChunksComplete(entries[i].catalog_hash);
+  }
+}
+
+
 struct MainWorkerContext {
   download::DownloadManager *download_manager;
 };
 
-static void *MainWorker(void *data) {
-  MainWorkerContext *mwc = static_cast<MainWorkerContext*>(data);
-  download::DownloadManager *download_manager = mwc->download_manager;
 
-  while (1) {
-    ChunkJob next_chunk;
-    pthread_mutex_lock(&lock_pipe);
-    ReadPipe(pipe_chunks[0], &next_chunk, sizeof(next_chunk));
-    pthread_mutex_unlock(&lock_pipe);
-    if (next_chunk.IsTerminateJob())
-      break;
+/**
+ * Drops a reference to the catalog.  Returns true if it was the last one,
+ * i.e. if the catalog is now ready to be stored.
+ */
+static bool ReleaseCatalog(CatalogJob *catalog) {
+  return atomic_xadd64(&catalog->pending, -1) == 1;
+}
 
-    shash::Any chunk_hash = next_chunk.hash();
-    zlib::Algorithms compression_alg = next_chunk.compression_alg;
-    LogCvmfs(kLogCvmfs, kLogVerboseMsg, "processing chunk %s",
-             chunk_hash.ToString().c_str());
-
-    if (!Peek(chunk_hash)) {
-      string tmp_file;
-      FILE *fchunk = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
-                                    &tmp_file);
-      assert(fchunk);
-      string url_chunk = *stratum0_url + "/data/" + chunk_hash.MakePath();
-      download::JobInfo download_chunk(&url_chunk, false, false, fchunk,
-                                       &chunk_hash);
-
-      const download::Failures download_result =
-                                       download_manager->Fetch(&download_chunk);
-      if (download_result != download::kFailOk) {
-        ReportDownloadError(chunk_hash, download_result);
-        abort();
-      }
-      fclose(fchunk);
-      Store(tmp_file, chunk_hash,
-            (compression_alg == zlib::kZlibDefault) ? true : false);
-      atomic_inc64(&overall_new);
-    }
-    if (atomic_xadd64(&overall_chunks, 1) % 1000 == 0)
-      LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, ".");
-    atomic_dec64(&chunk_queue);
-  }
-  return NULL;
+/**
+ * Drops a chunk reference.  Must be called before the corresponding
+ * ReleaseCatalog().
+ */
+static void ReleaseChunk(CatalogJob *catalog) {
+  if (atomic_xadd64(&catalog->pending_chunks, -1) == 1)
+    QueueJournalEntry(catalog->hash, false);
 }
 
+/**
+ * Used by all stages but the store stage, which finishes catalogs by itself
+ * in order to not block on its own queue.
+ */
+static void ReleaseCatalogAsync(CatalogJob *catalog) {
+  if (ReleaseCatalog(catalog))
+    store_queue->Enqueue(ChunkJob(catalog->hash, zlib::kZlibDefault, catalog));
+}
+
+
+static void SpawnCatalog(CatalogJob *catalog) {
+  if (catalog->parent != NULL)
+    atomic_inc64(&catalog->parent->pending);
+  else
+    pending_roots.Increment();
+  catalog_queue->Enqueue(catalog);
+}
 
-bool CommandPull::PullRecursion(catalog::Catalog   *catalog,
-                                const std::string  &path) {
-  assert(catalog);
 
-  // Previous catalogs
-  if (pull_history) {
+/**
+ * Schedules the previous revision and the nested catalogs of a catalog.  Nested
+ * catalogs inherit the base catalog mounted at the same path, if any.
+ */
+static void SpawnReferencedCatalogs(catalog::Catalog *catalog,
+                                    catalog::Catalog *base,
+                                    CatalogJob *job)
+{
+  if (job->pull_history) {
     shash::Any previous_catalog = catalog->GetPreviousRevision();
     if (previous_catalog.IsNull()) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Start of catalog, no more history");
     } else {
       LogCvmfs(kLogCvmfs, kLogStdout, "Replicating from historic catalog %s",
                previous_catalog.ToString().c_str());
-      bool retval = Pull(previous_catalog, path);
-      if (!retval)
-        return false;
+      SpawnCatalog(new CatalogJob(previous_catalog, job->path, job, true,
+                                  true));
     }
   }
 
-  // Nested catalogs (in a nested code block because goto fail...)
-  {
-    const catalog::Catalog::NestedCatalogList nested_catalogs =
-      catalog->ListOwnNestedCatalogs();
+  map<string, shash::Any> base_catalogs;
+  if (base != NULL) {
+    const catalog::Catalog::NestedCatalogList base_nested =
+      base->ListOwnNestedCatalogs();
     for (catalog::Catalog::NestedCatalogList::const_iterator i =
-         nested_catalogs.begin(), iEnd = nested_catalogs.end();
-         i != iEnd; ++i)
+         base_nested.begin(), iEnd = base_nested.end(); i != iEnd; ++i)
     {
-      LogCvmfs(kLogCvmfs, kLogStdout, "Replicating from catalog at %s",
-               i->mountpoint.c_str());
-      bool retval = Pull(i->hash, i->mountpoint.ToString());
-      if (!retval)
-        return false;
+      base_catalogs[i->mountpoint.ToString()] = i->hash;
     }
   }
 
-  return true;
+  const catalog::Catalog::NestedCatalogList nested_catalogs =
+    catalog->ListOwnNestedCatalogs();
+  for (catalog::Catalog::NestedCatalogList::const_iterator i =
+       nested_catalogs.begin(), iEnd = nested_catalogs.end();
+       i != iEnd; ++i)
+  {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Replicating from catalog at %s",
+             i->mountpoint.c_str());
+    const string mountpoint = i->mountpoint.ToString();
+    SpawnCatalog(new CatalogJob(i->hash, mountpoint, job, true,
+                                job->pull_history, base_catalogs[mountpoint]));
+  }
+}
+
+
+/**
+ * Loads the base catalog from the target storage.  Returns NULL if it is not
+ * available, e.g. because it was excluded by a path specification, in which
+ * case all the objects of the new catalog are checked.
+ */
+static catalog::Catalog *FetchBaseCatalog(
+  const shash::Any &base_hash,
+  const string &path,
+  download::DownloadManager *download_manager)
+{
+  string file_base;
+  string file_base_vanilla;
+  FILE *fbase_vanilla = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
+                                       &file_base_vanilla);
+  if (fbase_vanilla == NULL)
+    return NULL;
+  const string url_base = *stratum1_url + "/data/" + base_hash.MakePath();
+  download::JobInfo download_base(&url_base, false, false, fbase_vanilla,
+                                  &base_hash);
+  const download::Failures dl_retval = download_manager->Fetch(&download_base);
+  fclose(fbase_vanilla);
+  if (dl_retval != download::kFailOk) {
+    LogCvmfs(kLogCvmfs, kLogVerboseMsg, "base catalog %s not available "
+             "(%d - %s)", base_hash.ToString().c_str(),
+             dl_retval, download::Code2Ascii(dl_retval));
+    unlink(file_base_vanilla.c_str());
+    return NULL;
+  }
+
+  FILE *fbase = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w", &file_base);
+  if (fbase == NULL) {
+    unlink(file_base_vanilla.c_str());
+    return NULL;
+  }
+  fclose(fbase);
+  const bool retval = zlib::DecompressPath2Path(file_base_vanilla, file_base);
+  unlink(file_base_vanilla.c_str());
+  if (!retval) {
+    unlink(file_base.c_str());
+    return NULL;
+  }
+
+  catalog::Catalog *base =
+    catalog::Catalog::AttachFreely(path, file_base, base_hash);
+  if (base == NULL) {
+    unlink(file_base.c_str());
+    return NULL;
+  }
+  base->TakeDatabaseFileOwnership();
+  return base;
 }
 
-bool CommandPull::Pull(const shash::Any   &catalog_hash,
-                       const std::string  &path) {
+
+/**
+ * Downloads and lists a catalog.  Its chunks go to the existence check stage
+ * and the catalogs it refers to back to the catalog workers.
+ */
+static void ProcessCatalog(CatalogJob *job,
+                           download::DownloadManager *download_manager)
+{
+  const shash::Any &catalog_hash = job->hash;
+  const string &path = job->path;
+  const string print_path = path.empty() ? "/" : path;
   int retval;
   download::Failures dl_retval;
   assert(shash::kSuffixCatalog == catalog_hash.suffix);
 
+  // Check if an interrupted replication has already completed the catalog
+  if ((journal != NULL) && journal->HasCatalogComplete(catalog_hash)) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "  Catalog at %s replicated before "
+             "(journal)", print_path.c_str());
+    // The reflog of the interrupted replication might have been lost
+    if (path.empty() && reflog != NULL) {
+      pthread_mutex_lock(&lock_reflog);
+      retval = reflog->AddCatalog(catalog_hash);
+      pthread_mutex_unlock(&lock_reflog);
+      if (!retval) {
+        LogCvmfs(kLogCvmfs, kLogStderr, "failed to add catalog to Reflog.");
+        job->failed = true;
+      }
+    }
+    ReleaseCatalogAsync(job);
+    return;
+  }
+
   // Check if the catalog already exists
   if (Peek(catalog_hash)) {
     // Preload: dirtab changed
@@ -350,15 +548,18 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
       if (catalog == NULL) {
         LogCvmfs(kLogCvmfs, kLogStderr, "failed to attach catalog %s",
                  catalog_hash.ToString().c_str());
-        return false;
+        job->failed = true;
+      } else {
+        SpawnReferencedCatalogs(catalog, NULL, job);
+        delete catalog;
       }
-      bool retval = PullRecursion(catalog, path);
-      delete catalog;
-      return retval;
+    } else {
+      LogCvmfs(kLogCvmfs, kLogStdout, "  Catalog at %s up to date",
+               print_path.c_str());
     }
-
-    LogCvmfs(kLogCvmfs, kLogStdout, "  Catalog up to date");
-    return true;
+    job->mark_complete = true;
+    ReleaseCatalogAsync(job);
+    return;
   }
 
   // Check if the catalog matches the pathfilter
@@ -367,23 +568,24 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
      !pathfilter->IsMatching(path)) {
     LogCvmfs(kLogCvmfs, kLogStdout, "  Catalog in '%s' does not match"
              " the path specification", path.c_str());
-    return true;
+    ReleaseCatalogAsync(job);
+    return;
   }
 
-  int64_t gauge_chunks = atomic_read64(&overall_chunks);
-  int64_t gauge_new = atomic_read64(&overall_new);
-
   // Download and uncompress catalog
   shash::Any chunk_hash;
   zlib::Algorithms compression_alg;
   catalog::Catalog *catalog = NULL;
+  catalog::Catalog *base = NULL;
   string file_catalog;
   string file_catalog_vanilla;
   FILE *fcatalog = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
                                   &file_catalog);
   if (!fcatalog) {
     LogCvmfs(kLogCvmfs, kLogStderr, "I/O error");
-    return false;
+    job->failed = true;
+    ReleaseCatalogAsync(job);
+    return;
   }
   fclose(fcatalog);
   FILE *fcatalog_vanilla = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
@@ -391,12 +593,14 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
   if (!fcatalog_vanilla) {
     LogCvmfs(kLogCvmfs, kLogStderr, "I/O error");
     unlink(file_catalog.c_str());
-    return false;
+    job->failed = true;
+    ReleaseCatalogAsync(job);
+    return;
   }
   const string url_catalog = *stratum0_url + "/data/" + catalog_hash.MakePath();
   download::JobInfo download_catalog(&url_catalog, false, false,
                                      fcatalog_vanilla, &catalog_hash);
-  dl_retval = download_manager()->Fetch(&download_catalog);
+  dl_retval = download_manager->Fetch(&download_catalog);
   fclose(fcatalog_vanilla);
   if (dl_retval != download::kFailOk) {
     if (path == "" && is_garbage_collectable) {
@@ -416,7 +620,10 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
     goto pull_cleanup;
   }
   if (path.empty() && reflog != NULL) {
-    if (!reflog->AddCatalog(catalog_hash)) {
+    pthread_mutex_lock(&lock_reflog);
+    retval = reflog->AddCatalog(catalog_hash);
+    pthread_mutex_unlock(&lock_reflog);
+    if (!retval) {
       LogCvmfs(kLogCvmfs, kLogStderr, "failed to add catalog to Reflog.");
       goto pull_cleanup;
     }
@@ -430,59 +637,220 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
   }
 
   // Always pull the HEAD root catalog and nested catalogs
-  if (apply_timestamp_threshold && (path == "") &&
+  if (job->apply_threshold && (path == "") &&
       (catalog->GetLastModified() < timestamp_threshold))
   {
     LogCvmfs(kLogCvmfs, kLogStdout,
              "  Pruning at root catalog from %s due to threshold at %s",
              StringifyTime(catalog->GetLastModified(), false).c_str(),
              StringifyTime(timestamp_threshold, false).c_str());
-    delete catalog;
     goto pull_skip;
   }
-  apply_timestamp_threshold = true;
 
-  // Traverse the chunks
-  LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak,
-           "  Processing chunks [%" PRIu64 " registered chunks]: ",
-           catalog->GetNumChunks());
-  retval = catalog->AllChunksBegin();
-  if (!retval) {
-    LogCvmfs(kLogCvmfs, kLogStderr, "failed to gather chunks");
-    goto pull_cleanup;
-  }
-  while (catalog->AllChunksNext(&chunk_hash, &compression_alg)) {
-    ChunkJob next_chunk(chunk_hash, compression_alg);
-    WritePipe(pipe_chunks[1], &next_chunk, sizeof(next_chunk));
-    atomic_inc64(&chunk_queue);
-  }
-  catalog->AllChunksEnd();
-  while (atomic_read64(&chunk_queue) != 0) {
-    SafeSleepMs(100);
-  }
-  LogCvmfs(kLogCvmfs, kLogStdout, " fetched %" PRId64 " new chunks out of "
-           "%" PRId64 " unique chunks",
-           atomic_read64(&overall_new)-gauge_new,
-           atomic_read64(&overall_chunks)-gauge_chunks);
+  if (!job->base_hash.IsNull())
+    base = FetchBaseCatalog(job->base_hash, path, download_manager);
+
+  // Referenced catalogs are listed by other workers while we walk the chunks
+  SpawnReferencedCatalogs(catalog, base, job);
 
-  retval = PullRecursion(catalog, path);
+  if ((journal != NULL) && journal->HasChunksComplete(catalog_hash)) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "  Chunks of catalog at %s replicated "
+             "before (journal)", print_path.c_str());
+  } else {
+    RevisionDiff::ObjectList new_objects;
+    if ((base != NULL) &&
+        RevisionDiff::ListNewObjects(base, catalog, &new_objects))
+    {
+      LogCvmfs(kLogCvmfs, kLogStdout,
+               "  Processing chunks of catalog at %s [%u new out of %" PRIu64
+               " registered chunks]", print_path.c_str(), new_objects.size(),
+               catalog->GetNumChunks());
+      for (unsigned i = 0; i < new_objects.size(); ++i) {
+        atomic_inc64(&job->pending);
+        atomic_inc64(&job->pending_chunks);
+        atomic_inc64(&job->num_chunks);
+        check_queue->Enqueue(ChunkJob(new_objects[i].first,
+                                      new_objects[i].second, job));
+      }
+    } else {
+      LogCvmfs(kLogCvmfs, kLogStdout,
+               "  Processing chunks of catalog at %s [%" PRIu64 " registered "
+               "chunks]", print_path.c_str(), catalog->GetNumChunks());
+      retval = catalog->AllChunksBegin();
+      if (!retval) {
+        LogCvmfs(kLogCvmfs, kLogStderr, "failed to gather chunks");
+        goto pull_cleanup;
+      }
+      while (catalog->AllChunksNext(&chunk_hash, &compression_alg)) {
+        atomic_inc64(&job->pending);
+        atomic_inc64(&job->pending_chunks);
+        atomic_inc64(&job->num_chunks);
+        check_queue->Enqueue(ChunkJob(chunk_hash, compression_alg, job));
+      }
+      catalog->AllChunksEnd();
+    }
+    ReleaseChunk(job);
+  }
 
+  delete base;
   delete catalog;
   unlink(file_catalog.c_str());
-  WaitForStorage();
-  Store(file_catalog_vanilla, catalog_hash);
-  return true;
+  job->file_vanilla = file_catalog_vanilla;
+  job->mark_complete = true;
+  ReleaseCatalogAsync(job);
+  return;
 
  pull_cleanup:
+  job->failed = true;
+ pull_skip:
+  delete base;
   delete catalog;
   unlink(file_catalog.c_str());
   unlink(file_catalog_vanilla.c_str());
-  return false;
+  ReleaseCatalogAsync(job);
+}
 
- pull_skip:
-  unlink(file_catalog.c_str());
-  unlink(file_catalog_vanilla.c_str());
-  return true;
+
+/**
+ * Stores a complete catalog and drops its reference to the parent catalog,
+ * which can complete the parent in turn.  Runs in the store stage.
+ */
+static void FinishCatalog(CatalogJob *catalog) {
+  while (catalog != NULL) {
+    CatalogJob *parent = catalog->parent;
+    if (catalog->failed) {
+      if (!catalog->file_vanilla.empty())
+        unlink(catalog->file_vanilla.c_str());
+      if (parent != NULL)
+        parent->failed = true;
+      else
+        atomic_inc32(&failed_roots);
+    } else if (!catalog->file_vanilla.empty()) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "  Catalog at %s: fetched %" PRId64
+               " new chunks out of %" PRId64 " unique chunks",
+               catalog->path.empty() ? "/" : catalog->path.c_str(),
+               atomic_read64(&catalog->num_new),
+               atomic_read64(&catalog->num_chunks));
+      // All chunks must be in place before the catalog becomes visible
+      WaitForStorageAndJournal();
+      Store(catalog->file_vanilla, catalog->hash);
+    }
+    if (!catalog->failed && catalog->mark_complete)
+      QueueJournalEntry(catalog->hash, true);
+    delete catalog;
+
+    if (parent == NULL) {
+      pending_roots.Decrement();
+      break;
+    }
+    catalog = ReleaseCatalog(parent) ? parent : NULL;
+  }
+}
+
+
+static void *MainCatalogWorker(void *data) {
+  MainWorkerContext *mwc = static_cast<MainWorkerContext*>(data);
+
+  while (1) {
+    CatalogJob *next_catalog = catalog_queue->Dequeue();
+    if (next_catalog == NULL) {
+      // Leave the termination marker for the other workers
+      catalog_queue->Enqueue(NULL);
+      break;
+    }
+    ProcessCatalog(next_catalog, mwc->download_manager);
+  }
+  return NULL;
+}
+
+
+/**
+ * Checks the existence of chunks in the target storage.  Dequeues chunks in
+ * batches so that the workers do not contend on the queue for every chunk.
+ */
+static void *MainCheckWorker(void *data) {
+  vector<ChunkJob> batch;
+
+  while (1) {
+    batch.clear();
+    check_queue->DequeueBatch(kCheckBatchSize, &batch);
+    if (batch[0].IsTerminateJob()) {
+      check_queue->Enqueue(batch[0]);
+      break;
+    }
+
+    for (unsigned i = 0; i < batch.size(); ++i) {
+      const ChunkJob &next_chunk = batch[i];
+      LogCvmfs(kLogCvmfs, kLogVerboseMsg, "processing chunk %s",
+               next_chunk.hash.ToString().c_str());
+      if (atomic_xadd64(&overall_chunks, 1) % 1000 == 0)
+        LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, ".");
+
+      if (Peek(next_chunk.hash)) {
+        ReleaseChunk(next_chunk.catalog);
+        ReleaseCatalogAsync(next_chunk.catalog);
+      } else {
+        download_queue->Enqueue(next_chunk);
+      }
+    }
+  }
+  return NULL;
+}
+
+
+static void *MainDownloadWorker(void *data) {
+  MainWorkerContext *mwc = static_cast<MainWorkerContext*>(data);
+  download::DownloadManager *download_manager = mwc->download_manager;
+
+  while (1) {
+    ChunkJob next_chunk = download_queue->Dequeue();
+    if (next_chunk.IsTerminateJob()) {
+      download_queue->Enqueue(next_chunk);
+      break;
+    }
+
+    shash::Any chunk_hash = next_chunk.hash;
+    FILE *fchunk = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
+                                  &next_chunk.local_path);
+    assert(fchunk);
+    string url_chunk = *stratum0_url + "/data/" + chunk_hash.MakePath();
+    download::JobInfo download_chunk(&url_chunk, false, false, fchunk,
+                                     &chunk_hash);
+
+    const download::Failures download_result =
+                                     download_manager->Fetch(&download_chunk);
+    if (download_result != download::kFailOk) {
+      ReportDownloadError(chunk_hash, download_result);
+      abort();
+    }
+    fclose(fchunk);
+    atomic_inc64(&overall_new);
+    atomic_inc64(&next_chunk.catalog->num_new);
+    store_queue->Enqueue(next_chunk);
+  }
+  return NULL;
+}
+
+
+/**
+ * There is only a single store worker.  Thus no other thread hands objects to
+ * the spooler while it waits for the chunks of a catalog to be uploaded.
+ */
+static void *MainStoreWorker(void *data) {
+  while (1) {
+    ChunkJob next_job = store_queue->Dequeue();
+    if (next_job.IsTerminateJob())
+      break;
+
+    if (!next_job.local_path.empty()) {
+      Store(next_job.local_path, next_job.hash, next_job.compression_alg);
+      ReleaseChunk(next_job.catalog);
+      if (!ReleaseCatalog(next_job.catalog))
+        continue;
+    }
+    FinishCatalog(next_job.catalog);
+  }
+  return NULL;
 }
 
 
@@ -496,6 +864,9 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
   manifest::ManifestEnsemble ensemble;
   shash::Any meta_info_hash;
   string meta_info;
+  shash::Any dictionary_hash;
+  string dictionary;
+  shash::Any base_root_hash;
 
   // Option parsing
   if (args.find('c') != args.end())
@@ -539,6 +910,7 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
     stratum1_url = args.find('w')->second;
   if (args.find('i') != args.end())
     initial_snapshot = true;
+  const bool check_all_objects = (args.find('f') != args.end());
   shash::Any reflog_hash;
   string reflog_chksum_path;
   if (args.find('R') != args.end()) {
@@ -549,7 +921,14 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
   if (args.find('Z') != args.end()) {
     timestamp_threshold = String2Int64(*args.find('Z')->second);
   }
+  string journal_path;
+  if (args.find('j') != args.end())
+    journal_path = *args.find('j')->second;
 
+  if (num_parallel == 0) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "need at least one download thread");
+    return 1;
+  }
   if (!preload_cache && stratum1_url == NULL) {
     LogCvmfs(kLogCvmfs, kLogStderr, "need -w <stratum 1 URL>");
     return 1;
@@ -566,10 +945,14 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
   // Initialization
   atomic_init64(&overall_chunks);
   atomic_init64(&overall_new);
-  atomic_init64(&chunk_queue);
+  atomic_init32(&failed_roots);
 
+  const unsigned num_catalog_workers = std::min(num_parallel,
+                                                kMaxCatalogWorkers);
+  // catalog workers, existence checkers, downloaders, and the store worker
+  const unsigned num_workers = num_catalog_workers + 2 * num_parallel + 1;
   const bool     follow_redirects = false;
-  const unsigned max_pool_handles = num_parallel+1;
+  const unsigned max_pool_handles = num_parallel + num_catalog_workers + 1;
 
   if (!this->InitDownloadManager(follow_redirects, max_pool_handles)) {
     return 1;
@@ -620,7 +1003,7 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
                                signature_manager());
 
   pthread_t *workers =
-    reinterpret_cast<pthread_t *>(smalloc(sizeof(pthread_t) * num_parallel));
+    reinterpret_cast<pthread_t *>(smalloc(sizeof(pthread_t) * num_workers));
 
   // Check if we have a replica-ready server
   const string url_sentinel = *stratum0_url + "/.cvmfs_master_replica";
@@ -663,6 +1046,25 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
                        download_metainfo.destination_mem.pos);
   }
 
+  // Get compression dictionary
+  dictionary_hash = ensemble.manifest->compression_dictionary();
+  if (!dictionary_hash.IsNull()) {
+    if (!FetchCompressionDictionary(*stratum0_url, dictionary_hash,
+                                    &dictionary))
+    {
+      goto fini;
+    }
+    // Preloaded objects are stored decompressed
+    zlib::Dictionary *zstd_dictionary = zlib::Dictionary::Create(
+      dictionary.data(), dictionary.size(),
+      zlib::ZstdCompressor::kDefaultLevel);
+    if (zstd_dictionary == NULL) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "invalid compression dictionary");
+      goto fini;
+    }
+    zlib::Dictionary::Register(zstd_dictionary);
+  }
+
   is_garbage_collectable = ensemble.manifest->garbage_collectable();
 
   // Manifest available, now the spooler's hash algorithm can be determined
@@ -676,6 +1078,19 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
     spooler->RegisterListener(&SpoolerOnUpload);
   }
 
+  if (!journal_path.empty()) {
+    journal = ReplicationJournal::Open(journal_path);
+    if (journal == NULL) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "failed to open journal %s",
+               journal_path.c_str());
+      goto fini;
+    }
+    if (journal->GetNumEntries() > 0) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "Resuming replication, %u catalogs "
+               "in the journal", journal->GetNumEntries());
+    }
+  }
+
   // Open the reflog for modification
   if (!preload_cache) {
     if (initial_snapshot) {
@@ -714,6 +1129,24 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
     }
   }
 
+  // The revision present in the target storage is the base for the HEAD root
+  // catalog: the objects that it references are already replicated
+  if (!preload_cache && !initial_snapshot && !check_all_objects) {
+    manifest::ManifestEnsemble ensemble_stratum1;
+    m_retval = FetchRemoteManifestEnsemble(*stratum1_url,
+                                           repository_name,
+                                           &ensemble_stratum1);
+    if (m_retval == manifest::kFailOk) {
+      base_root_hash = ensemble_stratum1.manifest->catalog_hash();
+      LogCvmfs(kLogCvmfs, kLogStdout, "Replicating changes since revision "
+               "%" PRIu64, ensemble_stratum1.manifest->revision());
+    } else {
+      LogCvmfs(kLogCvmfs, kLogStdout, "No replicated revision found "
+               "(%d - %s), checking all objects",
+               m_retval, manifest::Code2Ascii(m_retval));
+    }
+  }
+
   // Fetch tag list.
   // If we are just preloading the cache it is not strictly necessarily to
   // download the entire tag list
@@ -764,41 +1197,63 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
     }
   }
 
-  // Starting threads
-  MakePipe(pipe_chunks);
-  LogCvmfs(kLogCvmfs, kLogStdout, "Starting %u workers", num_parallel);
+  // Starting threads.  The catalog queue is not bounded because the catalog
+  // workers feed it themselves.  The other queues are bounded so that the
+  // stages run concurrently without piling up work or temporary files.
+  catalog_queue = new FifoChannel<CatalogJob *>(size_t(-1), 1);
+  check_queue = new FifoChannel<ChunkJob>(kCheckQueueLength,
+                                          kCheckQueueLength / 2);
+  download_queue = new FifoChannel<ChunkJob>(4 * num_parallel,
+                                             2 * num_parallel);
+  store_queue = new FifoChannel<ChunkJob>(4 * num_parallel, 2 * num_parallel);
+  LogCvmfs(kLogCvmfs, kLogStdout, "Starting %u catalog workers and %u workers",
+           num_catalog_workers, num_parallel);
   MainWorkerContext mwc;
   mwc.download_manager = download_manager();
-  for (unsigned i = 0; i < num_parallel; ++i) {
-    int retval = pthread_create(&workers[i], NULL, MainWorker,
+  for (unsigned i = 0; i < num_workers; ++i) {
+    void *(*worker)(void *) = MainStoreWorker;
+    if (i < num_catalog_workers)
+      worker = MainCatalogWorker;
+    else if (i < num_catalog_workers + num_parallel)
+      worker = MainCheckWorker;
+    else if (i < num_catalog_workers + 2 * num_parallel)
+      worker = MainDownloadWorker;
+    int retval = pthread_create(&workers[i], NULL, worker,
                                 static_cast<void*>(&mwc));
     assert(retval == 0);
   }
 
   LogCvmfs(kLogCvmfs, kLogStdout, "Replicating from trunk catalog at /");
-  retval = Pull(ensemble.manifest->catalog_hash(), "");
-  pull_history = false;
+  SpawnCatalog(new CatalogJob(ensemble.manifest->catalog_hash(), "", NULL,
+                              false, pull_history, base_root_hash));
   for (TagVector::const_iterator i    = historic_tags.begin(),
                                  iend = historic_tags.end();
        i != iend; ++i) {
     LogCvmfs(kLogCvmfs, kLogStdout, "Replicating from %s repository tag",
              i->name.c_str());
-    apply_timestamp_threshold = false;
-    bool retval2 = Pull(i->root_hash, "");
-    retval = retval && retval2;
+    SpawnCatalog(new CatalogJob(i->root_hash, "", NULL, false, false));
   }
-
-  // Stopping threads
-  LogCvmfs(kLogCvmfs, kLogStdout, "Stopping %u workers", num_parallel);
-  for (unsigned i = 0; i < num_parallel; ++i) {
-    ChunkJob terminate_workers;
-    WritePipe(pipe_chunks[1], &terminate_workers, sizeof(terminate_workers));
-  }
-  for (unsigned i = 0; i < num_parallel; ++i) {
+  pending_roots.WaitForZero();
+  retval = (atomic_read32(&failed_roots) == 0);
+
+  // Stopping threads, every worker passes the termination marker on
+  LogCvmfs(kLogCvmfs, kLogStdout, "Stopping %u workers", num_workers);
+  catalog_queue->Enqueue(NULL);
+  check_queue->Enqueue(ChunkJob());
+  download_queue->Enqueue(ChunkJob());
+  store_queue->Enqueue(ChunkJob());
+  for (unsigned i = 0; i < num_workers; ++i) {
     int retval = pthread_join(workers[i], NULL);
     assert(retval == 0);
   }
-  ClosePipe(pipe_chunks);
+  delete catalog_queue;
+  delete check_queue;
+  delete download_queue;
+  delete store_queue;
+  // Keeps the progress of the catalogs that finished after the last catalog
+  // was stored, in case the replication is resumed
+  if (journal != NULL)
+    WaitForStorageAndJournal();
 
   if (!retval)
     goto fini;
@@ -827,6 +1282,14 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
         goto fini;
       }
     }
+    if (!dictionary_hash.IsNull()) {
+      StoreBuffer(reinterpret_cast<const unsigned char *>(dictionary.data()),
+                  dictionary.size(), dictionary_hash, true);
+      if (reflog != NULL && !reflog->AddDictionary(dictionary_hash)) {
+        LogCvmfs(kLogCvmfs, kLogStderr, "Failed to add dictionary to Reflog.");
+        goto fini;
+      }
+    }
 
     // upload Reflog database
     if (!preload_cache && reflog != NULL) {
@@ -869,12 +1332,15 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
   LogCvmfs(kLogCvmfs, kLogStdout, "Fetched %" PRId64 " new chunks out of %"
            PRId64 " processed chunks",
            atomic_read64(&overall_new), atomic_read64(&overall_chunks));
+  if (journal != NULL)
+    journal->Remove();
   result = 0;
 
  fini:
   if (fd_lockfile >= 0)
     UnlockFile(fd_lockfile);
   free(workers);
+  delete journal;
   delete spooler;
   delete pathfilter;
   return result;
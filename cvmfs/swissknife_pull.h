@@ -9,14 +9,6 @@
 
 #include "swissknife.h"
 
-namespace catalog {
-class Catalog;
-}
-
-namespace shash {
-struct Any;
-}
-
 namespace swissknife {
 
 class CommandPull : public Command {
@@ -42,9 +34,12 @@ class CommandPull : public Command {
     r.push_back(Parameter::Optional('a', "number of retries"));
     r.push_back(Parameter::Optional('d', "directory for path specification"));
     r.push_back(Parameter::Optional('Z', "pull revisions younger than <Z>"));
+    r.push_back(Parameter::Optional('j', "journal file to resume from"));
     r.push_back(Parameter::Switch('p', "pull catalog history, too"));
     r.push_back(Parameter::Switch('i', "mark as an 'initial snapshot'"));
     r.push_back(Parameter::Switch('c', "preload cache instead of stratum 1"));
+    r.push_back(Parameter::Switch('f', "check all objects, not only the ones "
+                                       "new since the replicated revision"));
     // Required for preloading client cache with a dirtab.  If the dirtab
     // changes, the existence of a catalog does not anymore indicate if
     // everything in the corresponding subtree is already fetched, too.
@@ -53,10 +48,6 @@ class CommandPull : public Command {
     return r;
   }
   int Main(const ArgumentList &args);
-
- protected:
-  bool PullRecursion(catalog::Catalog *catalog, const std::string &path);
-  bool Pull(const shash::Any &catalog_hash, const std::string &path);
 };
 
 }  // namespace swissknife
@@ -150,6 +150,7 @@ void CommandReconstructReflog::AddStaticManifestObjects(
                                           manifest::Manifest  *manifest) const {
   const shash::Any certificate = manifest->certificate();
   const shash::Any meta_info   = manifest->meta_info();
+  const shash::Any dictionary  = manifest->compression_dictionary();
   assert(!certificate.IsNull());
 
   bool success = reflog->AddCertificate(certificate);
@@ -163,6 +164,13 @@ void CommandReconstructReflog::AddStaticManifestObjects(
     LogCvmfs(kLogCvmfs, kLogStdout, "Metainfo: %s",
              meta_info.ToString().c_str());
   }
+
+  if (!dictionary.IsNull()) {
+    success = reflog->AddDictionary(dictionary);
+    assert(success);
+    LogCvmfs(kLogCvmfs, kLogStdout, "Compression dictionary: %s",
+             dictionary.ToString().c_str());
+  }
 }
 
 
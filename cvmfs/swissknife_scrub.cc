@@ -7,9 +7,19 @@
 #include "cvmfs_config.h"
 #include "swissknife_scrub.h"
 
+#include <alloca.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
 #include "fs_traversal.h"
 #include "logging.h"
+#include "platform.h"
 #include "smalloc.h"
+#include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -21,74 +31,32 @@ const std::string kTxnDirectoryName  = "txn";
 
 CommandScrub::CommandScrub()
   : machine_readable_output_(false)
-  , reader_(NULL)
+  , num_threads_(1)
+  , queue_(NULL)
+  , small_files_(NULL)
   , alerts_(0)
 {
   // initialize alert printer mutex
   const bool mutex_init = (pthread_mutex_init(&alerts_mutex_, NULL) == 0);
   assert(mutex_init);
+  atomic_init64(&num_files_);
+  atomic_init64(&num_bytes_);
 }
 
 
 CommandScrub::~CommandScrub() {
-  if (reader_ != NULL) {
-    delete reader_;
-    reader_ = NULL;
-  }
-
+  delete small_files_;
+  delete queue_;
   pthread_mutex_destroy(&alerts_mutex_);
 }
 
 
-CommandScrub::StoredFile::StoredFile(const std::string &path,
-                                     const std::string &expected_hash) :
-  AbstractFile(path, GetFileSize(path)),
-  hash_done_(false)
-{
-  expected_hash_ = shash::MkFromHexPtr(shash::HexPtr(expected_hash));
-  hash_context_.algorithm = expected_hash_.algorithm;
-  hash_context_.size = shash::GetContextSize(expected_hash_.algorithm);
-  hash_context_.buffer = smalloc(hash_context_.size);
-  shash::Init(hash_context_);
-}
-
-
-void CommandScrub::StoredFile::Update(const unsigned char *data,
-                                      const size_t nbytes)
-{
-  assert(!hash_done_);
-  shash::Update(data, nbytes, hash_context_);
-}
-
-
-void CommandScrub::StoredFile::Finalize() {
-  assert(!hash_done_);
-  shash::Final(hash_context_, &content_hash_);
-  free(hash_context_.buffer);
-  hash_context_.buffer = NULL;
-  hash_done_ = true;
-}
-
-
-
-tbb::task* CommandScrub::StoredFileScrubbingTask::execute() {
-  StoredFile          *file   = StoredFileScrubbingTask::file();
-  upload::CharBuffer  *buffer = StoredFileScrubbingTask::buffer();
-
-  file->Update(buffer->ptr(), buffer->used_bytes());
-  if (IsLast()) {
-    file->Finalize();
-  }
-
-  return Finalize();
-}
-
-
-
 swissknife::ParameterList CommandScrub::GetParams() const {
   swissknife::ParameterList r;
   r.push_back(Parameter::Mandatory('r', "repository directory"));
   r.push_back(Parameter::Switch('m', "machine readable output"));
+  r.push_back(Parameter::Optional('j', "number of scrubbing threads "
+                                       "(default: number of CPU cores)"));
   return r;
 }
 
@@ -109,6 +77,8 @@ const char* CommandScrub::Alerts::ToString(const CommandScrub::Alerts::Type t) {
       return "malformed CAS subdir length";
     case Alerts::kContentHashMismatch:
       return "mismatch of file name and content hash";
+    case Alerts::kReadError:
+      return "failed to read file";
     default:
       return "unknown alert";
   }
@@ -142,8 +112,27 @@ void CommandScrub::FileCallback(const std::string &relative_path,
     return;
   }
 
-  assert(reader_ != NULL);
-  reader_->ScheduleRead(new StoredFile(full_path, hash_string));
+  const StoredFile file(full_path,
+                        shash::MkFromHexPtr(shash::HexPtr(hash_string)),
+                        GetFileSize(full_path));
+  if ((file.size >= 0) && (file.size <= kMaxSmallFileSize)) {
+    if (small_files_ == NULL)
+      small_files_ = new FileBatch();
+    small_files_->push_back(file);
+    if (small_files_->size() >= kSmallFileBatchSize)
+      FlushSmallFiles();
+    return;
+  }
+
+  queue_->Enqueue(new FileBatch(1, file));
+}
+
+
+void CommandScrub::FlushSmallFiles() {
+  if (small_files_ == NULL)
+    return;
+  queue_->Enqueue(small_files_);
+  small_files_ = NULL;
 }
 
 
@@ -175,14 +164,131 @@ void CommandScrub::SymlinkCallback(const std::string &relative_path,
 }
 
 
-void CommandScrub::FileProcessedCallback(StoredFile* const& file) {
-  if (file->content_hash() != file->expected_hash()) {
-    PrintAlert(Alerts::kContentHashMismatch, file->path(),
-               file->content_hash().ToString());
+/**
+ * Reads the small files of the batch into memory and hashes them together.
+ * Large files and small files that cannot be read in one go are streamed.
+ * Like for large files, the pages of small files are dropped from the page
+ * cache once read.
+ */
+void CommandScrub::ScrubBatch(const FileBatch &batch,
+                              unsigned char *read_buffer)
+{
+  vector<string> contents(batch.size());
+  vector<const unsigned char *> buffers;
+  vector<unsigned> sizes;
+  vector<shash::Any> hashes;
+  vector<unsigned> indexes;
+  for (unsigned i = 0; i < batch.size(); ++i) {
+    const StoredFile &file = batch[i];
+    if ((file.size >= 0) && (file.size <= kMaxSmallFileSize)) {
+      const int fd = open(file.path.c_str(), O_RDONLY);
+      if (fd >= 0) {
+        platform_sequential_read(fd);
+        const bool retval = SafeReadToString(fd, &contents[i]);
+        (void)platform_invalidate_kcache(fd, 0, 0);
+        close(fd);
+        if (retval) {
+          buffers.push_back(
+            reinterpret_cast<const unsigned char *>(contents[i].data()));
+          sizes.push_back(contents[i].size());
+          hashes.push_back(shash::Any(file.expected_hash.algorithm));
+          indexes.push_back(i);
+          continue;
+        }
+      }
+    }
+
+    shash::Any content_hash(file.expected_hash.algorithm);
+    if (HashLargeFile(file, read_buffer, &content_hash))
+      CheckContentHash(file, content_hash);
+  }
+
+  if (indexes.empty())
+    return;
+  shash::HashMemBatch(&buffers[0], &sizes[0], indexes.size(), &hashes[0]);
+  for (unsigned i = 0; i < indexes.size(); ++i) {
+    atomic_xadd64(&num_bytes_, sizes[i]);
+    CheckContentHash(batch[indexes[i]], hashes[i]);
   }
 }
 
 
+/**
+ * Streams the file through the hash function in reads of kReadBufferSize.
+ * The file is not mapped into memory because an I/O error would then raise
+ * SIGBUS instead of a read error.  The pages are dropped from the page cache
+ * afterwards so that scrubbing does not evict the working set of the server.
+ */
+bool CommandScrub::HashLargeFile(const StoredFile &file,
+                                 unsigned char *read_buffer,
+                                 shash::Any *content_hash)
+{
+  const int fd = open(file.path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    PrintAlert(Alerts::kReadError, file.path);
+    return false;
+  }
+  platform_sequential_read(fd);
+
+  shash::ContextPtr context(content_hash->algorithm);
+  context.buffer = alloca(context.size);
+  shash::Init(context);
+  uint64_t nbytes = 0;
+  while (true) {
+    const ssize_t retval = read(fd, read_buffer, kReadBufferSize);
+    if (retval == 0)
+      break;
+    if (retval < 0) {
+      if (errno == EINTR)
+        continue;
+      close(fd);
+      PrintAlert(Alerts::kReadError, file.path);
+      return false;
+    }
+    shash::Update(read_buffer, retval, context);
+    nbytes += retval;
+  }
+  shash::Final(context, content_hash);
+
+  (void)platform_invalidate_kcache(fd, 0, 0);
+  close(fd);
+  atomic_xadd64(&num_bytes_, nbytes);
+  return true;
+}
+
+
+void CommandScrub::CheckContentHash(const StoredFile &file,
+                                    const shash::Any &content_hash)
+{
+  atomic_inc64(&num_files_);
+  if (content_hash != file.expected_hash) {
+    PrintAlert(Alerts::kContentHashMismatch, file.path,
+               content_hash.ToString());
+  }
+}
+
+
+void *CommandScrub::MainWorker(void *data) {
+  CommandScrub *scrub = static_cast<CommandScrub *>(data);
+  unsigned char *read_buffer =
+    static_cast<unsigned char *>(sxmmap(kReadBufferSize));
+
+  while (true) {
+    FileBatch *batch = scrub->queue_->Dequeue();
+    if (batch == NULL) {
+      // Leave the termination marker for the other workers
+      scrub->queue_->Enqueue(NULL);
+      break;
+    }
+    scrub->ScrubBatch(*batch, read_buffer);
+    delete batch;
+  }
+
+  sxunmap(read_buffer, kReadBufferSize);
+  return NULL;
+}
+
+
 std::string CommandScrub::CheckPathAndExtractHash(
                                            const std::string &relative_path,
                                            const std::string &file_name,
@@ -200,7 +306,8 @@ std::string CommandScrub::CheckPathAndExtractHash(
       last_character != shash::kSuffixPartial      &&
       last_character != shash::kSuffixCertificate  &&
       last_character != shash::kSuffixMicroCatalog &&
-      last_character != shash::kSuffixMetainfo)
+      last_character != shash::kSuffixMetainfo    &&
+      last_character != shash::kSuffixDictionary)
   {
     PrintAlert(Alerts::kUnexpectedModifier, full_path);
     return "";
@@ -218,12 +325,24 @@ int CommandScrub::Main(const swissknife::ArgumentList &args) {
   repo_path_               = MakeCanonicalPath(*args.find('r')->second);
   machine_readable_output_ = (args.find('m') != args.end());
 
-  // initialize asynchronous reader
-  const size_t       max_buffer_size     = 512 * 1024;
-  const unsigned int max_files_in_flight = 100;
-  reader_ = new ScrubbingReader(max_buffer_size, max_files_in_flight);
-  reader_->RegisterListener(&CommandScrub::FileProcessedCallback, this);
-  reader_->Initialize();
+  num_threads_ = GetNumberOfCpuCores();
+  if (args.find('j') != args.end()) {
+    num_threads_ = String2Uint64(*args.find('j')->second);
+    if (num_threads_ == 0) {
+      LogCvmfs(kLogUtility, kLogStderr, "at least one thread is required");
+      return 1;
+    }
+  }
+
+  // start the scrubbing workers
+  queue_ = new FifoChannel<FileBatch *>(kQueueLength, kQueueLength / 2);
+  vector<pthread_t> workers(num_threads_);
+  for (unsigned i = 0; i < num_threads_; ++i) {
+    int retval = pthread_create(&workers[i], NULL, MainWorker,
+                                static_cast<void *>(this));
+    assert(retval == 0);
+  }
+  const uint64_t start_ns = platform_monotonic_time_ns();
 
   // initialize file system recursion engine
   FileSystemTraversal<CommandScrub> traverser(this, repo_path_, true);
@@ -231,10 +350,21 @@ int CommandScrub::Main(const swissknife::ArgumentList &args) {
   traverser.fn_enter_dir   = &CommandScrub::DirCallback;
   traverser.fn_new_symlink = &CommandScrub::SymlinkCallback;
   traverser.Recurse(repo_path_);
-
-  // wait for reader to finish all jobs
-  reader_->Wait();
-  reader_->TearDown();
+  FlushSmallFiles();
+
+  // wait for the workers to finish all jobs
+  queue_->Enqueue(NULL);
+  for (unsigned i = 0; i < num_threads_; ++i)
+    pthread_join(workers[i], NULL);
+
+  const double seconds =
+    static_cast<double>(platform_monotonic_time_ns() - start_ns) / 1e9;
+  const double mbytes =
+    static_cast<double>(atomic_read64(&num_bytes_)) / (1024 * 1024);
+  LogCvmfs(kLogUtility, kLogStdout, "scrubbed %" PRId64 " files "
+           "(%.1f MB) in %.1f seconds with %u threads (%.1f MB/s)",
+           atomic_read64(&num_files_), mbytes, seconds, num_threads_,
+           (seconds > 0) ? mbytes / seconds : 0.0);
 
   return (alerts_ == 0) ? 0 : 1;
 }
@@ -9,10 +9,11 @@
 
 #include <cassert>
 #include <string>
+#include <vector>
 
-#include "file_processing/async_reader.h"
-#include "file_processing/file.h"
+#include "atomic.h"
 #include "hash.h"
+#include "util_concurrency.h"
 
 namespace swissknife {
 
@@ -27,6 +28,7 @@ class CommandScrub : public Command {
       kMalformedHash,
       kMalformedCasSubdir,
       kContentHashMismatch,
+      kReadError,
       kNumberOfErrorTypes  // This should _always_ stay the last entry!
     };
 
@@ -34,42 +36,24 @@ class CommandScrub : public Command {
   };
 
  private:
-  class StoredFile : public upload::AbstractFile {
-   public:
-    StoredFile(const std::string &path, const std::string &expected_hash);
-    void Update(const unsigned char *data, const size_t nbytes);
-    void Finalize();
-
-    const shash::Any& content_hash() const {
-      assert(hash_done_); return content_hash_;
-    }
-    const shash::Any& expected_hash() const { return expected_hash_; }
-
-   private:
-    bool              hash_done_;
-    shash::ContextPtr hash_context_;
-
-    shash::Any        content_hash_;
-    shash::Any        expected_hash_;
+  /**
+   * Files are scrubbed by a pool of worker threads.  Small files are handed
+   * out in batches, read in one go, and hashed with the batch hashing kernels.
+   * Large files are streamed in big, page-aligned reads.
+   */
+  struct StoredFile {
+    StoredFile(const std::string &p, const shash::Any &h, const int64_t s) :
+      path(p), expected_hash(h), size(s) {}
+    std::string path;
+    shash::Any  expected_hash;
+    int64_t     size;
   };
+  typedef std::vector<StoredFile> FileBatch;
 
-  class StoredFileScrubbingTask :
-                          public upload::AbstractFileScrubbingTask<StoredFile> {
-   public:
-    StoredFileScrubbingTask(StoredFile              *file,
-                            upload::CharBuffer      *buffer,
-                            const bool               is_last_piece,
-                            upload::AbstractReader  *reader) :
-      upload::AbstractFileScrubbingTask<StoredFile>(file,
-                                                    buffer,
-                                                    is_last_piece,
-                                                    reader) {}
-
-   protected:
-    tbb::task* execute();
-  };
-
-  typedef upload::Reader<StoredFileScrubbingTask, StoredFile> ScrubbingReader;
+  static const int64_t kMaxSmallFileSize = 64 * 1024;
+  static const unsigned kSmallFileBatchSize = 64;
+  static const size_t kReadBufferSize = 2 * 1024 * 1024;
+  static const unsigned kQueueLength = 256;
 
  public:
   CommandScrub();
@@ -92,7 +76,14 @@ class CommandScrub : public Command {
   void SymlinkCallback(const std::string &relative_path,
                        const std::string &symlink_name);
 
-  void FileProcessedCallback(StoredFile* const& file);
+  void FlushSmallFiles();
+  void ScrubBatch(const FileBatch &batch, unsigned char *read_buffer);
+  bool HashLargeFile(const StoredFile &file,
+                     unsigned char *read_buffer,
+                     shash::Any *content_hash);
+  void CheckContentHash(const StoredFile &file,
+                        const shash::Any &content_hash);
+  static void *MainWorker(void *data);
 
   void PrintAlert(const Alerts::Type   type,
                   const std::string   &path,
@@ -112,7 +103,12 @@ class CommandScrub : public Command {
  private:
   std::string                   repo_path_;
   bool                          machine_readable_output_;
-  ScrubbingReader              *reader_;
+  unsigned                      num_threads_;
+  FifoChannel<FileBatch *>     *queue_;
+  FileBatch                    *small_files_;
+
+  atomic_int64                  num_files_;
+  atomic_int64                  num_bytes_;
 
   mutable unsigned int          alerts_;
   mutable pthread_mutex_t       alerts_mutex_;
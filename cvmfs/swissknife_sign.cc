@@ -50,6 +50,8 @@ int swissknife::CommandSign::Main(const swissknife::ArgumentList &args) {
   if (args.find('s') != args.end()) pwd = *args.find('s')->second;
   string meta_info = "";
   if (args.find('M') != args.end()) meta_info = *args.find('M')->second;
+  string dictionary = "";
+  if (args.find('Y') != args.end()) dictionary = *args.find('Y')->second;
   const bool garbage_collectable = (args.count('g') > 0);
   const bool bootstrap_shortcuts = (args.count('A') > 0);
   const bool return_early = (args.count('e') > 0);
@@ -144,6 +146,29 @@ int swissknife::CommandSign::Main(const swissknife::ArgumentList &args) {
     }
   }
 
+  // Save compression dictionary.  Objects compressed with a dictionary remain
+  // in the repository, so it cannot be replaced by a different one
+  shash::Any dictionary_hash = manifest->compression_dictionary();
+  if (!dictionary.empty()) {
+    upload::Spooler::CallbackPtr callback =
+      spooler->RegisterListener(&CommandSign::DictionaryUploadCallback, this);
+    spooler->ProcessDictionary(dictionary);
+    const shash::Any new_dictionary_hash = dictionary_hash_.Get();
+    spooler->UnregisterListener(callback);
+
+    if (new_dictionary_hash.IsNull()) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "Failed to upload dictionary");
+      return 1;
+    }
+    if (!dictionary_hash.IsNull() && (dictionary_hash != new_dictionary_hash)) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "repository already has a different "
+               "compression dictionary (%s)",
+               dictionary_hash.ToString().c_str());
+      return 1;
+    }
+    dictionary_hash = new_dictionary_hash;
+  }
+
   // Update Reflog database
   if (reflog.IsValid()) {
     reflog->BeginTransaction();
@@ -172,6 +197,13 @@ int swissknife::CommandSign::Main(const swissknife::ArgumentList &args) {
       }
     }
 
+    if (!dictionary_hash.IsNull()) {
+      if (!reflog->AddDictionary(dictionary_hash)) {
+        LogCvmfs(kLogCvmfs, kLogStderr, "Failed to add dictionary to Reflog");
+        return 1;
+      }
+    }
+
     reflog->CommitTransaction();
 
     // upload Reflog database
@@ -207,6 +239,9 @@ int swissknife::CommandSign::Main(const swissknife::ArgumentList &args) {
   if (!metainfo_hash.IsNull()) {
     manifest->set_meta_info(metainfo_hash);
   }
+  if (!dictionary_hash.IsNull()) {
+    manifest->set_compression_dictionary(dictionary_hash);
+  }
 
   string signed_manifest = manifest->ExportString();
   shash::Any published_hash(manifest->GetHashAlgorithm());
@@ -292,3 +327,17 @@ void swissknife::CommandSign::MetainfoUploadCallback(
   }
   metainfo_hash_.Set(metainfo_hash);
 }
+
+
+void swissknife::CommandSign::DictionaryUploadCallback(
+                                          const upload::SpoolerResult &result) {
+  shash::Any dictionary_hash;
+  if (result.return_code == 0) {
+    dictionary_hash = result.content_hash;
+  } else {
+    LogCvmfs(kLogCvmfs, kLogStderr, "Failed to upload dictionary "
+                                    "(retcode: %d)",
+                                    result.return_code);
+  }
+  dictionary_hash_.Set(dictionary_hash);
+}
@@ -36,6 +36,7 @@ class CommandSign : public Command {
     r.push_back(Parameter::Optional('s', "password for the private key"));
     r.push_back(Parameter::Optional('n', "repository name"));
     r.push_back(Parameter::Optional('M', "repository meta info file"));
+    r.push_back(Parameter::Optional('Y', "zstd compression dictionary file"));
     r.push_back(Parameter::Switch('b', "generate symlinks for VOMS-secured "
                                        "repo backends"));
     r.push_back(Parameter::Switch('g', "repository is garbage collectible"));
@@ -49,10 +50,12 @@ class CommandSign : public Command {
  protected:
   void CertificateUploadCallback(const upload::SpoolerResult &result);
   void MetainfoUploadCallback(const upload::SpoolerResult &result);
+  void DictionaryUploadCallback(const upload::SpoolerResult &result);
 
  private:
   Future<shash::Any> certificate_hash_;
   Future<shash::Any> metainfo_hash_;
+  Future<shash::Any> dictionary_hash_;
 };
 
 }  // namespace swissknife
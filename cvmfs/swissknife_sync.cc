@@ -493,6 +493,16 @@ bool swissknife::CommandSync::ReadFileChunkingArgs(
     }
   }
 
+  swissknife::ArgumentList::const_iterator alg = args.find('G');
+  if (alg != args.end()) {
+    if (*alg->second == "xor32")
+      params->chunking_algorithm = upload::SpoolerDefinition::Xor32;
+    else if (*alg->second == "gear")
+      params->chunking_algorithm = upload::SpoolerDefinition::Gear;
+    else
+      return false;
+  }
+
   // check if argument values are sane
   return true;
 }
@@ -568,7 +578,8 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
   }
   if (args.find('Z') != args.end()) {
     params.compression_alg =
-      zlib::ParseCompressionAlgorithm(*args.find('Z')->second);
+      zlib::ParseCompressionAlgorithm(*args.find('Z')->second,
+                                      &params.compression_level);
   }
 
   if (args.find('C') != args.end()) {
@@ -588,6 +599,14 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     params.max_concurrent_write_jobs = String2Uint64(*args.find('q')->second);
   }
 
+  if (args.find('P') != args.end()) {
+    params.num_scan_threads = String2Uint64(*args.find('P')->second);
+    if (params.num_scan_threads == 0) {
+      PrintError("number of scanning threads must be positive");
+      return 1;
+    }
+  }
+
   if (args.find('T') != args.end()) {
     params.ttl_seconds = String2Uint64(*args.find('T')->second);
   }
@@ -606,22 +625,20 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     params.use_file_chunking,
     params.min_file_chunk_size,
     params.avg_file_chunk_size,
-    params.max_file_chunk_size);
+    params.max_file_chunk_size,
+    params.chunking_algorithm);
+  spooler_definition.compression_level = params.compression_level;
   if (params.max_concurrent_write_jobs > 0) {
     spooler_definition.number_of_concurrent_uploads =
                                                params.max_concurrent_write_jobs;
   }
-
-  upload::SpoolerDefinition spooler_definition_catalogs(
-    spooler_definition.Dup2DefaultCompression());
-
-  params.spooler = upload::Spooler::Construct(spooler_definition);
-  if (NULL == params.spooler)
-    return 3;
-  UniquePtr<upload::Spooler> spooler_catalogs(
-    upload::Spooler::Construct(spooler_definition_catalogs));
-  if (!spooler_catalogs.IsValid())
-    return 3;
+  if (args.find('E') != args.end()) {
+    spooler_definition.existence_filter_path = *args.find('E')->second;
+  }
+  if (args.find('B') != args.end()) {
+    spooler_definition.object_pack_threshold =
+      String2Uint64(*args.find('B')->second);
+  }
 
   const bool follow_redirects = (args.count('L') > 0);
   if (!this->InitDownloadManager(follow_redirects)) {
@@ -645,6 +662,40 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     return 3;
   }
 
+  // New zstd compressed objects use the repository's dictionary
+  UniquePtr<zlib::Dictionary> dictionary;
+  if ((params.compression_alg == zlib::kZstd) &&
+      !manifest->compression_dictionary().IsNull())
+  {
+    string dictionary_buf;
+    if (!FetchCompressionDictionary(params.stratum0,
+                                    manifest->compression_dictionary(),
+                                    &dictionary_buf))
+    {
+      return 3;
+    }
+    dictionary = zlib::Dictionary::Create(
+      dictionary_buf.data(), dictionary_buf.size(),
+      (params.compression_level > 0) ? params.compression_level
+                                     : zlib::ZstdCompressor::kDefaultLevel);
+    if (!dictionary.IsValid()) {
+      PrintError("invalid compression dictionary");
+      return 3;
+    }
+    spooler_definition.compression_dictionary = dictionary.weak_ref();
+  }
+
+  upload::SpoolerDefinition spooler_definition_catalogs(
+    spooler_definition.Dup2DefaultCompression());
+
+  params.spooler = upload::Spooler::Construct(spooler_definition);
+  if (NULL == params.spooler)
+    return 3;
+  UniquePtr<upload::Spooler> spooler_catalogs(
+    upload::Spooler::Construct(spooler_definition_catalogs));
+  if (!spooler_catalogs.IsValid())
+    return 3;
+
   catalog::WritableCatalogManager
     catalog_manager(params.base_hash, params.stratum0, params.dir_temp,
                     spooler_catalogs, download_manager(),
@@ -676,6 +727,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
       return 3;
     }
 
+    sync->SetNumScanThreads(params.num_scan_threads);
     if (!sync->Initialize()) {
       LogCvmfs(kLogCvmfs, kLogStderr, "Initialization of the synchronisation "
                                       "engine failed");
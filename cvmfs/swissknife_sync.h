@@ -35,13 +35,16 @@ struct SyncParameters {
     virtual_dir_actions(0),
     ignore_special_files(false),
     compression_alg(zlib::kZlibDefault),
+    compression_level(0),
     catalog_entry_warn_threshold(kDefaultEntryWarnThreshold),
     min_file_chunk_size(kDefaultMinFileChunkSize),
     avg_file_chunk_size(kDefaultAvgFileChunkSize),
     max_file_chunk_size(kDefaultMaxFileChunkSize),
+    chunking_algorithm(upload::SpoolerDefinition::Xor32),
     manual_revision(0),
     ttl_seconds(0),
     max_concurrent_write_jobs(0),
+    num_scan_threads(1),
     is_balanced(false),
     max_weight(kDefaultMaxWeight),
     min_weight(kDefaultMinWeight) {}
@@ -72,13 +75,16 @@ struct SyncParameters {
   unsigned         virtual_dir_actions;  // bit field
   bool             ignore_special_files;
   zlib::Algorithms compression_alg;
+  int              compression_level;
   uint64_t         catalog_entry_warn_threshold;
   size_t           min_file_chunk_size;
   size_t           avg_file_chunk_size;
   size_t           max_file_chunk_size;
+  upload::SpoolerDefinition::ChunkingAlgorithm chunking_algorithm;
   uint64_t         manual_revision;
   uint64_t         ttl_seconds;
   uint64_t         max_concurrent_write_jobs;
+  unsigned         num_scan_threads;
   bool             is_balanced;
   unsigned         max_weight;
   unsigned         min_weight;
@@ -243,12 +249,21 @@ class CommandSync : public Command {
     r.push_back(Parameter::Optional('q', "number of concurrent write jobs"));
     r.push_back(Parameter::Optional('v', "manual revision number"));
     r.push_back(Parameter::Optional('z', "log level (0-4, default: 2)"));
+    r.push_back(Parameter::Optional('B', "upload objects up to <B> bytes in "
+                                         "object packs (default: off)"));
     r.push_back(Parameter::Optional('C', "trusted certificates"));
+    r.push_back(Parameter::Optional('E', "existence filter of the uploaded "
+                                         "objects (skips re-uploads)"));
     r.push_back(Parameter::Optional('F', "Authz file listing (default: none)"));
+    r.push_back(Parameter::Optional('G', "file chunking algorithm "
+                                         "[xor32, gear] (default: xor32)"));
     r.push_back(Parameter::Optional('M', "minimum weight of the autocatalogs"));
+    r.push_back(Parameter::Optional('P', "number of threads scanning the "
+                                         "scratch area (default: 1)"));
     r.push_back(Parameter::Optional('T', "Root catalog TTL in seconds"));
     r.push_back(Parameter::Optional('X', "maximum weight of the autocatalogs"));
     r.push_back(Parameter::Optional('Z', "compression algorithm "
+                                         "[zlib, zstd[:level], lz4, none] "
                                          "(default: zlib)"));
     r.push_back(Parameter::Optional('S', "virtual directory options "
                                          "[snapshots, remove]"));
@@ -30,6 +30,7 @@ SyncUnion::SyncUnion(SyncMediator *mediator,
   scratch_path_(scratch_path),
   union_path_(union_path),
   mediator_(mediator),
+  num_scan_threads_(1),
   initialized_(false) {}
 
 
@@ -201,6 +202,7 @@ void SyncUnionAufs::Traverse() {
   traversal.fn_new_symlink        = &SyncUnionAufs::ProcessSymlink;
   traversal.fn_new_character_dev  = &SyncUnionAufs::ProcessCharacterDevice;
   traversal.fn_new_block_dev      = &SyncUnionAufs::ProcessBlockDevice;
+  traversal.SetNumThreads(num_scan_threads_);
   LogCvmfs(kLogUnionFs, kLogVerboseMsg, "Aufs starting traversal "
            "recursion for scratch_path=[%s] with external data set to %d",
            scratch_path().c_str(),
@@ -385,6 +387,7 @@ void SyncUnionOverlayfs::Traverse() {
   traversal.fn_ignore_file        = &SyncUnionOverlayfs::IgnoreFilePredicate;
   traversal.fn_new_dir_prefix     = &SyncUnionOverlayfs::ProcessDirectory;
   traversal.fn_new_symlink        = &SyncUnionOverlayfs::ProcessSymlink;
+  traversal.SetNumThreads(num_scan_threads_);
 
   LogCvmfs(kLogUnionFs, kLogVerboseMsg, "OverlayFS starting traversal "
            "recursion for scratch_path=[%s]",
@@ -132,12 +132,21 @@ class SyncUnion {
   bool IsInitialized() const { return initialized_; }
   virtual bool SupportsHardlinks() const { return false; }
 
+  /**
+   * With more than one thread, the scratch area is read ahead by a pool of
+   * threads.  The order of the resulting SyncItems does not change.
+   */
+  void SetNumScanThreads(const unsigned num_threads) {
+    num_scan_threads_ = num_threads;
+  }
+
  protected:
   std::string rdonly_path_;
   std::string scratch_path_;
   std::string union_path_;
 
   SyncMediator *mediator_;
+  unsigned num_scan_threads_;
 
   /**
    * Allow for preprocessing steps before emiting any SyncItems from SyncUnion.
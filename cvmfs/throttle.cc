@@ -0,0 +1,54 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * Rate limiting for background tasks.
+ */
+
+#include "cvmfs_config.h"
+#include "throttle.h"
+
+#include <cassert>
+#include <cstdlib>
+
+#include "platform.h"
+#include "smalloc.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+RateThrottle::RateThrottle(const uint64_t units_per_second)
+  : units_per_second_(units_per_second)
+  , spent_until_ns_(platform_monotonic_time_ns())
+{
+  assert(units_per_second_ > 0);
+  lock_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  int retval = pthread_mutex_init(lock_, NULL);
+  assert(retval == 0);
+}
+
+
+RateThrottle::~RateThrottle() {
+  pthread_mutex_destroy(lock_);
+  free(lock_);
+}
+
+
+unsigned RateThrottle::Consume(const uint64_t units) {
+  const uint64_t cost_ns = static_cast<uint64_t>(
+    static_cast<double>(units) * 1e9 / units_per_second_);
+
+  pthread_mutex_lock(lock_);
+  const uint64_t now_ns = platform_monotonic_time_ns();
+  if (spent_until_ns_ + kMaxBurstNs < now_ns)
+    spent_until_ns_ = now_ns - kMaxBurstNs;
+  spent_until_ns_ += cost_ns;
+  const uint64_t wait_ns =
+    (spent_until_ns_ > now_ns) ? spent_until_ns_ - now_ns : 0;
+  pthread_mutex_unlock(lock_);
+
+  const unsigned wait_ms = wait_ns / 1000000;
+  if (wait_ms > 0)
+    SafeSleepMs(wait_ms);
+  return wait_ms;
+}
@@ -0,0 +1,44 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_THROTTLE_H_
+#define CVMFS_THROTTLE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "util/single_copy.h"
+
+/**
+ * Limits the average rate at which several threads consume a resource, such as
+ * bytes read from disk or CPU time.  Threads account for their consumption
+ * after the fact and sleep until the consumed amount is paid off at the given
+ * rate.  Up to one second of unused budget is carried over, which allows for
+ * short bursts after idle periods.
+ */
+class RateThrottle : SingleCopy {
+ public:
+  explicit RateThrottle(const uint64_t units_per_second);
+  ~RateThrottle();
+
+  /**
+   * Accounts for the consumed units and sleeps if the rate limit is exceeded.
+   * Returns the number of milliseconds slept.
+   */
+  unsigned Consume(const uint64_t units);
+
+  uint64_t units_per_second() const { return units_per_second_; }
+
+ private:
+  static const uint64_t kMaxBurstNs = 1000000000;
+
+  const uint64_t units_per_second_;
+  /**
+   * The budget is used up until this point in time (monotonic clock)
+   */
+  uint64_t spent_until_ns_;
+  pthread_mutex_t *lock_;
+};
+
+#endif  // CVMFS_THROTTLE_H_
@@ -74,6 +74,10 @@ void Spooler::ProcessMetainfo(const std::string &local_path) {
   file_processor_->Process(local_path, false, shash::kSuffixMetainfo);
 }
 
+void Spooler::ProcessDictionary(const std::string &local_path) {
+  file_processor_->Process(local_path, false, shash::kSuffixDictionary);
+}
+
 
 void Spooler::Upload(const std::string &local_path,
                      const std::string &remote_path) {
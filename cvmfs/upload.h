@@ -232,6 +232,13 @@ class Spooler : public Observable<SpoolerResult> {
    */
   void ProcessMetainfo(const std::string &local_path);
 
+  /**
+   * Convenience wrapper to process a zstd compression dictionary.
+   *
+   * @param local_path  the location of the dictionary file
+   */
+  void ProcessDictionary(const std::string &local_path);
+
 
   /**
    * Deletes the given file from the repository backend storage. This is done
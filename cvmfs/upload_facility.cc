@@ -4,8 +4,15 @@
 
 #include "upload_facility.h"
 
+#include <inttypes.h>
+
+#include <algorithm>
 #include <cassert>
 
+#include "bloom_filter.h"
+#include "file_processing/char_buffer.h"
+#include "platform.h"
+#include "smalloc.h"
 #include "upload_local.h"
 #include "upload_s3.h"
 
@@ -20,10 +27,45 @@ void AbstractUploader::RegisterPlugins() {
 AbstractUploader::AbstractUploader(const SpoolerDefinition& spooler_definition)
   : spooler_definition_(spooler_definition)
   , torn_down_(false)
-  , jobs_in_flight_(spooler_definition.number_of_concurrent_uploads) { }
+  , jobs_in_flight_(spooler_definition.number_of_concurrent_uploads)
+  , existence_filter_(NULL)
+  , skipped_uploads_(0)
+  , peeks_in_flight_(kMaxPeeksInFlight)
+  , object_pack_(NULL)
+  , pack_threshold_(0)
+  , num_held_buffers_(0)
+  , pack_idle_since_ns_(0)
+  , packed_objects_(0)
+{
+  const std::string &filter_path = spooler_definition.existence_filter_path;
+  if (!filter_path.empty()) {
+    existence_filter_ = BloomFilter::Load(filter_path);
+    if (existence_filter_ == NULL) {
+      LogCvmfs(kLogSpooler, kLogDebug, "creating new existence filter %s",
+               filter_path.c_str());
+      existence_filter_ = new BloomFilter();
+    }
+  }
+}
 
 
 bool AbstractUploader::Initialize() {
+  if (spooler_definition_.object_pack_threshold > 0) {
+    if (SupportsObjectPacks()) {
+      pack_threshold_ = spooler_definition_.object_pack_threshold;
+      if (pack_threshold_ > kObjectPackLimit) {
+        LogCvmfs(kLogSpooler, kLogStderr, "Warning: object pack threshold "
+                 "reduced to the object pack size of %" PRIu64 " bytes",
+                 kObjectPackLimit);
+        pack_threshold_ = kObjectPackLimit;
+      }
+      object_pack_ = new ObjectPack(kObjectPackLimit);
+    } else {
+      LogCvmfs(kLogSpooler, kLogStderr, "Warning: object packs are not "
+               "supported by the uploader, uploading objects one by one");
+    }
+  }
+
   // late initialization of the writer_thread_ field. This is necessary, since
   // AbstractUploader::WriteThread is pure virtual and relies on a concrete sub-
   // class being initialized before the writer_thread_ starts running
@@ -39,6 +81,13 @@ bool AbstractUploader::Initialize() {
   assert(writer_thread_.joinable());
   assert(!thread.joinable());
 
+  if (existence_filter_ != NULL) {
+    for (unsigned i = 0; i < kNumPeekThreads; ++i) {
+      peek_threads_.push_back(new tbb::tbb_thread(
+        &ThreadProxy<AbstractUploader>, this, &AbstractUploader::PeekThread));
+    }
+  }
+
   // wait for the thread to call back...
   return thread_started_executing_.Get();
 }
@@ -79,15 +128,26 @@ AbstractUploader::JobStatus::State AbstractUploader::DispatchJob(
                                                          const UploadJob &job) {
   switch (job.type) {
     case UploadJob::Upload:
+      if ((object_pack_ != NULL) && HoldBuffer(job))
+        return JobStatus::kOk;
       StreamedUpload(job.stream_handle,
                      job.buffer,
                      job.callback);
       return JobStatus::kOk;
 
     case UploadJob::Commit:
+      if ((existence_filter_ != NULL) && SkipExistingObject(job))
+        return JobStatus::kOk;
+      if ((object_pack_ != NULL) && PackObject(job))
+        return JobStatus::kOk;
       FinalizeStreamedUpload(job.stream_handle, job.content_hash);
       return JobStatus::kOk;
 
+    case UploadJob::Remove:
+      RemoveObjects(*job.hashes, job.callback);
+      delete job.hashes;
+      return JobStatus::kOk;
+
     case UploadJob::Terminate:
       return JobStatus::kTerminate;
 
@@ -99,10 +159,276 @@ AbstractUploader::JobStatus::State AbstractUploader::DispatchJob(
 }
 
 
+/**
+ * Packed objects are committed only once their pack is stored, and held
+ * buffers are answered only once their object is complete.  Both count as jobs
+ * in flight.  In order not to hold them back forever, the pack is uploaded and
+ * the held buffers are written as soon as the writer thread did not get a new
+ * job for kPackIdleMs.
+ */
+bool AbstractUploader::PopJob(const bool block, UploadJob *job) {
+  while (!pack_callbacks_.empty() || (num_held_buffers_ > 0)) {
+    if (upload_queue_.try_pop(*job)) {
+      pack_idle_since_ns_ = 0;
+      return true;
+    }
+    const uint64_t now_ns = platform_monotonic_time_ns();
+    if (pack_idle_since_ns_ == 0) {
+      pack_idle_since_ns_ = now_ns;
+    } else if (now_ns - pack_idle_since_ns_ >=
+               static_cast<uint64_t>(kPackIdleMs) * 1000 * 1000)
+    {
+      FlushObjectPack();
+      for (HeldStreams::iterator i = held_streams_.begin(),
+           iEnd = held_streams_.end(); i != iEnd; ++i)
+      {
+        if (!i->second.streamed) {
+          ReleaseHeldBuffers(i->first, &i->second, true);
+          i->second.streamed = true;
+        }
+      }
+      break;
+    }
+    if (!block)
+      return false;
+    SafeSleepMs(1);
+  }
+  pack_idle_since_ns_ = 0;
+
+  if (block) {
+    upload_queue_.pop(*job);
+    return true;
+  }
+  return upload_queue_.try_pop(*job);
+}
+
+
+void AbstractUploader::RemoveObjects(const std::vector<shash::Any>  &hashes,
+                                     const CallbackTN               *callback)
+{
+  int num_failed = 0;
+  for (unsigned i = 0; i < hashes.size(); ++i) {
+    if (!Remove(hashes[i])) {
+      LogCvmfs(kLogSpooler, kLogStderr, "failed to remove %s",
+               hashes[i].ToStringWithSuffix().c_str());
+      ++num_failed;
+    }
+  }
+  Respond(callback, UploaderResults(UploaderResults::kRemoval, num_failed));
+}
+
+
+/**
+ * The existence filter answers most lookups for new objects without asking the
+ * backend storage.  Only on a hit, which can be a false positive or an object
+ * removed by the garbage collector since, the object is looked up with Peek().
+ * New objects are added to the filter before they are committed; if the
+ * commit fails, the next lookup of the object is checked by Peek(), too.
+ *
+ * Peek() can be a round trip to the storage, so it runs on the peek threads
+ * while the writer thread carries on with other jobs.  Returns true if the
+ * commit job is taken care of, i.e. queued for Peek() or skipped.
+ */
+bool AbstractUploader::SkipExistingObject(const UploadJob &job) {
+  if (!job.existence_checked) {
+    if (!existence_filter_->Contains(job.content_hash)) {
+      existence_filter_->Add(job.content_hash);
+      return false;
+    }
+    ++peeks_in_flight_;
+    peek_queue_.push(job);
+    return true;
+  }
+  if (!job.object_exists)
+    return false;
+
+  const CallbackTN *callback = job.stream_handle->commit_callback;
+  if (object_pack_ != NULL) {
+    // Uploaders that use object packs always discard, the held buffers of the
+    // object are not needed
+    HeldStreams::iterator i = held_streams_.find(job.stream_handle);
+    if (i != held_streams_.end()) {
+      ReleaseHeldBuffers(job.stream_handle, &i->second, false);
+      held_streams_.erase(i);
+    }
+  }
+  if (!DiscardStreamedUpload(job.stream_handle))
+    return false;
+  ++skipped_uploads_;
+  LogCvmfs(kLogSpooler, kLogVerboseMsg, "skipping upload of existing %s",
+           job.content_hash.ToString(true).c_str());
+  Respond(callback, UploaderResults(0));
+  return true;
+}
+
+
+void AbstractUploader::PeekThread() {
+  while (true) {
+    UploadJob job;
+    peek_queue_.pop(job);
+    if (job.type == UploadJob::Terminate)
+      break;
+    job.object_exists = Peek("data/" + job.content_hash.MakePath());
+    job.existence_checked = true;
+    upload_queue_.push(job);
+    --peeks_in_flight_;
+  }
+}
+
+
+/**
+ * Keeps back the buffers of a streamed object as long as the object fits into
+ * an object pack.  Returns false if the buffer is to be written to the stream
+ * as usual.
+ */
+bool AbstractUploader::HoldBuffer(const UploadJob &job) {
+  HeldStream *stream = &held_streams_[job.stream_handle];
+  if (stream->streamed)
+    return false;
+
+  stream->size += job.buffer->used_bytes();
+  if (stream->size > pack_threshold_) {
+    ReleaseHeldBuffers(job.stream_handle, stream, true);
+    stream->streamed = true;
+    return false;
+  }
+  stream->buffers.push_back(job.buffer);
+  stream->callbacks.push_back(job.callback);
+  ++num_held_buffers_;
+  return true;
+}
+
+
+/**
+ * Either writes the held buffers to the stream or answers their callbacks
+ * right away, once their content is copied or not needed anymore.
+ */
+void AbstractUploader::ReleaseHeldBuffers(UploadStreamHandle  *handle,
+                                          HeldStream          *stream,
+                                          const bool           write)
+{
+  for (unsigned i = 0; i < stream->buffers.size(); ++i) {
+    if (write) {
+      StreamedUpload(handle, stream->buffers[i], stream->callbacks[i]);
+    } else {
+      Respond(stream->callbacks[i], UploaderResults(0, stream->buffers[i]));
+    }
+  }
+  num_held_buffers_ -= stream->buffers.size();
+  stream->buffers.clear();
+  stream->callbacks.clear();
+}
+
+
+/**
+ * Moves a complete small object into the current object pack and drops its
+ * (empty) streamed upload.  The commit callback is answered once the pack is
+ * stored.  Empty objects are not packed because the ObjectPackConsumer does
+ * not see them at the very end of a pack.  Returns false if the object needs
+ * to be committed as usual.
+ */
+bool AbstractUploader::PackObject(const UploadJob &job) {
+  HeldStreams::iterator i = held_streams_.find(job.stream_handle);
+  if (i == held_streams_.end())
+    return false;
+  HeldStream *stream = &i->second;
+  if (stream->streamed || (stream->size == 0)) {
+    ReleaseHeldBuffers(job.stream_handle, stream, true);
+    held_streams_.erase(i);
+    return false;
+  }
+
+  if (object_pack_->size() + stream->size > kObjectPackLimit)
+    FlushObjectPack();
+  ObjectPack::BucketHandle bucket = object_pack_->OpenBucket();
+  for (unsigned j = 0; j < stream->buffers.size(); ++j) {
+    object_pack_->AddToBucket(stream->buffers[j]->ptr(),
+                              stream->buffers[j]->used_bytes(), bucket);
+  }
+  if (!object_pack_->CommitBucket(job.content_hash, bucket)) {
+    // Too many objects in the pack
+    object_pack_->DiscardBucket(bucket);
+    FlushObjectPack();
+    bucket = object_pack_->OpenBucket();
+    for (unsigned j = 0; j < stream->buffers.size(); ++j) {
+      object_pack_->AddToBucket(stream->buffers[j]->ptr(),
+                                stream->buffers[j]->used_bytes(), bucket);
+    }
+    const bool retval = object_pack_->CommitBucket(job.content_hash, bucket);
+    assert(retval);
+  }
+  ReleaseHeldBuffers(job.stream_handle, stream, false);
+  held_streams_.erase(i);
+
+  pack_callbacks_.push_back(job.stream_handle->commit_callback);
+  const bool retval = DiscardStreamedUpload(job.stream_handle);
+  assert(retval);
+
+  // The pending commit callbacks count as jobs in flight, don't let them
+  // take up all the slots
+  const unsigned max_pending =
+    std::max(1U, spooler_definition_.number_of_concurrent_uploads / 2);
+  if (pack_callbacks_.size() >= max_pending)
+    FlushObjectPack();
+  return true;
+}
+
+
+/**
+ * Serializes the current object pack and hands it to the concrete uploader.
+ */
+void AbstractUploader::FlushObjectPack() {
+  if (object_pack_->GetNoObjects() == 0)
+    return;
+
+  ObjectPackUpload *upload = new ObjectPackUpload();
+  ObjectPackProducer producer(object_pack_);
+  upload->digest = shash::Any(spooler_definition_.hash_algorithm);
+  producer.GetDigest(&upload->digest);
+  upload->header_size = producer.GetHeaderSize();
+  upload->size = upload->header_size + object_pack_->size();
+  upload->data = reinterpret_cast<unsigned char *>(smalloc(upload->size));
+  const unsigned nbytes =
+    producer.ProduceNext(static_cast<unsigned>(upload->size), upload->data);
+  assert(nbytes == upload->size);
+  upload->callbacks.swap(pack_callbacks_);
+
+  LogCvmfs(kLogSpooler, kLogVerboseMsg, "uploading object pack of %u "
+           "objects (%" PRIu64 " bytes)", object_pack_->GetNoObjects(),
+           upload->size);
+  packed_objects_ += object_pack_->GetNoObjects();
+  delete object_pack_;
+  object_pack_ = new ObjectPack(kObjectPackLimit);
+  UploadObjectPack(upload);
+}
+
+
 void AbstractUploader::TearDown() {
   assert(!torn_down_);
+  // Pending object packs are uploaded once the writer thread is idle.  Some
+  // uploaders store the pack asynchronously, so wait before terminating.
+  if (object_pack_ != NULL)
+    jobs_in_flight_.WaitForZero();
+  // Checked commit jobs are queued before the termination signal
+  peeks_in_flight_.WaitForZero();
   upload_queue_.push(UploadJob());  // Termination signal
   writer_thread_.join();
+  delete object_pack_;
+  object_pack_ = NULL;
+  for (unsigned i = 0; i < peek_threads_.size(); ++i)
+    peek_queue_.push(UploadJob());
+  for (unsigned i = 0; i < peek_threads_.size(); ++i) {
+    peek_threads_[i]->join();
+    delete peek_threads_[i];
+  }
+  peek_threads_.clear();
+  if (existence_filter_ != NULL) {
+    existence_filter_->Save(spooler_definition_.existence_filter_path);
+    LogCvmfs(kLogSpooler, kLogDebug, "skipped %" PRIu64 " uploads of "
+             "existing objects", skipped_uploads_);
+    delete existence_filter_;
+    existence_filter_ = NULL;
+  }
   torn_down_ = true;
 }
 
@@ -9,13 +9,20 @@
 #include <tbb/tbb_thread.h>
 
 #include <fcntl.h>
+#include <inttypes.h>
 
+#include <cstdlib>
+#include <map>
 #include <string>
+#include <vector>
 
+#include "pack.h"
 #include "upload_spooler_definition.h"
 #include "util/posix.h"
 #include "util_concurrency.h"
 
+class BloomFilter;
+
 namespace upload {
 
 class CharBuffer;
@@ -24,7 +31,8 @@ struct UploaderResults {
   enum Type {
     kFileUpload,
     kBufferUpload,
-    kChunkCommit
+    kChunkCommit,
+    kRemoval
   };
 
   UploaderResults(const int return_code, const std::string &local_path) :
@@ -45,6 +53,12 @@ struct UploaderResults {
     local_path(""),
     buffer(NULL) {}
 
+  UploaderResults(const Type type, const int return_code) :
+    type(type),
+    return_code(return_code),
+    local_path(""),
+    buffer(NULL) {}
+
   const Type         type;
   const int          return_code;
   const std::string  local_path;
@@ -77,34 +91,57 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
     enum Type {
       Upload,
       Commit,
+      Remove,
       Terminate
     };
 
     UploadJob(UploadStreamHandle  *handle,
               CharBuffer          *buffer,
               const CallbackTN    *callback = NULL) :
-      type(Upload), stream_handle(handle), buffer(buffer), callback(callback) {}
+      type(Upload), stream_handle(handle), buffer(buffer), callback(callback),
+      hashes(NULL), existence_checked(false), object_exists(false) {}
 
     UploadJob(UploadStreamHandle  *handle,
               const shash::Any    &content_hash) :
       type(Commit), stream_handle(handle), buffer(NULL), callback(NULL),
-      content_hash(content_hash) {}
+      content_hash(content_hash), hashes(NULL), existence_checked(false),
+      object_exists(false) {}
+
+    UploadJob(std::vector<shash::Any>  *hashes,
+              const CallbackTN         *callback) :
+      type(Remove), stream_handle(NULL), buffer(NULL), callback(callback),
+      hashes(hashes), existence_checked(false), object_exists(false) {}
 
     UploadJob() :
-      type(Terminate), stream_handle(NULL), buffer(NULL), callback(NULL) {}
+      type(Terminate), stream_handle(NULL), buffer(NULL), callback(NULL),
+      hashes(NULL), existence_checked(false), object_exists(false) {}
 
     Type                 type;
     UploadStreamHandle  *stream_handle;
 
-    // type=Upload specific fields
+    // type=Upload and type=Remove specific fields
     CharBuffer          *buffer;
     const CallbackTN    *callback;
 
     // type=Commit specific fields
     shash::Any           content_hash;
+
+    // type=Remove specific fields, owned by the job
+    std::vector<shash::Any>  *hashes;
+
+    // type=Commit specific fields, set once the object is looked up in the
+    // backend storage after a hit of the existence filter
+    bool                 existence_checked;
+    bool                 object_exists;
   };
 
  public:
+  /**
+   * Maximum size of the object packs, see SpoolerDefinition::
+   * object_pack_threshold
+   */
+  static const uint64_t kObjectPackLimit = 16 * 1024 * 1024;
+
   struct JobStatus {
     enum State {
       kOk,
@@ -216,8 +253,7 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
    * Note: If the file doesn't exist before calling this method it will report
    *       a successful deletion anyways.
    *
-   * Note: This method is currently used very sparsely! If this changes in the
-   *       future, one might think about doing deletion asynchronously!
+   * Note: For removing many objects, use the asynchronous ScheduleRemoval()
    *
    * @param file_to_delete  path to the file to be removed
    * @return                true if the file does not exist (anymore), false if
@@ -238,6 +274,25 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   }
 
 
+  /**
+   * Schedules the removal of a batch of objects.  The removal happens
+   * asynchronously, concurrently to other scheduled removals.  Once all the
+   * objects of the batch are processed, the callback receives the number of
+   * objects that could not be removed as return code.  Like for the uploads,
+   * the number of batches in flight is bounded, so that this method blocks if
+   * too many batches are pending.
+   *
+   * @param hashes    content hashes of the objects to be removed
+   * @param callback  (optional) gets notified when the batch was processed
+   */
+  void ScheduleRemoval(const std::vector<shash::Any>  &hashes,
+                       const CallbackTN               *callback = NULL) {
+    ++jobs_in_flight_;
+    upload_queue_.push(
+      UploadJob(new std::vector<shash::Any>(hashes), callback));
+  }
+
+
   /**
    * Checks if a file is already present in the backend storage. This might be a
    * synchronous operation.
@@ -271,6 +326,18 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   virtual unsigned int GetNumberOfErrors() const = 0;
   static void RegisterPlugins();
 
+  /**
+   * Number of streamed uploads that were dropped because the object was
+   * already in the backend storage (see DiscardStreamedUpload()).
+   */
+  uint64_t GetNumberOfSkippedUploads() const { return skipped_uploads_; }
+
+  /**
+   * Number of objects that were handed to the backend storage as part of an
+   * object pack.
+   */
+  uint64_t GetNumberOfPackedObjects() const { return packed_objects_; }
+
 
  protected:
   explicit AbstractUploader(const SpoolerDefinition& spooler_definition);
@@ -309,6 +376,66 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   virtual void FinalizeStreamedUpload(UploadStreamHandle  *handle,
                                       const shash::Any    &content_hash) = 0;
 
+  /**
+   * Drops a streamed upload instead of committing it because the object is
+   * already in the backend storage.  Frees the handle but does not respond to
+   * its commit callback.  Concrete Uploaders that do not override this method
+   * always commit.
+   *
+   * @param handle  decendant of UploadStreamHandle specifying the stream
+   * @return        true if the handle was discarded
+   */
+  virtual bool DiscardStreamedUpload(UploadStreamHandle *handle) {
+    return false;
+  }
+
+  /**
+   * Removes a batch of objects scheduled by ScheduleRemoval() in the context of
+   * the writer thread.  Implementations must eventually Respond() to the
+   * callback with a UploaderResults::kRemoval result.  The default
+   * implementation removes the objects one by one using Remove().
+   *
+   * @param hashes    content hashes of the objects to be removed
+   * @param callback  (optional) callback to be invoked through Respond()
+   */
+  virtual void RemoveObjects(const std::vector<shash::Any>  &hashes,
+                             const CallbackTN               *callback);
+
+  /**
+   * A serialized object pack together with the commit callbacks of the packed
+   * objects, in the order of the objects in the pack.
+   */
+  struct ObjectPackUpload {
+    ObjectPackUpload() : data(NULL), size(0), header_size(0) { }
+    ~ObjectPackUpload() { free(data); }
+    unsigned char                   *data;
+    uint64_t                         size;
+    shash::Any                       digest;  // of the header
+    unsigned                         header_size;
+    std::vector<const CallbackTN *>  callbacks;
+  };
+
+  /**
+   * Concrete Uploaders that can store many small objects in one go return
+   * true and implement UploadObjectPack().  They must implement
+   * DiscardStreamedUpload() as well.  Otherwise, object packs are not used.
+   */
+  virtual bool SupportsObjectPacks() const { return false; }
+
+  /**
+   * Stores the objects of a pack serialized by the ObjectPackProducer in the
+   * backend storage.  Called by the writer thread.  Implementations take
+   * ownership of the upload and must eventually Respond() to every one of its
+   * callbacks.
+   *
+   * @param upload  the serialized pack and the callbacks of its objects
+   */
+  virtual void UploadObjectPack(ObjectPackUpload *upload) {
+    const bool object_packs_supported = false;
+    assert(object_packs_supported);
+  }
+
+
   /**
    * This notifies the callback that is associated to a finishing job. Please
    * do not call the handed callback yourself in concrete Uploaders!
@@ -341,7 +468,7 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
    */
   JobStatus::State PerformJob() {
     UploadJob job;
-    upload_queue_.pop(job);
+    PopJob(true, &job);
     return DispatchJob(job);
   }
 
@@ -357,7 +484,7 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
    */
   JobStatus::State TryToPerformJob() {
     UploadJob job;
-    const bool got_job = upload_queue_.try_pop(job);
+    const bool got_job = PopJob(false, &job);
     return (got_job)
       ? DispatchJob(job)
       : JobStatus::kNoJobs;
@@ -403,7 +530,42 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
 
 
  private:
+  /**
+   * Number of threads that look up hits of the existence filter in the
+   * backend storage, and the maximum number of lookups queued for them.
+   */
+  static const unsigned kNumPeekThreads = 4;
+  static const int32_t kMaxPeeksInFlight = 256;
+  /**
+   * An object pack with pending commit callbacks is uploaded once no new job
+   * arrived for this long.
+   */
+  static const unsigned kPackIdleMs = 50;
+
+  /**
+   * The buffers of a streamed object that might still go into an object pack.
+   * They are not written until the object is either committed or grows larger
+   * than the object pack threshold.
+   */
+  struct HeldStream {
+    HeldStream() : size(0), streamed(false) { }
+    uint64_t                         size;
+    bool                             streamed;  // too large, written as usual
+    std::vector<CharBuffer *>        buffers;
+    std::vector<const CallbackTN *>  callbacks;
+  };
+  typedef std::map<UploadStreamHandle *, HeldStream> HeldStreams;
+
   JobStatus::State DispatchJob(const UploadJob &job);
+  bool PopJob(const bool block, UploadJob *job);
+  bool SkipExistingObject(const UploadJob &job);
+  void PeekThread();
+  bool HoldBuffer(const UploadJob &job);
+  void ReleaseHeldBuffers(UploadStreamHandle  *handle,
+                          HeldStream          *stream,
+                          const bool           write);
+  bool PackObject(const UploadJob &job);
+  void FlushObjectPack();
 
  private:
   const SpoolerDefinition                   spooler_definition_;
@@ -413,6 +575,37 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
 
   mutable SynchronizingCounter<int32_t>     jobs_in_flight_;
   Future<bool>                              thread_started_executing_;
+
+  /**
+   * Hashes of the objects known to be in the backend storage.  Only used by
+   * the writer thread.  NULL if no existence filter is configured.
+   */
+  BloomFilter                              *existence_filter_;
+  uint64_t                                  skipped_uploads_;
+  /**
+   * Commit jobs that wait for Peek() on one of the peek threads.  Once
+   * checked, they are put back into the upload queue.
+   */
+  tbb::concurrent_bounded_queue<UploadJob>  peek_queue_;
+  std::vector<tbb::tbb_thread *>            peek_threads_;
+  SynchronizingCounter<int32_t>             peeks_in_flight_;
+
+  /**
+   * Small streamed objects are collected in object_pack_ and stored in one go.
+   * The following fields are only used by the writer thread.  object_pack_ is
+   * NULL if object packs are not used.
+   */
+  ObjectPack                               *object_pack_;
+  uint64_t                                  pack_threshold_;
+  HeldStreams                               held_streams_;
+  unsigned                                  num_held_buffers_;
+  /**
+   * Commit callbacks of the objects in object_pack_, answered once the pack
+   * is stored.
+   */
+  std::vector<const CallbackTN *>           pack_callbacks_;
+  uint64_t                                  pack_idle_since_ns_;
+  uint64_t                                  packed_objects_;
 };
 
 
@@ -176,6 +176,98 @@ void LocalUploader::FinalizeStreamedUpload(UploadStreamHandle  *handle,
 }
 
 
+bool LocalUploader::DiscardStreamedUpload(UploadStreamHandle *handle) {
+  LocalStreamHandle *local_handle = static_cast<LocalStreamHandle*>(handle);
+  close(local_handle->file_descriptor);
+  const int retval = unlink(local_handle->temporary_path.c_str());
+  if (retval != 0) {
+    LogCvmfs(kLogSpooler, kLogVerboseMsg,
+             "failed to remove temporary '%s' (errno: %d)",
+             local_handle->temporary_path.c_str(), errno);
+  }
+  delete local_handle;
+  return true;
+}
+
+
+/**
+ * The ObjectPackConsumer plays the role of the receiving end and unpacks the
+ * objects into the storage.
+ */
+void LocalUploader::UploadObjectPack(ObjectPackUpload *upload) {
+  PackCursor cursor(upload);
+  ObjectPackConsumer consumer(upload->digest, upload->header_size);
+  consumer.RegisterListener(&LocalUploader::OnPackedObject, this, &cursor);
+  const ObjectPackConsumer::BuildState state =
+    consumer.ConsumeNext(static_cast<unsigned>(upload->size), upload->data);
+  if (state != ObjectPackConsumer::kStateDone) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to unpack object pack of %u "
+             "objects (state %d)",
+             static_cast<unsigned>(upload->callbacks.size()), state);
+  }
+  for (unsigned i = cursor.idx; i < upload->callbacks.size(); ++i) {
+    atomic_inc32(&copy_errors_);
+    Respond(upload->callbacks[i], UploaderResults(1));
+  }
+  delete upload;
+}
+
+
+/**
+ * The pack is consumed in one go, so every object arrives in one piece.
+ */
+void LocalUploader::OnPackedObject(
+  const ObjectPackConsumerBase::BuildEvent &event,
+  PackCursor *cursor)
+{
+  assert(event.buf_size == event.size);
+  assert(cursor->idx < cursor->upload->callbacks.size());
+  const CallbackTN *callback = cursor->upload->callbacks[cursor->idx++];
+  const int retcode = StoreObject(event.id, event.buf, event.size);
+  if (retcode != 0)
+    atomic_inc32(&copy_errors_);
+  Respond(callback, UploaderResults(retcode));
+}
+
+
+/**
+ * Writes an object into a temporary file and moves it in place.
+ */
+int LocalUploader::StoreObject(const shash::Any  &id,
+                               const void        *buf,
+                               const uint64_t     size)
+{
+  const std::string final_path = "data/" + id.MakePath();
+  if (Peek(final_path))
+    return 0;
+
+  std::string tmp_path;
+  const int fd = CreateAndOpenTemporaryChunkFile(&tmp_path);
+  if (fd < 0)
+    return 1;
+  if (!SafeWrite(fd, buf, size)) {
+    const int cpy_errno = errno;
+    LogCvmfs(kLogSpooler, kLogVerboseMsg, "failed to write to '%s' "
+             "(errno: %d)", tmp_path.c_str(), cpy_errno);
+    close(fd);
+    unlink(tmp_path.c_str());
+    return cpy_errno;
+  }
+  if (close(fd) != 0) {
+    const int cpy_errno = errno;
+    unlink(tmp_path.c_str());
+    return cpy_errno;
+  }
+  const int retval = Move(tmp_path, final_path);
+  if (retval != 0) {
+    LogCvmfs(kLogSpooler, kLogVerboseMsg, "failed to move temp file '%s' to "
+             "final location '%s'", tmp_path.c_str(), final_path.c_str());
+    unlink(tmp_path.c_str());
+  }
+  return retval;
+}
+
+
 bool LocalUploader::Remove(const std::string& file_to_delete) {
   const int retval = unlink((upstream_path_ + "/" + file_to_delete).c_str());
   return retval == 0 || errno == ENOENT;
@@ -10,6 +10,7 @@
 #include <string>
 
 #include "atomic.h"
+#include "pack.h"
 #include "upload_facility.h"
 #include "util_concurrency.h"
 
@@ -61,6 +62,9 @@ class LocalUploader : public AbstractUploader {
                       const CallbackTN    *callback = NULL);
   void FinalizeStreamedUpload(UploadStreamHandle  *handle,
                               const shash::Any    &content_hash);
+  bool DiscardStreamedUpload(UploadStreamHandle *handle);
+  bool SupportsObjectPacks() const { return true; }
+  void UploadObjectPack(ObjectPackUpload *upload);
 
   bool Remove(const std::string &file_to_delete);
 
@@ -79,6 +83,19 @@ class LocalUploader : public AbstractUploader {
            const std::string &remote_path) const;
 
  private:
+  /**
+   * Position in the object pack that is currently unpacked.
+   */
+  struct PackCursor {
+    explicit PackCursor(ObjectPackUpload *upload) : upload(upload), idx(0) { }
+    ObjectPackUpload *upload;
+    unsigned idx;
+  };
+
+  void OnPackedObject(const ObjectPackConsumerBase::BuildEvent &event,
+                      PackCursor *cursor);
+  int StoreObject(const shash::Any &id, const void *buf, const uint64_t size);
+
   // state information
   const std::string    upstream_path_;
   const std::string    temporary_path_;
@@ -12,6 +12,8 @@
 #endif
 #include <unistd.h>
 
+#include <algorithm>
+#include <map>
 #include <sstream>  // TODO(jblomer): remove me
 #include <string>
 #include <vector>
@@ -28,6 +30,8 @@ namespace upload {
 
 S3Uploader::S3Uploader(const SpoolerDefinition &spooler_definition)
     : AbstractUploader(spooler_definition),
+      multipart_threshold_(kDefaultMultipartThreshold),
+      multipart_part_size_(kDefaultMultipartPartSize),
       temporary_path_(spooler_definition.temporary_path) {
   if (!ParseSpoolerDefinition(spooler_definition)) {
     abort();
@@ -40,10 +44,17 @@ S3Uploader::S3Uploader(const SpoolerDefinition &spooler_definition)
   s3fanout_mgr_.Spawn();
 
   atomic_init32(&copy_errors_);
+
+  lock_multipart_uploads_ =
+      reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  int retval = pthread_mutex_init(lock_multipart_uploads_, NULL);
+  assert(retval == 0);
 }
 
 S3Uploader::~S3Uploader() {
   s3fanout_mgr_.Fini();
+  pthread_mutex_destroy(lock_multipart_uploads_);
+  free(lock_multipart_uploads_);
 }
 
 bool S3Uploader::ParseSpoolerDefinition(
@@ -126,6 +137,24 @@ bool S3Uploader::ParseSpoolerDefinition(
     return false;
   }
   max_num_parallel_uploads_ = String2Uint64(parameter);
+  if (options_manager->GetValue("CVMFS_S3_MULTIPART_THRESHOLD", &parameter))
+    multipart_threshold_ = String2Uint64(parameter);
+  if (options_manager->GetValue("CVMFS_S3_MULTIPART_PART_SIZE", &parameter)) {
+    multipart_part_size_ = String2Uint64(parameter);
+    if (multipart_part_size_ == 0) {
+      LogCvmfs(kLogUploadS3, kLogStderr,
+               "Fail, invalid CVMFS_S3_MULTIPART_PART_SIZE given: '%s'.",
+               parameter.c_str());
+      return false;
+    }
+    if (multipart_part_size_ < kMinMultipartPartSize) {
+      LogCvmfs(kLogUploadS3, kLogStderr | kLogSyslogWarn,
+               "Warning, CVMFS_S3_MULTIPART_PART_SIZE of %" PRIu64 " bytes is "
+               "below the S3 minimum, using %" PRIu64 " bytes instead.",
+               multipart_part_size_, kMinMultipartPartSize);
+      multipart_part_size_ = kMinMultipartPartSize;
+    }
+  }
   delete options_manager;
   options_manager = NULL;
 
@@ -185,6 +214,16 @@ void S3Uploader::WorkerThread() {
     for (; it != itend; ++it) {
       // Report completed job
       s3fanout::JobInfo *info = *it;
+      if ((info->request == s3fanout::JobInfo::kReqMultipartPart) ||
+          (info->request == s3fanout::JobInfo::kReqMultipartComplete))
+      {
+        OnMultipartJobCompleted(info);
+        continue;
+      }
+      if (info->request == s3fanout::JobInfo::kReqDeleteMulti) {
+        OnDeleteJobCompleted(info);
+        continue;
+      }
       int reply_code = 0;
       if (info->error_code != s3fanout::kFailOk) {
         LogCvmfs(kLogUploadS3, kLogStderr, "Upload job for '%s' failed. "
@@ -200,6 +239,8 @@ void S3Uploader::WorkerThread() {
         Respond(static_cast<CallbackTN*>(info->callback),
                 UploaderResults(reply_code, info->origin_path));
       }
+      if (!packed_object_jobs_.empty())
+        OnPackedObjectCompleted(info);
       assert(info->mmf == NULL);
       assert(info->origin_file == NULL);
     }
@@ -336,6 +377,29 @@ void S3Uploader::FileUpload(
   const std::string mangled_filename = repository_alias_ + "/" + remote_path;
   GetKeysAndBucket(mangled_filename, &access_key, &secret_key, &bucket_name);
 
+  const int64_t file_size = GetFileSize(local_path);
+  const bool is_large =
+    (multipart_threshold_ > 0) && (file_size > 0) &&
+    (static_cast<uint64_t>(file_size) > multipart_threshold_);
+  if (is_large && (remote_path.compare(0, 6, ".cvmfs") != 0)) {
+#ifndef S3_UPLOAD_OBJECTS_EVEN_IF_THEY_EXIST
+    if (Peek(remote_path)) {
+      Respond(callback, UploaderResults(0, local_path));
+      return;
+    }
+#endif
+    MemoryMappedFile *mmf = new MemoryMappedFile(local_path);
+    if (mmf->Map() &&
+        UploadMultipart(mangled_filename, mmf, callback, local_path))
+    {
+      return;
+    }
+    // Fall back to a single PUT request
+    if (mmf->IsMapped())
+      mmf->Unmap();
+    delete mmf;
+  }
+
   s3fanout::JobInfo *info =
       new s3fanout::JobInfo(access_key,
                             secret_key,
@@ -469,6 +533,16 @@ void S3Uploader::FinalizeStreamedUpload(UploadStreamHandle  *handle,
   const std::string mangled_filename = repository_alias_ + "/" + final_path;
   GetKeysAndBucket(mangled_filename, &access_key, &secret_key, &bucket_name);
 
+  if ((multipart_threshold_ > 0) &&
+      (static_cast<uint64_t>(mmf->size()) > multipart_threshold_) &&
+      UploadMultipart(mangled_filename, mmf, handle->commit_callback, ""))
+  {
+    retval = remove(local_handle->temporary_path.c_str());
+    assert(retval == 0);
+    delete local_handle;
+    return;
+  }
+
   s3fanout::JobInfo *info =
       new s3fanout::JobInfo(access_key,
                             secret_key,
@@ -497,6 +571,263 @@ void S3Uploader::FinalizeStreamedUpload(UploadStreamHandle  *handle,
 }
 
 
+/**
+ * Initiates a multipart upload and schedules the upload of all the parts.  The
+ * parts point into the memory mapped object, which is released once the upload
+ * finished.  Returns false if the upload cannot be initiated, e.g. because the
+ * server does not support multipart uploads.  The caller keeps the ownership
+ * of mmf in this case.
+ */
+bool S3Uploader::UploadMultipart(const std::string  &object_key,
+                                 MemoryMappedFile   *mmf,
+                                 const CallbackTN   *callback,
+                                 const std::string  &local_path)
+{
+  s3fanout::JobInfo *info = CreateJobInfo(object_key);
+  info->request = s3fanout::JobInfo::kReqMultipartInit;
+  if (!s3fanout_mgr_.DoSingleJob(info)) {
+    LogCvmfs(kLogUploadS3, kLogStderr, "Failed to initiate multipart upload "
+             "of %s (error code: %d - %s)", object_key.c_str(),
+             info->error_code, s3fanout::Code2Ascii(info->error_code));
+    delete info;
+    return false;
+  }
+
+  const uint64_t size = mmf->size();
+  uint64_t part_size = multipart_part_size_;
+  if (size / part_size >= kMaxNumParts)
+    part_size = size / kMaxNumParts + 1;
+  const unsigned num_parts = (size + part_size - 1) / part_size;
+
+  MultipartUpload *upload = new MultipartUpload();
+  upload->info = info;
+  upload->mmf = mmf;
+  upload->callback = callback;
+  upload->local_path = local_path;
+  upload->etags.resize(num_parts);
+  upload->num_pending_parts = num_parts;
+  {
+    MutexLockGuard guard(lock_multipart_uploads_);
+    multipart_uploads_[info->upload_id] = upload;
+  }
+
+  LogCvmfs(kLogUploadS3, kLogDebug, "Uploading %s in %u parts (upload id %s)",
+           object_key.c_str(), num_parts, info->upload_id.c_str());
+  const unsigned char *buffer = mmf->buffer();
+  for (unsigned i = 0; i < num_parts; ++i) {
+    const uint64_t offset = i * part_size;
+    const uint64_t length =
+        (offset + part_size > size) ? size - offset : part_size;
+    s3fanout::JobInfo *part =
+        new s3fanout::JobInfo(info->access_key,
+                              info->secret_key,
+                              info->hostname,
+                              info->bucket,
+                              info->object_key,
+                              NULL,
+                              NULL,
+                              buffer + offset,
+                              static_cast<size_t>(length));
+    part->request = s3fanout::JobInfo::kReqMultipartPart;
+    part->upload_id = info->upload_id;
+    part->part_number = i + 1;
+    const bool retval = UploadJobInfo(part);
+    assert(retval);
+  }
+
+  return true;
+}
+
+
+/**
+ * Bookkeeping of finished parts and complete requests.  Runs in the context of
+ * the worker thread.
+ */
+void S3Uploader::OnMultipartJobCompleted(s3fanout::JobInfo *info) {
+  MultipartUpload *upload;
+  {
+    MutexLockGuard guard(lock_multipart_uploads_);
+    std::map<std::string, MultipartUpload *>::const_iterator i =
+        multipart_uploads_.find(info->upload_id);
+    assert(i != multipart_uploads_.end());
+    upload = i->second;
+  }
+
+  if (info->request == s3fanout::JobInfo::kReqMultipartComplete) {
+    int reply_code = 0;
+    if (info->error_code != s3fanout::kFailOk) {
+      LogCvmfs(kLogUploadS3, kLogStderr, "Failed to complete multipart upload "
+               "of '%s' (error code: %d - %s)",
+               info->object_key.c_str(), info->error_code,
+               s3fanout::Code2Ascii(info->error_code));
+      reply_code = 99;
+    }
+    delete info;
+    FinishMultipart(upload, reply_code);
+    return;
+  }
+
+  if ((info->error_code != s3fanout::kFailOk) || info->etag.empty()) {
+    LogCvmfs(kLogUploadS3, kLogStderr, "Upload of part %u of '%s' failed. "
+             "(error code: %d - %s)", info->part_number,
+             info->object_key.c_str(), info->error_code,
+             s3fanout::Code2Ascii(info->error_code));
+    upload->failed = true;
+  } else {
+    upload->etags[info->part_number - 1] = info->etag;
+  }
+  delete info;
+
+  assert(upload->num_pending_parts > 0);
+  if (--upload->num_pending_parts > 0)
+    return;
+
+  if (upload->failed) {
+    FinishMultipart(upload, 99);
+    return;
+  }
+
+  upload->complete_body = s3fanout::MkCompleteMultipartBody(upload->etags);
+  s3fanout::JobInfo *complete =
+      new s3fanout::JobInfo(upload->info->access_key,
+                            upload->info->secret_key,
+                            upload->info->hostname,
+                            upload->info->bucket,
+                            upload->info->object_key,
+                            NULL,
+                            NULL,
+                            reinterpret_cast<const unsigned char *>(
+                                upload->complete_body.data()),
+                            upload->complete_body.length());
+  complete->request = s3fanout::JobInfo::kReqMultipartComplete;
+  complete->upload_id = upload->info->upload_id;
+  const bool retval = UploadJobInfo(complete);
+  assert(retval);
+}
+
+
+/**
+ * Reports the result of a multipart upload and releases its resources.  Failed
+ * uploads are aborted, so that the server discards the uploaded parts.
+ */
+void S3Uploader::FinishMultipart(MultipartUpload *upload,
+                                 const int reply_code)
+{
+  if (reply_code != 0) {
+    upload->info->request = s3fanout::JobInfo::kReqMultipartAbort;
+    if (!s3fanout_mgr_.DoSingleJob(upload->info)) {
+      LogCvmfs(kLogUploadS3, kLogStderr, "Failed to abort multipart upload "
+               "%s of '%s'", upload->info->upload_id.c_str(),
+               upload->info->object_key.c_str());
+    }
+  }
+
+  {
+    MutexLockGuard guard(lock_multipart_uploads_);
+    multipart_uploads_.erase(upload->info->upload_id);
+  }
+
+  if (upload->local_path.empty()) {
+    Respond(upload->callback, UploaderResults(reply_code));
+  } else {
+    Respond(upload->callback, UploaderResults(reply_code, upload->local_path));
+  }
+
+  upload->mmf->Unmap();
+  delete upload->mmf;
+  delete upload->info;
+  delete upload;
+}
+
+
+/**
+ * Plain S3 has no server-side component that could unpack an object pack.
+ * Instead, the ObjectPackConsumer unpacks it here and the objects are sent
+ * concurrently right from the memory of the pack, without a temporary file
+ * per object.  The commit callbacks are answered one by one as the objects
+ * are stored.
+ */
+void S3Uploader::UploadObjectPack(ObjectPackUpload *upload) {
+  PackCursor cursor(upload);
+  ObjectPackConsumer consumer(upload->digest, upload->header_size);
+  consumer.RegisterListener(&S3Uploader::OnPackedObject, this, &cursor);
+  const ObjectPackConsumer::BuildState state =
+    consumer.ConsumeNext(static_cast<unsigned>(upload->size), upload->data);
+  if (state != ObjectPackConsumer::kStateDone) {
+    LogCvmfs(kLogUploadS3, kLogStderr, "failed to unpack object pack of %u "
+             "objects (state %d)",
+             static_cast<unsigned>(upload->callbacks.size()), state);
+  }
+  for (unsigned i = cursor.jobs.size(); i < upload->callbacks.size(); ++i) {
+    atomic_inc32(&copy_errors_);
+    Respond(upload->callbacks[i], UploaderResults(1));
+  }
+  if (cursor.jobs.empty()) {
+    delete upload;
+    return;
+  }
+
+  // All jobs need to be registered before the first one can finish
+  PackedObjects *packed_objects =
+    new PackedObjects(upload, cursor.jobs.size());
+  for (unsigned i = 0; i < cursor.jobs.size(); ++i)
+    packed_object_jobs_[cursor.jobs[i]] = packed_objects;
+  for (unsigned i = 0; i < cursor.jobs.size(); ++i) {
+    const bool retval = UploadJobInfo(cursor.jobs[i]);
+    assert(retval);
+  }
+}
+
+
+/**
+ * The pack is consumed in one go, so every object arrives in one piece.
+ */
+void S3Uploader::OnPackedObject(
+  const ObjectPackConsumerBase::BuildEvent &event,
+  PackCursor *cursor)
+{
+  assert(event.buf_size == event.size);
+  assert(cursor->jobs.size() < cursor->upload->callbacks.size());
+  const CallbackTN *callback = cursor->upload->callbacks[cursor->jobs.size()];
+
+  const std::string mangled_filename =
+    repository_alias_ + "/data/" + event.id.MakePath();
+  std::string access_key, secret_key, bucket_name;
+  GetKeysAndBucket(mangled_filename, &access_key, &secret_key, &bucket_name);
+  s3fanout::JobInfo *info =
+      new s3fanout::JobInfo(access_key,
+                            secret_key,
+                            full_host_name_,
+                            bucket_name,
+                            mangled_filename,
+                            const_cast<void*>(
+                                static_cast<void const*>(callback)),
+                            NULL,
+                            static_cast<const unsigned char *>(event.buf),
+                            static_cast<size_t>(event.size));
+  cursor->jobs.push_back(info);
+}
+
+
+/**
+ * Frees the object pack once its last object is stored.  Runs in the context
+ * of the worker thread, after the commit callback of the object is answered.
+ */
+void S3Uploader::OnPackedObjectCompleted(s3fanout::JobInfo *info) {
+  std::map<s3fanout::JobInfo *, PackedObjects *>::iterator i =
+    packed_object_jobs_.find(info);
+  if (i == packed_object_jobs_.end())
+    return;
+  PackedObjects *packed_objects = i->second;
+  packed_object_jobs_.erase(i);
+  assert(packed_objects->num_pending > 0);
+  if (--packed_objects->num_pending == 0) {
+    delete packed_objects->upload;
+    delete packed_objects;
+  }
+}
+
+
 s3fanout::JobInfo *S3Uploader::CreateJobInfo(const std::string& path) const {
   std::string access_key, secret_key, bucket_name;
   GetKeysAndBucket(path, &access_key, &secret_key, &bucket_name);
@@ -513,6 +844,20 @@ s3fanout::JobInfo *S3Uploader::CreateJobInfo(const std::string& path) const {
 }
 
 
+bool S3Uploader::DiscardStreamedUpload(UploadStreamHandle *handle) {
+  S3StreamHandle *local_handle = static_cast<S3StreamHandle*>(handle);
+  close(local_handle->file_descriptor);
+  const int retval = unlink(local_handle->temporary_path.c_str());
+  if (retval != 0) {
+    LogCvmfs(kLogUploadS3, kLogVerboseMsg,
+             "failed to remove temporary '%s' (errno: %d)",
+             local_handle->temporary_path.c_str(), errno);
+  }
+  delete local_handle;
+  return true;
+}
+
+
 bool S3Uploader::Remove(const std::string& file_to_delete) {
   const std::string mangled_path = repository_alias_ + "/" + file_to_delete;
   s3fanout::JobInfo *info = CreateJobInfo(mangled_path);
@@ -525,6 +870,102 @@ bool S3Uploader::Remove(const std::string& file_to_delete) {
 }
 
 
+/**
+ * Deletes the objects by multi-object delete requests, one or more per bucket.
+ * The requests are processed concurrently by the S3FanoutManager.
+ */
+void S3Uploader::RemoveObjects(const std::vector<shash::Any>  &hashes,
+                               const CallbackTN               *callback)
+{
+  if (hashes.empty()) {
+    Respond(callback, UploaderResults(UploaderResults::kRemoval, 0));
+    return;
+  }
+
+  // Object keys grouped by bucket
+  std::map<std::string, std::vector<std::string> > object_keys;
+  for (unsigned i = 0; i < hashes.size(); ++i) {
+    const std::string mangled_path =
+      repository_alias_ + "/data/" + hashes[i].MakePath();
+    object_keys[GetBucketName(SelectBucket(mangled_path))].push_back(
+      mangled_path);
+  }
+
+  std::vector<s3fanout::JobInfo *> jobs;
+  BatchRemoval *batch = new BatchRemoval();
+  batch->callback = callback;
+  std::map<std::string, std::vector<std::string> >::const_iterator i =
+    object_keys.begin();
+  for (; i != object_keys.end(); ++i) {
+    const std::vector<std::string> &keys = i->second;
+    for (unsigned pos = 0; pos < keys.size(); pos += kMaxKeysPerDelete) {
+      const unsigned num_keys =
+        std::min(static_cast<unsigned>(keys.size()) - pos, kMaxKeysPerDelete);
+      DeleteRequest *request = new DeleteRequest();
+      request->batch = batch;
+      request->num_keys = num_keys;
+      request->body = s3fanout::MkDeleteObjectsBody(
+        std::vector<std::string>(keys.begin() + pos,
+                                 keys.begin() + pos + num_keys));
+
+      // All keys of the group share the bucket and thus the access keys
+      std::string access_key, secret_key, bucket_name;
+      GetKeysAndBucket(keys[pos], &access_key, &secret_key, &bucket_name);
+      s3fanout::JobInfo *info =
+          new s3fanout::JobInfo(access_key,
+                                secret_key,
+                                full_host_name_,
+                                bucket_name,
+                                "",
+                                request,
+                                NULL,
+                                reinterpret_cast<const unsigned char *>(
+                                    request->body.data()),
+                                request->body.length());
+      info->request = s3fanout::JobInfo::kReqDeleteMulti;
+      jobs.push_back(info);
+    }
+  }
+
+  // All requests need to be counted before the first one can finish
+  batch->num_pending_requests = jobs.size();
+  for (unsigned j = 0; j < jobs.size(); ++j) {
+    const bool retval = UploadJobInfo(jobs[j]);
+    assert(retval);
+  }
+}
+
+
+/**
+ * Bookkeeping of finished multi-object delete requests.  Runs in the context
+ * of the worker thread.
+ */
+void S3Uploader::OnDeleteJobCompleted(s3fanout::JobInfo *info) {
+  DeleteRequest *request = static_cast<DeleteRequest *>(info->callback);
+  BatchRemoval *batch = request->batch;
+  if (info->error_code != s3fanout::kFailOk) {
+    // Either individual keys failed or the entire request
+    const unsigned num_errors = s3fanout::CountDeleteErrors(
+      info->response_body);
+    LogCvmfs(kLogUploadS3, kLogStderr, "Failed to delete %u objects in "
+             "bucket '%s' (error code: %d - %s)",
+             (num_errors > 0) ? num_errors : request->num_keys,
+             info->bucket.c_str(), info->error_code,
+             s3fanout::Code2Ascii(info->error_code));
+    batch->num_failed += (num_errors > 0) ? num_errors : request->num_keys;
+  }
+  delete request;
+  delete info;
+
+  assert(batch->num_pending_requests > 0);
+  if (--batch->num_pending_requests > 0)
+    return;
+  Respond(batch->callback,
+          UploaderResults(UploaderResults::kRemoval, batch->num_failed));
+  delete batch;
+}
+
+
 bool S3Uploader::Peek(const std::string& path) const {
   const std::string mangled_path = repository_alias_ + "/" + path;
   s3fanout::JobInfo *info = CreateJobInfo(mangled_path);
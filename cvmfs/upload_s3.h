@@ -5,10 +5,14 @@
 #ifndef CVMFS_UPLOAD_S3_H_
 #define CVMFS_UPLOAD_S3_H_
 
+#include <pthread.h>
+
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "pack.h"
 #include "s3fanout.h"
 #include "upload_facility.h"
 
@@ -58,8 +62,13 @@ class S3Uploader : public AbstractUploader {
                       const CallbackTN    *callback = NULL);
   void FinalizeStreamedUpload(UploadStreamHandle  *handle,
                               const shash::Any    &content_hash);
+  bool DiscardStreamedUpload(UploadStreamHandle *handle);
+  bool SupportsObjectPacks() const { return true; }
+  void UploadObjectPack(ObjectPackUpload *upload);
 
   bool Remove(const std::string &file_to_delete);
+  void RemoveObjects(const std::vector<shash::Any>  &hashes,
+                     const CallbackTN               *callback);
   bool Peek(const std::string& path) const;
   bool PlaceBootstrappingShortcut(const shash::Any &object) const;
 
@@ -73,8 +82,98 @@ class S3Uploader : public AbstractUploader {
   void WorkerThread();
 
  private:
+  /**
+   * Objects above the multipart threshold are uploaded in parts of equal size.
+   * The parts are pushed concurrently into the S3FanoutManager; once all of
+   * them arrived, the object is assembled by a complete request.  If any part
+   * fails, the upload is aborted so that the server drops the stored parts.
+   */
+  struct MultipartUpload {
+    MultipartUpload() : info(NULL), mmf(NULL), callback(NULL),
+                        num_pending_parts(0), failed(false) { }
+
+    s3fanout::JobInfo  *info;  // keys, bucket, object name and upload id
+    MemoryMappedFile   *mmf;
+    const CallbackTN   *callback;
+    std::string         local_path;  // empty for streamed uploads
+    std::vector<std::string> etags;
+    unsigned            num_pending_parts;
+    bool                failed;
+    std::string         complete_body;
+  };
+
+  /**
+   * A batch of objects scheduled for removal is deleted by one or multiple
+   * multi-object delete requests.  The callback is answered once all of them
+   * are finished.
+   */
+  struct BatchRemoval {
+    BatchRemoval() : callback(NULL), num_pending_requests(0), num_failed(0) { }
+
+    const CallbackTN  *callback;
+    unsigned           num_pending_requests;
+    int                num_failed;
+  };
+
+  /**
+   * The body of a multi-object delete request needs to stay valid until the
+   * request is finished.
+   */
+  struct DeleteRequest {
+    DeleteRequest() : batch(NULL), num_keys(0) { }
+
+    BatchRemoval  *batch;
+    std::string    body;
+    unsigned       num_keys;
+  };
+
+  /**
+   * The objects of an unpacked object pack are uploaded right from the memory
+   * of the pack.  It is freed once all of them are finished.
+   */
+  struct PackedObjects {
+    PackedObjects(ObjectPackUpload *upload, const unsigned num_pending)
+      : upload(upload), num_pending(num_pending) { }
+    ObjectPackUpload  *upload;
+    unsigned           num_pending;
+  };
+
+  /**
+   * Collects the upload jobs of the objects while a pack is unpacked.
+   */
+  struct PackCursor {
+    explicit PackCursor(ObjectPackUpload *upload) : upload(upload) { }
+    ObjectPackUpload                  *upload;
+    std::vector<s3fanout::JobInfo *>   jobs;
+  };
+
+  /**
+   * S3 accepts up to 1000 keys in a multi-object delete request
+   */
+  static const unsigned kMaxKeysPerDelete = 1000;
+
+  /**
+   * Objects larger than the threshold are uploaded in parts.  Parts must be
+   * at least 5MB (except for the last one), S3 allows for at most 10000 parts
+   * per object.
+   */
+  static const uint64_t kDefaultMultipartThreshold = 64 * 1024 * 1024;
+  static const uint64_t kDefaultMultipartPartSize = 16 * 1024 * 1024;
+  static const uint64_t kMinMultipartPartSize = 5 * 1024 * 1024;
+  static const unsigned kMaxNumParts = 10000;
+
   bool ParseSpoolerDefinition(const SpoolerDefinition &spooler_definition);
   bool UploadJobInfo(s3fanout::JobInfo *info);
+  bool UploadMultipart(const std::string  &object_key,
+                       MemoryMappedFile   *mmf,
+                       const CallbackTN   *callback,
+                       const std::string  &local_path);
+  void OnMultipartJobCompleted(s3fanout::JobInfo *info);
+  void FinishMultipart(MultipartUpload *upload, const int reply_code);
+  void OnDeleteJobCompleted(s3fanout::JobInfo *info);
+  void OnPackedObject(const ObjectPackConsumerBase::BuildEvent &event,
+                      PackCursor *cursor);
+  void OnPackedObjectCompleted(s3fanout::JobInfo *info);
 
   int GetKeysAndBucket(const std::string  &filename,
                        std::string        *access_key,
@@ -93,11 +192,19 @@ class S3Uploader : public AbstractUploader {
   std::string bucket_body_name_;
   int         number_of_buckets_;
   int         max_num_parallel_uploads_;
+  uint64_t    multipart_threshold_;  // 0 disables multipart uploads
+  uint64_t    multipart_part_size_;
   std::vector<std::pair<std::string, std::string> > keys_;
 
   const std::string    temporary_path_;
   mutable atomic_int32 copy_errors_;   // counts the number of occured
                                        // errors in Upload()
+
+  // Multipart uploads in flight, indexed by upload id
+  std::map<std::string, MultipartUpload *> multipart_uploads_;
+  pthread_mutex_t *lock_multipart_uploads_;
+  // Upload jobs of packed objects, only used by the worker thread
+  std::map<s3fanout::JobInfo *, PackedObjects *> packed_object_jobs_;
 };
 
 }  // namespace upload
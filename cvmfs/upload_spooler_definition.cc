@@ -19,16 +19,21 @@ SpoolerDefinition::SpoolerDefinition(
                       const bool               use_file_chunking,
                       const size_t             min_file_chunk_size,
                       const size_t             avg_file_chunk_size,
-                      const size_t             max_file_chunk_size) :
+                      const size_t             max_file_chunk_size,
+                      const ChunkingAlgorithm  chunking_algorithm) :
   driver_type(Unknown),
   hash_algorithm(hash_algorithm),
   compression_alg(compression_algorithm),
+  compression_level(0),
+  compression_dictionary(NULL),
   use_file_chunking(use_file_chunking),
   min_file_chunk_size(min_file_chunk_size),
   avg_file_chunk_size(avg_file_chunk_size),
   max_file_chunk_size(max_file_chunk_size),
+  chunking_algorithm(chunking_algorithm),
   number_of_threads(tbb::task_scheduler_init::default_num_threads()),
   number_of_concurrent_uploads(number_of_threads * 100),
+  object_pack_threshold(0),
   valid_(false)
 {
   // check if given file chunking values are sane
@@ -69,6 +74,9 @@ SpoolerDefinition::SpoolerDefinition(
 SpoolerDefinition SpoolerDefinition::Dup2DefaultCompression() const {
   SpoolerDefinition result(*this);
   result.compression_alg = zlib::kZlibDefault;
+  result.compression_level = 0;
+  result.compression_dictionary = NULL;
+  result.existence_filter_path = "";
   return result;
 }
 
@@ -5,6 +5,8 @@
 #ifndef CVMFS_UPLOAD_SPOOLER_DEFINITION_H_
 #define CVMFS_UPLOAD_SPOOLER_DEFINITION_H_
 
+#include <inttypes.h>
+
 #include <string>
 
 #include "compression.h"
@@ -27,6 +29,14 @@ struct SpoolerDefinition {
     Unknown
   };
 
+  /**
+   * Content-defined chunking algorithm, see file_processing/chunk_detector.h
+   */
+  enum ChunkingAlgorithm {
+    Xor32,
+    Gear
+  };
+
   /**
    * Reads a given definition_string as described above and interprets
    * it. If the provided string turns out to be malformed the created
@@ -43,13 +53,14 @@ struct SpoolerDefinition {
     const bool               use_file_chunking   = false,
     const size_t             min_file_chunk_size = 0,
     const size_t             avg_file_chunk_size = 0,
-    const size_t             max_file_chunk_size = 0);
+    const size_t             max_file_chunk_size = 0,
+    const ChunkingAlgorithm  chunking_algorithm  = Xor32);
   bool IsValid() const { return valid_; }
 
   /**
    * Creates a new SpoolerDefinition based on an existing one.  The new spooler
    * has compression set to zlib, which is required for catalogs and other meta-
-   * objects.
+   * objects.  The new spooler does not use the upload existence filter.
    */
   SpoolerDefinition Dup2DefaultCompression() const;
 
@@ -63,14 +74,34 @@ struct SpoolerDefinition {
 
   shash::Algorithms  hash_algorithm;
   zlib::Algorithms   compression_alg;
+  int                compression_level;  //!< 0: default of the algorithm
+  /**
+   * Trained zstd dictionary for small objects, NULL if not used.  Owned by the
+   * caller, it has to outlive the spooler.
+   */
+  const zlib::Dictionary *compression_dictionary;
   bool               use_file_chunking;
   size_t             min_file_chunk_size;
   size_t             avg_file_chunk_size;
   size_t             max_file_chunk_size;
+  ChunkingAlgorithm  chunking_algorithm;
 
   const unsigned int number_of_threads;
   unsigned int       number_of_concurrent_uploads;
 
+  /**
+   * If set, streamed uploads of objects that are already in the backend
+   * storage are skipped, see AbstractUploader.  The path points to the
+   * persistent Bloom filter of the known objects.
+   */
+  std::string        existence_filter_path;
+
+  /**
+   * Streamed objects up to this size are collected in object packs and stored
+   * in one go, if the uploader supports it.  0 disables object packs.
+   */
+  uint64_t           object_pack_threshold;
+
   bool valid_;
 };
 
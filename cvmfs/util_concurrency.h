@@ -474,6 +474,16 @@ class FifoChannel : protected std::queue<T> {
    */
   const T Dequeue();
 
+  /**
+   * Removes up to max_items elements from the channel and appends them to
+   * items.  Blocks like Dequeue() until at least one item is available but
+   * does not wait for more than that.  Allows consumers to process items in
+   * batches with a single lock acquisition.
+   *
+   * @return  the number of dequeued items
+   */
+  size_t DequeueBatch(const size_t max_items, std::vector<T> *items);
+
   /**
    * Clears all items in the FIFO channel. The cleared items will be lost.
    *
@@ -296,6 +296,31 @@ const T FifoChannel<T>::Dequeue() {
 }
 
 
+template <class T>
+size_t FifoChannel<T>::DequeueBatch(const size_t max_items,
+                                    std::vector<T> *items)
+{
+  assert(max_items > 0);
+  MutexLockGuard lock(mutex_);
+
+  while (this->empty()) {
+    pthread_cond_wait(&queue_is_not_empty_, &mutex_);
+  }
+
+  size_t num_items = 0;
+  while (!this->empty() && (num_items < max_items)) {
+    items->push_back(this->front()); this->pop();
+    ++num_items;
+  }
+
+  if (this->size() < queue_drainout_threshold_) {
+    pthread_cond_broadcast(&queue_is_not_full_);
+  }
+
+  return num_items;
+}
+
+
 template <class T>
 unsigned int FifoChannel<T>::Drop() {
   MutexLockGuard lock(mutex_);
@@ -54,6 +54,8 @@ BuildRequires: valgrind-devel
 BuildRequires: cmake
 BuildRequires: fuse-devel
 BuildRequires: libattr-devel
+BuildRequires: libzstd-devel
+BuildRequires: lz4-devel
 BuildRequires: openssl-devel
 BuildRequires: patch
 BuildRequires: pkgconfig
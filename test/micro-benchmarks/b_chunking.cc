@@ -0,0 +1,186 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <inttypes.h>
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include "bm_util.h"
+#include "file_processing/char_buffer.h"
+#include "file_processing/chunk_detector.h"
+#include "hash.h"
+#include "prng.h"
+
+using namespace std;  // NOLINT
+
+// size of the read buffers of the file processor
+static const size_t kBufferSize = 4 * 1024 * 1024;
+static const size_t kReleaseSize = 64 * 1024 * 1024;
+
+typedef upload::ChunkDetector *(*DetectorFactory)(size_t avg_chunk_size);
+
+static upload::ChunkDetector *MakeXor32(size_t avg_chunk_size) {
+  return new upload::Xor32Detector(avg_chunk_size / 2, avg_chunk_size,
+                                   avg_chunk_size * 2);
+}
+
+static upload::ChunkDetector *MakeGear(size_t avg_chunk_size) {
+  return new upload::GearDetector(avg_chunk_size / 2, avg_chunk_size,
+                                  avg_chunk_size * 2);
+}
+
+
+/**
+ * Mimics a software release: a sequence of files of random size and content.
+ */
+static void CreateRelease(Prng *prng, vector<vector<unsigned char> > *files) {
+  size_t total = 0;
+  while (total < kReleaseSize) {
+    vector<unsigned char> file(4096 + prng->Next(4 * 1024 * 1024));
+    for (unsigned i = 0; i < file.size(); ++i)
+      file[i] = prng->Next(256);
+    total += file.size();
+    files->push_back(file);
+  }
+}
+
+
+/**
+ * The next release modifies every fourth file by a few insertions and
+ * deletions and adds a new file.
+ */
+static void CreateNextRelease(Prng *prng,
+                              vector<vector<unsigned char> > *files)
+{
+  for (unsigned i = 0; i < files->size(); i += 4) {
+    vector<unsigned char> *file = &(*files)[i];
+    for (unsigned j = 0; j < 3; ++j) {
+      const size_t pos = prng->Next(file->size());
+      const size_t len = 1 + prng->Next(512);
+      if (prng->Next(2) == 0) {
+        vector<unsigned char> patch(len);
+        for (unsigned k = 0; k < len; ++k)
+          patch[k] = prng->Next(256);
+        file->insert(file->begin() + pos, patch.begin(), patch.end());
+      } else {
+        file->erase(file->begin() + pos,
+                    file->begin() + min(pos + len, file->size()));
+      }
+    }
+  }
+  vector<unsigned char> file(1024 * 1024);
+  for (unsigned i = 0; i < file.size(); ++i)
+    file[i] = prng->Next(256);
+  files->push_back(file);
+}
+
+
+/**
+ * Chunks the files like the file processor does, i.e. in buffers of
+ * kBufferSize.  Returns the number of processed bytes.
+ */
+static size_t ChunkFiles(const vector<vector<unsigned char> > &files,
+                         DetectorFactory factory,
+                         size_t avg_chunk_size,
+                         set<shash::Any> *chunks)
+{
+  size_t bytes = 0;
+  for (unsigned i = 0; i < files.size(); ++i) {
+    const vector<unsigned char> &file = files[i];
+    upload::ChunkDetector *detector = factory(avg_chunk_size);
+    upload::CharBuffer buffer(kBufferSize);
+    off_t last_cut = 0;
+    for (size_t pos = 0; pos < file.size(); pos += kBufferSize) {
+      const size_t nbytes = min(kBufferSize, file.size() - pos);
+      memcpy(buffer.ptr(), &file[pos], nbytes);
+      buffer.SetUsedBytes(nbytes);
+      buffer.SetBaseOffset(pos);
+      off_t cut;
+      while ((cut = detector->FindNextCutMark(&buffer)) != 0) {
+        if (static_cast<size_t>(cut) >= file.size())
+          break;
+        if (chunks != NULL) {
+          shash::Any hash(shash::kMd5);
+          shash::HashMem(&file[last_cut], cut - last_cut, &hash);
+          chunks->insert(hash);
+        }
+        last_cut = cut;
+      }
+    }
+    if (chunks != NULL) {
+      shash::Any hash(shash::kMd5);
+      shash::HashMem(&file[last_cut], file.size() - last_cut, &hash);
+      chunks->insert(hash);
+    }
+    bytes += file.size();
+    delete detector;
+  }
+  return bytes;
+}
+
+
+/**
+ * Throughput of the chunk detector on a full release.  The label shows the
+ * share of the chunks of the next release that are already present in the
+ * previous release.
+ */
+static void ChunkRelease(benchmark::State &st, DetectorFactory factory) {
+  const size_t avg_chunk_size = st.range_x();
+  Prng prng;
+  prng.InitSeed(42);
+  vector<vector<unsigned char> > files;
+  CreateRelease(&prng, &files);
+  vector<vector<unsigned char> > next_files(files);
+  CreateNextRelease(&prng, &next_files);
+
+  size_t bytes = 0;
+  while (st.KeepRunning()) {
+    bytes += ChunkFiles(files, factory, avg_chunk_size, NULL);
+  }
+  st.SetBytesProcessed(bytes);
+
+  set<shash::Any> chunks;
+  set<shash::Any> next_chunks;
+  ChunkFiles(files, factory, avg_chunk_size, &chunks);
+  ChunkFiles(next_files, factory, avg_chunk_size, &next_chunks);
+  unsigned shared = 0;
+  for (set<shash::Any>::const_iterator i = next_chunks.begin(),
+       iEnd = next_chunks.end(); i != iEnd; ++i)
+  {
+    if (chunks.find(*i) != chunks.end())
+      ++shared;
+  }
+  char label[32];
+  snprintf(label, sizeof(label), "dedup %.3f",
+           static_cast<double>(shared) / next_chunks.size());
+  st.SetLabel(label);
+}
+
+
+class BM_Chunking : public benchmark::Fixture {
+ protected:
+  virtual void SetUp(const benchmark::State &st) {
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+  }
+};
+
+
+BENCHMARK_DEFINE_F(BM_Chunking, Xor32)(benchmark::State &st) {
+  ChunkRelease(st, MakeXor32);
+}
+BENCHMARK_REGISTER_F(BM_Chunking, Xor32)->Repetitions(3)->
+  Arg(256*1024)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Chunking, Gear)(benchmark::State &st) {
+  ChunkRelease(st, MakeGear);
+}
+BENCHMARK_REGISTER_F(BM_Chunking, Gear)->Repetitions(3)->
+  Arg(256*1024)->Arg(1024*1024);
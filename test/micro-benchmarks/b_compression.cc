@@ -5,6 +5,7 @@
 
 #include <inttypes.h>
 
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
@@ -34,3 +35,94 @@ BENCHMARK_DEFINE_F(BM_Compression, Zlib)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Compression, Zlib)->Repetitions(3)->
   Arg(100)->Arg(4096)->Arg(100*1024);
+
+
+/**
+ * Fills the buffer with repetitive, text-like data that compresses somewhat.
+ */
+static void FillCompressible(unsigned char *buffer, unsigned size) {
+  srand(42);
+  for (unsigned i = 0; i < size; ++i)
+    buffer[i] = 'a' + (rand() % 16) * ((i / 64) % 2);
+}
+
+
+static void CompressAlgorithm(benchmark::State &st, zlib::Algorithms alg) {
+  unsigned size = st.range_x();
+  unsigned char *buffer = new unsigned char[size];
+  FillCompressible(buffer, size);
+  uint64_t out_size = 0;
+  while (st.KeepRunning()) {
+    void *out_buf;
+    zlib::CompressMem2Mem(buffer, size, &out_buf, &out_size, alg);
+    free(out_buf);
+  }
+  st.SetBytesProcessed(int64_t(st.iterations()) * size);
+  char label[32];
+  snprintf(label, sizeof(label), "ratio %.3f",
+           static_cast<double>(out_size) / size);
+  st.SetLabel(label);
+  delete[] buffer;
+}
+
+
+static void DecompressAlgorithm(benchmark::State &st, zlib::Algorithms alg) {
+  unsigned size = st.range_x();
+  unsigned char *buffer = new unsigned char[size];
+  FillCompressible(buffer, size);
+  void *compressed;
+  uint64_t compressed_size;
+  zlib::CompressMem2Mem(buffer, size, &compressed, &compressed_size, alg);
+  while (st.KeepRunning()) {
+    void *out_buf;
+    uint64_t out_size;
+    zlib::DecompressMem2Mem(compressed, compressed_size,
+                            &out_buf, &out_size, alg);
+    free(out_buf);
+  }
+  st.SetBytesProcessed(int64_t(st.iterations()) * size);
+  free(compressed);
+  delete[] buffer;
+}
+
+
+BENCHMARK_DEFINE_F(BM_Compression, CompressZlib)(benchmark::State &st) {
+  CompressAlgorithm(st, zlib::kZlibDefault);
+}
+BENCHMARK_REGISTER_F(BM_Compression, CompressZlib)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, CompressZstd)(benchmark::State &st) {
+  CompressAlgorithm(st, zlib::kZstd);
+}
+BENCHMARK_REGISTER_F(BM_Compression, CompressZstd)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, CompressLz4)(benchmark::State &st) {
+  CompressAlgorithm(st, zlib::kLz4);
+}
+BENCHMARK_REGISTER_F(BM_Compression, CompressLz4)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, DecompressZlib)(benchmark::State &st) {
+  DecompressAlgorithm(st, zlib::kZlibDefault);
+}
+BENCHMARK_REGISTER_F(BM_Compression, DecompressZlib)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, DecompressZstd)(benchmark::State &st) {
+  DecompressAlgorithm(st, zlib::kZstd);
+}
+BENCHMARK_REGISTER_F(BM_Compression, DecompressZstd)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, DecompressLz4)(benchmark::State &st) {
+  DecompressAlgorithm(st, zlib::kLz4);
+}
+BENCHMARK_REGISTER_F(BM_Compression, DecompressLz4)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
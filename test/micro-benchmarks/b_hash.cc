@@ -63,3 +63,55 @@ BENCHMARK_DEFINE_F(BM_Hash, Sha1)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Hash, Sha1)->Repetitions(3)->Arg(100)->Arg(4096)->
   Arg(100*1024);
+
+
+/**
+ * Hashes 64 buffers of the given size at once with the given kernel.  Falls
+ * back to the generic kernel if the CPU does not support the requested one.
+ */
+static void HashBatch(benchmark::State &st, shash::BatchKernel kernel) {
+  if (!shash::HasBatchKernel(kernel)) {
+    st.SetLabel("kernel not supported, using generic");
+    kernel = shash::kBatchGeneric;
+  }
+  const unsigned size = st.range_x();
+  const unsigned nbuffers = 64;
+  unsigned char *data = new unsigned char[nbuffers * size];
+  memset(data, 42, nbuffers * size);
+  const unsigned char *buffers[nbuffers];
+  unsigned sizes[nbuffers];
+  shash::Any digests[nbuffers];
+  for (unsigned i = 0; i < nbuffers; ++i) {
+    buffers[i] = data + i * size;
+    sizes[i] = size;
+    digests[i].algorithm = shash::kSha1;
+  }
+  while (st.KeepRunning()) {
+    shash::HashMemBatch(buffers, sizes, nbuffers, digests, kernel);
+    ClobberMemory();
+  }
+  st.SetItemsProcessed(st.iterations() * nbuffers);
+  st.SetBytesProcessed(int64_t(st.iterations()) * nbuffers * size);
+  delete[] data;
+}
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Sha1BatchGeneric)(benchmark::State &st) {
+  HashBatch(st, shash::kBatchGeneric);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Sha1BatchGeneric)->Repetitions(3)->
+  Arg(100)->Arg(4096)->Arg(100*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Sha1BatchShaNi)(benchmark::State &st) {
+  HashBatch(st, shash::kBatchShaNi);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Sha1BatchShaNi)->Repetitions(3)->
+  Arg(100)->Arg(4096)->Arg(100*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Sha1BatchAvx2)(benchmark::State &st) {
+  HashBatch(st, shash::kBatchAvx2);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Sha1BatchAvx2)->Repetitions(3)->
+  Arg(100)->Arg(4096)->Arg(100*1024);
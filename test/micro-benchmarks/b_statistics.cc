@@ -0,0 +1,48 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include "bm_util.h"
+#include "statistics.h"
+
+/**
+ * Shared among the benchmark threads, like the fuse callback counters are
+ * shared among the fuse threads.  Constructed before any benchmark thread runs.
+ */
+struct SharedCounters {
+  SharedCounters() { sharded.MakeSharded(); }
+  perf::Counter plain;
+  perf::Counter sharded;
+};
+static SharedCounters shared_counters_;
+
+
+static void BM_CounterPlain(benchmark::State &st) {  // NOLINT
+  while (st.KeepRunning()) {
+    perf::Inc(&shared_counters_.plain);
+  }
+  st.SetItemsProcessed(st.iterations());
+}
+BENCHMARK(BM_CounterPlain)->ThreadRange(1, 64)->UseRealTime();
+
+
+static void BM_CounterSharded(benchmark::State &st) {  // NOLINT
+  while (st.KeepRunning()) {
+    perf::Inc(&shared_counters_.sharded);
+  }
+  st.SetItemsProcessed(st.iterations());
+}
+BENCHMARK(BM_CounterSharded)->ThreadRange(1, 64)->UseRealTime();
+
+
+static void BM_CounterShardedGet(benchmark::State &st) {  // NOLINT
+  perf::Counter counter;
+  counter.MakeSharded();
+  while (st.KeepRunning()) {
+    int64_t value = counter.Get();
+    Escape(&value);
+  }
+  st.SetItemsProcessed(st.iterations());
+}
+BENCHMARK(BM_CounterShardedGet);
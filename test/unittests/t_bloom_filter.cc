@@ -0,0 +1,183 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "bloom_filter.h"
+#include "hash.h"
+#include "prng.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+class T_BloomFilter : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    prng_.InitSeed(42);
+    tmp_path_ = CreateTempDir("./cvmfs_ut_bloom_filter");
+    ASSERT_FALSE(tmp_path_.empty());
+  }
+
+  virtual void TearDown() {
+    if (!tmp_path_.empty())
+      RemoveTree(tmp_path_);
+  }
+
+  void MakeHashes(const unsigned n, vector<shash::Any> *hashes) {
+    for (unsigned i = 0; i < n; ++i) {
+      shash::Any hash(shash::kSha1);
+      hash.Randomize(&prng_);
+      hashes->push_back(hash);
+    }
+  }
+
+  Prng prng_;
+  string tmp_path_;
+};
+
+
+TEST_F(T_BloomFilter, Sizing) {
+  BloomFilter filter(1000, 0.01);
+  EXPECT_EQ(1000U, filter.capacity());
+  EXPECT_EQ(0U, filter.num_bits() % 64);
+  // m = -n ln(p) / ln(2)^2 ~ 9.6 bits per entry, k = 7
+  EXPECT_GE(filter.num_bits(), 9585U);
+  EXPECT_LE(filter.num_bits(), 9585U + 64);
+  EXPECT_EQ(7U, filter.num_hashes());
+  EXPECT_EQ(0U, filter.count());
+}
+
+
+TEST_F(T_BloomFilter, AddContains) {
+  const unsigned n = 10000;
+  BloomFilter filter(n, 0.01);
+  vector<shash::Any> hashes;
+  MakeHashes(n, &hashes);
+  for (unsigned i = 0; i < n; ++i)
+    filter.Add(hashes[i]);
+  // Hashes that are false positives during Add() are not counted
+  EXPECT_LE(filter.count(), n);
+  EXPECT_GE(filter.count(), n - n / 100);
+  EXPECT_EQ(1U, filter.num_layers());
+  for (unsigned i = 0; i < n; ++i)
+    EXPECT_TRUE(filter.Contains(hashes[i]));
+
+  vector<shash::Any> others;
+  MakeHashes(n, &others);
+  unsigned false_positives = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    if (filter.Contains(others[i]))
+      ++false_positives;
+  }
+  EXPECT_LT(false_positives, 2 * n / 100);
+
+  filter.Clear();
+  EXPECT_EQ(0U, filter.count());
+  for (unsigned i = 0; i < n; ++i)
+    EXPECT_FALSE(filter.Contains(hashes[i]));
+}
+
+
+TEST_F(T_BloomFilter, Duplicates) {
+  BloomFilter filter(100, 0.01);
+  shash::Any hash(shash::kSha1);
+  hash.Randomize(&prng_);
+  filter.Add(hash);
+  filter.Add(hash);
+  EXPECT_EQ(1U, filter.count());
+}
+
+
+TEST_F(T_BloomFilter, Grow) {
+  const unsigned capacity = 1000;
+  const unsigned n = 50 * capacity;
+  BloomFilter filter(capacity, 0.01);
+  vector<shash::Any> hashes;
+  MakeHashes(n, &hashes);
+  for (unsigned i = 0; i < n; ++i)
+    filter.Add(hashes[i]);
+  // 1000 + 2000 + ... + 32000 >= 50000
+  EXPECT_EQ(6U, filter.num_layers());
+  EXPECT_GE(filter.capacity(), filter.count());
+  EXPECT_GE(filter.count(), n - n / 50);
+  for (unsigned i = 0; i < n; ++i)
+    EXPECT_TRUE(filter.Contains(hashes[i]));
+
+  vector<shash::Any> others;
+  MakeHashes(n, &others);
+  unsigned false_positives = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    if (filter.Contains(others[i]))
+      ++false_positives;
+  }
+  EXPECT_LT(false_positives, 2 * n / 100);
+
+  filter.Clear();
+  EXPECT_EQ(1U, filter.num_layers());
+  EXPECT_EQ(capacity, filter.capacity());
+  EXPECT_EQ(0U, filter.count());
+}
+
+
+TEST_F(T_BloomFilter, Suffix) {
+  BloomFilter filter(100, 0.001);
+  shash::Any hash(shash::kSha1);
+  hash.Randomize(&prng_);
+  shash::Any catalog_hash(hash);
+  catalog_hash.suffix = shash::kSuffixCatalog;
+
+  filter.Add(hash);
+  EXPECT_TRUE(filter.Contains(hash));
+  EXPECT_FALSE(filter.Contains(catalog_hash));
+}
+
+
+TEST_F(T_BloomFilter, SaveLoad) {
+  const string path = tmp_path_ + "/filter";
+  EXPECT_EQ(NULL, BloomFilter::Load(path));
+
+  BloomFilter filter(1000, 0.01);
+  vector<shash::Any> hashes;
+  MakeHashes(5000, &hashes);
+  for (unsigned i = 0; i < hashes.size(); ++i)
+    filter.Add(hashes[i]);
+  EXPECT_EQ(3U, filter.num_layers());
+  EXPECT_TRUE(filter.Save(path));
+  EXPECT_FALSE(FileExists(path + ".tmp"));
+
+  UniquePtr<BloomFilter> loaded(BloomFilter::Load(path));
+  ASSERT_TRUE(loaded.IsValid());
+  EXPECT_EQ(filter.capacity(), loaded->capacity());
+  EXPECT_EQ(filter.num_bits(), loaded->num_bits());
+  EXPECT_EQ(filter.num_hashes(), loaded->num_hashes());
+  EXPECT_EQ(filter.num_layers(), loaded->num_layers());
+  EXPECT_EQ(filter.count(), loaded->count());
+  for (unsigned i = 0; i < hashes.size(); ++i)
+    EXPECT_TRUE(loaded->Contains(hashes[i]));
+
+  // The loaded filter keeps growing
+  vector<shash::Any> more;
+  MakeHashes(5000, &more);
+  for (unsigned i = 0; i < more.size(); ++i)
+    loaded->Add(more[i]);
+  EXPECT_EQ(4U, loaded->num_layers());
+  for (unsigned i = 0; i < more.size(); ++i)
+    EXPECT_TRUE(loaded->Contains(more[i]));
+}
+
+
+TEST_F(T_BloomFilter, LoadCorrupted) {
+  const string path = tmp_path_ + "/filter";
+  EXPECT_TRUE(SafeWriteToFile("not a bloom filter", path, 0644));
+  EXPECT_EQ(NULL, BloomFilter::Load(path));
+
+  BloomFilter filter(1000, 0.01);
+  EXPECT_TRUE(filter.Save(path));
+  EXPECT_EQ(0, truncate(path.c_str(), GetFileSize(path) - 1));
+  EXPECT_EQ(NULL, BloomFilter::Load(path));
+}
@@ -7,11 +7,18 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "cache_posix.h"
 #include "catalog.h"
+#include "catalog_mgr.h"
 #include "catalog_rw.h"
 #include "hash.h"
 #include "shortstring.h"
+#include "sqlitevfs.h"
+#include "statistics.h"
 #include "testutil.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -303,6 +310,109 @@ TEST_F(T_Catalog, Lookup) {
   EXPECT_TRUE(dirent.IsHidden());
 }
 
+TEST_F(T_Catalog, PathFilter) {
+  perf::Statistics statistics;
+  Statistics counters(&statistics);
+  catalog = catalog::Catalog::AttachFreely("",
+                                           catalog_db_root,
+                                           shash::Any(),
+                                           NULL,
+                                           false);
+  catalog->EnablePathFilter(&counters);
+  DirectoryEntry dirent;
+
+  // The first negative lookup builds the filter
+  EXPECT_EQ(0, counters.sz_path_filters->Get());
+  EXPECT_FALSE(catalog->LookupPath(PathString("/fakepath"), &dirent));
+  EXPECT_EQ(0, counters.n_path_filter_negative->Get());
+  EXPECT_EQ(0, counters.n_path_filter_false_positive->Get());
+  EXPECT_GT(counters.sz_path_filters->Get(), 0);
+
+  const unsigned num_lookups = 1000;
+  for (unsigned i = 0; i < num_lookups; ++i) {
+    const string path = "/dir/dir/fakefile" + StringifyInt(i);
+    EXPECT_FALSE(catalog->LookupPath(PathString(path), &dirent));
+  }
+  EXPECT_EQ(num_lookups, counters.n_path_filter_negative->Get() +
+                         counters.n_path_filter_false_positive->Get());
+  EXPECT_GT(counters.n_path_filter_negative->Get(), 9 * num_lookups / 10);
+
+  // Existing entries are never filtered out
+  const int64_t false_positives = counters.n_path_filter_false_positive->Get();
+  EXPECT_TRUE(catalog->LookupPath(PathString("/foo"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString("/hidden"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/bar2"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/link"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/folder"), &dirent));
+  EXPECT_EQ(false_positives, counters.n_path_filter_false_positive->Get());
+
+  // The memory of the filter is released with the catalog
+  delete catalog;
+  catalog = NULL;
+  EXPECT_EQ(0, counters.sz_path_filters->Get());
+}
+
+// On the client, catalogs are opened through the read-only sqlite VFS on a
+// file descriptor of the cache manager
+TEST_F(T_Catalog, PathFilterCacheFd) {
+  perf::Statistics statistics;
+  Statistics counters(&statistics);
+  UniquePtr<PosixCacheManager> cache_mgr(
+    PosixCacheManager::Create(sandbox + "/cache", false));
+  ASSERT_TRUE(cache_mgr.IsValid());
+  unsigned char *buffer;
+  unsigned size;
+  ASSERT_TRUE(CopyPath2Mem(catalog_db_root, &buffer, &size));
+  shash::Any hash(shash::kSha1, shash::kSuffixCatalog);
+  shash::HashMem(buffer, size, &hash);
+  EXPECT_TRUE(cache_mgr->CommitFromMem(hash, buffer, size, "catalog"));
+  free(buffer);
+  const int fd = cache_mgr->Open(CacheManager::Bless(hash));
+  ASSERT_GE(fd, 0);
+
+  ASSERT_TRUE(sqlite::RegisterVfsRdOnly(cache_mgr.weak_ref(), &statistics,
+                                        sqlite::kVfsOptDefault));
+  catalog = catalog::Catalog::AttachFreely("", "@" + StringifyInt(fd), hash,
+                                           NULL, false);
+  ASSERT_TRUE(catalog != NULL);
+  catalog->EnablePathFilter(&counters);
+
+  // Building the filter leaves the database usable
+  DirectoryEntry dirent;
+  EXPECT_FALSE(catalog->LookupPath(PathString("/fakepath"), &dirent));
+  EXPECT_GT(counters.sz_path_filters->Get(), 0);
+  EXPECT_TRUE(catalog->LookupPath(PathString("/foo"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/bar2"), &dirent));
+  DirectoryEntryList listing;
+  EXPECT_TRUE(catalog->ListingPath(PathString("/dir/dir"), &listing));
+  EXPECT_EQ(3U, listing.size());
+
+  delete catalog;
+  catalog = NULL;
+  EXPECT_TRUE(sqlite::UnregisterVfsRdOnly());
+  EXPECT_EQ(0, counters.sz_path_filters->Get());
+}
+
+TEST_F(T_Catalog, PathFilterWritable) {
+  perf::Statistics statistics;
+  Statistics counters(&statistics);
+  catalog::WritableCatalog *writable_catalog =
+    catalog::WritableCatalog::AttachFreely("",
+                                           catalog_db_root,
+                                           shash::Any(shash::kSha1),
+                                           NULL,
+                                           false);
+  catalog = writable_catalog;
+  catalog->EnablePathFilter(&counters);
+  DirectoryEntry dirent;
+
+  EXPECT_FALSE(catalog->LookupPath(PathString("/new"), &dirent));
+  AddEntry(writable_catalog, "new", "", S_IFREG,
+           "988881adc9fc3655077dc2d4d757d480b5ea0e11");
+  EXPECT_TRUE(catalog->LookupPath(PathString("/new"), &dirent));
+  EXPECT_EQ(0, counters.n_path_filter_negative->Get());
+}
+
 TEST_F(T_Catalog, Listing) {
   StatEntryList stat_entry_list;
   DirectoryEntryList dir_entry_list;
@@ -383,6 +493,59 @@ TEST_F(T_Catalog, Chunks) {
   EXPECT_EQ(4u, counter);  // number of files with content + empty hash
 }
 
+TEST_F(T_Catalog, BulkInsert) {
+  const string db_path = CreateCatalogDB("");
+  WritableCatalog *writable_catalog =
+    WritableCatalog::AttachFreely("", db_path, shash::Any(shash::kSha1));
+  ASSERT_TRUE(writable_catalog != NULL);
+
+  // Crosses the boundaries of the multi-row inserts
+  const unsigned num_files = 150;
+  writable_catalog->BeginBulkInsert();
+  AddEntry(writable_catalog, "dir", "", S_IFDIR, "");
+  for (unsigned i = 0; i < num_files; ++i) {
+    AddEntry(writable_catalog, "file" + StringifyInt(i), "/dir", S_IFREG,
+             "988881adc9fc3655077dc2d4d757d480b5ea0e11", "", i == 100);
+  }
+  writable_catalog->AddFileChunk("/dir/file100", FileChunk());
+  writable_catalog->EndBulkInsert();
+  {
+    // The previous settings are restored
+    SqlCatalog sql_journal_mode(writable_catalog->database(),
+                                "PRAGMA journal_mode;");
+    SqlCatalog sql_synchronous(writable_catalog->database(),
+                               "PRAGMA synchronous;");
+    ASSERT_TRUE(sql_journal_mode.FetchRow());
+    ASSERT_TRUE(sql_synchronous.FetchRow());
+    EXPECT_EQ("delete", string(reinterpret_cast<const char *>(
+      sql_journal_mode.RetrieveText(0))));
+    EXPECT_EQ(2, sql_synchronous.RetrieveInt(0));  // FULL
+  }
+  writable_catalog->Commit();
+  delete writable_catalog;
+
+  catalog = Catalog::AttachFreely("", db_path, shash::Any());
+  ASSERT_TRUE(catalog != NULL);
+  DirectoryEntryList listing;
+  EXPECT_TRUE(catalog->ListingPath(PathString("/dir"), &listing));
+  EXPECT_EQ(num_files, listing.size());
+  DirectoryEntry dirent;
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/file149"), &dirent));
+  EXPECT_EQ(NameString("file149"), dirent.name());
+  FileChunkList chunks;
+  EXPECT_TRUE(catalog->ListPathChunks(PathString("/dir/file100"),
+                                      shash::kSha1, &chunks));
+  EXPECT_EQ(1u, chunks.size());
+
+  UniquePtr<CatalogDatabase> db(
+    CatalogDatabase::Open(db_path, CatalogDatabase::kOpenReadOnly));
+  ASSERT_TRUE(db.IsValid());
+  SqlCatalog sql_index(*db, "SELECT count(*) FROM sqlite_master "
+                            "WHERE name = 'idx_catalog_parent';");
+  ASSERT_TRUE(sql_index.FetchRow());
+  EXPECT_EQ(1, sql_index.RetrieveInt(0));
+}
+
 TEST_F(T_Catalog, Statistics) {
   catalog = catalog::Catalog::AttachFreely("",
                                            catalog_db_root,
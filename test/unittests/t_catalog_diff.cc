@@ -0,0 +1,201 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "catalog_diff.h"
+#include "hash.h"
+#include "testutil.h"
+
+using swissknife::CatalogDiff;
+
+namespace {
+
+class DiffRecorder : public CatalogDiff<MockObjectFetcher> {
+ public:
+  explicit DiffRecorder(MockObjectFetcher *object_fetcher)
+    : CatalogDiff<MockObjectFetcher>(object_fetcher) { }
+
+  std::vector<std::string> changes;
+
+ protected:
+  virtual void ReportAddition(const PathString &path,
+                              const catalog::DirectoryEntry &entry)
+  {
+    changes.push_back("A " + path.ToString());
+  }
+  virtual void ReportRemoval(const PathString &path,
+                             const catalog::DirectoryEntry &entry)
+  {
+    changes.push_back("R " + path.ToString());
+  }
+  virtual void ReportModification(const PathString &path,
+                                  const catalog::DirectoryEntry &old_entry,
+                                  const catalog::DirectoryEntry &new_entry)
+  {
+    changes.push_back("M " + path.ToString());
+  }
+};
+
+}  // anonymous namespace
+
+
+class T_CatalogDiff : public ::testing::Test {
+ protected:
+  void SetUp() {
+    old_root_hash_ = h("1000000000000000000000000000000000000000", 'C');
+    new_root_hash_ = h("2000000000000000000000000000000000000000", 'C');
+    const shash::Any old_nested_hash =
+      h("3000000000000000000000000000000000000000", 'C');
+    const shash::Any new_nested_hash =
+      h("4000000000000000000000000000000000000000", 'C');
+    shared_hash_ = h("5000000000000000000000000000000000000000", 'C');
+    const shash::Any dir;
+    const time_t timestamp = t(1, 1, 2017);
+
+    // Revision 1
+    MockCatalog *old_root =
+      new MockCatalog("", old_root_hash_, 0, 1, timestamp, true);
+    old_root->AddFile(h("a100000000000000000000000000000000000000"), 1,
+                      "", "a");
+    old_root->AddFile(dir, 4096, "", "b");
+    old_root->AddFile(h("b100000000000000000000000000000000000000"), 1,
+                      "/b", "x");
+    old_root->AddFile(h("c100000000000000000000000000000000000000"), 1,
+                      "", "c");
+    old_root->AddFile(h("e100000000000000000000000000000000000000"), 1,
+                      "", "t");
+    old_root->AddFile(dir, 4096, "", "nested");
+    old_root->AddFile(dir, 4096, "", "shared");
+    MockCatalog *old_nested = new MockCatalog("/nested", old_nested_hash, 0, 1,
+                                              timestamp, false, old_root);
+    old_nested->AddFile(h("f100000000000000000000000000000000000000"), 1,
+                        "/nested", "f");
+    MockCatalog::RegisterObject(old_root_hash_, old_root);
+    MockCatalog::RegisterObject(old_nested_hash, old_nested);
+
+    // Revision 2
+    MockCatalog *new_root =
+      new MockCatalog("", new_root_hash_, 0, 2, timestamp, true);
+    new_root->AddFile(h("a200000000000000000000000000000000000000"), 1,
+                      "", "a");
+    new_root->AddFile(dir, 4096, "", "b");
+    new_root->AddFile(h("b200000000000000000000000000000000000000"), 1,
+                      "/b", "y");
+    new_root->AddFile(dir, 4096, "", "d");
+    new_root->AddFile(h("d200000000000000000000000000000000000000"), 1,
+                      "/d", "z");
+    new_root->AddFile(dir, 4096, "", "t");
+    new_root->AddFile(h("e200000000000000000000000000000000000000"), 1,
+                      "/t", "u");
+    new_root->AddFile(dir, 4096, "", "nested");
+    new_root->AddFile(dir, 4096, "", "shared");
+    MockCatalog *new_nested = new MockCatalog("/nested", new_nested_hash, 0, 2,
+                                              timestamp, false, new_root);
+    new_nested->AddFile(h("f100000000000000000000000000000000000000"), 1,
+                        "/nested", "f");
+    new_nested->AddFile(h("f200000000000000000000000000000000000000"), 1,
+                        "/nested", "g");
+    MockCatalog::RegisterObject(new_root_hash_, new_root);
+    MockCatalog::RegisterObject(new_nested_hash, new_nested);
+
+    // Identical in both revisions
+    MockCatalog *shared = new MockCatalog("/shared", shared_hash_, 0, 1,
+                                          timestamp, false);
+    shared->AddFile(h("5100000000000000000000000000000000000000"), 1,
+                    "/shared", "s");
+    old_root->RegisterNestedCatalog(shared);
+    new_root->RegisterNestedCatalog(shared);
+    MockCatalog::RegisterObject(shared_hash_, shared);
+  }
+
+  void TearDown() {
+    MockCatalog::Reset();
+    EXPECT_EQ(0u, MockCatalog::instances);
+  }
+
+  std::vector<std::string> Sorted(const std::vector<std::string> &changes) {
+    std::vector<std::string> result(changes);
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  MockObjectFetcher object_fetcher_;
+  shash::Any old_root_hash_;
+  shash::Any new_root_hash_;
+  shash::Any shared_hash_;
+};
+
+
+TEST_F(T_CatalogDiff, Identical) {
+  DiffRecorder diff(&object_fetcher_);
+  EXPECT_TRUE(diff.Run(old_root_hash_, old_root_hash_));
+  EXPECT_TRUE(diff.changes.empty());
+  EXPECT_EQ(5u, MockCatalog::instances);
+}
+
+
+TEST_F(T_CatalogDiff, Changes) {
+  // Identical nested catalogs must not be fetched
+  std::set<shash::Any> deleted_objects;
+  deleted_objects.insert(shared_hash_);
+  MockCatalog::s_deleted_objects = &deleted_objects;
+
+  DiffRecorder diff(&object_fetcher_);
+  EXPECT_TRUE(diff.Run(old_root_hash_, new_root_hash_));
+
+  std::vector<std::string> expected;
+  expected.push_back("A /b/y");
+  expected.push_back("A /d");
+  expected.push_back("A /d/z");
+  expected.push_back("A /nested/g");
+  expected.push_back("A /t");
+  expected.push_back("A /t/u");
+  expected.push_back("M /a");
+  expected.push_back("R /b/x");
+  expected.push_back("R /c");
+  expected.push_back("R /t");
+  EXPECT_EQ(expected, Sorted(diff.changes));
+
+  // Fetched catalogs are released again
+  EXPECT_EQ(5u, MockCatalog::instances);
+  MockCatalog::s_deleted_objects = NULL;
+}
+
+
+TEST_F(T_CatalogDiff, Reverse) {
+  DiffRecorder diff(&object_fetcher_);
+  EXPECT_TRUE(diff.Run(new_root_hash_, old_root_hash_));
+
+  std::vector<std::string> expected;
+  expected.push_back("A /b/x");
+  expected.push_back("A /c");
+  expected.push_back("A /t");
+  expected.push_back("M /a");
+  expected.push_back("R /b/y");
+  expected.push_back("R /d");
+  expected.push_back("R /d/z");
+  expected.push_back("R /nested/g");
+  expected.push_back("R /t");
+  expected.push_back("R /t/u");
+  EXPECT_EQ(expected, Sorted(diff.changes));
+}
+
+
+TEST_F(T_CatalogDiff, MissingCatalog) {
+  DiffRecorder diff(&object_fetcher_);
+  EXPECT_FALSE(diff.Run(old_root_hash_,
+                        h("6000000000000000000000000000000000000000", 'C')));
+
+  std::set<shash::Any> deleted_objects;
+  deleted_objects.insert(h("4000000000000000000000000000000000000000", 'C'));
+  MockCatalog::s_deleted_objects = &deleted_objects;
+  EXPECT_FALSE(diff.Run(old_root_hash_, new_root_hash_));
+  MockCatalog::s_deleted_objects = NULL;
+}
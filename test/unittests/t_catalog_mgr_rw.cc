@@ -0,0 +1,296 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "catalog.h"
+#include "catalog_mgr_rw.h"
+#include "compression.h"
+#include "download.h"
+#include "hash.h"
+#include "manifest.h"
+#include "statistics.h"
+#include "testutil.h"
+#include "upload.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/string.h"
+#include "xattr.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+class T_WritableCatalogManager : public ::testing::Test {
+ protected:
+  static const unsigned kNumFiles = 10;
+  static const unsigned kFanOut = 4;
+
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir(GetCurrentWorkingDirectory() +
+                              "/cvmfs_ut_catalog_mgr_rw");
+    ASSERT_FALSE(tmp_path_.empty());
+    repo_path_ = tmp_path_ + "/repo";
+    ASSERT_TRUE(MakeCacheDirectories(repo_path_ + "/data", 0755));
+
+    upload::SpoolerDefinition spooler_definition(
+      "local," + repo_path_ + "/data/txn," + repo_path_, shash::kSha1);
+    spooler_ = upload::Spooler::Construct(spooler_definition);
+    ASSERT_TRUE(spooler_.IsValid());
+    manifest_ = WritableCatalogManager::CreateRepository(
+      repo_path_ + "/data/txn", false, "", spooler_.weak_ref());
+    ASSERT_TRUE(manifest_.IsValid());
+    download_manager_.Init(4, false, &statistics_);
+  }
+
+  virtual void TearDown() {
+    download_manager_.Fini();
+    RemoveTree(tmp_path_);
+  }
+
+  /**
+   * Every catalog manager needs its own statistics, so that its counters can
+   * be registered.
+   */
+  WritableCatalogManager *NewCatalogManager(perf::Statistics *statistics) {
+    WritableCatalogManager *catalog_mgr = new WritableCatalogManager(
+      manifest_->catalog_hash(), "file://" + repo_path_,
+      repo_path_ + "/data/txn", spooler_.weak_ref(), &download_manager_,
+      500000, statistics, false, 0, 0);
+    EXPECT_TRUE(catalog_mgr->Init());
+    return catalog_mgr;
+  }
+
+  void AddFiles(WritableCatalogManager *catalog_mgr, const string &path,
+                const string &prefix)
+  {
+    XattrList xattrs;
+    for (unsigned i = 0; i < kNumFiles; ++i) {
+      const string name = prefix + StringifyInt(i);
+      shash::Any hash(shash::kSha1);
+      shash::HashString(path + "/" + name, &hash);
+      const DirectoryEntryBase file =
+        DirectoryEntryTestFactory::RegularFile(name, 4096, hash);
+      catalog_mgr->AddFile(file, xattrs, path);
+    }
+  }
+
+  /**
+   * Creates the directories dX/dY/dZ, each of them in a nested catalog, and
+   * returns the list of nested catalog mountpoints (relative paths).
+   */
+  vector<string> AddNestedTree(WritableCatalogManager *catalog_mgr) {
+    vector<string> mountpoints;
+    for (unsigned level = 0; level < 3; ++level) {
+      vector<string> parents;
+      if (level == 0)
+        parents.push_back("");
+      for (unsigned i = 0; i < mountpoints.size(); ++i) {
+        if (static_cast<unsigned>(
+              SplitString(mountpoints[i], '/').size()) == level)
+        {
+          parents.push_back(mountpoints[i]);
+        }
+      }
+      for (unsigned p = 0; p < parents.size(); ++p) {
+        for (unsigned i = 0; i < kFanOut; ++i) {
+          const string name = "d" + StringifyInt(i);
+          const string path =
+            parents[p].empty() ? name : parents[p] + "/" + name;
+          catalog_mgr->AddDirectory(
+            DirectoryEntryTestFactory::Directory(name, 4096),
+            parents[p]);
+          AddFiles(catalog_mgr, path, "file");
+          catalog_mgr->CreateNestedCatalog(path);
+          mountpoints.push_back(path);
+        }
+      }
+    }
+    return mountpoints;
+  }
+
+  bool Commit(WritableCatalogManager *catalog_mgr, const bool stop_for_tweaks)
+  {
+    catalog_mgr->PrecalculateListings();
+    if (!catalog_mgr->Commit(stop_for_tweaks, 0, manifest_.weak_ref()))
+      return false;
+    spooler_->WaitForUpload();
+    return true;
+  }
+
+  /**
+   * Walks the committed catalog tree from the root catalog in the manifest.
+   * For every catalog, the content hash of the stored object and the nested
+   * catalog reference in the parent are verified.  Fills the map of catalog
+   * hashes and previous revision hashes by (absolute) mountpoint.
+   */
+  void CheckTree(map<string, shash::Any> *hashes,
+                 map<string, shash::Any> *previous)
+  {
+    hashes->clear();
+    previous->clear();
+    CheckCatalog("", manifest_->catalog_hash(), 0, hashes, previous);
+  }
+
+  void CheckCatalog(const string &path, const shash::Any &hash,
+                    const uint64_t size,
+                    map<string, shash::Any> *hashes,
+                    map<string, shash::Any> *previous)
+  {
+    const string object_path = repo_path_ + "/data/" + hash.MakePath();
+    shash::Any content_hash(hash.algorithm);
+    ASSERT_TRUE(shash::HashFile(object_path, &content_hash)) << path;
+    EXPECT_EQ(hash, content_hash) << path;
+
+    const string catalog_path = CreateTempPath(tmp_path_ + "/catalog", 0600);
+    ASSERT_FALSE(catalog_path.empty());
+    ASSERT_TRUE(zlib::DecompressPath2Path(object_path, catalog_path));
+    // The parent stores the size of the uncompressed catalog
+    if (!path.empty())
+      EXPECT_EQ(size, static_cast<uint64_t>(GetFileSize(catalog_path)));
+    UniquePtr<Catalog> catalog(
+      Catalog::AttachFreely(path, catalog_path, hash));
+    unlink(catalog_path.c_str());
+    ASSERT_TRUE(catalog.IsValid()) << path;
+
+    (*hashes)[path] = hash;
+    (*previous)[path] = catalog->GetPreviousRevision();
+    // The reference from the parent points to the catalog of this directory
+    DirectoryEntry dirent;
+    ASSERT_TRUE(catalog->LookupPath(PathString(path), &dirent)) << path;
+    if (!path.empty()) {
+      EXPECT_TRUE(dirent.IsNestedCatalogRoot()) << path;
+      EXPECT_TRUE(catalog->LookupPath(PathString(path + "/file0"), &dirent))
+        << path;
+    }
+
+    const Catalog::NestedCatalogList nested = catalog->ListOwnNestedCatalogs();
+    for (unsigned i = 0; i < nested.size(); ++i) {
+      const string nested_path = nested[i].mountpoint.ToString();
+      EXPECT_EQ(path, GetParentPath(nested_path));
+      CheckCatalog(nested_path, nested[i].hash, nested[i].size,
+                   hashes, previous);
+    }
+  }
+
+  string tmp_path_;
+  string repo_path_;
+  perf::Statistics statistics_;
+  download::DownloadManager download_manager_;
+  UniquePtr<upload::Spooler> spooler_;
+  UniquePtr<manifest::Manifest> manifest_;
+};
+
+
+TEST_F(T_WritableCatalogManager, CommitNestedTree) {
+  const shash::Any empty_root = manifest_->catalog_hash();
+  perf::Statistics statistics;
+  UniquePtr<WritableCatalogManager> catalog_mgr(
+    NewCatalogManager(&statistics));
+  catalog_mgr->num_finalizer_threads_ = 8;
+  AddFiles(catalog_mgr.weak_ref(), "", "file");
+  const vector<string> mountpoints = AddNestedTree(catalog_mgr.weak_ref());
+  EXPECT_EQ(kFanOut + kFanOut * kFanOut + kFanOut * kFanOut * kFanOut,
+            mountpoints.size());
+  ASSERT_TRUE(Commit(catalog_mgr.weak_ref(), false));
+  EXPECT_EQ(static_cast<int>(mountpoints.size()) + 1,
+            catalog_mgr->GetNumCatalogs());
+
+  map<string, shash::Any> hashes;
+  map<string, shash::Any> previous;
+  CheckTree(&hashes, &previous);
+  EXPECT_EQ(mountpoints.size() + 1, hashes.size());
+  for (unsigned i = 0; i < mountpoints.size(); ++i)
+    EXPECT_EQ(1U, hashes.count("/" + mountpoints[i])) << mountpoints[i];
+  EXPECT_EQ(empty_root, previous[""]);
+}
+
+
+TEST_F(T_WritableCatalogManager, CommitPartialTree) {
+  perf::Statistics statistics;
+  UniquePtr<WritableCatalogManager> catalog_mgr(
+    NewCatalogManager(&statistics));
+  AddNestedTree(catalog_mgr.weak_ref());
+  ASSERT_TRUE(Commit(catalog_mgr.weak_ref(), false));
+  map<string, shash::Any> hashes_before;
+  map<string, shash::Any> previous;
+  CheckTree(&hashes_before, &previous);
+
+  for (unsigned num_threads = 1; num_threads <= 16; num_threads *= 4) {
+    perf::Statistics statistics_update;
+    UniquePtr<WritableCatalogManager> catalog_mgr_update(
+      NewCatalogManager(&statistics_update));
+    catalog_mgr_update->num_finalizer_threads_ = num_threads;
+    // Touches a few leafs in separate subtrees and one inner catalog
+    const string prefix = "new" + StringifyInt(num_threads) + "_";
+    AddFiles(catalog_mgr_update.weak_ref(), "d0/d1/d2", prefix);
+    AddFiles(catalog_mgr_update.weak_ref(), "d0/d3/d0", prefix);
+    AddFiles(catalog_mgr_update.weak_ref(), "d2/d2/d3", prefix);
+    AddFiles(catalog_mgr_update.weak_ref(), "d3/d1", prefix);
+    ASSERT_TRUE(Commit(catalog_mgr_update.weak_ref(), false));
+
+    map<string, shash::Any> hashes_after;
+    CheckTree(&hashes_after, &previous);
+    ASSERT_EQ(hashes_before.size(), hashes_after.size());
+    const char *dirty[] = {"", "/d0", "/d0/d1", "/d0/d1/d2", "/d0/d3",
+                           "/d0/d3/d0", "/d2", "/d2/d2", "/d2/d2/d3", "/d3",
+                           "/d3/d1"};
+    const unsigned num_dirty = sizeof(dirty) / sizeof(dirty[0]);
+    for (map<string, shash::Any>::const_iterator i = hashes_after.begin(),
+         iEnd = hashes_after.end(); i != iEnd; ++i)
+    {
+      bool is_dirty = false;
+      for (unsigned d = 0; d < num_dirty; ++d)
+        is_dirty = is_dirty || (i->first == dirty[d]);
+      if (is_dirty) {
+        EXPECT_NE(hashes_before[i->first], i->second) << i->first;
+        EXPECT_EQ(hashes_before[i->first], previous[i->first]) << i->first;
+      } else {
+        EXPECT_EQ(hashes_before[i->first], i->second) << i->first;
+      }
+    }
+    hashes_before = hashes_after;
+  }
+}
+
+
+TEST_F(T_WritableCatalogManager, CommitStopForTweaks) {
+  perf::Statistics statistics;
+  UniquePtr<WritableCatalogManager> catalog_mgr(
+    NewCatalogManager(&statistics));
+  const vector<string> mountpoints = AddNestedTree(catalog_mgr.weak_ref());
+
+  // Every finalized catalog waits for one line on stdin
+  int pipe_tweaks[2];
+  MakePipe(pipe_tweaks);
+  const string lines(mountpoints.size() + 1, '\n');
+  WritePipe(pipe_tweaks[1], lines.data(), lines.length());
+  close(pipe_tweaks[1]);
+  const int fd_stdin = dup(0);
+  ASSERT_GE(fd_stdin, 0);
+  ASSERT_EQ(0, dup2(pipe_tweaks[0], 0));
+  close(pipe_tweaks[0]);
+
+  const bool retval = Commit(catalog_mgr.weak_ref(), true);
+  const int next_char = getchar();
+  clearerr(stdin);
+  ASSERT_EQ(0, dup2(fd_stdin, 0));
+  close(fd_stdin);
+  ASSERT_TRUE(retval);
+  // All the lines are consumed
+  EXPECT_EQ(EOF, next_char);
+
+  map<string, shash::Any> hashes;
+  map<string, shash::Any> previous;
+  CheckTree(&hashes, &previous);
+  EXPECT_EQ(mountpoints.size() + 1, hashes.size());
+}
+
+}  // namespace catalog
@@ -6,6 +6,7 @@
 
 #include "catalog_counters.h"
 #include "catalog_sql.h"
+#include "compression.h"
 #include "util/posix.h"
 #include "util/string.h"
 
@@ -193,3 +194,59 @@ TEST_F(T_CatalogSql, SchemaMigration) {
     EXPECT_EQ(0, sql9.RetrieveInt(0));
   }
 }
+
+
+TEST_F(T_CatalogSql, CompressionSchema) {
+  string path;
+  FILE *ftmp = CreateTempFile("./cvmfs_ut_catalog_sql", 0600, "w+", &path);
+  ASSERT_TRUE(ftmp != NULL);
+  fclose(ftmp);
+  UnlinkGuard unlink_guard(path);
+
+  const float kSchema25 = catalog::CatalogDatabase::kLatestSchema;
+  const float kSchema26 = catalog::CatalogDatabase::kCompressionSchema;
+  const int zstd_flags = catalog::SqlDirent::kFlagFile |
+    (zlib::kZstd << catalog::SqlDirent::kFlagPosCompression);
+  const int zlib_flags = catalog::SqlDirent::kFlagFile |
+    (zlib::kZlibDefault << catalog::SqlDirent::kFlagPosCompression);
+
+  {
+    UniquePtr<catalog::CatalogDatabase>
+      db(catalog::CatalogDatabase::Create(path));
+    ASSERT_TRUE(db.IsValid());
+    EXPECT_TRUE(db->IsEqualSchema(db->schema_version(), kSchema25));
+    ASSERT_TRUE(sqlite::Sql(db->sqlite_db(),
+      "INSERT INTO catalog (md5path_1, md5path_2, parent_1, parent_2, flags) "
+      "VALUES (1, 1, 0, 0, " + StringifyInt(zlib_flags) + ");").Execute());
+    EXPECT_TRUE(db->UpdateCompressionSchema());
+    EXPECT_TRUE(db->IsEqualSchema(db->schema_version(), kSchema25));
+
+    ASSERT_TRUE(sqlite::Sql(db->sqlite_db(),
+      "INSERT INTO catalog (md5path_1, md5path_2, parent_1, parent_2, flags) "
+      "VALUES (2, 2, 0, 0, " + StringifyInt(zstd_flags) + ");").Execute());
+    EXPECT_TRUE(db->UpdateCompressionSchema());
+    EXPECT_TRUE(db->IsEqualSchema(db->schema_version(), kSchema26));
+  }
+
+  // Supported by this version, the schema survives reopening
+  {
+    UniquePtr<catalog::CatalogDatabase> db(catalog::CatalogDatabase::Open(
+      path, catalog::CatalogDatabase::kOpenReadWrite));
+    ASSERT_TRUE(db.IsValid());
+    EXPECT_TRUE(db->IsEqualSchema(db->schema_version(), kSchema26));
+    EXPECT_EQ(catalog::CatalogDatabase::kLatestSchemaRevision,
+              db->schema_revision());
+
+    ASSERT_TRUE(sqlite::Sql(db->sqlite_db(),
+      "DELETE FROM catalog WHERE md5path_1=2;").Execute());
+    EXPECT_TRUE(db->UpdateCompressionSchema());
+    EXPECT_TRUE(db->IsEqualSchema(db->schema_version(), kSchema25));
+  }
+
+  {
+    UniquePtr<catalog::CatalogDatabase> db(catalog::CatalogDatabase::Open(
+      path, catalog::CatalogDatabase::kOpenReadOnly));
+    ASSERT_TRUE(db.IsValid());
+    EXPECT_TRUE(db->IsEqualSchema(db->schema_version(), kSchema25));
+  }
+}
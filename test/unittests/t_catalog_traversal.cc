@@ -2912,3 +2912,80 @@ TEST_F(T_CatalogTraversal, TraverseNamedSnapshotsWithoutHistory) {
   CheckCatalogSequence(
     catalogs, TraverseNamedSnapshotsWithoutHistory_visited_catalogs);
 }
+
+
+//------------------------------------------------------------------------------
+
+
+CatalogIdentifiers PrefetchedTraversal_visited_catalogs;
+void PrefetchedTraversalCallback(
+  const MockedCatalogTraversal::CallbackDataTN &data)
+{
+  PrefetchedTraversal_visited_catalogs.push_back(
+    std::make_pair(data.catalog->GetRevision(),
+                   data.catalog->mountpoint().ToString()));
+}
+
+TEST_F(T_CatalogTraversal, PrefetchedTraversal) {
+  const MockedCatalogTraversal::TraversalType types[] = {
+    MockedCatalogTraversal::kBreadthFirstTraversal,
+    MockedCatalogTraversal::kDepthFirstTraversal
+  };
+
+  for (unsigned i = 0; i < 2; ++i) {
+    for (unsigned no_repeat = 0; no_repeat < 2; ++no_repeat) {
+      TraversalParams params = GetBasicTraversalParams();
+      params.history           = TraversalParams::kFullHistory;
+      params.no_repeat_history = (no_repeat > 0);
+
+      PrefetchedTraversal_visited_catalogs.clear();
+      MockedCatalogTraversal sequential(params);
+      sequential.RegisterListener(&PrefetchedTraversalCallback);
+      EXPECT_TRUE(sequential.Traverse(types[i]));
+      EXPECT_TRUE(sequential.TraverseNamedSnapshots(types[i]));
+      const CatalogIdentifiers catalogs = PrefetchedTraversal_visited_catalogs;
+
+      // the prefetch threads must not change the order of the callbacks
+      params.num_threads = 4;
+      PrefetchedTraversal_visited_catalogs.clear();
+      MockedCatalogTraversal prefetched(params);
+      prefetched.RegisterListener(&PrefetchedTraversalCallback);
+      EXPECT_TRUE(prefetched.Traverse(types[i]));
+      EXPECT_TRUE(prefetched.TraverseNamedSnapshots(types[i]));
+
+      CheckCatalogSequence(catalogs, PrefetchedTraversal_visited_catalogs);
+      EXPECT_EQ(initial_catalog_instances, MockCatalog::instances);
+    }
+  }
+}
+
+
+TEST_F(T_CatalogTraversal, PrefetchedTraversalUnavailableCatalogs) {
+  std::set<shash::Any> deleted_catalogs;
+  deleted_catalogs.insert(GetRootHash(3));
+  deleted_catalogs.insert(GetCatalog(4, "/00/12/26")->hash());
+  MockCatalog::s_deleted_objects = &deleted_catalogs;
+
+  TraversalParams params = GetBasicTraversalParams();
+  params.history             = TraversalParams::kFullHistory;
+  params.ignore_load_failure = true;
+  params.quiet               = true;
+
+  PrefetchedTraversal_visited_catalogs.clear();
+  MockedCatalogTraversal sequential(params);
+  sequential.RegisterListener(&PrefetchedTraversalCallback);
+  const bool t1 = sequential.Traverse();
+  const CatalogIdentifiers catalogs = PrefetchedTraversal_visited_catalogs;
+
+  params.num_threads = 2;
+  PrefetchedTraversal_visited_catalogs.clear();
+  MockedCatalogTraversal prefetched(params);
+  prefetched.RegisterListener(&PrefetchedTraversalCallback);
+  const bool t2 = prefetched.Traverse();
+
+  // missing catalogs are skipped in both cases
+  EXPECT_TRUE(t1);
+  EXPECT_TRUE(t2);
+  CheckCatalogSequence(catalogs, PrefetchedTraversal_visited_catalogs);
+  EXPECT_EQ(initial_catalog_instances, MockCatalog::instances);
+}
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "file_processing/char_buffer.h"
@@ -309,4 +311,135 @@ TEST_F(T_ChunkDetectors, Xor32ChunkDetectorZerosBufferPowerOfTwo) {
   }
 }
 
+
+TEST_F(T_ChunkDetectors, Gear) {
+  GearDetector gear_detector(64, 128, 256);
+
+  EXPECT_EQ(0xE000000000000000ULL, GearDetector::MakeMask(3));
+  EXPECT_EQ(0x8000000000000000ULL, GearDetector::MakeMask(1));
+  EXPECT_EQ(0xFFFFFFFFFFFFFFFEULL, GearDetector::MakeMask(63));
+
+  gear_detector.gear(42);
+  EXPECT_EQ(GearDetector::gear_table_[42], gear_detector.gear_);
+
+  // the gear hash only depends on the last 64 bytes
+  Prng prng;
+  prng.InitSeed(42);
+  for (unsigned i = 0; i < 100; ++i)
+    gear_detector.gear(static_cast<unsigned char>(prng.Next(256)));
+  GearDetector other_detector(64, 128, 256);
+  for (unsigned i = 0; i < 10; ++i)
+    other_detector.gear(static_cast<unsigned char>(prng.Next(256)));
+  prng.InitSeed(1);
+  for (unsigned i = 0; i < GearDetector::gear_influence; ++i) {
+    const unsigned char byte = static_cast<unsigned char>(prng.Next(256));
+    gear_detector.gear(byte);
+    other_detector.gear(byte);
+  }
+  EXPECT_EQ(gear_detector.gear_, other_detector.gear_);
+}
+
+
+TEST_F(T_ChunkDetectors, GearChunkDetectorSlow) {
+  const size_t base = 512000;
+  const size_t min_chk_size = base;
+  const size_t avg_chk_size = base * 2;
+  const size_t max_chk_size = base * 4;
+  GearDetector gear_detector(min_chk_size, avg_chk_size, max_chk_size);
+
+  EXPECT_FALSE(gear_detector.MightFindChunks(0));
+  EXPECT_FALSE(gear_detector.MightFindChunks(base));
+  EXPECT_TRUE(gear_detector.MightFindChunks(base + 1));
+
+  std::vector<size_t> buffer_sizes;
+  buffer_sizes.push_back(102400);    // 100kB
+  buffer_sizes.push_back(base);      // same as minimal chunk size
+  buffer_sizes.push_back(base * 2);  // same as average chunk size
+  buffer_sizes.push_back(10485760);  // 10MB
+
+  // the cut marks must not depend on the buffer size
+  std::vector<off_t> expected;
+  std::vector<size_t>::const_iterator i    = buffer_sizes.begin();
+  std::vector<size_t>::const_iterator iend = buffer_sizes.end();
+  for (; i != iend; ++i) {
+    CreateBuffers(*i);
+
+    GearDetector detector(min_chk_size, avg_chk_size, max_chk_size);
+    std::vector<off_t> cut_marks;
+    off_t next_cut = 0;
+    off_t last_cut = 0;
+    Buffers::const_iterator j    = buffers_.begin();
+    Buffers::const_iterator jend = buffers_.end();
+    for (; j != jend; ++j) {
+      while ((next_cut = detector.FindNextCutMark(*j)) != 0) {
+        const size_t chunk_size = next_cut - last_cut;
+        ASSERT_GE(max_chk_size, chunk_size)
+          << "too large chunk with buffer size " << *i << " bytes...";
+        ASSERT_LE(min_chk_size, chunk_size)
+          << "too small chunk with buffer size " << *i << " bytes...";
+        cut_marks.push_back(next_cut);
+        last_cut = next_cut;
+      }
+    }
+
+    if (expected.empty()) {
+      expected = cut_marks;
+      // normalized chunking keeps the chunk sizes close to the average
+      const size_t mean_chunk_size = last_cut / expected.size();
+      EXPECT_LE(avg_chk_size * 3 / 4, mean_chunk_size);
+      EXPECT_GE(avg_chk_size * 3 / 2, mean_chunk_size);
+    } else {
+      EXPECT_EQ(expected, cut_marks)
+        << "unexpected cut marks with buffer size " << *i << " bytes...";
+    }
+  }
+}
+
+
+TEST_F(T_ChunkDetectors, GearChunkDetectorResync) {
+  // Inserting data shifts the cut marks after the insertion but does not
+  // change them otherwise
+  const size_t base = 16384;
+  const size_t size = 8 * 1024 * 1024;
+  const size_t insert_at = size / 2;
+  const size_t insert_size = 1000;
+  Prng prng;
+  prng.InitSeed(42);
+  std::vector<unsigned char> data(size);
+  for (size_t i = 0; i < size; ++i)
+    data[i] = static_cast<unsigned char>(prng.Next(256));
+  std::vector<unsigned char> modified(data.begin(), data.begin() + insert_at);
+  for (size_t i = 0; i < insert_size; ++i)
+    modified.push_back(static_cast<unsigned char>(prng.Next(256)));
+  modified.insert(modified.end(), data.begin() + insert_at, data.end());
+
+  std::vector<off_t> cut_marks[2];
+  const std::vector<unsigned char> *inputs[2] = {&data, &modified};
+  for (unsigned k = 0; k < 2; ++k) {
+    GearDetector detector(base, base * 4, base * 16);
+    CharBuffer buffer(inputs[k]->size());
+    memcpy(buffer.ptr(), &(*inputs[k])[0], inputs[k]->size());
+    buffer.SetUsedBytes(inputs[k]->size());
+    off_t next_cut;
+    while ((next_cut = detector.FindNextCutMark(&buffer)) != 0)
+      cut_marks[k].push_back(next_cut);
+  }
+
+  unsigned identical = 0;
+  unsigned shifted = 0;
+  for (unsigned i = 0; i < cut_marks[0].size(); ++i) {
+    const off_t cut = cut_marks[0][i];
+    const off_t moved = (cut < static_cast<off_t>(insert_at)) ?
+                        cut : cut + static_cast<off_t>(insert_size);
+    if (std::find(cut_marks[1].begin(), cut_marks[1].end(), moved) !=
+        cut_marks[1].end())
+    {
+      (cut < static_cast<off_t>(insert_at)) ? ++identical : ++shifted;
+    }
+  }
+  EXPECT_LT(100U, cut_marks[0].size());
+  // at most two chunks are affected by the insertion
+  EXPECT_LE(cut_marks[0].size() - 2, identical + shifted);
+}
+
 }  // namespace upload
@@ -5,13 +5,30 @@
 #include "gtest/gtest.h"
 
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "compression.h"
+#include "smalloc.h"
 #include "util/pointer.h"
+#include "util/string.h"
 
 // TODO(jblomer): typed tests
 
 namespace zlib {
 
+class StringSink : public cvmfs::Sink {
+ public:
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    data.append(static_cast<const char *>(buf), sz);
+    return sz;
+  }
+  virtual int Reset() { data.clear(); return 0; }
+  std::string data;
+};
+
+
 // Test fixture that creates data structures necessary to test Compressor
 class T_Compressor : public ::testing::Test {
  protected:
@@ -45,6 +62,81 @@ class T_Compressor : public ::testing::Test {
 
   unsigned char *long_string;
   size_t long_size;
+
+  /**
+   * Compresses long_string in pieces of buf_size bytes and checks that the
+   * result decompresses to the original.
+   */
+  void CompressLong(const Algorithms alg) {
+    compressor = zlib::Compressor::Construct(alg);
+    for (unsigned i = 0; i < long_size; ++i)
+      long_string[i] = (i / 1024) % 7;
+    unsigned char *compress_buf =
+      new unsigned char[compressor->DeflateBound(long_size)];
+    unsigned compress_pos = 0;
+    bool deflate_finished = false;
+    unsigned char *input = long_string;
+    size_t remaining = long_size;
+    unsigned rounds = 0;
+
+    while (!deflate_finished) {
+      buf_size = 100;
+      deflate_finished =
+        compressor->Deflate(true, &input, &remaining, &buf, &buf_size);
+      memcpy(compress_buf + compress_pos, buf, buf_size);
+      compress_pos += buf_size;
+      rounds++;
+    }
+
+    EXPECT_GT(rounds, 1U);
+    EXPECT_GT(compress_pos, 0U);
+    EXPECT_LT(compress_pos, long_size);
+    ASSERT_EQ(0U, remaining);
+
+    char *decompress_buf;
+    uint64_t decompress_size;
+    bool retval = DecompressMem2Mem(compress_buf, compress_pos,
+      reinterpret_cast<void **>(&decompress_buf), &decompress_size, alg);
+    EXPECT_TRUE(retval);
+    EXPECT_EQ(static_cast<uint64_t>(long_size), decompress_size);
+    EXPECT_EQ(0, memcmp(decompress_buf, long_string, long_size));
+
+    delete[] compress_buf;
+    free(decompress_buf);
+  }
+
+  /**
+   * Clones the compressor in the middle of the stream, both copies have to
+   * produce the same output.
+   */
+  void CompressClone(const Algorithms alg) {
+    compressor = zlib::Compressor::Construct(alg);
+    const size_t size = 3 * FrameCompressor::kFrameSize / 2;
+    for (unsigned i = 0; i < long_size; ++i)
+      long_string[i] = i % 13;
+    unsigned char *input = long_string;
+    size_t remaining = size / 2;
+    unsigned char *out = new unsigned char[compressor->DeflateBound(size)];
+    size_t out_size = compressor->DeflateBound(size);
+    EXPECT_TRUE(
+      compressor->Deflate(false, &input, &remaining, &out, &out_size));
+    EXPECT_EQ(0U, remaining);
+
+    UniquePtr<Compressor> clone(compressor->Clone());
+    std::string results[2];
+    Compressor *compressors[2] = {compressor.weak_ref(), clone.weak_ref()};
+    for (unsigned i = 0; i < 2; ++i) {
+      unsigned char *rest_input = input;
+      size_t rest_remaining = size - size / 2;
+      unsigned char *rest_out = out;
+      size_t rest_out_size = compressors[i]->DeflateBound(rest_remaining);
+      EXPECT_TRUE(compressors[i]->Deflate(
+        true, &rest_input, &rest_remaining, &rest_out, &rest_out_size));
+      results[i] = std::string(reinterpret_cast<char *>(out), rest_out_size);
+    }
+    EXPECT_EQ(results[0], results[1]);
+    delete[] out;
+  }
 };
 
 
@@ -154,4 +246,222 @@ TEST_F(T_Compressor, EchoCompressionLong) {
   EXPECT_EQ(0, memcmp(compress_buf.weak_ref(), long_string, long_size));
 }
 
+
+TEST_F(T_Compressor, ZstdCompression) {
+  compressor = zlib::Compressor::Construct(zlib::kZstd);
+
+  unsigned char *input = reinterpret_cast<unsigned char *>(ptr_test_string);
+  bool deflate_finished =
+    compressor->Deflate(true, &input, &size_input, &buf, &buf_size);
+
+  ASSERT_TRUE(deflate_finished);
+  ASSERT_GT(buf_size, 0U);
+  ASSERT_EQ(0U, size_input);
+
+  char *decompress_buf;
+  uint64_t decompress_size;
+  EXPECT_TRUE(DecompressMem2Mem(buf, buf_size,
+    reinterpret_cast<void **>(&decompress_buf), &decompress_size, kZstd));
+  ASSERT_EQ(0, strcmp(decompress_buf, test_string));
+  free(decompress_buf);
+
+  // Not a zstd stream
+  EXPECT_FALSE(DecompressMem2Mem(test_string, strlen(test_string),
+    reinterpret_cast<void **>(&decompress_buf), &decompress_size, kZstd));
+}
+
+
+TEST_F(T_Compressor, ZstdCompressionLong) {
+  CompressLong(zlib::kZstd);
+}
+
+
+TEST_F(T_Compressor, ZstdClone) {
+  CompressClone(zlib::kZstd);
+}
+
+
+TEST_F(T_Compressor, Lz4Compression) {
+  compressor = zlib::Compressor::Construct(zlib::kLz4);
+
+  unsigned char *input = reinterpret_cast<unsigned char *>(ptr_test_string);
+  bool deflate_finished =
+    compressor->Deflate(true, &input, &size_input, &buf, &buf_size);
+
+  ASSERT_TRUE(deflate_finished);
+  ASSERT_GT(buf_size, 0U);
+  ASSERT_EQ(0U, size_input);
+
+  char *decompress_buf;
+  uint64_t decompress_size;
+  EXPECT_TRUE(DecompressMem2Mem(buf, buf_size,
+    reinterpret_cast<void **>(&decompress_buf), &decompress_size, kLz4));
+  ASSERT_EQ(0, strcmp(decompress_buf, test_string));
+  free(decompress_buf);
+}
+
+
+TEST_F(T_Compressor, Lz4CompressionLong) {
+  CompressLong(zlib::kLz4);
+}
+
+
+TEST_F(T_Compressor, Lz4Clone) {
+  CompressClone(zlib::kLz4);
+}
+
+
+TEST_F(T_Compressor, StreamingDecompressor) {
+  Algorithms algorithms[] = {kZlibDefault, kNoCompression, kZstd, kLz4};
+  for (unsigned a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); ++a) {
+    for (unsigned i = 0; i < long_size; ++i)
+      long_string[i] = i % 251;
+    const size_t size = 1024 * 1024;
+    void *compressed;
+    uint64_t compressed_size;
+    EXPECT_TRUE(CompressMem2Mem(long_string, size,
+                                &compressed, &compressed_size, algorithms[a]));
+
+    // Feed the decompressor byte-wise at the beginning, then in large pieces
+    UniquePtr<Decompressor> decompressor(
+      Decompressor::Construct(algorithms[a]));
+    StringSink sink;
+    unsigned char *pos = static_cast<unsigned char *>(compressed);
+    uint64_t left = compressed_size;
+    StreamStates state = kStreamContinue;
+    for (unsigned i = 0; (i < 64) && (left > 1); ++i, ++pos, --left)
+      state = decompressor->Inflate(pos, 1, &sink);
+    EXPECT_NE(kStreamDataError, state);
+    while (left > 0) {
+      const uint64_t piece = std::min(left, static_cast<uint64_t>(10000));
+      state = decompressor->Inflate(pos, piece, &sink);
+      EXPECT_NE(kStreamDataError, state);
+      pos += piece;
+      left -= piece;
+    }
+    EXPECT_EQ(kStreamEnd, state) << AlgorithmName(algorithms[a]);
+    EXPECT_EQ(size, sink.data.size());
+    EXPECT_EQ(0, memcmp(sink.data.data(), long_string, size));
+    free(compressed);
+  }
+}
+
+
+TEST_F(T_Compressor, ZstdDictionary) {
+  // Small, similar text files
+  std::vector<std::string> samples;
+  for (unsigned i = 0; i < 2000; ++i) {
+    samples.push_back(
+      "#include <stdio.h>\n\nint function_" + StringifyInt(i) +
+      "(int argc, char **argv) {\n  printf(\"Hello World " +
+      StringifyInt(i * 7) + "\\n\");\n  return " + StringifyInt(i % 3) +
+      ";\n}\n");
+  }
+  std::string dictionary_buf;
+  ASSERT_TRUE(Dictionary::Train(samples, 4096, &dictionary_buf));
+  EXPECT_GT(dictionary_buf.size(), 0U);
+  EXPECT_LE(dictionary_buf.size(), 4096U);
+  EXPECT_EQ(NULL, Dictionary::Create("abc", 3, ZstdCompressor::kDefaultLevel));
+  Dictionary *dictionary = Dictionary::Create(
+    dictionary_buf.data(), dictionary_buf.size(),
+    ZstdCompressor::kDefaultLevel);
+  ASSERT_TRUE(dictionary != NULL);
+  const uint32_t dictionary_id = dictionary->id();
+
+  const std::string input =
+    "#include <stdio.h>\n\nint function_4242(int argc, char **argv) {\n"
+    "  printf(\"Hello World 31\\n\");\n  return 2;\n}\n";
+  void *plain;
+  uint64_t plain_size;
+  EXPECT_TRUE(CompressMem2Mem(input.data(), input.size(),
+                              &plain, &plain_size, kZstd));
+
+  UniquePtr<Compressor> dict_compressor(Compressor::Construct(kZstd));
+  dict_compressor->SetDictionary(dictionary);
+  const uint64_t compressed_bound = dict_compressor->DeflateBound(input.size());
+  void *compressed = smalloc(compressed_bound);
+  uint64_t compressed_size = 0;
+  unsigned char *dict_input =
+    reinterpret_cast<unsigned char *>(const_cast<char *>(input.data()));
+  size_t dict_remaining = input.size();
+  bool dict_done = false;
+  while (!dict_done) {
+    unsigned char *out = static_cast<unsigned char *>(compressed) +
+                         compressed_size;
+    size_t out_size = compressed_bound - compressed_size;
+    dict_done = dict_compressor->Deflate(true, &dict_input, &dict_remaining,
+                                         &out, &out_size);
+    compressed_size += out_size;
+  }
+  EXPECT_LT(compressed_size, plain_size);
+
+  // Dictionary unknown to the decompressor
+  void *decompressed;
+  uint64_t decompressed_size;
+  EXPECT_FALSE(DecompressMem2Mem(compressed, compressed_size,
+                                 &decompressed, &decompressed_size, kZstd));
+
+  Dictionary::Register(dictionary);
+  EXPECT_EQ(dictionary, Dictionary::Find(dictionary_id));
+  EXPECT_TRUE(DecompressMem2Mem(compressed, compressed_size,
+                                &decompressed, &decompressed_size, kZstd));
+  EXPECT_EQ(input, std::string(static_cast<char *>(decompressed),
+                               decompressed_size));
+  free(decompressed);
+
+  // Byte-wise, followed by a frame without dictionary
+  UniquePtr<Decompressor> decompressor(Decompressor::Construct(kZstd));
+  StringSink sink;
+  StreamStates state = kStreamContinue;
+  for (unsigned i = 0; i < compressed_size; ++i) {
+    state = decompressor->Inflate(static_cast<char *>(compressed) + i, 1,
+                                  &sink);
+    EXPECT_NE(kStreamDataError, state);
+  }
+  EXPECT_EQ(kStreamEnd, state);
+  EXPECT_EQ(kStreamEnd, decompressor->Inflate(plain, plain_size, &sink));
+  EXPECT_EQ(input + input, sink.data);
+
+  free(compressed);
+  free(plain);
+}
+
+
+TEST_F(T_Compressor, ParseCompressionAlgorithm) {
+  EXPECT_EQ(kZlibDefault, ParseCompressionAlgorithm("default"));
+  EXPECT_EQ(kZlibDefault, ParseCompressionAlgorithm("zlib"));
+  EXPECT_EQ(kNoCompression, ParseCompressionAlgorithm("none"));
+  EXPECT_EQ(kZstd, ParseCompressionAlgorithm("zstd"));
+  EXPECT_EQ(kLz4, ParseCompressionAlgorithm("lz4"));
+
+  int level = -1;
+  EXPECT_EQ(kZstd, ParseCompressionAlgorithm("zstd", &level));
+  EXPECT_EQ(0, level);
+  EXPECT_EQ(kZstd, ParseCompressionAlgorithm("zstd:9", &level));
+  EXPECT_EQ(9, level);
+  EXPECT_EQ(kZlibDefault, ParseCompressionAlgorithm("zlib", &level));
+  EXPECT_EQ(0, level);
+
+  EXPECT_EQ("zstd", AlgorithmName(kZstd));
+  EXPECT_EQ("lz4", AlgorithmName(kLz4));
+}
+
+
+TEST_F(T_Compressor, UnsupportedAlgorithm) {
+  EXPECT_TRUE(IsSupportedAlgorithm(kZlibDefault));
+  EXPECT_TRUE(IsSupportedAlgorithm(kNoCompression));
+  EXPECT_TRUE(IsSupportedAlgorithm(kZstd));
+  EXPECT_TRUE(IsSupportedAlgorithm(kLz4));
+  const Algorithms unknown = static_cast<Algorithms>(kLz4 + 1);
+  EXPECT_FALSE(IsSupportedAlgorithm(unknown));
+
+  const char input[] = "not compressed";
+  void *out_buf = NULL;
+  uint64_t out_size = 1;
+  EXPECT_FALSE(DecompressMem2Mem(input, sizeof(input), &out_buf, &out_size,
+                                 unknown));
+  EXPECT_EQ(NULL, out_buf);
+  EXPECT_EQ(0U, out_size);
+}
+
 }  // end namespace zlib
@@ -7,8 +7,12 @@
 #include <unistd.h>
 
 #include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "compression.h"
+#include "dns.h"
 #include "download.h"
 #include "hash.h"
 #include "prng.h"
@@ -147,6 +151,97 @@ TEST_F(T_Download, Multiple) {
 }
 
 
+TEST_F(T_Download, ConnectionWarmup) {
+  string repo_path = CreateTempDir(GetCurrentWorkingDirectory() +
+                                   "/cvmfs_ut_download");
+  ASSERT_FALSE(repo_path.empty());
+  ASSERT_TRUE(SafeWriteToFile("manifest", repo_path + "/.cvmfspublished",
+                              0600));
+
+  DownloadManager warm_mgr;
+  warm_mgr.Init(8, false, /* use_system_proxy */ &statistics, "warm");
+  warm_mgr.SetHostChain("file://" + repo_path);
+  warm_mgr.SetConnectionWarmup(4);
+  warm_mgr.Spawn();
+
+  // Warm-up requests are sent by the I/O thread without a waiting caller
+  perf::Counter *n_requests = statistics.Lookup("warm.n_requests");
+  for (unsigned i = 0; (i < 100) && (n_requests->Get() < 4); ++i)
+    SafeSleepMs(50);
+  EXPECT_EQ(4, n_requests->Get());
+
+  // Regular requests are not affected
+  JobInfo info(&foo_url, false /* compressed */, false /* probe hosts */,
+               NULL);
+  warm_mgr.Fetch(&info);
+  EXPECT_EQ(kFailOk, info.error_code);
+  EXPECT_EQ(5, n_requests->Get());
+  free(info.destination_mem.data);
+
+  warm_mgr.Fini();
+  unlink((repo_path + "/.cvmfspublished").c_str());
+  rmdir(repo_path.c_str());
+}
+
+
+TEST_F(T_Download, ConnectionWarmupFailure) {
+  DownloadManager warm_mgr;
+  warm_mgr.Init(8, false, /* use_system_proxy */ &statistics, "warm_fail");
+  // Nothing listens on port 1
+  warm_mgr.SetHostChain("http://127.0.0.1:1/cvmfs/a;"
+                        "http://127.0.0.1:1/cvmfs/b");
+  warm_mgr.SetProxyChain("http://127.0.0.1:1;http://127.0.0.2:1", "",
+                         DownloadManager::kSetProxyRegular);
+  warm_mgr.SetConnectionWarmup(4);
+  warm_mgr.Spawn();
+
+  // Failed warm-up requests are neither retried nor trigger a fail-over
+  perf::Counter *n_requests = statistics.Lookup("warm_fail.n_requests");
+  for (unsigned i = 0; (i < 100) && (n_requests->Get() < 4); ++i)
+    SafeSleepMs(50);
+  SafeSleepMs(200);
+  EXPECT_EQ(4, n_requests->Get());
+  EXPECT_EQ(0, statistics.Lookup("warm_fail.n_retries")->Get());
+  EXPECT_EQ(0, statistics.Lookup("warm_fail.n_proxy_failover")->Get());
+  EXPECT_EQ(0, statistics.Lookup("warm_fail.n_host_failover")->Get());
+  unsigned current_host = 1;
+  warm_mgr.GetHostInfo(NULL, NULL, &current_host);
+  EXPECT_EQ(0U, current_host);
+  vector< vector<DownloadManager::ProxyInfo> > proxy_chain;
+  unsigned current_group = 1;
+  unsigned fallback_group = 0;
+  warm_mgr.GetProxyInfo(&proxy_chain, &current_group, &fallback_group);
+  EXPECT_EQ(0U, current_group);
+
+  warm_mgr.Fini();
+}
+
+
+TEST_F(T_Download, ConnectionWarmupIdle) {
+  DownloadManager warm_mgr;
+  warm_mgr.Init(8, false, /* use_system_proxy */ &statistics, "warm_idle");
+  EXPECT_EQ(0U, warm_mgr.GetWarmupDeadline());
+
+  // Copies avoid odr-using the in-class constants
+  const uint64_t refresh = DownloadManager::kWarmupRefreshS;
+  const uint64_t max_idle = DownloadManager::kWarmupMaxIdleS;
+  warm_mgr.SetConnectionWarmup(4);
+  warm_mgr.timestamp_last_job_ = 1000;
+  warm_mgr.timestamp_warmup_ = 1000;
+  EXPECT_EQ(1000 + refresh, warm_mgr.GetWarmupDeadline());
+  // Keeps refreshing while the last transfer is recent enough
+  warm_mgr.timestamp_warmup_ = 1000 + max_idle;
+  EXPECT_EQ(1000 + max_idle + refresh, warm_mgr.GetWarmupDeadline());
+  // Stops after the maximum idle time until the next transfer
+  warm_mgr.timestamp_warmup_ = 1001 + max_idle;
+  EXPECT_EQ(0U, warm_mgr.GetWarmupDeadline());
+  warm_mgr.timestamp_last_job_ = warm_mgr.timestamp_warmup_;
+  EXPECT_EQ(1001 + max_idle + refresh, warm_mgr.GetWarmupDeadline());
+
+  warm_mgr.Fini();
+}
+
+
 TEST_F(T_Download, LocalFile2Mem) {
   string dest_path;
   FILE *fdest = CreateTemporaryFile(&dest_path);
@@ -165,6 +260,80 @@ TEST_F(T_Download, LocalFile2Mem) {
 }
 
 
+TEST_F(T_Download, LocalCompressedFile2Mem) {
+  string dest_path;
+  FILE *fdest = CreateTemporaryFile(&dest_path);
+  ASSERT_TRUE(fdest != NULL);
+  UnlinkGuard unlink_guard(dest_path);
+  string content(10000, 'x');
+  shash::Any hash(shash::kSha1);
+  EXPECT_TRUE(zlib::CompressMem2File(
+    reinterpret_cast<const unsigned char *>(content.data()), content.size(),
+    fdest, &hash));
+  fclose(fdest);
+
+  string url = "file://" + dest_path;
+  uint64_t num_misses = 0;
+  for (unsigned i = 0; i < 2; ++i) {
+    JobInfo info(&url, true /* compressed */, false /* probe hosts */, NULL);
+    download_mgr.Fetch(&info);
+    ASSERT_EQ(kFailOk, info.error_code);
+    ASSERT_EQ(content.size(), info.destination_mem.pos);
+    EXPECT_EQ(content, string(info.destination_mem.data,
+                              info.destination_mem.pos));
+    free(info.destination_mem.data);
+    if (i == 0)
+      num_misses = download_mgr.mem_pool_->num_misses();
+  }
+  // The second download reuses the receive buffers of the first one
+  EXPECT_GT(num_misses, 0U);
+  EXPECT_EQ(num_misses, download_mgr.mem_pool_->num_misses());
+  EXPECT_EQ(num_misses, download_mgr.mem_pool_->num_hits());
+  EXPECT_EQ(static_cast<int64_t>(num_misses),
+            statistics.Lookup("download.n_mem_pool_misses")->Get());
+  EXPECT_EQ(static_cast<int64_t>(num_misses),
+            statistics.Lookup("download.n_mem_pool_hits")->Get());
+}
+
+
+TEST_F(T_Download, MemBufferPool) {
+  EXPECT_EQ(MemBufferPool::kMinSize, MemBufferPool::GetCapacity(0));
+  EXPECT_EQ(MemBufferPool::kMinSize, MemBufferPool::GetCapacity(1));
+  EXPECT_EQ(2 * MemBufferPool::kMinSize,
+            MemBufferPool::GetCapacity(MemBufferPool::kMinSize + 1));
+
+  MemBufferPool pool(64 * 1024);
+  char *buf1 = pool.Get(5000);
+  char *buf2 = pool.Get(5000);
+  EXPECT_NE(buf1, buf2);
+  memset(buf1, 0, MemBufferPool::GetCapacity(5000));
+  pool.Put(buf1, 5000);
+  EXPECT_EQ(buf1, pool.Get(8192));
+  EXPECT_EQ(1U, pool.num_hits());
+  EXPECT_EQ(2U, pool.num_misses());
+  pool.Put(buf2, 5000);
+  char *small = pool.Get(100);
+  EXPECT_NE(buf2, small);
+  free(small);
+  pool.Put(buf1, 8192);
+
+  // Oversized buffers are not recycled
+  char *big = pool.Get(128 * 1024);
+  pool.Put(big, 128 * 1024);
+  EXPECT_EQ(1U, pool.num_hits());
+
+  // Only kMaxIdle buffers per size class are kept
+  std::vector<char *> buffers;
+  for (unsigned i = 0; i < MemBufferPool::kMaxIdle + 2; ++i)
+    buffers.push_back(pool.Get(100));
+  for (unsigned i = 0; i < buffers.size(); ++i)
+    pool.Put(buffers[i], 100);
+  for (unsigned i = 0; i < MemBufferPool::kMaxIdle + 2; ++i)
+    free(pool.Get(100));
+  EXPECT_EQ(1U + MemBufferPool::kMaxIdle, pool.num_hits());
+}
+
+
 TEST_F(T_Download, LocalFile2Sink) {
   string dest_path;
   FILE *fdest = CreateTemporaryFile(&dest_path);
@@ -236,6 +405,79 @@ TEST_F(T_Download, StripDirect) {
 }
 
 
+TEST_F(T_Download, RefreshProxyIps) {
+  string hosts_path;
+  FILE *fhosts = CreateTemporaryFile(&hosts_path);
+  ASSERT_TRUE(fhosts != NULL);
+  UnlinkGuard unlink_guard(hosts_path);
+  fprintf(fhosts, "127.0.0.1 proxy.cvmfs.test\n");
+  fflush(fhosts);
+
+  // A local stand-in for the DNS, also for the refresh
+  delete download_mgr.resolver_;
+  download_mgr.resolver_ = dns::HostfileResolver::Create(hosts_path, true);
+  ASSERT_TRUE(download_mgr.resolver_ != NULL);
+  delete download_mgr.refresh_resolver_;
+  download_mgr.refresh_resolver_ =
+    dns::HostfileResolver::Create(hosts_path, true);
+  ASSERT_TRUE(download_mgr.refresh_resolver_ != NULL);
+  download_mgr.refresh_resolver_generation_ = download_mgr.resolver_generation_;
+  download_mgr.SetProxyChain("http://proxy.cvmfs.test:3128", "",
+                             DownloadManager::kSetProxyRegular);
+
+  vector< vector<DownloadManager::ProxyInfo> > proxies;
+  download_mgr.GetProxyInfo(&proxies, NULL, NULL);
+  ASSERT_EQ(1U, proxies.size());
+  ASSERT_EQ(1U, proxies[0].size());
+  EXPECT_EQ("http://127.0.0.1:3128", proxies[0][0].url);
+  dns::Host host = proxies[0][0].host;
+
+  // Not close to expiry
+  EXPECT_EQ(0U, download_mgr.RefreshProxyIps(host.deadline() - 1));
+
+  // Same addresses, only the host object is exchanged
+  EXPECT_EQ(1U, download_mgr.RefreshProxyIps(host.deadline()));
+  download_mgr.GetProxyInfo(&proxies, NULL, NULL);
+  ASSERT_EQ(1U, proxies[0].size());
+  EXPECT_EQ("http://127.0.0.1:3128", proxies[0][0].url);
+  EXPECT_NE(host.id(), proxies[0][0].host.id());
+  host = proxies[0][0].host;
+
+  // Changed addresses are swapped in
+  rewind(fhosts);
+  fprintf(fhosts, "127.0.0.2 proxy.cvmfs.test\n127.0.0.3 proxy.cvmfs.test\n");
+  fflush(fhosts);
+  EXPECT_EQ(1U, download_mgr.RefreshProxyIps(host.deadline()));
+  download_mgr.GetProxyInfo(&proxies, NULL, NULL);
+  ASSERT_EQ(2U, proxies[0].size());
+  set<string> urls;
+  urls.insert(proxies[0][0].url);
+  urls.insert(proxies[0][1].url);
+  EXPECT_EQ(1U, urls.count("http://127.0.0.2:3128"));
+  EXPECT_EQ(1U, urls.count("http://127.0.0.3:3128"));
+  host = proxies[0][0].host;
+
+  // Failed name resolution keeps the existing entries
+  EXPECT_EQ(0, ftruncate(fileno(fhosts), 0));
+  EXPECT_EQ(0U, download_mgr.RefreshProxyIps(host.deadline()));
+  download_mgr.GetProxyInfo(&proxies, NULL, NULL);
+  ASSERT_EQ(2U, proxies[0].size());
+  EXPECT_EQ(host.id(), proxies[0][0].host.id());
+
+  // Changed resolver settings are picked up by the refresh
+  dns::Resolver *refresh_resolver = download_mgr.refresh_resolver_;
+  download_mgr.SetMaxIpaddrPerProxy(1);
+  download_mgr.UpdateRefreshResolver();
+  ASSERT_TRUE(download_mgr.refresh_resolver_ != NULL);
+  EXPECT_NE(refresh_resolver, download_mgr.refresh_resolver_);
+  EXPECT_EQ(1U, download_mgr.refresh_resolver_->throttle());
+  EXPECT_EQ(download_mgr.resolver_generation_,
+            download_mgr.refresh_resolver_generation_);
+
+  fclose(fhosts);
+}
+
+
 TEST_F(T_Download, ValidateGeoReply) {
   vector<uint64_t> geo_order;
   EXPECT_FALSE(download_mgr.ValidateGeoReply("", geo_order.size(), &geo_order));
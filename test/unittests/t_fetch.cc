@@ -240,6 +240,141 @@ TEST_F(T_Fetcher, ExternalFetch) {
 }
 
 
+/**
+ * Waits until the verification threads are idle.
+ */
+void TestWaitVerified(Fetcher *fetcher) {
+  pthread_mutex_lock(fetcher->lock_sparse_objects_);
+  while (true) {
+    bool verifying = !fetcher->verify_queue_.empty();
+    for (Fetcher::SparseObjects::const_iterator i =
+         fetcher->sparse_objects_.begin(),
+         iEnd = fetcher->sparse_objects_.end(); i != iEnd; ++i)
+    {
+      if (i->second.state == Fetcher::SparseObject::kVerifying)
+        verifying = true;
+    }
+    if (!verifying)
+      break;
+    pthread_cond_wait(fetcher->cond_verify_done_,
+                      fetcher->lock_sparse_objects_);
+  }
+  pthread_mutex_unlock(fetcher->lock_sparse_objects_);
+}
+
+
+TEST_F(T_Fetcher, ExternalFetchBlock) {
+  const uint64_t kBlockSize = 4096;
+  string content(2 * kBlockSize + 100, 'b');
+  for (unsigned i = 0; i < content.size(); ++i)
+    content[i] = static_cast<char>(i % 251);
+  shash::Any hash_big(shash::kSha1);
+  shash::HashString(content, &hash_big);
+  EXPECT_TRUE(CopyMem2Path(
+    reinterpret_cast<const unsigned char *>(content.data()), content.size(),
+    tmp_path_ + "/big"));
+  external_fetcher_->SetBlockSize(kBlockSize);
+
+  // The first access returns the block right away and verifies the object in
+  // the background, blocks are stored as cache objects of their own
+  int fd = external_fetcher_->FetchBlock(hash_big, content.size(), kBlockSize,
+                                         "/big", CacheManager::kTypeRegular,
+                                         "/big");
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(static_cast<int64_t>(kBlockSize), cache_mgr_->GetSize(fd));
+  char buf[kBlockSize];
+  EXPECT_EQ(static_cast<int64_t>(kBlockSize),
+            cache_mgr_->Pread(fd, buf, kBlockSize, 0));
+  EXPECT_EQ(content.substr(kBlockSize, kBlockSize), string(buf, kBlockSize));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  TestWaitVerified(external_fetcher_);
+  for (unsigned i = 0; i < 3; ++i) {
+    fd = cache_mgr_->Open(CacheManager::Bless(Fetcher::MakeBlockId(
+      hash_big, i * kBlockSize, (i < 2) ? kBlockSize : 100)));
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(0, cache_mgr_->Close(fd));
+  }
+  EXPECT_EQ(-ENOENT, cache_mgr_->Open(CacheManager::Bless(hash_big)));
+
+  // Last block is short
+  fd = external_fetcher_->FetchBlock(hash_big, content.size(), 2 * kBlockSize,
+                                     "/big", CacheManager::kTypeRegular,
+                                     "/big");
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(100, cache_mgr_->GetSize(fd));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  // A block that dropped out of the cache is checked against its digest
+  const shash::Any block_id = Fetcher::MakeBlockId(hash_big, 0, kBlockSize);
+  EXPECT_EQ(0, unlink(
+    (tmp_path_ + "/" + block_id.MakePathWithoutSuffix()).c_str()));
+  string corrupted = content;
+  corrupted[0] = ~corrupted[0];
+  EXPECT_TRUE(CopyMem2Path(
+    reinterpret_cast<const unsigned char *>(corrupted.data()),
+    corrupted.size(), tmp_path_ + "/big"));
+  EXPECT_EQ(-EIO,
+    external_fetcher_->FetchBlock(hash_big, content.size(), 0,
+                                  "/big", CacheManager::kTypeRegular, "/big"));
+  EXPECT_EQ(-ENOENT, cache_mgr_->Open(CacheManager::Bless(block_id)));
+  EXPECT_TRUE(CopyMem2Path(
+    reinterpret_cast<const unsigned char *>(content.data()), content.size(),
+    tmp_path_ + "/big"));
+  fd = external_fetcher_->FetchBlock(hash_big, content.size(), 0,
+                                     "/big", CacheManager::kTypeRegular,
+                                     "/big");
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  // Once the object turned out not to match its content hash, no further block
+  // is handed out
+  shash::Any hash_wrong(shash::kSha1);
+  hash_wrong.Randomize();
+  fd = external_fetcher_->FetchBlock(hash_wrong, content.size(), 0,
+                                     "/big", CacheManager::kTypeRegular,
+                                     "/big");
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  TestWaitVerified(external_fetcher_);
+  EXPECT_EQ(-EIO,
+    external_fetcher_->FetchBlock(hash_wrong, content.size(), 0,
+                                  "/big", CacheManager::kTypeRegular, "/big"));
+  EXPECT_EQ(-EIO,
+    external_fetcher_->FetchBlock(hash_wrong, content.size(), kBlockSize,
+                                  "/big", CacheManager::kTypeRegular, "/big"));
+
+  // Download fails
+  shash::Any rnd_hash(shash::kSha1);
+  rnd_hash.Randomize();
+  EXPECT_EQ(-EIO,
+    external_fetcher_->FetchBlock(rnd_hash, content.size(), 0,
+                                  "/big-fail", CacheManager::kTypeRegular,
+                                  "/big-fail"));
+  TestWaitVerified(external_fetcher_);
+  EXPECT_EQ(-EIO,
+    external_fetcher_->FetchBlock(rnd_hash, content.size(), 0,
+                                  "/big-fail", CacheManager::kTypeRegular,
+                                  "/big-fail"));
+
+  // The state of finished objects is bounded
+  for (unsigned i = 0; i < Fetcher::kMaxSparseObjects; ++i) {
+    hash_wrong.Randomize();
+    fd = external_fetcher_->FetchBlock(hash_wrong, content.size(), 0, "/big",
+                                       CacheManager::kTypeRegular, "/big");
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(0, cache_mgr_->Close(fd));
+  }
+  TestWaitVerified(external_fetcher_);
+  pthread_mutex_lock(external_fetcher_->lock_sparse_objects_);
+  EXPECT_EQ(Fetcher::kMaxSparseObjects,
+            external_fetcher_->sparse_objects_.size());
+  EXPECT_EQ(Fetcher::kMaxSparseObjects,
+            external_fetcher_->sparse_objects_finished_.size());
+  EXPECT_TRUE(external_fetcher_->verify_queue_.empty());
+  pthread_mutex_unlock(external_fetcher_->lock_sparse_objects_);
+}
+
+
 TEST_F(T_Fetcher, Fetch) {
   // Cache hit
   unsigned char x = 'x';
@@ -303,6 +438,34 @@ TEST_F(T_Fetcher, FetchUncompressed) {
 }
 
 
+TEST_F(T_Fetcher, FetchZstd) {
+  const std::string content(100000, 'z');
+  void *buf;
+  uint64_t buf_size;
+  EXPECT_TRUE(zlib::CompressMem2Mem(content.data(), content.size(),
+                                    &buf, &buf_size, zlib::kZstd));
+  shash::Any hash_zstd(shash::kSha1);
+  shash::HashMem(static_cast<unsigned char *>(buf), buf_size, &hash_zstd);
+  MkdirDeep(GetParentPath(src_path_ + "/" + hash_zstd.MakePath()), 0700);
+  EXPECT_TRUE(CopyMem2Path(static_cast<unsigned char *>(buf), buf_size,
+                           src_path_ + "/" + hash_zstd.MakePath()));
+  free(buf);
+
+  int fd = fetcher_->Fetch(hash_zstd, content.size(), "zstd",
+                           zlib::kZlibDefault, CacheManager::kTypeRegular);
+  EXPECT_EQ(-EIO, fd);
+
+  fd = fetcher_->Fetch(hash_zstd, content.size(), "zstd",
+                       zlib::kZstd, CacheManager::kTypeRegular);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(static_cast<int64_t>(content.size()), cache_mgr_->GetSize(fd));
+  char data[16];
+  EXPECT_EQ(16, cache_mgr_->Pread(fd, data, 16, 50000));
+  EXPECT_EQ(content.substr(0, 16), std::string(data, 16));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+}
+
+
 TEST_F(T_Fetcher, FetchAltPath) {
   unlink((src_path_ + "/" + hash_regular_.MakePath()).c_str());
   int fd;
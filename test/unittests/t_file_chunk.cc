@@ -55,6 +55,33 @@ TEST_F(T_FileChunk, FindChunkIdx) {
 }
 
 
+TEST_F(T_FileChunk, BlockList) {
+  shash::Any hash(shash::kSha1);
+  hash.Randomize();
+  FileChunkList blocks;
+  FileChunkReflist::MakeBlockList(hash, 10000, 4096, &blocks);
+  ASSERT_EQ(3U, blocks.size());
+  EXPECT_EQ(8192, blocks.AtPtr(2)->offset());
+  EXPECT_EQ(1808U, blocks.AtPtr(2)->size());
+  EXPECT_EQ(hash, blocks.AtPtr(2)->content_hash());
+
+  FileChunkReflist reflist(&blocks, PathString(""), zlib::kNoCompression,
+                           true);
+  EXPECT_TRUE(reflist.IsBlockList());
+  EXPECT_EQ(10000U, reflist.FileSize());
+  EXPECT_EQ(1U, reflist.FindChunkIdx(4096));
+  reflist.external_data = false;
+  EXPECT_FALSE(reflist.IsBlockList());
+
+  FileChunkList chunks;
+  chunks.PushBack(
+    FileChunk(shash::Any(shash::kSha1, shash::kSuffixPartial), 0, 1));
+  FileChunkReflist chunk_reflist(&chunks, PathString(""), zlib::kNoCompression,
+                                 true);
+  EXPECT_FALSE(chunk_reflist.IsBlockList());
+}
+
+
 TEST_F(T_FileChunk, Simple) {
   EXPECT_DEATH(simple_.Add(FileChunkReflist()), ".*");
 
@@ -14,6 +14,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "fs_traversal.h"
 #include "platform.h"
@@ -659,6 +660,120 @@ TEST_F(T_FsTraversal, SteeredTraversal) {
   delegate.Check();
 }
 
+TEST_F(T_FsTraversal, ParallelSteeredTraversal) {
+  SteeringTraversalDelegate delegate(reference_);
+  FileSystemTraversal<SteeringTraversalDelegate> traverse(&delegate,
+                                                           testbed_path_,
+                                                           true);
+  RegisterDelegate(&traverse);
+  traverse.SetNumThreads(4);
+
+  traverse.Recurse(testbed_path_);
+  delegate.Check();
+}
+
+
+TEST_F(T_FsTraversal, ParallelIgnoringTraversal) {
+  std::set<std::string> ignored_filenames;
+  ignored_filenames.insert("baz");
+  ignored_filenames.insert("d");
+
+  IgnoringTraversalDelegate delegate(reference_);
+  delegate.SetIgnoreNames(ignored_filenames);
+  FileSystemTraversal<IgnoringTraversalDelegate> traverse(&delegate,
+                                                           testbed_path_,
+                                                           true);
+  RegisterDelegate(&traverse);
+  traverse.fn_ignore_file = &IgnoringTraversalDelegate::IgnoreFilePredicate;
+  traverse.SetNumThreads(4);
+
+  traverse.Recurse(testbed_path_);
+  delegate.Check();
+}
+
+
+//
+// # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
+//
+
+
+class RecordingTraversalDelegate : public SteeringTraversalDelegate {
+ public:
+  explicit RecordingTraversalDelegate(const ChecklistMap &reference) :
+    SteeringTraversalDelegate(reference) {}
+
+  virtual void EnterDir(const std::string &relative_path,
+                        const std::string &dir_name) {
+    Record("enter", relative_path, dir_name);
+  }
+
+  virtual void LeaveDir(const std::string &relative_path,
+                        const std::string &dir_name) {
+    Record("leave", relative_path, dir_name);
+  }
+
+  virtual void File(const std::string &relative_path,
+                    const std::string &file_name) {
+    Record("file", relative_path, file_name);
+  }
+
+  virtual void Symlink(const std::string &relative_path,
+                       const std::string &link_name) {
+    Record("symlink", relative_path, link_name);
+  }
+
+  virtual bool DirPrefix(const std::string &relative_path,
+                         const std::string &dir_name) {
+    Record("prefix", relative_path, dir_name);
+    return SteeringTraversalDelegate::DirPrefix(relative_path, dir_name);
+  }
+
+  virtual void DirPostfix(const std::string &relative_path,
+                          const std::string &dir_name) {
+    Record("postfix", relative_path, dir_name);
+  }
+
+  virtual void Socket(const std::string &relative_path,
+                      const std::string &dir_name) {
+    Record("socket", relative_path, dir_name);
+  }
+
+  virtual void Fifo(const std::string &relative_path,
+                    const std::string &dir_name) {
+    Record("fifo", relative_path, dir_name);
+  }
+
+  std::vector<std::string> calls;
+
+ private:
+  void Record(const std::string &what,
+              const std::string &relative_path,
+              const std::string &name) {
+    calls.push_back(what + " " + CombinePath(relative_path, name));
+  }
+};
+
+TEST_F(T_FsTraversal, ParallelTraversalOrder) {
+  RecordingTraversalDelegate serial_delegate(reference_);
+  FileSystemTraversal<RecordingTraversalDelegate> serial(&serial_delegate,
+                                                         testbed_path_,
+                                                         true);
+  RegisterDelegate(&serial);
+  serial.Recurse(testbed_path_);
+
+  for (unsigned num_threads = 2; num_threads <= 8; num_threads *= 2) {
+    RecordingTraversalDelegate delegate(reference_);
+    FileSystemTraversal<RecordingTraversalDelegate> traverse(&delegate,
+                                                             testbed_path_,
+                                                             true);
+    RegisterDelegate(&traverse);
+    traverse.SetNumThreads(num_threads);
+    traverse.Recurse(testbed_path_);
+    EXPECT_EQ(serial_delegate.calls, delegate.calls);
+  }
+}
+
+
 class CustomDelegate {
  public:
   explicit CustomDelegate(const std::string &path) :
@@ -726,3 +841,35 @@ TEST_F(T_FsTraversal, CharacterDevice) {
   traverse.Recurse("/dev");
   EXPECT_LT(0, delegate.num_character_dev);
 }
+
+
+TEST_F(T_FsTraversal, PrefetcherDiscard) {
+  // 'p-foo' sorts between 'p' and 'p/x'
+  const std::string base = testbed_path_ + "/prefetch";
+  ASSERT_EQ(0, mkdir(base.c_str(), 0755));
+  ASSERT_EQ(0, mkdir((base + "/p").c_str(), 0755));
+  ASSERT_EQ(0, mkdir((base + "/p/x").c_str(), 0755));
+  ASSERT_EQ(0, mkdir((base + "/p-foo").c_str(), 0755));
+  ASSERT_EQ(0, mkdir((base + "/p-foo/z").c_str(), 0755));
+
+  FileSystemTraversal<CustomDelegate>::Prefetcher prefetcher(2);
+  delete prefetcher.Get(base);
+  // Either the traversal thread or a pool thread queues p/x
+  delete prefetcher.Get(base + "/p");
+  pthread_mutex_lock(&prefetcher.lock_);
+  EXPECT_EQ(1U, prefetcher.listings_.count(base + "/p/x"));
+  EXPECT_EQ(1U, prefetcher.listings_.count(base + "/p-foo"));
+  pthread_mutex_unlock(&prefetcher.lock_);
+
+  prefetcher.Discard(base + "/p");
+  pthread_mutex_lock(&prefetcher.lock_);
+  EXPECT_EQ(0U, prefetcher.listings_.count(base + "/p/x"));
+  EXPECT_EQ(1U, prefetcher.listings_.count(base + "/p-foo"));
+  pthread_mutex_unlock(&prefetcher.lock_);
+
+  prefetcher.Discard(base + "/p-foo");
+  pthread_mutex_lock(&prefetcher.lock_);
+  EXPECT_EQ(0U, prefetcher.listings_.count(base + "/p-foo"));
+  EXPECT_EQ(0U, prefetcher.listings_.count(base + "/p-foo/z"));
+  pthread_mutex_unlock(&prefetcher.lock_);
+}
@@ -0,0 +1,159 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include "fsck_index.h"
+#include "hash.h"
+#include "platform.h"
+#include "prng.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+class T_FsckIndex : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    prng_.InitSeed(42);
+    tmp_path_ = CreateTempDir("./cvmfs_ut_fsck_index");
+    ASSERT_FALSE(tmp_path_.empty());
+    index_path_ = tmp_path_ + "/fsckindex";
+  }
+
+  virtual void TearDown() {
+    if (!tmp_path_.empty())
+      RemoveTree(tmp_path_);
+  }
+
+  shash::Any MakeHash() {
+    shash::Any hash(shash::kSha1);
+    hash.Randomize(&prng_);
+    return hash;
+  }
+
+  platform_stat64 MakeStat(const uint64_t inode,
+                           const uint64_t size,
+                           const time_t mtime)
+  {
+    platform_stat64 info;
+    memset(&info, 0, sizeof(info));
+    info.st_ino = inode;
+    info.st_size = size;
+    info.st_mtime = mtime;
+    return info;
+  }
+
+  Prng prng_;
+  string tmp_path_;
+  string index_path_;
+};
+
+
+TEST_F(T_FsckIndex, MarkAndReopen) {
+  const shash::Any hash1 = MakeHash();
+  const shash::Any hash2 = MakeHash();
+  const shash::Any hash3 = MakeHash();
+  const platform_stat64 info1 = MakeStat(1, 100, 1000);
+  const platform_stat64 info2 = MakeStat(2, 200, 2000);
+
+  UniquePtr<FsckIndex> index(FsckIndex::Open(index_path_));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(0U, index->GetNumPrevious());
+  EXPECT_EQ(0U, index->GetVerificationTime(hash1, info1));
+
+  index->MarkVerified(hash1, info1, 10);
+  index->MarkVerified(hash2, info2, 20);
+  EXPECT_EQ(2U, index->GetNumRecorded());
+  // Records of the running pass are not used for lookups
+  EXPECT_EQ(0U, index->GetVerificationTime(hash1, info1));
+  EXPECT_TRUE(index->Commit());
+
+  index.Destroy();
+  index = FsckIndex::Open(index_path_);
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(2U, index->GetNumPrevious());
+  EXPECT_EQ(0U, index->GetNumRecorded());
+  EXPECT_EQ(10U, index->GetVerificationTime(hash1, info1));
+  EXPECT_EQ(20U, index->GetVerificationTime(hash2, info2));
+  EXPECT_EQ(0U, index->GetVerificationTime(hash3, info1));
+}
+
+
+TEST_F(T_FsckIndex, ChangedObject) {
+  const shash::Any hash = MakeHash();
+  UniquePtr<FsckIndex> index(FsckIndex::Open(index_path_));
+  ASSERT_TRUE(index.IsValid());
+  index->MarkVerified(hash, MakeStat(1, 100, 1000), 10);
+  EXPECT_TRUE(index->Commit());
+
+  index.Destroy();
+  index = FsckIndex::Open(index_path_);
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(10U, index->GetVerificationTime(hash, MakeStat(1, 100, 1000)));
+  EXPECT_EQ(0U, index->GetVerificationTime(hash, MakeStat(2, 100, 1000)));
+  EXPECT_EQ(0U, index->GetVerificationTime(hash, MakeStat(1, 101, 1000)));
+  EXPECT_EQ(0U, index->GetVerificationTime(hash, MakeStat(1, 100, 1001)));
+}
+
+
+TEST_F(T_FsckIndex, CheckpointAndCommit) {
+  const unsigned kNumObjects = 100;
+  vector<shash::Any> hashes;
+  UniquePtr<FsckIndex> index(FsckIndex::Open(index_path_));
+  ASSERT_TRUE(index.IsValid());
+  for (unsigned i = 0; i < kNumObjects; ++i) {
+    hashes.push_back(MakeHash());
+    index->MarkVerified(hashes[i], MakeStat(i, i, i), 1);
+  }
+  EXPECT_TRUE(index->Commit());
+
+  // An interrupted pass revisits half of the objects
+  index.Destroy();
+  index = FsckIndex::Open(index_path_);
+  ASSERT_TRUE(index.IsValid());
+  for (unsigned i = 0; i < kNumObjects / 2; ++i)
+    index->MarkVerified(hashes[i], MakeStat(i, i, i), 2);
+  EXPECT_TRUE(index->Checkpoint());
+
+  index.Destroy();
+  index = FsckIndex::Open(index_path_);
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(kNumObjects, index->GetNumPrevious());
+  for (unsigned i = 0; i < kNumObjects; ++i) {
+    EXPECT_EQ((i < kNumObjects / 2) ? 2U : 1U,
+              index->GetVerificationTime(hashes[i], MakeStat(i, i, i)));
+  }
+
+  // A complete pass forgets objects that disappeared
+  index->MarkVerified(hashes[0], MakeStat(0, 0, 0), 3);
+  EXPECT_TRUE(index->Commit());
+  index.Destroy();
+  index = FsckIndex::Open(index_path_);
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(1U, index->GetNumPrevious());
+  EXPECT_EQ(3U, index->GetVerificationTime(hashes[0], MakeStat(0, 0, 0)));
+  EXPECT_EQ(0U, index->GetVerificationTime(hashes[1], MakeStat(1, 1, 1)));
+}
+
+
+TEST_F(T_FsckIndex, GarbledIndex) {
+  const shash::Any hash1 = MakeHash();
+  const shash::Any hash2 = MakeHash();
+  const string content =
+    hash1.ToString() + " 1 100 1000 10\n" +
+    "garbage\n" +
+    hash2.ToString() + " 2 200 x 20\n" +
+    hash2.ToString() + " 2 2";
+  ASSERT_TRUE(SafeWriteToFile(content, index_path_, 0600));
+
+  UniquePtr<FsckIndex> index(FsckIndex::Open(index_path_));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(1U, index->GetNumPrevious());
+  EXPECT_EQ(10U, index->GetVerificationTime(hash1, MakeStat(1, 100, 1000)));
+  EXPECT_EQ(0U, index->GetVerificationTime(hash2, MakeStat(2, 200, 2000)));
+}
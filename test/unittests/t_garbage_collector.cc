@@ -44,6 +44,8 @@ class GC_MockUploader : public AbstractMockUploader<GC_MockUploader> {
   }
 
   bool Remove(const shash::Any &hash_to_delete) {
+    if (undeletable_hashes.count(hash_to_delete) > 0)
+      return false;
     deleted_hashes.insert(hash_to_delete);
     return true;
   }
@@ -54,6 +56,7 @@ class GC_MockUploader : public AbstractMockUploader<GC_MockUploader> {
 
  public:
   std::set<shash::Any> deleted_hashes;
+  std::set<shash::Any> undeletable_hashes;
 };
 
 class T_GarbageCollector : public ::testing::Test {
@@ -583,6 +586,59 @@ TEST_F(T_GarbageCollector, KeepLastRevision) {
 }
 
 
+TEST_F(T_GarbageCollector, FailedDeletionKeepsReflogEntry) {
+  GcConfiguration config = GetStandardGarbageCollectorConfiguration();
+  config.keep_history_depth = 0;
+  GC_MockUploader *upl = static_cast<GC_MockUploader*>(config.uploader);
+  upl->undeletable_hashes.insert(
+    h("2e87adef242bc67cb66fcd61238ad808a7b44aab"));
+
+  MyGarbageCollector gc(config);
+  EXPECT_TRUE(gc.Collect());
+  EXPECT_EQ(11u, gc.condemned_objects_count());
+  EXPECT_EQ(10u, upl->deleted_hashes.size());
+  EXPECT_TRUE(upl->HasDeleted(h("3bf4854891899670727fc8e9c6e454f7e4058454")));
+
+  // Revision 3 needs to be swept again by the next run
+  RevisionMap &c = catalogs_;
+  EXPECT_FALSE(config.reflog->ContainsCatalog(c[mp(1, "00")]->hash()));
+  EXPECT_TRUE(config.reflog->ContainsCatalog(c[mp(3, "00")]->hash()));
+  EXPECT_TRUE(config.reflog->ContainsCatalog(c[mp(5, "00")]->hash()));
+}
+
+
+TEST_F(T_GarbageCollector, KeepLastRevisionSpillingFilter) {
+  typedef GarbageCollector<MockedCatalogTraversal, SpillingHashFilter>
+    SpillingGarbageCollector;
+  const GcConfiguration standard = GetStandardGarbageCollectorConfiguration();
+  SpillingGarbageCollector::Configuration config;
+  config.keep_history_depth = 0;
+  config.uploader           = standard.uploader;
+  config.object_fetcher     = standard.object_fetcher;
+  config.reflog             = standard.reflog;
+
+  SpillingGarbageCollector gc(config);
+  gc.hash_filter()->SetSpillDirectory(".", 4);
+  EXPECT_TRUE(gc.Collect());
+  EXPECT_GT(gc.hash_filter()->num_runs(), 0u);
+  EXPECT_FALSE(gc.hash_filter()->failed());
+  EXPECT_EQ(11u, gc.preserved_catalog_count());
+  EXPECT_EQ(5u, gc.condemned_catalog_count());
+
+  GC_MockUploader *upl = static_cast<GC_MockUploader*>(config.uploader);
+  RevisionMap     &c   = catalogs_;
+  EXPECT_FALSE(upl->HasDeleted(h("b52945d780f8cc16711d4e670d82499dad99032d")));
+  EXPECT_FALSE(
+    upl->HasDeleted(h("defae1853b929bbbdbc7c6d4e75531273f1ae4cb", 'P')));
+  EXPECT_FALSE(upl->HasDeleted(c[mp(5, "00")]->hash()));
+  EXPECT_FALSE(upl->HasDeleted(c[mp(4, "20")]->hash()));
+  EXPECT_TRUE(upl->HasDeleted(h("2e87adef242bc67cb66fcd61238ad808a7b44aab")));
+  EXPECT_TRUE(upl->HasDeleted(c[mp(1, "00")]->hash()));
+  EXPECT_TRUE(upl->HasDeleted(c[mp(3, "11")]->hash()));
+  EXPECT_EQ(11u, upl->deleted_hashes.size());
+}
+
+
 TEST_F(T_GarbageCollector, KeepLastThreeRevisions) {
   GcConfiguration config = GetStandardGarbageCollectorConfiguration();
   config.keep_history_depth   = 2;  // preserve two historic revisions
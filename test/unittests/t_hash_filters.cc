@@ -4,7 +4,16 @@
 
 #include <gtest/gtest.h>
 
+#ifdef __linux__
+#include <malloc.h>
+#endif
+#include <sys/time.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
 
 #include "garbage_collection/hash_filter.h"
 
@@ -23,6 +32,40 @@ static shash::Any md5(const std::string &hash,
   return shash::Any(shash::kMd5, shash::HexPtr(hash), suffix);
 }
 
+static uint64_t MicroSeconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+/**
+ * Allocated heap memory in bytes, 0 if unknown
+ */
+static size_t HeapInUse() {
+#ifdef __linux__
+  struct mallinfo info = mallinfo();
+  return static_cast<unsigned>(info.uordblks) +
+         static_cast<unsigned>(info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Resident memory in bytes, including anonymous mappings that are not
+ * allocated by malloc (e.g. by the SmallHashDynamic), 0 if unknown
+ */
+static size_t ResidentMemory() {
+  size_t pages_total = 0;
+  size_t pages_resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm == NULL)
+    return 0;
+  const int retval = fscanf(statm, "%zu %zu", &pages_total, &pages_resident);
+  fclose(statm);
+  return (retval == 2) ? pages_resident * getpagesize() : 0;
+}
+
 class RandomHashGenerator {
  public:
   explicit RandomHashGenerator(Prng &rng) : rng_(rng) {}
@@ -67,7 +110,10 @@ class T_HashFilter : public ::testing::Test {
   };
 };
 
-typedef ::testing::Types<SimpleHashFilter, SmallhashFilter> HashFilterTypes;
+typedef ::testing::Types<SimpleHashFilter,
+                         SmallhashFilter,
+                         CompactHashFilter,
+                         SpillingHashFilter> HashFilterTypes;
 TYPED_TEST_CASE(T_HashFilter, HashFilterTypes);
 
 
@@ -424,3 +470,156 @@ TYPED_TEST(T_HashFilter, FillManyRandomHashesSlow) {
 
   std::for_each(random_hashes.begin(), random_hashes.end(), check_contains);
 }
+
+
+/**
+ * Fills the filter with the objects of 20 revisions in which 5% of the objects
+ * change from revision to revision and prints the memory consumption as well
+ * as the fill and lookup throughput
+ */
+TYPED_TEST(T_HashFilter, BenchmarkSlow) {
+  const unsigned num_objects = 1000000;
+  const unsigned num_revisions = 20;
+  const unsigned num_changes = num_objects / 20;
+
+  Prng rng;
+  rng.InitSeed(42);
+  RandomHashGenerator random_hash_generator(rng);
+  std::vector<shash::Any> objects(num_objects, shash::Any());
+  std::generate(objects.begin(), objects.end(), random_hash_generator);
+  std::vector<shash::Any> changes(num_changes * num_revisions, shash::Any());
+  std::generate(changes.begin(), changes.end(), random_hash_generator);
+
+  const size_t heap_before = HeapInUse();
+  const size_t resident_before = ResidentMemory();
+  const uint64_t fill_start = MicroSeconds();
+  TypeParam *filter = new TypeParam();
+  for (unsigned r = 0; r < num_revisions; ++r) {
+    for (unsigned i = 0; i < num_changes; ++i)
+      objects[rng.Next(num_objects)] = changes[r * num_changes + i];
+    for (unsigned i = 0; i < num_objects; ++i)
+      filter->Fill(objects[i]);
+  }
+  filter->Freeze();
+  const uint64_t fill_time = MicroSeconds() - fill_start;
+  // The heap usage misses mmap()'ed tables, the resident memory misses reused
+  // heap memory, take the larger one
+  const size_t memory_filter = std::max(HeapInUse() - heap_before,
+                                        ResidentMemory() - resident_before);
+  const size_t count = filter->Count();
+  EXPECT_GE(count, num_objects);
+
+  const uint64_t lookup_start = MicroSeconds();
+  unsigned num_found = 0;
+  for (unsigned i = 0; i < num_objects; ++i)
+    num_found += filter->Contains(objects[i]) ? 1 : 0;
+  for (unsigned i = 0; i < num_objects; ++i)
+    num_found += filter->Contains(random_hash_generator()) ? 1 : 0;
+  const uint64_t lookup_time = MicroSeconds() - lookup_start;
+  EXPECT_EQ(num_objects, num_found);
+  delete filter;
+
+  printf("%u hashes (%u fills): %.1f bytes per hash, "
+         "%.2f M fills/s, %.2f M lookups/s\n",
+         static_cast<unsigned>(count), num_objects * num_revisions,
+         static_cast<double>(memory_filter) / count,
+         static_cast<double>(num_objects) * num_revisions / fill_time,
+         2.0 * num_objects / lookup_time);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+class T_SpillingHashFilter : public ::testing::Test {
+ protected:
+  void SetUp() {
+    rng_.InitSeed(1337);
+    RandomHashGenerator random_hash_generator(rng_);
+    hashes_.resize(100000);
+    std::generate(hashes_.begin(), hashes_.end(), random_hash_generator);
+  }
+
+  void FillTwice(SpillingHashFilter *filter) {
+    for (unsigned i = 0; i < hashes_.size(); ++i)
+      filter->Fill(hashes_[i]);
+    for (unsigned i = 0; i < hashes_.size(); ++i)
+      filter->Fill(hashes_[hashes_.size() - i - 1]);
+  }
+
+  void ExpectContained(const SpillingHashFilter &filter) {
+    unsigned num_found = 0;
+    for (unsigned i = 0; i < hashes_.size(); ++i)
+      num_found += filter.Contains(hashes_[i]) ? 1 : 0;
+    EXPECT_EQ(hashes_.size(), num_found);
+
+    RandomHashGenerator random_hash_generator(rng_);
+    for (unsigned i = 0; i < 1000; ++i)
+      EXPECT_FALSE(filter.Contains(random_hash_generator()));
+  }
+
+  Prng rng_;
+  std::vector<shash::Any> hashes_;
+};
+
+
+TEST_F(T_SpillingHashFilter, InMemory) {
+  SpillingHashFilter filter;
+  FillTwice(&filter);
+  EXPECT_EQ(0u, filter.num_runs());
+  EXPECT_EQ(hashes_.size(), filter.Count());
+  filter.Freeze();
+  EXPECT_EQ(hashes_.size(), filter.Count());
+  ExpectContained(filter);
+}
+
+
+TEST_F(T_SpillingHashFilter, Spill) {
+  SpillingHashFilter filter;
+  filter.SetSpillDirectory(".", 10000);
+  FillTwice(&filter);
+  EXPECT_GT(filter.num_runs(), 10u);
+  EXPECT_EQ(hashes_.size(), filter.Count());
+  EXPECT_EQ(1u, filter.num_runs());
+
+  // Fill after counting
+  filter.Fill(hashes_[0]);
+  for (unsigned i = 0; i < 20000; ++i)
+    filter.Fill(hashes_[i]);
+  EXPECT_GT(filter.num_runs(), 1u);
+
+  filter.Freeze();
+  EXPECT_FALSE(filter.failed());
+  EXPECT_EQ(1u, filter.num_runs());
+  EXPECT_EQ(hashes_.size(), filter.Count());
+  ExpectContained(filter);
+}
+
+
+TEST_F(T_SpillingHashFilter, SpillFailure) {
+  SpillingHashFilter filter;
+  filter.SetSpillDirectory("/no/such/directory", 10);
+  for (unsigned i = 0; i < 100; ++i)
+    filter.Fill(hashes_[i]);
+  filter.Freeze();
+  EXPECT_TRUE(filter.failed());
+
+  // Conservative answers, nothing gets deleted
+  RandomHashGenerator random_hash_generator(rng_);
+  EXPECT_TRUE(filter.Contains(random_hash_generator()));
+}
+
+
+TEST_F(T_SpillingHashFilter, MemoryBound) {
+  if (HeapInUse() == 0)
+    return;
+
+  const size_t heap_before = HeapInUse();
+  SpillingHashFilter filter;
+  filter.SetSpillDirectory(".", 5000);
+  FillTwice(&filter);
+  filter.Freeze();
+  ExpectContained(filter);
+  // The sorted runs are mapped, not allocated
+  EXPECT_LT(HeapInUse() - heap_before, 10 * 5000 * sizeof(shash::Any));
+}
@@ -11,6 +11,7 @@
 
 #include "hash.h"
 #include "manifest.h"
+#include "util/pointer.h"
 #include "util/posix.h"
 
 using namespace std;  // NOLINT
@@ -68,4 +69,59 @@ TEST_F(T_Manifest, ReadChecksum) {
   fclose(f);
 }
 
+
+TEST_F(T_Manifest, CompressionDictionary) {
+  shash::Any catalog_hash(shash::kSha1, shash::kSuffixCatalog);
+  catalog_hash.Randomize();
+  Manifest manifest(catalog_hash, 1, "");
+  EXPECT_TRUE(manifest.compression_dictionary().IsNull());
+  string exported = manifest.ExportString();
+  UniquePtr<Manifest> reloaded(Manifest::LoadMem(
+    reinterpret_cast<const unsigned char *>(exported.data()),
+    exported.length()));
+  ASSERT_TRUE(reloaded.IsValid());
+  EXPECT_TRUE(reloaded->compression_dictionary().IsNull());
+
+  shash::Any dictionary(shash::kSha1, shash::kSuffixDictionary);
+  dictionary.Randomize();
+  manifest.set_compression_dictionary(dictionary);
+  exported = manifest.ExportString();
+  reloaded = Manifest::LoadMem(
+    reinterpret_cast<const unsigned char *>(exported.data()),
+    exported.length());
+  ASSERT_TRUE(reloaded.IsValid());
+  EXPECT_EQ(dictionary, reloaded->compression_dictionary());
+  EXPECT_EQ(shash::kSuffixDictionary,
+            reloaded->compression_dictionary().suffix);
+}
+
+
+TEST_F(T_Manifest, ChecksumCompressionDictionary) {
+  shash::Any catalog_hash(shash::kSha1, shash::kSuffixCatalog);
+  catalog_hash.Randomize();
+  Manifest manifest(catalog_hash, 1, "");
+  manifest.set_repository_name("test");
+  manifest.set_publish_timestamp(42);
+  ASSERT_TRUE(manifest.ExportChecksum(tmp_path_, 0600));
+
+  shash::Any retrieved_hash;
+  shash::Any retrieved_dictionary;
+  uint64_t last_modified = 0;
+  EXPECT_TRUE(Manifest::ReadChecksum("test", tmp_path_, &retrieved_hash,
+                                     &last_modified, &retrieved_dictionary));
+  EXPECT_EQ(catalog_hash, retrieved_hash);
+  EXPECT_EQ(42U, last_modified);
+  EXPECT_TRUE(retrieved_dictionary.IsNull());
+
+  shash::Any dictionary(shash::kShake128, shash::kSuffixDictionary);
+  dictionary.Randomize();
+  manifest.set_compression_dictionary(dictionary);
+  ASSERT_TRUE(manifest.ExportChecksum(tmp_path_, 0600));
+  EXPECT_TRUE(Manifest::ReadChecksum("test", tmp_path_, &retrieved_hash,
+                                     &last_modified, &retrieved_dictionary));
+  EXPECT_EQ(catalog_hash, retrieved_hash);
+  EXPECT_EQ(42U, last_modified);
+  EXPECT_EQ(dictionary, retrieved_dictionary);
+}
+
 }  // namespace manifest
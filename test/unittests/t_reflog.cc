@@ -331,6 +331,8 @@ TYPED_TEST(T_Reflog, ContainsObject) {
                      shash::kSuffixMetainfo));
   rl1->AddHistory(h("cab790100c3b10afd7e755b3c93eaeda6a0db9ab",
                      shash::kSuffixHistory));
+  rl1->AddDictionary(h("7e5b7f1a0c6ba1b5fd4d53b2a62e5ad4c3b9c0a1",
+                       shash::kSuffixDictionary));
 
   EXPECT_TRUE(
     rl1->ContainsCatalog(h("b99a789dcdffff8f95b977cc8e2037fcd3960b5b",
@@ -356,13 +358,19 @@ TYPED_TEST(T_Reflog, ContainsObject) {
   EXPECT_FALSE(
     rl1->ContainsHistory(h("abcde0100c3b10afd7e755b3c93eaeda6a0db9ab",
                            shash::kSuffixHistory)));
+  EXPECT_TRUE(
+    rl1->ContainsDictionary(h("7e5b7f1a0c6ba1b5fd4d53b2a62e5ad4c3b9c0a1",
+                              shash::kSuffixDictionary)));
+  EXPECT_FALSE(
+    rl1->ContainsDictionary(h("abcdef1a0c6ba1b5fd4d53b2a62e5ad4c3b9c0a1",
+                              shash::kSuffixDictionary)));
 
   TestFixture::CloseReflog(rl1);
 
   Reflog *rl2 = TestFixture::OpenReflog(rp);
   ASSERT_NE(static_cast<Reflog*>(NULL), rl2);
   EXPECT_EQ(TestFixture::fqrn, rl2->fqrn());
-  EXPECT_EQ(5u, rl2->CountEntries());
+  EXPECT_EQ(6u, rl2->CountEntries());
 
   EXPECT_TRUE(
     rl2->ContainsCatalog(h("c5501bd0142cad45c4f0957cbf307e184ac1f661",
@@ -388,6 +396,9 @@ TYPED_TEST(T_Reflog, ContainsObject) {
   EXPECT_FALSE(
     rl2->ContainsHistory(h("abcde0100c3b10afd7e755b3c93eaeda6a0db9ab",
                            shash::kSuffixHistory)));
+  EXPECT_TRUE(
+    rl2->ContainsDictionary(h("7e5b7f1a0c6ba1b5fd4d53b2a62e5ad4c3b9c0a1",
+                              shash::kSuffixDictionary)));
 
   TestFixture::CloseReflog(rl2);
 }
@@ -0,0 +1,122 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <string>
+
+#include "hash.h"
+#include "prng.h"
+#include "replication_journal.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+class T_ReplicationJournal : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    prng_.InitSeed(42);
+    tmp_path_ = CreateTempDir("./cvmfs_ut_replication_journal");
+    ASSERT_FALSE(tmp_path_.empty());
+    journal_path_ = tmp_path_ + "/journal";
+  }
+
+  virtual void TearDown() {
+    if (!tmp_path_.empty())
+      RemoveTree(tmp_path_);
+  }
+
+  shash::Any MakeCatalogHash() {
+    shash::Any hash(shash::kSha1, shash::kSuffixCatalog);
+    hash.Randomize(&prng_);
+    return hash;
+  }
+
+  Prng prng_;
+  string tmp_path_;
+  string journal_path_;
+};
+
+
+TEST_F(T_ReplicationJournal, MarkAndReopen) {
+  const shash::Any catalog1 = MakeCatalogHash();
+  const shash::Any catalog2 = MakeCatalogHash();
+  const shash::Any catalog3 = MakeCatalogHash();
+
+  UniquePtr<ReplicationJournal> journal(
+    ReplicationJournal::Open(journal_path_));
+  ASSERT_TRUE(journal.IsValid());
+  EXPECT_EQ(0U, journal->GetNumEntries());
+  EXPECT_FALSE(journal->HasChunksComplete(catalog1));
+
+  EXPECT_TRUE(journal->MarkChunksComplete(catalog1));
+  EXPECT_TRUE(journal->MarkChunksComplete(catalog2));
+  EXPECT_TRUE(journal->MarkCatalogComplete(catalog2));
+  EXPECT_TRUE(journal->MarkCatalogComplete(catalog2));
+  EXPECT_EQ(3U, journal->GetNumEntries());
+  EXPECT_TRUE(journal->HasChunksComplete(catalog1));
+  EXPECT_FALSE(journal->HasCatalogComplete(catalog1));
+  EXPECT_TRUE(journal->HasCatalogComplete(catalog2));
+
+  // Resume
+  journal.Destroy();
+  journal = ReplicationJournal::Open(journal_path_);
+  ASSERT_TRUE(journal.IsValid());
+  EXPECT_EQ(3U, journal->GetNumEntries());
+  EXPECT_TRUE(journal->HasChunksComplete(catalog1));
+  EXPECT_FALSE(journal->HasCatalogComplete(catalog1));
+  EXPECT_TRUE(journal->HasChunksComplete(catalog2));
+  EXPECT_TRUE(journal->HasCatalogComplete(catalog2));
+  EXPECT_FALSE(journal->HasChunksComplete(catalog3));
+
+  EXPECT_TRUE(journal->Remove());
+  EXPECT_FALSE(FileExists(journal_path_));
+}
+
+
+TEST_F(T_ReplicationJournal, TruncatedEntry) {
+  const shash::Any catalog1 = MakeCatalogHash();
+  const shash::Any catalog2 = MakeCatalogHash();
+  const shash::Any catalog3 = MakeCatalogHash();
+
+  UniquePtr<ReplicationJournal> journal(
+    ReplicationJournal::Open(journal_path_));
+  ASSERT_TRUE(journal.IsValid());
+  EXPECT_TRUE(journal->MarkCatalogComplete(catalog1));
+  EXPECT_TRUE(journal->MarkCatalogComplete(catalog2));
+  journal.Destroy();
+
+  // Interrupted in the middle of writing the second entry
+  EXPECT_EQ(0, truncate(journal_path_.c_str(), GetFileSize(journal_path_) - 5));
+  journal = ReplicationJournal::Open(journal_path_);
+  ASSERT_TRUE(journal.IsValid());
+  EXPECT_EQ(1U, journal->GetNumEntries());
+  EXPECT_TRUE(journal->HasCatalogComplete(catalog1));
+  EXPECT_FALSE(journal->HasCatalogComplete(catalog2));
+
+  EXPECT_TRUE(journal->MarkCatalogComplete(catalog3));
+  journal.Destroy();
+  journal = ReplicationJournal::Open(journal_path_);
+  ASSERT_TRUE(journal.IsValid());
+  EXPECT_EQ(2U, journal->GetNumEntries());
+  EXPECT_TRUE(journal->HasCatalogComplete(catalog3));
+}
+
+
+TEST_F(T_ReplicationJournal, Garbage) {
+  EXPECT_TRUE(SafeWriteToFile("not a journal\nX\n\nT 1234\n", journal_path_,
+                              0644));
+  UniquePtr<ReplicationJournal> journal(
+    ReplicationJournal::Open(journal_path_));
+  ASSERT_TRUE(journal.IsValid());
+  EXPECT_EQ(0U, journal->GetNumEntries());
+}
+
+
+TEST_F(T_ReplicationJournal, Unwritable) {
+  EXPECT_EQ(NULL, ReplicationJournal::Open(tmp_path_ + "/no/such/journal"));
+}
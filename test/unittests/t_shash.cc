@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "hash.h"
 #include "prng.h"
@@ -1065,3 +1066,57 @@ TEST(T_Shash, Hmac) {
                     &sha1_hmacstring);
   EXPECT_EQ(sha1_hmacstring, sha1);
 }
+
+
+TEST(T_Shash, HashMemBatch) {
+  // Sizes around the SHA-1 block and padding boundaries
+  const unsigned sizes[] = {0, 1, 3, 55, 56, 57, 63, 64, 65, 119, 120, 127,
+                            128, 129, 1000, 4096, 65537, 17, 0, 200000};
+  const unsigned nbuffers = sizeof(sizes) / sizeof(sizes[0]);
+  Prng prng;
+  prng.InitSeed(42);
+  vector<unsigned char *> buffers;
+  for (unsigned i = 0; i < nbuffers; ++i) {
+    unsigned char *buffer =
+      reinterpret_cast<unsigned char *>(smalloc(sizes[i] + 1));
+    for (unsigned j = 0; j < sizes[i]; ++j)
+      buffer[j] = prng.Next(256);
+    buffers.push_back(buffer);
+  }
+
+  vector<shash::Any> expected;
+  for (unsigned i = 0; i < nbuffers; ++i) {
+    // Mix in a different algorithm
+    shash::Any hash((i == 5) ? shash::kRmd160 : shash::kSha1);
+    shash::HashMem(buffers[i], sizes[i], &hash);
+    expected.push_back(hash);
+  }
+
+  const shash::BatchKernel kernels[] =
+    {shash::kBatchGeneric, shash::kBatchShaNi, shash::kBatchAvx2};
+  EXPECT_TRUE(shash::HasBatchKernel(shash::kBatchGeneric));
+  EXPECT_TRUE(shash::HasBatchKernel(shash::GetBatchKernel()));
+  for (unsigned k = 0; k < 3; ++k) {
+    if (!shash::HasBatchKernel(kernels[k]))
+      continue;
+    // Different batch sizes let the AVX2 lanes run idle
+    for (unsigned n = 1; n <= nbuffers; n += 6) {
+      vector<shash::Any> digests;
+      for (unsigned i = 0; i < n; ++i)
+        digests.push_back(shash::Any(expected[i].algorithm));
+      shash::HashMemBatch(&buffers[0], sizes, n, &digests[0], kernels[k]);
+      for (unsigned i = 0; i < n; ++i) {
+        EXPECT_EQ(expected[i], digests[i])
+          << "kernel " << k << ", buffer " << i << ", size " << sizes[i];
+      }
+    }
+  }
+
+  vector<shash::Any> digests(nbuffers, shash::Any(shash::kSha1));
+  digests[5].algorithm = shash::kRmd160;
+  shash::HashMemBatch(&buffers[0], sizes, nbuffers, &digests[0]);
+  EXPECT_EQ(expected, digests);
+
+  for (unsigned i = 0; i < nbuffers; ++i)
+    free(buffers[i]);
+}
@@ -4,6 +4,8 @@
 
 #include "gtest/gtest.h"
 
+#include <pthread.h>
+
 #include "platform.h"
 #include "statistics.h"
 
@@ -39,6 +41,50 @@ TEST(T_Statistics, Counter) {
 }
 
 
+static void *IncShardedCounter(void *data) {
+  Counter *counter = reinterpret_cast<Counter *>(data);
+  for (unsigned i = 0; i < 10000; ++i) {
+    perf::Inc(counter);
+    perf::Xadd(counter, 2);
+    perf::Dec(counter);
+  }
+  return NULL;
+}
+
+
+TEST(T_Statistics, ShardedCounter) {
+  Counter counter;
+  counter.Set(5);
+  EXPECT_FALSE(counter.IsSharded());
+  counter.MakeSharded();
+  EXPECT_TRUE(counter.IsSharded());
+  EXPECT_EQ(5, counter.Get());
+  counter.Inc();
+  EXPECT_EQ(6, counter.Get());
+  counter.Dec();
+  EXPECT_EQ(5, counter.Get());
+  EXPECT_EQ(5, counter.Xadd(-5));
+  EXPECT_EQ(0, counter.Get());
+  counter.Set(1024*1024);
+  EXPECT_EQ("1048576", counter.Print());
+  Counter copy(counter);
+  EXPECT_FALSE(copy.IsSharded());
+  EXPECT_EQ(1024*1024, copy.Get());
+  counter.Set(0);
+
+  const unsigned kNumThreads = 2 * Counter::kNumShards + 1;
+  pthread_t threads[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    int retval = pthread_create(&threads[i], NULL, IncShardedCounter,
+                                &counter);
+    ASSERT_EQ(0, retval);
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+  EXPECT_EQ(static_cast<int64_t>(kNumThreads) * 10000 * 2, counter.Get());
+}
+
+
 TEST(T_Statistics, Statistics) {
   Statistics statistics;
 
@@ -54,6 +100,12 @@ TEST(T_Statistics, Statistics) {
 
   EXPECT_EQ("test.counter|0|a test counter\n",
             statistics.PrintList(Statistics::kPrintSimple));
+
+  Counter *sharded = statistics.RegisterSharded("test.sharded", "sharded");
+  ASSERT_TRUE(sharded != NULL);
+  EXPECT_TRUE(sharded->IsSharded());
+  perf::Inc(sharded);
+  EXPECT_EQ(1, statistics.Lookup("test.sharded")->Get());
 }
 
 
@@ -0,0 +1,181 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "catalog_mgr_rw.h"
+#include "download.h"
+#include "file_chunk.h"
+#include "hash.h"
+#include "manifest.h"
+#include "statistics.h"
+#include "swissknife_check.h"
+#include "testutil.h"
+#include "upload.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/string.h"
+#include "xattr.h"
+
+using namespace std;  // NOLINT
+
+class T_SwissknifeCheck : public ::testing::Test {
+ protected:
+  static const unsigned kNumFiles = 50;
+
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir(GetCurrentWorkingDirectory() +
+                              "/cvmfs_ut_swissknife_check");
+    ASSERT_FALSE(tmp_path_.empty());
+    repo_path_ = tmp_path_ + "/repo";
+    ASSERT_TRUE(MakeCacheDirectories(repo_path_ + "/data", 0755));
+    ASSERT_TRUE(MkdirDeep(tmp_path_ + "/tmp", 0755));
+    CreateRepository();
+  }
+
+  virtual void TearDown() {
+    RemoveTree(tmp_path_);
+  }
+
+  /**
+   * Runs the check on the local repository, possibly with several threads.
+   */
+  int RunCheck(const unsigned num_threads, const bool verify_content) {
+    swissknife::ArgumentList args;
+    args['r'] = new string(repo_path_);
+    args['t'] = new string(tmp_path_ + "/tmp");
+    args['c'] = new string();
+    if (num_threads > 0)
+      args['j'] = new string(StringifyInt(num_threads));
+    if (verify_content)
+      args['d'] = new string();
+
+    const string cwd = GetCurrentWorkingDirectory();
+    swissknife::CommandCheck check;
+    const int retval = check.Main(args);
+    EXPECT_EQ(0, chdir(cwd.c_str()));
+    for (swissknife::ArgumentList::iterator i = args.begin(),
+         iEnd = args.end(); i != iEnd; ++i)
+    {
+      delete i->second;
+    }
+
+    // No leftover temporary catalogs, only "." and ".."
+    EXPECT_EQ(2U, FindFiles(tmp_path_ + "/tmp", "").size());
+    return retval;
+  }
+
+  shash::Any StoreObject(const string &content,
+                         const shash::Suffix suffix = shash::kSuffixNone)
+  {
+    shash::Any hash(shash::kSha1, suffix);
+    shash::HashString(content, &hash);
+    const string path = repo_path_ + "/data/" + hash.MakePath();
+    EXPECT_TRUE(SafeWriteToFile(content, path, 0644));
+    if (!content.empty())
+      object_paths_.push_back(path);
+    return hash;
+  }
+
+  /**
+   * Creates a repository with a tree of nested catalogs.  The file objects
+   * are stored uncompressed, so that their content hashes match.
+   */
+  void CreateRepository() {
+    upload::SpoolerDefinition spooler_definition(
+      "local," + repo_path_ + "/data/txn," + repo_path_, shash::kSha1);
+    UniquePtr<upload::Spooler> spooler(
+      upload::Spooler::Construct(spooler_definition));
+    ASSERT_TRUE(spooler.IsValid());
+    UniquePtr<manifest::Manifest> manifest(
+      catalog::WritableCatalogManager::CreateRepository(
+        repo_path_ + "/data/txn", false, "", spooler.weak_ref()));
+    ASSERT_TRUE(manifest.IsValid());
+
+    perf::Statistics statistics;
+    download::DownloadManager download_manager;
+    download_manager.Init(4, false, &statistics);
+    UniquePtr<catalog::WritableCatalogManager> catalog_mgr(
+      new catalog::WritableCatalogManager(
+        manifest->catalog_hash(), "file://" + repo_path_,
+        repo_path_ + "/data/txn", spooler.weak_ref(), &download_manager,
+        500000, &statistics, false, 0, 0));
+    ASSERT_TRUE(catalog_mgr->Init());
+
+    XattrList xattrs;
+    const char *nested[] = {"a", "b", "b/c", "b/c/d", "e", "f"};
+    for (unsigned n = 0; n < sizeof(nested) / sizeof(nested[0]); ++n) {
+      const string path = nested[n];
+      catalog_mgr->AddDirectory(
+        catalog::DirectoryEntryTestFactory::Directory(GetFileName(path), 4096),
+        GetParentPath(path));
+      for (unsigned i = 0; i < kNumFiles; ++i) {
+        const string content = path + StringifyInt(i);
+        const catalog::DirectoryEntryBase file =
+          catalog::DirectoryEntryTestFactory::RegularFile(
+            "file" + StringifyInt(i), content.length(), StoreObject(content));
+        catalog_mgr->AddFile(file, xattrs, path);
+      }
+      FileChunkList chunks;
+      chunks.PushBack(FileChunk(
+        StoreObject("chunk0" + path, shash::kSuffixPartial), 0, 7));
+      chunks.PushBack(FileChunk(
+        StoreObject("chunk1" + path, shash::kSuffixPartial), 7, 7));
+      catalog_mgr->AddChunkedFile(
+        catalog::DirectoryEntryTestFactory::RegularFile(
+          "chunked", 14, StoreObject("chunked" + path)),
+        xattrs, path, chunks);
+      const catalog::DirectoryEntryBase marker =
+        catalog::DirectoryEntryTestFactory::RegularFile(
+          ".cvmfscatalog", 0, StoreObject(""));
+      catalog_mgr->AddFile(marker, xattrs, path);
+      catalog_mgr->CreateNestedCatalog(path);
+    }
+    catalog_mgr->PrecalculateListings();
+    ASSERT_TRUE(catalog_mgr->Commit(false, 0, manifest.weak_ref()));
+    spooler->WaitForUpload();
+    ASSERT_TRUE(manifest->Export(repo_path_ + "/.cvmfspublished"));
+  }
+
+  string tmp_path_;
+  string repo_path_;
+  vector<string> object_paths_;
+};
+
+
+TEST_F(T_SwissknifeCheck, Serial) {
+  EXPECT_EQ(0, RunCheck(0, false));
+  EXPECT_EQ(0, RunCheck(0, true));
+}
+
+
+TEST_F(T_SwissknifeCheck, Parallel) {
+  for (unsigned num_threads = 1; num_threads <= 16; num_threads *= 4) {
+    EXPECT_EQ(0, RunCheck(num_threads, false));
+    EXPECT_EQ(0, RunCheck(num_threads, true));
+  }
+}
+
+
+TEST_F(T_SwissknifeCheck, ParallelCorruptedObject) {
+  ASSERT_FALSE(object_paths_.empty());
+  ASSERT_TRUE(SafeWriteToFile("garbage", object_paths_[kNumFiles / 2], 0644));
+  // Only found if content hashes are verified
+  EXPECT_EQ(0, RunCheck(8, false));
+  EXPECT_EQ(1, RunCheck(8, true));
+  EXPECT_EQ(1, RunCheck(0, true));
+}
+
+
+TEST_F(T_SwissknifeCheck, ParallelMissingObject) {
+  ASSERT_FALSE(object_paths_.empty());
+  ASSERT_EQ(0, unlink(object_paths_.back().c_str()));
+  EXPECT_EQ(1, RunCheck(8, false));
+  EXPECT_EQ(1, RunCheck(0, false));
+}
@@ -0,0 +1,74 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include "platform.h"
+#include "throttle.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+namespace {
+
+struct ConsumerInfo {
+  RateThrottle *throttle;
+  unsigned num_calls;
+  uint64_t units;
+};
+
+void *MainConsumer(void *data) {
+  ConsumerInfo *info = static_cast<ConsumerInfo *>(data);
+  for (unsigned i = 0; i < info->num_calls; ++i)
+    info->throttle->Consume(info->units);
+  return NULL;
+}
+
+}  // anonymous namespace
+
+
+TEST(T_Throttle, Unlimited) {
+  RateThrottle throttle(uint64_t(1) << 50);
+  EXPECT_EQ(uint64_t(1) << 50, throttle.units_per_second());
+  for (unsigned i = 0; i < 1000; ++i)
+    EXPECT_EQ(0U, throttle.Consume(1000));
+}
+
+
+TEST(T_Throttle, Rate) {
+  // 10 units per millisecond
+  RateThrottle throttle(10000);
+  const unsigned kNumThreads = 4;
+  ConsumerInfo info;
+  info.throttle = &throttle;
+  info.num_calls = 25;
+  info.units = 50;
+
+  const uint64_t start_ns = platform_monotonic_time_ns();
+  pthread_t threads[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, MainConsumer, &info));
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+  const uint64_t elapsed_ms =
+    (platform_monotonic_time_ns() - start_ns) / 1000000;
+
+  // 5000 units take 500ms
+  EXPECT_GE(elapsed_ms, 480U);
+  EXPECT_LT(elapsed_ms, 2000U);
+}
+
+
+TEST(T_Throttle, Burst) {
+  RateThrottle throttle(10000);
+  EXPECT_LE(90U, throttle.Consume(1000));
+
+  // Unused budget of the idle period is carried over
+  SafeSleepMs(300);
+  EXPECT_EQ(0U, throttle.Consume(2000));
+  // 100ms of the budget are left
+  EXPECT_LE(80U, throttle.Consume(2000));
+}
@@ -8,10 +8,15 @@
 #include <tbb/atomic.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "atomic.h"
+#include "bloom_filter.h"
 #include "c_file_sandbox.h"
+#include "compression.h"
 #include "file_processing/char_buffer.h"
 #include "hash.h"
 #include "testutil.h"
@@ -20,6 +25,7 @@
 #include "upload_s3.h"
 #include "upload_spooler_definition.h"
 #include "util/file_guard.h"
+#include "util/pointer.h"
 #include "util/string.h"
 
 
@@ -28,6 +34,13 @@
  */
 #define CVMFS_S3_TEST_MOCKUP_SERVER_PORT 8082
 
+/**
+ * Objects above this size are uploaded in parts.  S3 requires parts of at
+ * least 5MB.
+ */
+#define CVMFS_S3_TEST_MULTIPART_THRESHOLD (8 * 1024 * 1024)
+#define CVMFS_S3_TEST_MULTIPART_PART_SIZE (6 * 1024 * 1024)
+
 namespace upload {
 
 class UploadCallbacks {
@@ -36,6 +49,7 @@ class UploadCallbacks {
     simple_upload_invocations            = 0;
     streamed_upload_complete_invocations = 0;
     buffer_upload_complete_invocations   = 0;
+    removal_complete_invocations         = 0;
   }
 
   void SimpleUploadClosure(const UploaderResults &results,
@@ -65,10 +79,18 @@ class UploadCallbacks {
     ++buffer_upload_complete_invocations;
   }
 
+  void RemovalComplete(const UploaderResults &results,
+                             int              num_failed) {
+    EXPECT_EQ(UploaderResults::kRemoval, results.type);
+    EXPECT_EQ(num_failed,                results.return_code);
+    ++removal_complete_invocations;
+  }
+
  public:
   tbb::atomic<unsigned int> simple_upload_invocations;
   tbb::atomic<unsigned int> streamed_upload_complete_invocations;
   tbb::atomic<unsigned int> buffer_upload_complete_invocations;
+  tbb::atomic<unsigned int> removal_complete_invocations;
 };
 
 
@@ -78,6 +100,7 @@ class T_Uploaders : public FileSandbox {
   static const char sandbox_path[];
   static const std::string dest_dir;
   static const std::string tmp_dir;
+  static const std::string parts_dir;
   std::string repo_alias;
   std::string s3_conf_path;
   template<typename> struct type {};
@@ -124,6 +147,7 @@ class T_Uploaders : public FileSandbox {
 
   virtual void SetUp(const type<upload::S3Uploader> type_specifier) {
     repo_alias = "testdata";
+    ASSERT_TRUE(MkdirDeep(T_Uploaders::parts_dir, 0700));
     CreateTempS3ConfigFile(10, 10);
     CreateS3Mockup();
   }
@@ -278,6 +302,31 @@ class T_Uploaders : public FileSandbox {
   }
 
 
+  /**
+   * A file of 2.5 times the multipart threshold, so that the last part is
+   * smaller than the others.
+   */
+  std::string CreateMultipartFile(const std::string &name) const {
+    const std::string path = T_Uploaders::tmp_dir + "/" + name;
+    FILE *file = fopen(path.c_str(), "w");
+    assert(file != NULL);
+    Prng rng;
+    rng.InitSeed(7);
+    for (unsigned i = 0; i < 5 * CVMFS_S3_TEST_MULTIPART_THRESHOLD / 2; ++i)
+      fputc(rng.Next(256), file);
+    fclose(file);
+    return path;
+  }
+
+
+  /**
+   * Parts of multipart uploads that are neither completed nor aborted
+   */
+  std::vector<std::string> GetPendingParts() const {
+    return FindFiles(T_Uploaders::parts_dir, ".part");
+  }
+
+
   bool CheckFile(const std::string &remote_path) const {
     const std::string absolute_path = AbsoluteDestinationPath(remote_path);
     return FileExists(absolute_path);
@@ -313,6 +362,11 @@ class T_Uploaders : public FileSandbox {
   }
 
 
+  std::string ExistenceFilterPath() const {
+    return T_Uploaders::tmp_dir + "/existence_filter";
+  }
+
+
   std::string AbsoluteDestinationPath(const std::string &remote_path) const {
     std::string retme = T_Uploaders::dest_dir;
     if (repo_alias.size() > 0)
@@ -377,6 +431,39 @@ class T_Uploaders : public FileSandbox {
   }
 
 
+  /**
+   * Get the value of a key in a query string like "a=b&c=d".
+   */
+  std::string GetQueryValue(const std::string &query, const std::string &key) {
+    std::vector<std::string> params = SplitString(query, '&');
+    for (unsigned i = 0; i < params.size(); ++i) {
+      if (params[i].compare(0, key.length() + 1, key + "=") == 0)
+        return params[i].substr(key.length() + 1);
+    }
+    return "";
+  }
+
+
+  /**
+   * Reads the request body into file and/or body.
+   */
+  void ReceiveBody(int sockfd, int content_length, FILE *file,
+                   std::string *body)
+  {
+    char buffer[1000];
+    int left_to_read = content_length;
+    while (left_to_read > 0) {
+      int n = read(sockfd, buffer, sizeof(buffer));
+      ASSERT_GT(n, 0);
+      if (file != NULL)
+        EXPECT_EQ(static_cast<size_t>(n), fwrite(buffer, 1, n, file));
+      if (body != NULL)
+        body->append(buffer, n);
+      left_to_read -= n;
+    }
+  }
+
+
   void S3MockupServerThread() {
     const int kReadBufferSize = 1000;
     int listen_sockfd, accept_sockfd;
@@ -404,6 +491,10 @@ class T_Uploaders : public FileSandbox {
     listen(listen_sockfd, 5);
     clilen = sizeof(cli_addr);
 
+    // Multipart uploads: maps the etags of uploaded parts to the part files
+    unsigned num_multipart_uploads = 0;
+    std::map<std::string, std::string> parts;
+
     struct timeval tv;
     tv.tv_sec = 5;
     tv.tv_usec = 0;
@@ -447,14 +538,33 @@ class T_Uploaders : public FileSandbox {
       req_type = GetField(req_header, ' ', 0);
       req_file = GetField(req_header, ' ', 1);
       req_file = req_file.substr(req_file.find("/", 1) + 1);  // no bucket
-      if (req_type.compare("PUT") == 0) {
+      std::string req_query = "";
+      const size_t query_pos = req_file.find('?');
+      if (query_pos != std::string::npos) {
+        req_query = req_file.substr(query_pos + 1);
+        req_file = req_file.substr(0, query_pos);
+      }
+      const std::string upload_id = GetQueryValue(req_query, "uploadId");
+      if ((req_type.compare("PUT") == 0) || (req_type.compare("POST") == 0)) {
         content_length = GetValue(req_header, "Content-Length");
         ASSERT_GE(content_length, 0);
       }
 
       // Get content
       FILE *file = NULL;
-      if (req_type.compare("PUT") == 0) {
+      std::string req_body;
+      std::string etag;
+      if (req_type.compare("POST") == 0) {
+        ReceiveBody(accept_sockfd, content_length, NULL, &req_body);
+      } else if ((req_type.compare("PUT") == 0) && !upload_id.empty()) {
+        etag = upload_id + "-" + GetQueryValue(req_query, "partNumber");
+        const std::string path = T_Uploaders::parts_dir + "/" + etag + ".part";
+        file = fopen(path.c_str(), "w");
+        ASSERT_TRUE(file != NULL);
+        FileGuard file_guard(file);
+        ReceiveBody(accept_sockfd, content_length, file, NULL);
+        parts[etag] = path;
+      } else if (req_type.compare("PUT") == 0) {
         std::string path = T_Uploaders::dest_dir + "/" + req_file;
         file = fopen(path.c_str(), "w");
         ASSERT_TRUE(file != NULL);
@@ -473,7 +583,61 @@ class T_Uploaders : public FileSandbox {
 
       // Reply to client
       std::string reply = "HTTP/1.1 200 OK\r\n";
-      if (req_type.compare("HEAD") == 0) {
+      std::string reply_body;
+      if ((req_type.compare("POST") == 0) && (req_query == "uploads")) {
+        reply_body = "<InitiateMultipartUploadResult><UploadId>upload" +
+                     StringifyInt(++num_multipart_uploads) +
+                     "</UploadId></InitiateMultipartUploadResult>";
+      } else if ((req_type.compare("POST") == 0) && (req_query == "delete")) {
+        // Multi-object delete in quiet mode, only errors would be listed
+        size_t pos = 0;
+        while ((pos = req_body.find("<Key>", pos)) != std::string::npos) {
+          pos += 5;
+          const std::string key =
+              req_body.substr(pos, req_body.find("</Key>", pos) - pos);
+          unlink((T_Uploaders::dest_dir + "/" + key).c_str());
+        }
+        reply_body = "<DeleteResult></DeleteResult>";
+      } else if (req_type.compare("POST") == 0) {
+        // Concatenate the parts in the order of the request
+        std::string path = T_Uploaders::dest_dir + "/" + req_file;
+        file = fopen(path.c_str(), "w");
+        ASSERT_TRUE(file != NULL);
+        FileGuard file_guard(file);
+        size_t pos = 0;
+        while ((pos = req_body.find("<ETag>\"", pos)) != std::string::npos) {
+          pos += 7;
+          const std::string part_etag =
+              req_body.substr(pos, req_body.find('"', pos) - pos);
+          ASSERT_TRUE(parts.find(part_etag) != parts.end());
+          unsigned char *content;
+          unsigned size;
+          ASSERT_TRUE(CopyPath2Mem(parts[part_etag], &content, &size));
+          EXPECT_EQ(size, fwrite(content, 1, size, file));
+          free(content);
+          unlink(parts[part_etag].c_str());
+          parts.erase(part_etag);
+        }
+        reply_body = "<CompleteMultipartUploadResult>"
+                     "</CompleteMultipartUploadResult>";
+      } else if (!etag.empty()) {
+        if (req_file.find("fail") != std::string::npos)
+          reply = "HTTP/1.1 403 Forbidden\r\n";
+        else
+          reply += "ETag: \"" + etag + "\"\r\n";
+      } else if ((req_type.compare("DELETE") == 0) && !upload_id.empty()) {
+        // Abort, drop all the parts of the upload
+        std::map<std::string, std::string>::iterator i = parts.begin();
+        while (i != parts.end()) {
+          if (HasPrefix(i->first, upload_id + "-", false)) {
+            unlink(i->second.c_str());
+            parts.erase(i++);
+          } else {
+            ++i;
+          }
+        }
+        reply = "HTTP/1.1 204 No Content\r\n";
+      } else if (req_type.compare("HEAD") == 0) {
         if (req_file.size() >= 4 &&
             req_file.compare(req_file.size() - 4, 4, "EXIT") == 0) {
           return;
@@ -489,7 +653,11 @@ class T_Uploaders : public FileSandbox {
         // "No Content"-reply even if file did not exist
         reply = "HTTP/1.1 204 No Content\r\n";
       }
-      reply += "Connection: close\r\n\r\n";
+      if (!reply_body.empty()) {
+        reply += "Content-Length: " + StringifyInt(reply_body.length()) +
+                 "\r\n";
+      }
+      reply += "Connection: close\r\n\r\n" + reply_body;
 
       int n = write(accept_sockfd, reply.c_str(), reply.length());
       ASSERT_GE(n, 0);
@@ -521,7 +689,11 @@ class T_Uploaders : public FileSandbox {
         "CVMFS_S3_MAX_NUMBER_OF_PARALLEL_CONNECTIONS=" +
         StringifyInt(parallel_connections) + "\n"
         "CVMFS_S3_HOST=127.0.0.1\n"
-        "CVMFS_S3_PORT=" + StringifyInt(CVMFS_S3_TEST_MOCKUP_SERVER_PORT);
+        "CVMFS_S3_PORT=" + StringifyInt(CVMFS_S3_TEST_MOCKUP_SERVER_PORT) + "\n"
+        "CVMFS_S3_MULTIPART_THRESHOLD=" +
+        StringifyInt(CVMFS_S3_TEST_MULTIPART_THRESHOLD) + "\n"
+        "CVMFS_S3_MULTIPART_PART_SIZE=" +
+        StringifyInt(CVMFS_S3_TEST_MULTIPART_PART_SIZE);
 
     fprintf(s3_conf, "%s\n", conf_str.c_str());
     fclose(s3_conf);
@@ -597,6 +769,10 @@ template <class UploadersT>
 const std::string T_Uploaders<UploadersT>::dest_dir =
     string(T_Uploaders::sandbox_path) + "/dest";
 
+template <class UploadersT>
+const std::string T_Uploaders<UploadersT>::parts_dir =
+    string(T_Uploaders::sandbox_path) + "/parts";
+
 typedef testing::Types<S3Uploader, LocalUploader> UploadTypes;
 TYPED_TEST_CASE(T_Uploaders, UploadTypes);
 
@@ -697,6 +873,60 @@ TYPED_TEST(T_Uploaders, RemoveFromStorage) {
 //
 
 
+TYPED_TEST(T_Uploaders, ScheduleRemoval) {
+  const std::string small_file_path = TestFixture::GetSmallFile();
+  const unsigned number_of_objects = 25;
+  const unsigned batch_size = 10;
+
+  std::vector<shash::Any> hashes;
+  for (unsigned i = 0; i < number_of_objects; ++i) {
+    shash::Any content_hash(shash::kSha1);
+    content_hash.Randomize(1000 + i);
+    hashes.push_back(content_hash);
+    this->uploader_->Upload(small_file_path,
+                            "data/" + content_hash.MakePath());
+  }
+  this->uploader_->WaitForUpload();
+  for (unsigned i = 0; i < number_of_objects; ++i)
+    EXPECT_TRUE(TestFixture::CheckFile("data/" + hashes[i].MakePath()));
+
+  // Removing non-existing objects is a successful deletion
+  shash::Any missing_hash(shash::kSha1);
+  missing_hash.Randomize(2000);
+  hashes.push_back(missing_hash);
+  for (unsigned i = 0; i < hashes.size(); i += batch_size) {
+    const std::vector<shash::Any> batch(
+      hashes.begin() + i,
+      hashes.begin() + std::min(i + batch_size,
+                                static_cast<unsigned>(hashes.size())));
+    this->uploader_->ScheduleRemoval(batch,
+                                     AbstractUploader::MakeClosure(
+                                         &UploadCallbacks::RemovalComplete,
+                                         &this->delegate_,
+                                         0));
+  }
+  this->uploader_->WaitForUpload();
+
+  EXPECT_EQ(3u, this->delegate_.removal_complete_invocations);
+  for (unsigned i = 0; i < number_of_objects; ++i)
+    EXPECT_FALSE(TestFixture::CheckFile("data/" + hashes[i].MakePath()));
+
+  // Empty batches are answered, too
+  this->uploader_->ScheduleRemoval(std::vector<shash::Any>(),
+                                   AbstractUploader::MakeClosure(
+                                       &UploadCallbacks::RemovalComplete,
+                                       &this->delegate_,
+                                       0));
+  this->uploader_->WaitForUpload();
+  EXPECT_EQ(4u, this->delegate_.removal_complete_invocations);
+}
+
+
+//
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//
+
+
 TYPED_TEST(T_Uploaders, UploadEmptyFile) {
   const std::string empty_file_path = TestFixture::GetEmptyFile();
   const std::string dest_name       = "empty_file";
@@ -742,6 +972,57 @@ TYPED_TEST(T_Uploaders, UploadHugeFileSlow) {
 //------------------------------------------------------------------------------
 
 
+TYPED_TEST(T_Uploaders, UploadMultipartFile) {
+  const std::string large_file_path =
+      TestFixture::CreateMultipartFile("large_file");
+  const std::string dest_name = "large_file";
+
+  this->uploader_->Upload(large_file_path, dest_name,
+                          AbstractUploader::MakeClosure(
+                              &UploadCallbacks::SimpleUploadClosure,
+                              &this->delegate_,
+                              UploaderResults(0, large_file_path)));
+  this->uploader_->WaitForUpload();
+
+  EXPECT_TRUE(TestFixture::CheckFile(dest_name));
+  EXPECT_EQ(1u, this->delegate_.simple_upload_invocations);
+  TestFixture::CompareFileContents(large_file_path,
+                                   TestFixture::AbsoluteDestinationPath(
+                                       dest_name));
+  EXPECT_TRUE(TestFixture::GetPendingParts().empty());
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, AbortMultipartUpload) {
+  if (!TestFixture::IsS3()) {
+    // Multipart uploads are specific to S3
+    return;
+  }
+
+  // The S3 mockup rejects parts of objects with "fail" in their name
+  const std::string large_file_path =
+      TestFixture::CreateMultipartFile("large_file");
+  const std::string dest_name = "fail_large_file";
+
+  this->uploader_->Upload(large_file_path, dest_name,
+                          AbstractUploader::MakeClosure(
+                              &UploadCallbacks::SimpleUploadClosure,
+                              &this->delegate_,
+                              UploaderResults(99, large_file_path)));
+  this->uploader_->WaitForUpload();
+
+  EXPECT_FALSE(TestFixture::CheckFile(dest_name));
+  EXPECT_EQ(1u, this->delegate_.simple_upload_invocations);
+  EXPECT_TRUE(TestFixture::GetPendingParts().empty());
+}
+
+
+//------------------------------------------------------------------------------
+
+
 TYPED_TEST(T_Uploaders, UploadManyFilesSlow) {
   const unsigned int number_of_files = 500;
   typedef std::vector<std::pair<std::string, std::string> > Files;
@@ -847,6 +1128,199 @@ TYPED_TEST(T_Uploaders, SingleStreamedUpload) {
 //------------------------------------------------------------------------------
 
 
+TYPED_TEST(T_Uploaders, SkipExistingStreamedUpload) {
+  const std::string filter_path = this->ExistenceFilterPath();
+  this->uploader_->TearDown();
+  delete this->uploader_;
+  SpoolerDefinition spooler_definition = this->GetSpoolerDefinition();
+  spooler_definition.existence_filter_path = filter_path;
+  this->uploader_ = AbstractUploader::Construct(spooler_definition);
+  ASSERT_NE(static_cast<AbstractUploader*>(NULL), this->uploader_);
+
+  shash::Any content_hash(shash::kSha1, 'A');
+  content_hash.Randomize(42);
+  const std::string dest = "data/" + content_hash.MakePath();
+  for (unsigned i = 0; i < 2; ++i) {
+    typename TestFixture::Buffers buffers =
+        TestFixture::MakeRandomizedBuffers(1, 1337);
+    UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+        AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                      &this->delegate_,
+                                      0));
+    ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+    this->uploader_->ScheduleUpload(handle, buffers[0],
+                                    AbstractUploader::MakeClosure(
+                                        &UploadCallbacks::BufferUploadComplete,
+                                        &this->delegate_,
+                                        UploaderResults(0, buffers[0])));
+    this->uploader_->ScheduleCommit(handle, content_hash);
+    this->uploader_->WaitForUpload();
+    EXPECT_EQ(i + 1, this->delegate_.streamed_upload_complete_invocations);
+    EXPECT_EQ(i, this->uploader_->GetNumberOfSkippedUploads());
+    EXPECT_TRUE(TestFixture::CheckFile(dest));
+    TestFixture::FreeBuffers(&buffers);
+  }
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+
+  // The filter is persisted on tear down
+  this->uploader_->TearDown();
+  delete this->uploader_;
+  this->uploader_ = NULL;
+  UniquePtr<BloomFilter> filter(BloomFilter::Load(filter_path));
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_TRUE(filter->Contains(content_hash));
+
+  // Hits of the filter are verified in the backend storage
+  this->uploader_ = AbstractUploader::Construct(spooler_definition);
+  ASSERT_NE(static_cast<AbstractUploader*>(NULL), this->uploader_);
+  EXPECT_TRUE(this->uploader_->Remove(content_hash));
+  typename TestFixture::Buffers buffers =
+      TestFixture::MakeRandomizedBuffers(1, 1337);
+  UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+      AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                    &this->delegate_,
+                                    0));
+  ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+  this->uploader_->ScheduleUpload(handle, buffers[0],
+                                  AbstractUploader::MakeClosure(
+                                      &UploadCallbacks::BufferUploadComplete,
+                                      &this->delegate_,
+                                      UploaderResults(0, buffers[0])));
+  this->uploader_->ScheduleCommit(handle, content_hash);
+  this->uploader_->WaitForUpload();
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfSkippedUploads());
+  EXPECT_TRUE(TestFixture::CheckFile(dest));
+  TestFixture::CompareBuffersAndFileContents(
+      buffers,
+      TestFixture::AbsoluteDestinationPath(dest));
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, SkipManyExistingStreamedUploads) {
+  const unsigned number_of_objects = 64;
+  this->uploader_->TearDown();
+  delete this->uploader_;
+  SpoolerDefinition spooler_definition = this->GetSpoolerDefinition();
+  spooler_definition.existence_filter_path = this->ExistenceFilterPath();
+  this->uploader_ = AbstractUploader::Construct(spooler_definition);
+  ASSERT_NE(static_cast<AbstractUploader*>(NULL), this->uploader_);
+
+  std::vector<shash::Any> content_hashes;
+  for (unsigned i = 0; i < number_of_objects; ++i) {
+    shash::Any content_hash(shash::kSha1);
+    content_hash.Randomize(1000 + i);
+    content_hashes.push_back(content_hash);
+  }
+
+  // The second round only consists of filter hits, which are looked up in the
+  // backend storage concurrently
+  for (unsigned round = 0; round < 2; ++round) {
+    typename TestFixture::Buffers buffers =
+        TestFixture::MakeRandomizedBuffers(number_of_objects, 1337);
+    for (unsigned i = 0; i < number_of_objects; ++i) {
+      UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+          AbstractUploader::MakeClosure(
+              &UploadCallbacks::StreamedUploadComplete, &this->delegate_, 0));
+      ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+      this->uploader_->ScheduleUpload(handle, buffers[i],
+          AbstractUploader::MakeClosure(&UploadCallbacks::BufferUploadComplete,
+                                        &this->delegate_,
+                                        UploaderResults(0, buffers[i])));
+      this->uploader_->ScheduleCommit(handle, content_hashes[i]);
+    }
+    this->uploader_->WaitForUpload();
+    EXPECT_EQ((round + 1) * number_of_objects,
+              this->delegate_.streamed_upload_complete_invocations);
+    EXPECT_EQ(round * number_of_objects,
+              this->uploader_->GetNumberOfSkippedUploads());
+    TestFixture::FreeBuffers(&buffers);
+  }
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  for (unsigned i = 0; i < number_of_objects; ++i)
+    EXPECT_TRUE(TestFixture::CheckFile("data/" + content_hashes[i].MakePath()));
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, ObjectPackUpload) {
+  const unsigned number_of_objects = 40;
+  const unsigned buffers_per_object = 3;
+  this->uploader_->TearDown();
+  delete this->uploader_;
+  SpoolerDefinition spooler_definition = this->GetSpoolerDefinition();
+  spooler_definition.object_pack_threshold = 1024 * 1024;
+  // Uploads the pack every 4 objects
+  spooler_definition.number_of_concurrent_uploads = 8;
+  this->uploader_ = AbstractUploader::Construct(spooler_definition);
+  ASSERT_NE(static_cast<AbstractUploader*>(NULL), this->uploader_);
+
+  std::vector<typename TestFixture::Buffers> objects;
+  std::vector<shash::Any> content_hashes;
+  unsigned number_of_small_objects = 0;
+  for (unsigned i = 0; i < number_of_objects; ++i) {
+    objects.push_back(
+      TestFixture::MakeRandomizedBuffers(buffers_per_object, i));
+    shash::Any content_hash(shash::kSha1);
+    shash::ContextPtr context(shash::kSha1);
+    context.buffer = alloca(context.size);
+    shash::Init(context);
+    uint64_t size = 0;
+    for (unsigned j = 0; j < buffers_per_object; ++j) {
+      CharBuffer *buffer = objects[i][j];
+      shash::Update(buffer->ptr(), buffer->used_bytes(), context);
+      size += buffer->used_bytes();
+    }
+    shash::Final(context, &content_hash);
+    content_hashes.push_back(content_hash);
+    if (size <= spooler_definition.object_pack_threshold)
+      ++number_of_small_objects;
+
+    UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+        AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                      &this->delegate_,
+                                      0));
+    ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+    for (unsigned j = 0; j < buffers_per_object; ++j) {
+      CharBuffer *buffer = objects[i][j];
+      this->uploader_->ScheduleUpload(handle, buffer,
+          AbstractUploader::MakeClosure(&UploadCallbacks::BufferUploadComplete,
+                                        &this->delegate_,
+                                        UploaderResults(0, buffer)));
+    }
+    this->uploader_->ScheduleCommit(handle, content_hash);
+  }
+  EXPECT_LT(0u, number_of_small_objects);
+  EXPECT_GT(number_of_objects, number_of_small_objects);
+
+  this->uploader_->WaitForUpload();
+  EXPECT_EQ(number_of_objects,
+            this->delegate_.streamed_upload_complete_invocations);
+  EXPECT_EQ(number_of_objects * buffers_per_object,
+            this->delegate_.buffer_upload_complete_invocations);
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  EXPECT_EQ(number_of_small_objects,
+            this->uploader_->GetNumberOfPackedObjects());
+
+  for (unsigned i = 0; i < number_of_objects; ++i) {
+    const std::string dest = "data/" + content_hashes[i].MakePath();
+    EXPECT_TRUE(TestFixture::CheckFile(dest));
+    TestFixture::CompareBuffersAndFileContents(
+        objects[i],
+        TestFixture::AbsoluteDestinationPath(dest));
+    TestFixture::FreeBuffers(&objects[i]);
+  }
+}
+
+
+//------------------------------------------------------------------------------
+
+
 TYPED_TEST(T_Uploaders, MultipleStreamedUploadSlow) {
   const unsigned int  number_of_files        = 100;
   const unsigned int  max_buffers_per_stream = 15;
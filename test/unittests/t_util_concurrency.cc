@@ -7,6 +7,8 @@
 #include <errno.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include "util_concurrency.h"
 
 
@@ -301,6 +303,29 @@ TEST(T_UtilConcurrency, SingleThreadedFifoChannel) {
 }
 
 
+TEST(T_UtilConcurrency, FifoChannelDequeueBatch) {
+  FifoChannel<int> fifo_queue(100, 1);
+  for (int i = 0; i < 10; ++i) {
+    fifo_queue.Enqueue(i);
+  }
+
+  std::vector<int> items;
+  EXPECT_EQ(4U, fifo_queue.DequeueBatch(4, &items));
+  ASSERT_EQ(4U, items.size());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(i, items[i]);
+  }
+
+  // Does not wait for more items than available
+  EXPECT_EQ(6U, fifo_queue.DequeueBatch(100, &items));
+  ASSERT_EQ(10U, items.size());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, items[i]);
+  }
+  EXPECT_TRUE(fifo_queue.IsEmpty());
+}
+
+
 const int g_kill_signal     = -1;
 const int g_base_value      = 5;
 const int g_cpu_burn_cycles = 100;
@@ -757,6 +757,11 @@ bool MockReflog::AddMetainfo(const shash::Any &metainfo) {
   return true;
 }
 
+bool MockReflog::AddDictionary(const shash::Any &dictionary) {
+  references_[dictionary] = time(NULL);
+  return true;
+}
+
 bool MockReflog::List(
   SqlReflog::ReferenceType type,
   std::vector<shash::Any> *hashes) const
@@ -817,3 +822,7 @@ bool MockReflog::ContainsHistory(const shash::Any &history) const {
 bool MockReflog::ContainsMetainfo(const shash::Any &metainfo) const {
   return references_.count(metainfo) == 1;
 }
+
+bool MockReflog::ContainsDictionary(const shash::Any &dictionary) const {
+  return references_.count(dictionary) == 1;
+}
@@ -455,6 +455,7 @@ class MockCatalog : public MockObjectStorage<MockCatalog> {
   void SetInodeAnnotation(catalog::InodeAnnotation *new_annotation) { }
   void SetOwnerMaps(const catalog::OwnerMap *uid_map,
                     const catalog::OwnerMap *gid_map) { }
+  void EnablePathFilter(const catalog::Statistics *statistics) { }
   bool IsInitialized() const { return initialized_; }
   MockCatalog* FindSubtree(const PathString &path);
   uint64_t GetTTL() const { return 0; }
@@ -796,6 +797,7 @@ class MockReflog : public MockObjectStorage<MockReflog> {
   bool AddCatalog(const shash::Any &catalog);
   bool AddHistory(const shash::Any &history);
   bool AddMetainfo(const shash::Any &metainfo);
+  bool AddDictionary(const shash::Any &dictionary);
 
   uint64_t CountEntries() { return references_.size(); }
   bool List(SqlReflog::ReferenceType type,
@@ -812,6 +814,7 @@ class MockReflog : public MockObjectStorage<MockReflog> {
   bool ContainsCatalog(const shash::Any &catalog) const;
   bool ContainsHistory(const shash::Any &history) const;
   bool ContainsMetainfo(const shash::Any &metainfo) const;
+  bool ContainsDictionary(const shash::Any &dictionary) const;
 
   void TakeDatabaseFileOwnership() { owns_database_file_ = true;  }
   void DropDatabaseFileOwnership() { owns_database_file_ = false; }